@@ -0,0 +1,63 @@
+#ifndef _PWC_RENDER_ANIMATION_H
+#define _PWC_RENDER_ANIMATION_H
+
+#include <pwc/render/scene/node.h>
+#include <pwc/render/scene/scene.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Animation timeline. Animations drive a node's SceneTransform along a curve and are
+// evaluated once per output frame at the frame's predicted presentation time, so motion
+// follows the display and not the moment the frame happened to be recorded. Only nodes
+// whose value changed are damaged. Transforms are recorded into the cached command buffer of
+// the node's layer, so that layer is re-recorded every frame its animation moves it; the
+// other layers of the workspace stay cached.
+
+enum AnimationProperty {
+    ANIMATION_OFFSET_X = 0,
+    ANIMATION_OFFSET_Y,
+    ANIMATION_SCALE,
+    ANIMATION_OPACITY,
+};
+
+enum AnimationCurve {
+    ANIMATION_CURVE_LINEAR = 0,
+    ANIMATION_CURVE_EASE_OUT,     // Cubic, for things entering or following input
+    ANIMATION_CURVE_EASE_IN_OUT,  // Cubic, for workspace switches
+};
+
+typedef struct Animation {
+    SceneNodeHandle node;
+    enum AnimationProperty property;
+    enum AnimationCurve curve;
+    float from;
+    float to;
+    uint64_t start_ns;  // CLOCK_MONOTONIC presentation time
+    uint64_t duration_ns;
+} AnimationT;
+
+struct pwc_timeline {
+    AnimationT *animations;
+    uint32_t count;
+    uint32_t capacity;
+};
+
+// Maps linear progress t in [0, 1] through the curve
+float animation_ease(enum AnimationCurve curve, float t);
+
+struct pwc_timeline *create_timeline(void);
+void destroy_timeline(struct pwc_timeline *timeline);
+
+// Animates the property from its current value to `to`. A running animation of the same
+// property is retargeted from where it is, so interrupted transitions don't jump
+bool timeline_animate(struct pwc_timeline *timeline, SceneNodeT *node, enum AnimationProperty property, float to,
+                      enum AnimationCurve curve, uint64_t start_ns, uint64_t duration_ns);
+// Stops animating the property, leaving its current value
+void timeline_cancel(struct pwc_timeline *timeline, SceneNodeT *node, enum AnimationProperty property);
+
+// Applies the animations of nodes shown on the given workspaces at time_ns and damages the
+// nodes that changed. Finished animations and those of destroyed nodes are dropped
+void timeline_update(struct pwc_timeline *timeline, struct pwc_scene *scene, const SceneNodeHandle *workspaces,
+                     uint32_t workspace_count, uint64_t time_ns);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef _PWC_RENDER_BLUR_H
+#define _PWC_RENDER_BLUR_H
+
+#include <pwc/render/scene/node.h>
+#include <pwc/render/vulkan/vk-effects.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Cached blur-behind, one cache per output. The backdrop under a layer is rendered
+// offscreen and run through a dual-Kawase chain on the compute queue. The result is kept
+// and drawn as a single textured quad until damage under it changes the backdrop.
+
+#define MAX_BLUR_LEVELS 6
+#define BLUR_OFFSET 1.5f  // Kawase tap spread, in half texels
+
+typedef struct BlurEntry {
+    SceneNodeHandle node;
+    VkRect2D region;  // Output space, the layer's geometry
+    uint32_t levels;
+
+    EffectImageT backdrop;  // render_pass_format, what's below the region
+    VkFramebuffer framebuffer;
+    EffectImageT down[MAX_BLUR_LEVELS];  // down[i] is 1/2^(i+1) of the region
+    EffectImageT up[MAX_BLUR_LEVELS];    // up[i] is 1/2^i of the region, up[0] is the result
+
+    // Hash of the layers below the region, a blur is only redone if it changed
+    uint64_t backdrop_signature;
+    uint64_t result_serial;  // Output frame that first dispatched a blur, 0 = never
+    uint64_t used_serial;    // Last output frame that drew or dispatched from the entry
+} BlurEntryT;
+
+struct pwc_blur_cache {
+    struct pwc_vulkan *vulkan;
+    struct pwc_effects *effects;
+    struct pwc_output *output;
+
+    BlurEntryT *entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+};
+
+struct pwc_blur_cache *create_blur_cache(struct pwc_vulkan *vulkan, struct pwc_effects *effects, struct pwc_output *output);
+// The device must be idle
+void destroy_blur_cache(struct pwc_blur_cache *cache);
+
+BlurEntryT *blur_cache_find(struct pwc_blur_cache *cache, SceneNodeHandle node);
+// The node was destroyed, its entry is freed by blur_cache_sweep() once no frame uses it
+void blur_cache_forget(struct pwc_blur_cache *cache, SceneNodeHandle node);
+// Returns the entry for node sized for region, creating or resizing it. *recreated is set if
+// its images are new (cached draws of the node are stale then). NULL if effects are disabled
+BlurEntryT *blur_cache_get(struct pwc_blur_cache *cache, SceneNodeT *node, VkRect2D region, uint32_t levels, bool *recreated);
+// Frees entries not used since before the given frame serial, once no frame can use them anymore
+void blur_cache_sweep(struct pwc_blur_cache *cache, uint64_t serial);
+
+// Begins the offscreen pass into the entry's backdrop with the viewport mapping output space,
+// the caller then draws everything below the region inline
+void blur_begin_backdrop(struct pwc_blur_cache *cache, BlurEntryT *entry, VkCommandBuffer cmd);
+// Ends the pass and records the blur chain on the compute queue. serial is the output frame
+// being recorded, the result is drawn from the next one on
+void blur_end_backdrop(struct pwc_blur_cache *cache, BlurEntryT *entry, VkCommandBuffer cmd, uint64_t serial);
+
+// Whether the entry has a result the frame with this serial can draw
+bool blur_entry_ready(const BlurEntryT *entry, uint64_t serial);
+
+#endif
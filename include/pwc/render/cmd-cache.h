@@ -0,0 +1,59 @@
+#ifndef _PWC_RENDER_CMD_CACHE_H
+#define _PWC_RENDER_CMD_CACHE_H
+
+#include <pwc/render/scene/node.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Reusable secondary command buffers keyed per subtree root. A buffer is re-recorded only
+// when the subtree's serial, the root's world transform, the pipeline or the swapchain
+// changed since it was recorded. Draws bake the world transform in, and a transform of an
+// ancestor (workspace, root) never touches the subtree's serial.
+// Entries are indexed by the node handle's slot, so lookup is O(1). A destroyed node's entry
+// is forgotten right away (cmd_cache_forget()), the generation mismatch when its slot gets
+// reused is only the fallback.
+
+typedef struct CmdCacheEntry {
+    SceneNodeHandle node;
+    VkCommandPool pool;  // Own pool, so any worker can re-record the entry without locking
+
+    // One buffer per FRAME_LAG slot: a slot is only re-recorded after its fence signaled
+    VkCommandBuffer cmd[FRAME_LAG];
+    bool valid[FRAME_LAG];
+    uint64_t subtree_serial[FRAME_LAG];
+    SceneTransformT world_transform[FRAME_LAG];
+    uint64_t pipeline_serial[FRAME_LAG];
+    uint64_t swapchain_serial[FRAME_LAG];
+} CmdCacheEntryT;
+
+// One cache per output: FRAME_LAG slots and the swapchain serial are per output
+struct pwc_cmd_cache {
+    struct pwc_vulkan *vulkan;
+    struct pwc_output *output;
+
+    CmdCacheEntryT *entries;  // Indexed by handle slot
+    uint32_t entry_count;
+
+    uint32_t hits;
+    uint32_t misses;
+};
+
+struct pwc_cmd_cache *create_cmd_cache(struct pwc_vulkan *vulkan, struct pwc_output *output);
+void destroy_cmd_cache(struct pwc_cmd_cache *cache);
+
+// Returns the cached buffer for node if it's still valid for frame_slot. Otherwise returns
+// VK_NULL_HANDLE and sets *record_target to the buffer the subtree has to be re-recorded into
+VkCommandBuffer cmd_cache_lookup(struct pwc_cmd_cache *cache, SceneNodeT *node, uint32_t frame_slot, VkCommandBuffer *record_target);
+// The record target of node ended successfully, later lookups may reuse it. Until then the
+// slot stays invalid, so a failed or skipped recording is never executed from the cache
+void cmd_cache_commit(struct pwc_cmd_cache *cache, SceneNodeT *node, uint32_t frame_slot);
+// Drops every cached buffer (e.g. the device is about to lose its render pass)
+void cmd_cache_invalidate_all(struct pwc_cmd_cache *cache);
+// Frees the node's pool and buffers. None of them may be used by a frame in flight
+void cmd_cache_evict(struct pwc_cmd_cache *cache, SceneNodeHandle node);
+// The node was destroyed: nothing recorded for it is reused, the buffers are kept for the slot
+void cmd_cache_forget(struct pwc_cmd_cache *cache, SceneNodeHandle node);
+
+#endif
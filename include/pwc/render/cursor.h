@@ -0,0 +1,91 @@
+#ifndef _PWC_RENDER_CURSOR_H
+#define _PWC_RENDER_CURSOR_H
+
+#include <pwc/render/damage.h>
+#include <pwc/render/scene/node.h>
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/render/vulkan/vk-upload.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// The pointer cursor, kept out of the scene so moving it never damages the composition.
+// Where a display plane fits it, the cursor is scanned out from there and a move only
+// presents the plane at its new position. Otherwise a small pass draws it over the finished
+// composition, after saving the pixels it covers (save-under). The next frame on that
+// swapchain image copies them back first, so a frame where only the cursor moved copies,
+// saves and draws two cursor sized rects and records no scene at all. Swapchains without
+// transfer usage and cursors over CURSOR_SAVE_SIZE fall back to damaging the cursor's rects.
+
+#define CURSOR_SAVE_SIZE 256
+#define CURSOR_SAVE_IMAGES 8  // Swapchain images with a save-under, the others fall back
+#define CURSOR_DEFAULT_SIZE 24
+
+struct pwc_cursor {
+    struct pwc_textures *textures;
+    struct pwc_uploader *uploader;
+    SceneNodeT *node;  // SCENE_NODE_SURFACE, never parented: plane frames draw it like a layer
+
+    double x, y;  // Layout space, sampled once per frame
+    TextureT *texture;  // NULL hides the cursor
+    VkExtent2D size;    // Layout space
+    VkOffset2D hotspot;
+    uint64_t serial;    // Bumped whenever the image or its contents change
+
+    // The compositor's arrow, shown while no client set a cursor
+    TextureT fallback;
+    bool fallback_valid;
+    bool fallback_uploaded;
+};
+
+// Per output
+typedef struct CursorOverlay {
+    VkRect2D box;   // Whole cursor image this frame, output space
+    VkRect2D clip;  // Part of box on the output, zero extent if not drawn by the overlay
+    bool changed;   // clip or the image differ from the last drawn frame
+    bool saving;    // This frame saves what the cursor covers, otherwise clip is damaged
+
+    VkRect2D shown;  // clip of the last drawn frame
+    bool shown_saved;
+    uint64_t shown_serial;
+
+    // One CURSOR_SAVE_SIZE square per swapchain image, stacked vertically, in GENERAL
+    VkImage save;
+    VkDeviceMemory save_mem;
+    bool save_initialized;
+    bool save_failed;
+    VkRect2D saved[CURSOR_SAVE_IMAGES];  // What each image has saved, zero extent if nothing
+    uint64_t swapchain_serial;
+} CursorOverlayT;
+
+struct pwc_cursor *create_cursor(struct pwc_vulkan *vulkan, struct pwc_textures *textures, struct pwc_uploader *uploader);
+// Frames sampling the textures must have completed
+void destroy_cursor(struct pwc_cursor *cursor);
+
+// Shows texture at size (layout space) with its hotspot, NULL hides the cursor. Called again
+// whenever the texture's contents change
+void cursor_set_image(struct pwc_cursor *cursor, TextureT *texture, VkExtent2D size, VkOffset2D hotspot);
+// Shows the compositor's arrow
+void cursor_set_default(struct pwc_cursor *cursor);
+// Once per frame: uploads the arrow until it succeeds
+void cursor_prepare(struct pwc_cursor *cursor);
+
+void cursor_overlay_finish(struct pwc_vulkan *vulkan, CursorOverlayT *overlay);
+// Places the cursor on the output at origin (layout space), outside the composition if it
+// is on a plane. Returns whether the output needs a frame for it
+bool cursor_overlay_update(struct pwc_cursor *cursor, CursorOverlayT *overlay, struct pwc_output *output, VkOffset2D origin,
+                           bool on_plane);
+// Once the image is acquired, before the frame's damage is taken: adds what the save-under
+// can't handle to damage
+void cursor_overlay_damage(struct pwc_cursor *cursor, CursorOverlayT *overlay, struct pwc_output *output, uint32_t image_index,
+                           DamageRegionT *damage);
+// Before the composition draws into the image (outside a render pass): copies back what the
+// cursor covered. Nothing to do if the composition redraws the image whole
+void cursor_overlay_restore(CursorOverlayT *overlay, struct pwc_output *output, VkCommandBuffer cmd, uint32_t image_index,
+                            bool whole);
+// After the composition: saves what the cursor covers and draws it with its own pass
+void cursor_overlay_draw(struct pwc_cursor *cursor, CursorOverlayT *overlay, struct pwc_output *output, VkCommandBuffer cmd,
+                         uint32_t image_index);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef _PWC_RENDER_DAMAGE_H
+#define _PWC_RENDER_DAMAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Small rectangle list. Rects may overlap; once the list is full new rects are merged into
+// the closest existing one, so the region only ever grows (never loses damage).
+
+#define MAX_DAMAGE_RECTS 16
+
+typedef struct DamageRegion {
+    VkRect2D rects[MAX_DAMAGE_RECTS];
+    uint32_t count;
+} DamageRegionT;
+
+void damage_clear(DamageRegionT *damage);
+bool damage_is_empty(const DamageRegionT *damage);
+void damage_add_rect(DamageRegionT *damage, VkRect2D rect);
+void damage_add_region(DamageRegionT *damage, const DamageRegionT *other);
+void damage_set_whole(DamageRegionT *damage, VkExtent2D extent);
+// Clips every rect to the extent, dropping empty ones
+void damage_clip(DamageRegionT *damage, VkExtent2D extent);
+VkRect2D damage_bounds(const DamageRegionT *damage);
+bool damage_intersects(const DamageRegionT *damage, VkRect2D rect);
+
+bool rect_intersects(VkRect2D a, VkRect2D b);
+VkRect2D rect_union(VkRect2D a, VkRect2D b);
+// Part of rect inside (0,0)-extent, false if there is none
+bool rect_clip(VkRect2D rect, VkExtent2D extent, VkRect2D *out);
+
+#endif
@@ -1,13 +1,128 @@
 #ifndef _PWC_RENDER_H
 #define _PWC_RENDER_H
 
+#include <pwc/render/animation.h>
+#include <pwc/render/blur.h>
+#include <pwc/render/cmd-cache.h>
+#include <pwc/render/cursor.h>
+#include <pwc/render/damage.h>
 #include <pwc/render/scene/scene.h>
+#include <pwc/render/utils/thread-pool.h>
+#include <pwc/render/vulkan/vk-decorations.h>
+#include <pwc/render/vulkan/vk-effects.h>
+#include <pwc/render/vulkan/vk-planes.h>
+#include <pwc/render/vulkan/vk-present-timing.h>
+#include <pwc/render/vulkan/vk-recorder.h>
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/render/vulkan/vk-upload.h>
 #include <pwc/render/vulkan/vulkan.h>
+#include <pwc/render/workspace-cache.h>
+
+struct pwc_server;
+
+// Older images are fully redrawn
+#define DAMAGE_HISTORY 4
+#define MAX_OUTPUT_WORKSPACES 16
+
+// Consecutive decoration instances with nothing drawn between them, one instanced draw
+typedef struct DecorationRun {
+    uint32_t first;
+    uint32_t count;
+} DecorationRunT;
+
+// A workspace snapshot composited in place of the live scene
+typedef struct SnapshotTile {
+    SceneNodeHandle workspace;
+    VkRect2D dst;  // Output space
+} SnapshotTileT;
+
+// When a workspace of the output was last on screen
+typedef struct WorkspaceActivity {
+    uint64_t visible_ns;
+    uint64_t visible_serial;  // Last output frame that may have drawn it
+    bool hibernated;          // Cached buffers freed, snapshot reduced to a thumbnail
+} WorkspaceActivityT;
+
+// Render state of one output. Everything bound to the output's FRAME_LAG slots or
+// swapchain images lives here, the thread pool and the scene are shared
+typedef struct RenderOutput {
+    struct pwc_render *render;
+    struct pwc_output *output;
+    struct pwc_recorder *recorder;
+    struct pwc_cmd_cache *cmd_cache;
+    struct pwc_planes *planes;
+    struct pwc_blur_cache *blur;
+    struct pwc_present_timing *present_timing;
+    // Output pixels per surface coordinate, what clients are told to render at (see
+    // wp_fractional_scale_v1). From the display's density, quarter steps
+    float scale;
+
+    // Workspaces of this output. Only the active one is drawn live, the others are kept as
+    // snapshots for switches and the overview
+    SceneNodeHandle workspaces[MAX_OUTPUT_WORKSPACES];
+    uint32_t workspace_count;
+    WorkspaceActivityT activity[MAX_OUTPUT_WORKSPACES];  // Parallel to workspaces
+    uint32_t active_workspace;
+    struct pwc_workspace_cache *workspace_cache;
+    bool overview;
+    bool switching;  // Sliding from switch_from to active_workspace
+    uint32_t switch_from;
+    uint64_t switch_start_ns;
+    SnapshotTileT tiles[MAX_OUTPUT_WORKSPACES];  // Of the frame being recorded
+    uint32_t tile_count;
+
+    // Taken from the scene but not drawn yet (no free slot or image), kept for the next try
+    DamageRegionT pending;
+    bool pending_whole;
+
+    // Damage of the last DAMAGE_HISTORY frames, indexed by frame serial. An image last drawn
+    // N frames ago only needs the union of the N newest entries repainted (buffer age)
+    DamageRegionT damage_history[DAMAGE_HISTORY];
+    uint64_t *image_drawn_serial;  // Per swapchain image, 0 = contents undefined
+    uint32_t image_drawn_count;
+    uint64_t damage_swapchain_serial;
+
+    // Decorations of the frame being recorded, written to the frame slot's buffer before
+    // the recorder runs
+    DecorationInstanceT *decoration_instances;
+    uint32_t decoration_count;
+    uint32_t decoration_capacity;
+    uint32_t decoration_flushed;  // Instances already in a run
+    DecorationRunT *decoration_runs;
+    uint32_t decoration_run_count;
+    uint32_t decoration_run_capacity;
+    DecorationBufferT decoration_buffers[FRAME_LAG];
+
+    // The cursor drawn over the composition while no display plane shows it
+    CursorOverlayT cursor;
+
+    // Frame clock, CLOCK_MONOTONIC
+    uint64_t refresh_ns;
+    uint64_t next_frame_ns;
+} RenderOutputT;
 
 struct pwc_render {
     struct pwc_vulkan *vulkan;
     struct pwc_scene *scene;
 
+    struct pwc_thread_pool *threads;  // Fixed pool, one worker per CPU
+    struct pwc_uploader *uploader;    // Shared, acquired by whichever output draws next
+    struct pwc_effects *effects;      // Shared, submitted after whichever output drew last
+    struct pwc_decorations *decorations;
+    struct pwc_textures *textures;  // Client surface contents
+    struct pwc_timeline *timeline;  // Evaluated per output at its predicted presentation time
+    struct pwc_cursor *cursor;      // Position sampled from the seat once per frame
+    RenderOutputT outputs[MAX_OUTPUTS];
+    uint32_t output_count;
+
+    // Hidden workspaces hibernate after this long (0 never), or right away while device
+    // memory use is over budget (VK_EXT_memory_budget)
+    uint64_t hibernate_after_ns;
+    uint64_t budget_checked_ns;
+    bool over_budget;
+
+    struct pwc_server *server;  // Applied while waiting for the next frame, NULL runs headless
+
     bool running;
 };
 
@@ -15,6 +130,24 @@ struct pwc_render {
 
 struct pwc_render *create_render(void);
 void render_run(struct pwc_render *render);
+// Shows the output's workspace at index, sliding over between their snapshots if both exist
+void render_switch_workspace(struct pwc_render *render, uint32_t output_index, uint32_t workspace_index);
+// Composites every workspace of the output from its snapshot in a grid
+void render_set_overview(struct pwc_render *render, uint32_t output_index, bool overview);
+void render_toggle_overview(struct pwc_render *render, uint32_t output_index);
+// Whether the node is on screen: in the live workspace of an output (set to *output_index if
+// not NULL), inside it and not hidden by an opaque surface of a layer stacked above
+bool render_node_visible(struct pwc_render *render, SceneNodeT *node, uint32_t *output_index);
+// Puts a toplevel's tree on top of the active workspace of the output under the cursor, the
+// window (in surface coordinates) centered on the output at its scale, with blur-behind and
+// a drop shadow. It fades in.
+// False without a workspace to put it on
+bool render_map_toplevel(struct pwc_render *render, SceneNodeT *tree, VkRect2D window);
+// Scale of the output the node's workspace belongs to, 1 if it is in none
+float render_node_scale(struct pwc_render *render, SceneNodeT *node);
+// Top left corner of the output in layout space: outputs side by side, left to right in
+// index order
+VkOffset2D render_output_origin(struct pwc_render *render, uint32_t output_index);
 void render_destroy(struct pwc_render *render);
 
 #endif
\ No newline at end of file
@@ -2,15 +2,53 @@
 #define _PWC_RENDER_SCENE_NODE_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <vulkan/vulkan_core.h>
 enum SceneNodeType {
     SCENE_NODE_ROOT = 1,
     SCENE_NODE_WORKSPACE = 2,
     SCENE_NODE_BACKGROUND = 3,
     SCENE_NODE_CONTAINER = 4,
-    SCENE_NODE_UNKNOWN = 5
+    SCENE_NODE_UNKNOWN = 5,
+    SCENE_NODE_SURFACE = 6,  // Client buffer contents, see texture
+    // A wl_surface with everything stacked relative to it: its own SCENE_NODE_SURFACE, the
+    // trees of its subsurfaces below and above that, then its popups. Draws nothing itself,
+    // children are placed with their transform offset (relative to the parent surface) and
+    // the geometry bounds them all
+    SCENE_NODE_SURFACE_TREE = 7,
 };
 
+// Whether a subtree would benefit from its own display plane. Set by whoever owns the node,
+// the plane allocator still falls back to composition when no plane fits
+enum ScenePlaneHint {
+    SCENE_PLANE_HINT_NONE = 0,
+    SCENE_PLANE_HINT_CURSOR = 1,   // Small, moves every frame, needs per-pixel alpha
+    SCENE_PLANE_HINT_OVERLAY = 2,  // Video or fullscreen surface, updates on its own
+};
+
+// Workspace layers only (containers, toplevel surface trees): window decoration around the
+// geometry, evaluated per pixel as signed distance fields, so it costs no geometry or render
+// targets. Colors are straight alpha
+typedef struct SceneDecoration {
+    bool enabled;
+    float corner_radius;
+    float border_width;  // Inside the geometry, 0 = none
+    float fill_color[4];
+    float border_color[4];
+    float shadow_radius;  // Falloff distance, 0 = no shadow
+    float shadow_offset[2];
+    float shadow_color[4];
+} SceneDecorationT;
+
+// Presentation of the subtree on top of its geometry, what animations drive. Recorded into
+// the draws, so changing it re-records the subtree's layer. Identity is offset 0, scale 1,
+// opacity 1
+typedef struct SceneTransform {
+    float offset[2];  // Output space pixels, inherited by the subtree
+    float scale;      // Around the node's own geometry center, not inherited
+    float opacity;    // Inherited, multiplied down the tree
+} SceneTransformT;
+
 typedef struct NodeRenderData {
     VkPipeline pipeline;        // Graphics pipeline for this node type
     VkBuffer vertex_buffer;     // Vertex data (e.g., quad for background)
@@ -21,21 +59,98 @@ typedef struct NodeRenderData {
     // Add more: e.g., VkImage for textures, push constants for transforms
 } NodeRenderData;
 
+// Stable reference to a node: low bits are the slot index (+1, so 0 is never valid),
+// high bits are the slot generation. A handle to a destroyed node never resolves again: freed
+// slots are reused oldest first and a slot's 32 bit generation would only wrap after 2^32
+// nodes went through it, so IPC/protocol objects can keep it without dangling.
+typedef uint64_t SceneNodeHandle;
+
+#define SCENE_NODE_HANDLE_NULL 0
+#define SCENE_NODE_HANDLE_INDEX_BITS 32
+#define SCENE_NODE_HANDLE_INDEX_MASK ((1ull << SCENE_NODE_HANDLE_INDEX_BITS) - 1)
+#define SCENE_NODE_HANDLE_MAX_NODES (1u << 20)
+
+struct Texture;
+
 typedef struct SceneNode {
     enum SceneNodeType type;
 
-    void *data;
+    // SCENE_NODE_SURFACE: what it shows, NULL shows nothing. Owned by whoever set it
+    struct Texture *texture;
+    // SCENE_NODE_SURFACE: the part of the texture stretched over the geometry, normalized
+    // x0, y0, x1, y1 after uv_transform (enum wl_output_transform) is undone. Identity is
+    // 0, 0, 1, 1 and 0
+    float uv_rect[4];
+    uint32_t uv_transform;
 
     bool is_dirty;
+    // Bumped whenever this node or anything below it is marked dirty,
+    // render caches compare it to decide if a recorded subtree is stale
+    uint64_t subtree_serial;
+
+    SceneNodeHandle handle;
+
+    // Output space box the subtree draws into, used for damage and culling.
+    // Zero extent means it may cover the whole output
+    VkRect2D geometry;
 
-    struct SceneNode **child;
+    enum ScenePlaneHint plane_hint;
+    bool on_plane;  // Scanned out from its own plane: skipped by composition, never damages it
+
+    // Workspace layers only (containers, toplevel surface trees): blur what's below its
+    // geometry with this many dual-Kawase levels (each one doubles the radius), 0 disables
+    // blur-behind
+    uint32_t blur_levels;
+
+    SceneDecorationT decoration;
+    SceneTransformT transform;
+
+    // Children are an intrusive doubly linked list ordered bottom -> top,
+    // so unlink/restack never has to search
+    struct SceneNode *first_child;  // Bottom of the stack
+    struct SceneNode *last_child;   // Top of the stack
+    struct SceneNode *prev;         // Sibling below
+    struct SceneNode *next;         // Sibling above
     int num_child;
-    int capacity;
     struct SceneNode *parent;
 } SceneNodeT;
 
-SceneNodeT *create_scene_node(enum SceneNodeType type, void *data);
+#define scene_node_for_each_child(pos, node) \
+    for (SceneNodeT *pos = (node)->first_child; pos; pos = pos->next)
+
+SceneNodeT *create_scene_node(enum SceneNodeType type);
+// Unlinks the node, destroys its whole subtree and invalidates every handle into it. The
+// destroy listener is called for every node of the subtree first
 void destroy_scene_node(SceneNodeT *node);
+
+// Told about every destroyed node, so what is cached per node goes with it instead of
+// waiting for its handle to stop resolving. One listener, the render's
+typedef void (*SceneNodeDestroyFunc)(SceneNodeT *node, void *data);
+void scene_node_set_destroy_listener(SceneNodeDestroyFunc func, void *data);
+// Appends child on top of src's children. If child already has a parent it is moved
+// (reparent). Ignored if src is child or below it
 void scene_add_child(SceneNodeT *src, SceneNodeT *child);
 
-#endif
\ No newline at end of file
+// Marks node dirty and bumps subtree_serial up to the root, O(depth)
+void scene_node_mark_dirty(SceneNodeT *node);
+
+// Relinking is O(1), marking the parent dirty O(depth). place_above/below move node next to
+// sibling, reparenting it if needed; ignored if sibling is node or below it
+void scene_node_unlink(SceneNodeT *node);
+void scene_node_place_above(SceneNodeT *node, SceneNodeT *sibling);
+void scene_node_place_below(SceneNodeT *node, SceneNodeT *sibling);
+void scene_node_raise_to_top(SceneNodeT *node);
+void scene_node_lower_to_bottom(SceneNodeT *node);
+
+// The node's transform combined with its ancestors': offsets add up, opacities multiply
+SceneTransformT scene_node_world_transform(const SceneNodeT *node);
+// Where the geometry ends up on the output, rounded out to whole pixels
+VkRect2D scene_node_transformed_geometry(const SceneNodeT *node);
+// Transformed geometry grown by the decoration's shadow, what damage and culling have to cover
+VkRect2D scene_node_bounds(const SceneNodeT *node);
+
+SceneNodeHandle scene_node_get_handle(const SceneNodeT *node);
+// Returns NULL if the node behind the handle was destroyed
+SceneNodeT *scene_node_from_handle(SceneNodeHandle handle);
+
+#endif
@@ -4,15 +4,41 @@
 // Это должно быть дерево. Структура такая: root (have cursor and etc., not rendering by itself)->workspaces->background->widgets
 //                                                                                              ->containers (windows)
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <pwc/render/damage.h>
 #include <pwc/render/scene/node.h>
 
+// Damage is kept per workspace, the output showing a workspace takes it from there
+typedef struct WorkspaceDamage {
+    SceneNodeHandle workspace;
+    DamageRegionT damage;
+    bool whole;
+    // workspace->subtree_serial as of the last damage call. If the serial moved past it,
+    // something was marked dirty without reporting damage and the workspace is redrawn
+    uint64_t damaged_serial;
+} WorkspaceDamageT;
+
 struct pwc_scene {
     SceneNodeT *root;
+
+    WorkspaceDamageT *damage;
+    uint32_t damage_count;
+    uint32_t damage_capacity;
 };
 
 void print_scene(struct pwc_scene *scene);
 void destroy_scene(struct pwc_scene *scene);
 struct pwc_scene *create_scene(void);
 
+// Marks node dirty and damages its geometry on its workspace. For a move/resize call it
+// before and after. Damaging the root or a workspace itself damages it whole
+void scene_damage_node(struct pwc_scene *scene, SceneNodeT *node);
+// Same, but only damages the region's rects, given relative to the node's geometry
+void scene_damage_node_region(struct pwc_scene *scene, SceneNodeT *node, const DamageRegionT *region);
+void scene_damage_rect(struct pwc_scene *scene, SceneNodeT *workspace, VkRect2D rect);
+// Adds the workspace's accumulated damage to out and resets it. Returns false when the
+// whole workspace has to be redrawn (nothing is added to out then)
+bool scene_take_damage(struct pwc_scene *scene, SceneNodeT *workspace, DamageRegionT *out);
+
 #endif
\ No newline at end of file
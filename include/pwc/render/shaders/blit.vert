@@ -0,0 +1,15 @@
+#version 450
+
+// Textured quad from gl_VertexIndex (triangle strip, no vertex buffer). rect is the
+// destination in normalized device coordinates: x0, y0, x1, y1
+
+layout(push_constant) uniform Push {
+    vec4 rect;
+} push;
+
+layout(location = 0) out vec2 uv;
+
+void main() {
+    uv = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    gl_Position = vec4(mix(push.rect.xy, push.rect.zw, uv), 0.0, 1.0);
+}
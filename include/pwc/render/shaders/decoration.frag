@@ -0,0 +1,39 @@
+#version 450
+
+layout(location = 0) in vec2 pos;
+layout(location = 1) flat in vec4 rect;
+layout(location = 2) flat in vec4 fill_color;
+layout(location = 3) flat in vec4 border_color;
+layout(location = 4) flat in vec4 shadow_color;
+layout(location = 5) flat in vec4 shape;
+layout(location = 6) flat in vec2 shadow_offset;
+
+layout(location = 0) out vec4 color;  // Premultiplied
+
+// Signed distance to a rounded box, negative inside
+float rounded_box(vec2 p, vec2 center, vec2 half_size, float radius) {
+    vec2 q = abs(p - center) - half_size + radius;
+    return min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - radius;
+}
+
+void main() {
+    vec2 half_size = rect.zw * 0.5;
+    vec2 center = rect.xy + half_size;
+    float radius = min(shape.x, min(half_size.x, half_size.y));
+    float dist = rounded_box(pos, center, half_size, radius);
+
+    // Coverage is antialiased over one pixel at every edge
+    float body = clamp(0.5 - dist, 0.0, 1.0);
+    float border = shape.y > 0.0 ? clamp(dist + shape.y + 0.5, 0.0, 1.0) : 0.0;
+    vec4 surface = mix(fill_color, border_color, border);
+    color = vec4(surface.rgb * surface.a, surface.a) * body;
+
+    // The same box moved by the offset, its edge smoothed over the shadow radius. Only
+    // outside the body, so translucent windows aren't darkened by their own shadow
+    if (shape.z > 0.0) {
+        float shadow_dist = rounded_box(pos, center + shadow_offset, half_size, radius);
+        float shadow = shadow_color.a * (1.0 - smoothstep(-shape.z, shape.z, shadow_dist)) * (1.0 - body);
+        color += vec4(shadow_color.rgb * shadow, shadow);
+    }
+    color *= shape.w;
+}
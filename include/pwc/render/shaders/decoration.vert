@@ -0,0 +1,39 @@
+#version 450
+
+// One instance per decorated container. The quad covers the container plus its shadow,
+// decoration.frag evaluates the shape per pixel
+
+layout(push_constant) uniform Push {
+    vec2 extent;  // Output size in pixels
+} push;
+
+layout(location = 0) in vec4 rect;  // x, y, width, height, output space
+layout(location = 1) in vec4 fill_color;
+layout(location = 2) in vec4 border_color;
+layout(location = 3) in vec4 shadow_color;
+layout(location = 4) in vec4 shape;   // corner radius, border width, shadow radius, opacity
+layout(location = 5) in vec4 shadow;  // xy: shadow offset
+
+layout(location = 0) out vec2 pos;
+layout(location = 1) flat out vec4 out_rect;
+layout(location = 2) flat out vec4 out_fill_color;
+layout(location = 3) flat out vec4 out_border_color;
+layout(location = 4) flat out vec4 out_shadow_color;
+layout(location = 5) flat out vec4 out_shape;
+layout(location = 6) flat out vec2 out_shadow_offset;
+
+void main() {
+    vec2 lo = min(rect.xy, rect.xy + shadow.xy) - shape.z;
+    vec2 hi = max(rect.xy + rect.zw, rect.xy + rect.zw + shadow.xy) + shape.z;
+
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    pos = mix(lo, hi, corner);
+    gl_Position = vec4(pos / push.extent * 2.0 - 1.0, 0.0, 1.0);
+
+    out_rect = rect;
+    out_fill_color = fill_color;
+    out_border_color = border_color;
+    out_shadow_color = shadow_color;
+    out_shape = shape;
+    out_shadow_offset = shadow.xy;
+}
@@ -0,0 +1,30 @@
+#version 450
+
+// Surfaces minified past 2x, e.g. a buffer scale above the output's. Textures have no mip
+// levels, so the pixel's footprint is averaged from a 4x4 grid of bilinear taps instead
+
+layout(push_constant) uniform Push {
+    vec4 rect;
+    vec4 uv_rect;
+    float opacity;
+    uint transform;
+    uint sampling;
+} push;
+
+layout(binding = 0) uniform sampler2D image;
+
+layout(location = 0) in vec2 uv;
+layout(location = 0) out vec4 color;
+
+void main() {
+    vec2 dx = dFdx(uv);
+    vec2 dy = dFdy(uv);
+    vec4 sum = vec4(0.0);
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            vec2 offset = (vec2(i, j) + 0.5) / 4.0 - 0.5;
+            sum += texture(image, uv + offset.x * dx + offset.y * dy);
+        }
+    }
+    color = sum / 16.0 * push.opacity;
+}
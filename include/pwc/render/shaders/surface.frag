@@ -0,0 +1,21 @@
+#version 450
+
+layout(push_constant) uniform Push {
+    vec4 rect;
+    vec4 uv_rect;
+    float opacity;
+    uint transform;
+    uint sampling;  // 1: texels map 1:1 onto pixels, sampled nearest
+} push;
+
+layout(binding = 0) uniform sampler2D image;  // Linear
+layout(binding = 1) uniform sampler2D image_nearest;
+
+layout(location = 0) in vec2 uv;
+layout(location = 0) out vec4 color;
+
+// Client buffers are premultiplied, so is the output
+void main() {
+    vec4 texel = push.sampling == 1u ? texture(image_nearest, uv) : texture(image, uv);
+    color = texel * push.opacity;
+}
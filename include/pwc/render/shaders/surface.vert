@@ -0,0 +1,38 @@
+#version 450
+
+// Client surface quad from gl_VertexIndex (triangle strip, no vertex buffer). rect is the
+// destination in normalized device coordinates, uv_rect the sampled part of the surface
+// (viewport source crop, normalized): x0, y0, x1, y1 both. transform is the client's
+// wl_output_transform, undone per vertex, so scaled, cropped and rotated buffers are sampled
+// in place
+
+layout(push_constant) uniform Push {
+    vec4 rect;
+    vec4 uv_rect;
+    float opacity;
+    uint transform;
+    uint sampling;
+} push;
+
+layout(location = 0) out vec2 uv;
+
+// Surface to buffer coordinates, both normalized. 90 and 270 undo each other, the others
+// undo themselves
+vec2 buffer_coords(vec2 s, uint transform) {
+    switch (transform) {
+        case 1u: return vec2(1.0 - s.y, s.x);
+        case 2u: return 1.0 - s;
+        case 3u: return vec2(s.y, 1.0 - s.x);
+        case 4u: return vec2(1.0 - s.x, s.y);
+        case 5u: return 1.0 - s.yx;
+        case 6u: return vec2(s.x, 1.0 - s.y);
+        case 7u: return s.yx;
+        default: return s;
+    }
+}
+
+void main() {
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    uv = buffer_coords(mix(push.uv_rect.xy, push.uv_rect.zw, corner), push.transform);
+    gl_Position = vec4(mix(push.rect.xy, push.rect.zw, corner), 0.0, 1.0);
+}
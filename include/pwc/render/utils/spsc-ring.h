@@ -0,0 +1,37 @@
+#ifndef _PWC_RENDER_UTILS_SPSC_RING
+#define _PWC_RENDER_UTILS_SPSC_RING
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bounded single-producer/single-consumer ring of fixed-size elements. Lock-free: each side
+// only stores its own index (release) and loads the other's (acquire), so one thread may push
+// while another pops without ever blocking either. A full ring refuses the push.
+
+#define SPSC_RING_CACHE_LINE 64
+
+struct pwc_spsc_ring {
+    uint8_t *slots;
+    uint32_t element_size;
+    uint32_t mask;  // Capacity - 1, capacity is a power of two
+
+    // Indices only grow (modulo 2^32), their difference is the fill level. Kept on their own
+    // lines so the two threads don't bounce one between them
+    alignas(SPSC_RING_CACHE_LINE) _Atomic uint32_t head;  // Consumer
+    uint32_t cached_tail;                                  // Consumer's last look at tail
+    alignas(SPSC_RING_CACHE_LINE) _Atomic uint32_t tail;  // Producer
+    uint32_t cached_head;                                  // Producer's last look at head
+};
+
+// capacity is rounded up to a power of two
+struct pwc_spsc_ring *create_spsc_ring(uint32_t capacity, uint32_t element_size);
+void destroy_spsc_ring(struct pwc_spsc_ring *ring);
+
+// Producer only. False if the ring is full, element isn't queued then
+bool spsc_ring_push(struct pwc_spsc_ring *ring, const void *element);
+// Consumer only. False if the ring is empty
+bool spsc_ring_pop(struct pwc_spsc_ring *ring, void *element);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _PWC_RENDER_UTILS_THREAD_POOL
+#define _PWC_RENDER_UTILS_THREAD_POOL
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Job callback. worker_index is stable per thread (0..thread_count-1), so jobs can use it
+// to pick per-thread resources (command pools etc.) without locking.
+typedef void (*pwc_job_fn)(void *arg, uint32_t worker_index);
+
+typedef struct PwcJob {
+    pwc_job_fn fn;
+    void *arg;
+} PwcJobT;
+
+struct pwc_thread_pool {
+    pthread_t *threads;
+    uint32_t thread_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_available;
+    pthread_cond_t jobs_done;
+
+    // Ring buffer of queued jobs
+    PwcJobT *jobs;
+    uint32_t job_capacity;
+    uint32_t job_head;
+    uint32_t job_count;
+
+    uint32_t jobs_in_flight;  // Queued + running
+    bool quit;
+};
+
+// thread_count == 0 sizes the pool to the number of online CPUs
+struct pwc_thread_pool *create_thread_pool(uint32_t thread_count);
+void destroy_thread_pool(struct pwc_thread_pool *pool);
+
+bool thread_pool_submit(struct pwc_thread_pool *pool, pwc_job_fn fn, void *arg);
+// Blocks until every submitted job has finished
+void thread_pool_wait(struct pwc_thread_pool *pool);
+
+#endif
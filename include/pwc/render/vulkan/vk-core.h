@@ -6,6 +6,7 @@
 #include <vulkan/vulkan_core.h>
 
 struct pwc_vulkan;
+struct pwc_output;
 
 typedef struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
@@ -16,7 +17,8 @@ typedef struct SwapChainSupportDetails {
     VkBool32 *supports_present;
 } SwapChainSupportDetails;
 
-SwapChainSupportDetails query_swap_chain_support(struct pwc_vulkan *vulkan);
+SwapChainSupportDetails query_swap_chain_support(struct pwc_vulkan *vulkan, struct pwc_output *output);
+void free_swap_chain_support(SwapChainSupportDetails *details);
 VkSurfaceFormatKHR choose_swap_surface_mode(const VkSurfaceFormatKHR *surface_formats, uint32_t count);
 VkPresentModeKHR choose_swap_present_mode(uint32_t modes_count, VkPresentModeKHR *available_modes);
 VkExtent2D choose_swap_surface_extent(VkSurfaceCapabilitiesKHR capabilities);
@@ -27,11 +29,35 @@ uint32_t get_swap_image_count(VkSurfaceCapabilitiesKHR capabilities);
 void create_vulkan_instance(struct pwc_vulkan *vulkan);
 
 void create_logical_device(struct pwc_vulkan *vulkan);
+// Index of the first memory type in type_bits with all of properties, UINT32_MAX if none
+uint32_t find_memory_type(struct pwc_vulkan *vulkan, uint32_t type_bits, VkMemoryPropertyFlags properties);
+// Usage and budget summed over the device local heaps. False without VK_EXT_memory_budget
+bool query_memory_budget(struct pwc_vulkan *vulkan, VkDeviceSize *usage, VkDeviceSize *budget);
 void pick_physical_device(struct pwc_vulkan *vulkan);
-void create_display_surface(struct pwc_vulkan *vulkan);
-void create_swapchain(struct pwc_vulkan *vulkan);
-void create_image_views(struct pwc_vulkan *vulkan);
+bool create_display_surface(struct pwc_vulkan *vulkan, struct pwc_output *output);
+void create_outputs(struct pwc_vulkan *vulkan);
+void create_swapchain(struct pwc_vulkan *vulkan, struct pwc_output *output);
+void create_image_views(struct pwc_vulkan *vulkan, struct pwc_output *output);
+void create_render_pass(struct pwc_vulkan *vulkan, VkFormat format);
+void create_framebuffers(struct pwc_vulkan *vulkan, struct pwc_output *output);
+void create_image_semaphores(struct pwc_vulkan *vulkan, struct pwc_output *output);
+void create_submission_resources(struct pwc_vulkan *vulkan, struct pwc_output *output);
 void create_graphics_pipeline(struct pwc_vulkan *vulkan);
+// Loads name from PWC_SHADER_DIR. Returns VK_NULL_HANDLE if it's missing or invalid
+VkShaderModule load_shader(struct pwc_vulkan *vulkan, const char *name);
 void prepare_vulkan(struct pwc_vulkan *vulkan);
 
+bool init_output(struct pwc_vulkan *vulkan, struct pwc_output *output);
+void destroy_output(struct pwc_vulkan *vulkan, struct pwc_output *output);
+
+// Never wait for frames in flight. Return false while the retired list is full: nothing
+// changed, the caller retries once a frame of the output completed
+bool recreate_swapchain(struct pwc_vulkan *vulkan, struct pwc_output *output);
+bool recreate_display_surface(struct pwc_vulkan *vulkan, struct pwc_output *output);
+void swapchain_frame_completed(struct pwc_vulkan *vulkan, struct pwc_output *output, uint64_t serial);
+void release_retired_swapchains(struct pwc_vulkan *vulkan, struct pwc_output *output, bool force);
+// Non-blocking: observes every frame slot whose fence signaled, not only the one about to be
+// reused. For consumers waiting on completed_serial while the output is idle
+void poll_frames_completed(struct pwc_vulkan *vulkan, struct pwc_output *output);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef _PWC_RENDER_VULKAN_DECORATIONS
+#define _PWC_RENDER_VULKAN_DECORATIONS
+
+#include <pwc/render/scene/node.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Window decorations (rounded corners, border, drop shadow) as signed distance fields. Every
+// decoration is one instance of a quad covering the layer and its shadow, so
+// consecutive decorations of any number of windows are a single instanced draw.
+
+// Per instance vertex attributes, every field is one vec4 attribute
+typedef struct DecorationInstance {
+    float rect[4];  // x, y, width, height, output space
+    float fill_color[4];
+    float border_color[4];
+    float shadow_color[4];
+    float shape[4];   // corner radius, border width, shadow radius, opacity
+    float shadow[4];  // shadow offset x, y, unused
+} DecorationInstanceT;
+
+// Host visible instances of one output frame slot, rewritten each frame the slot draws
+typedef struct DecorationBuffer {
+    VkBuffer buffer;
+    VkDeviceMemory mem;
+    void *map;
+    uint32_t capacity;  // Instances
+} DecorationBufferT;
+
+struct pwc_decorations {
+    struct pwc_vulkan *vulkan;
+    bool enabled;  // The pipeline was created
+
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+};
+
+// Decorations are disabled (enabled = false) if the shaders aren't available
+struct pwc_decorations *create_decorations(struct pwc_vulkan *vulkan);
+// The device must be idle
+void destroy_decorations(struct pwc_decorations *decorations);
+
+// Takes the node's world transform as of now, so animated decorations only cost the
+// per frame instance upload
+void decoration_instance_init(DecorationInstanceT *instance, const SceneNodeT *node);
+
+// Copies count instances into buffer, growing it if needed. No frame in flight may use it
+bool decoration_buffer_write(struct pwc_decorations *decorations, DecorationBufferT *buffer,
+                             const DecorationInstanceT *instances, uint32_t count);
+void decoration_buffer_finish(struct pwc_decorations *decorations, DecorationBufferT *buffer);
+
+// Draws instances [first, first + count) of buffer in one instanced draw inside a pass of
+// vulkan->render_pass whose viewport maps output space, extent is the output's. Safe from
+// recorder workers
+void decorations_draw(struct pwc_decorations *decorations, VkCommandBuffer cmd, const DecorationBufferT *buffer,
+                      uint32_t first, uint32_t count, VkExtent2D extent);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef _PWC_RENDER_VULKAN_DMABUF
+#define _PWC_RENDER_VULKAN_DMABUF
+
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Client dmabufs imported as sampled images (VK_EXT_external_memory_dma_buf with explicit
+// VK_EXT_image_drm_format_modifier layouts). The format/modifier pairs the device can import
+// and sample are queried once, they are what linux-dmabuf advertises. Planes of one buffer
+// have to share a dmabuf (no disjoint images).
+
+#define DMABUF_MAX_PLANES 4
+
+typedef struct DmabufAttributes {
+    uint32_t width, height;
+    uint32_t format;  // DRM fourcc
+    uint64_t modifier;
+    uint32_t plane_count;
+    int fds[DMABUF_MAX_PLANES];
+    uint32_t offsets[DMABUF_MAX_PLANES];
+    uint32_t strides[DMABUF_MAX_PLANES];
+} DmabufAttributesT;
+
+typedef struct DmabufModifier {
+    uint64_t modifier;
+    uint32_t plane_count;
+    VkExtent2D max_extent;
+} DmabufModifierT;
+
+typedef struct DmabufFormat {
+    uint32_t drm_format;
+    VkFormat vk_format;
+    bool opaque;  // X formats, alpha sampled as 1
+    DmabufModifierT *modifiers;
+    uint32_t modifier_count;
+} DmabufFormatT;
+
+struct pwc_dmabuf_formats {
+    struct pwc_vulkan *vulkan;
+    DmabufFormatT *formats;  // Only formats with at least one modifier
+    uint32_t format_count;
+};
+
+// Empty (format_count 0) without vulkan->dmabuf_import
+struct pwc_dmabuf_formats *create_dmabuf_formats(struct pwc_vulkan *vulkan);
+void destroy_dmabuf_formats(struct pwc_dmabuf_formats *formats);
+// NULL if the pair can't be imported
+const DmabufModifierT *dmabuf_find_modifier(const struct pwc_dmabuf_formats *formats, uint32_t drm_format, uint64_t modifier,
+                                            const DmabufFormatT **format);
+
+// Imports attributes into texture (see texture_import()). The fds stay owned by the caller
+bool dmabuf_import(struct pwc_dmabuf_formats *formats, struct pwc_textures *textures, TextureT *texture,
+                   const DmabufAttributesT *attributes);
+
+#endif
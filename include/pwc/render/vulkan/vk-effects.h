@@ -0,0 +1,115 @@
+#ifndef _PWC_RENDER_VULKAN_EFFECTS
+#define _PWC_RENDER_VULKAN_EFFECTS
+
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Compute effects (blur, color transforms, thumbnails) on the async compute queue. Passes are
+// recorded into a batch that is submitted right after a frame and waits for everything the
+// graphics queue did up to that frame. The next frame samples the results, so effect work
+// overlaps raster work instead of sitting on the graphics queue's critical path.
+
+#define EFFECT_BATCHES (FRAME_LAG + 1)
+#define EFFECT_MAX_PASSES 64  // Per batch
+#define EFFECT_MAX_IMAGES 256
+#define EFFECT_PUSH_SIZE 32
+// Storage format of every pass's dst
+#define EFFECT_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+// Every effect pipeline takes src (sampled, linear clamp) at binding 0 and dst (storage)
+// at binding 1, plus up to EFFECT_PUSH_SIZE bytes of push constants
+enum EffectPipeline {
+    EFFECT_DOWNSCALE = 0,
+    EFFECT_KAWASE_DOWN,  // float offset
+    EFFECT_KAWASE_UP,    // float offset
+    EFFECT_PIPELINE_COUNT,
+};
+
+// Shared by the graphics and compute families. Stays in GENERAL once initialized, also
+// while graphics renders into or samples it
+typedef struct EffectImage {
+    VkImage image;
+    VkDeviceMemory mem;
+    VkImageView view;
+    VkExtent2D extent;
+    VkFormat format;
+    VkDescriptorSet sample_set;  // For effects_draw()
+    bool initialized;  // Layout is GENERAL
+} EffectImageT;
+
+enum EffectBatchState {
+    EFFECT_BATCH_FREE = 0,
+    EFFECT_BATCH_RECORDING,
+    EFFECT_BATCH_SUBMITTED,  // Results not waited on by a frame yet
+    EFFECT_BATCH_ACQUIRED,   // Waited on by a frame, free once that frame completed
+};
+
+typedef struct EffectBatch {
+    enum EffectBatchState state;
+    VkCommandBuffer cmd;
+    VkDescriptorPool descriptor_pool;  // Reset per batch
+    uint32_t pass_count;
+
+    VkSemaphore input_semaphore;  // Graphics -> compute, signaled by the frame submission
+    VkSemaphore done_semaphore;   // Compute -> graphics, waited on by the next frame
+
+    // Frame that waited on the results
+    struct pwc_output *output;
+    uint64_t serial;
+} EffectBatchT;
+
+struct pwc_effects {
+    struct pwc_vulkan *vulkan;
+    bool enabled;  // Every pipeline was created
+
+    VkCommandPool pool;  // Compute family
+    VkSampler sampler;
+    VkDescriptorSetLayout set_layout;
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipelines[EFFECT_PIPELINE_COUNT];
+
+    // Draws effect images inside vulkan->render_pass
+    VkDescriptorSetLayout blit_set_layout;
+    VkPipelineLayout blit_pipeline_layout;
+    VkPipeline blit_pipeline;
+    VkDescriptorPool image_descriptor_pool;  // One sample_set per effect image
+
+    EffectBatchT batches[EFFECT_BATCHES];
+    EffectBatchT *recording;  // Batch of the next submit, NULL if nothing was recorded
+};
+
+// Effects are disabled (enabled = false) if the compute shaders aren't available
+struct pwc_effects *create_effects(struct pwc_vulkan *vulkan);
+// The device must be idle
+void destroy_effects(struct pwc_effects *effects);
+
+// Only EFFECT_FORMAT images can be a pass's dst, others (e.g. render_pass_format ones graphics
+// renders into) can only be sampled
+bool effect_image_init(struct pwc_effects *effects, EffectImageT *image, VkExtent2D extent, VkFormat format);
+// The image must not be used by any batch or frame in flight
+void effect_image_finish(struct pwc_effects *effects, EffectImageT *image);
+
+// Records one pass reading src and writing dst into the batch of the next submit. Passes
+// of a batch run in order. Returns false if effects are disabled or no batch is free, dst
+// keeps its previous contents then
+bool effects_dispatch(struct pwc_effects *effects, enum EffectPipeline pipeline, EffectImageT *src, EffectImageT *dst,
+                      const void *push, uint32_t push_size);
+
+// Semaphore the frame submission has to signal before the batch may run (it reads what the
+// frame drew), VK_NULL_HANDLE if nothing was recorded. Must be followed by effects_submit()
+VkSemaphore effects_input_semaphore(struct pwc_effects *effects);
+// Submits the recorded batch to the compute queue, called after the frame was submitted
+void effects_submit(struct pwc_effects *effects);
+
+// Draws image stretched over dst (output space) inside a pass of vulkan->render_pass whose
+// viewport maps output space, extent is the output's. Safe from recorder workers
+void effects_draw(struct pwc_effects *effects, VkCommandBuffer cmd, const EffectImageT *image, VkRect2D dst, VkExtent2D extent);
+
+// Returns how many semaphores the frame has to wait on before sampling effect results,
+// written to semaphores and stages. serial is the frame_serial the submission will get on output
+uint32_t effects_acquire(struct pwc_effects *effects, struct pwc_output *output, uint64_t serial,
+                         VkSemaphore *semaphores, VkPipelineStageFlags *stages, uint32_t max);
+
+#endif
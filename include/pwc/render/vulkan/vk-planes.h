@@ -0,0 +1,119 @@
+#ifndef _PWC_RENDER_VULKAN_PLANES
+#define _PWC_RENDER_VULKAN_PLANES
+
+#include <pwc/render/scene/node.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Display plane allocator. The primary plane scans out the composited image, the other planes
+// of the display can each scan out one subtree (cursor, video, fullscreen surface) from their
+// own swapchain. Updating or moving such a subtree redraws only its plane, never the composition.
+
+#define MAX_PLANE_ASSIGNMENTS 4
+// A retired plane keeps its bit in vulkan->claimed_planes (64 bits) until its swapchain is
+// destroyed, so no allocator ever has more retired at once and planes_release() never waits
+#define MAX_RETIRED_PLANES 64
+#define MAX_PLANE_WAITS 32  // Semaphores planes_submit() waits on besides the acquired images
+
+typedef struct DisplayPlane {
+    uint32_t index;
+    VkDisplayPlaneCapabilitiesKHR capabilities;  // For the current display mode
+    bool in_use;
+} DisplayPlaneT;
+
+typedef struct PlaneAssignment {
+    SceneNodeHandle node;  // SCENE_NODE_HANDLE_NULL: slot is free
+    DisplayPlaneT *plane;
+    VkRect2D dst;          // Where the plane is shown, output space
+    uint64_t drawn_serial;  // Content serial of the last presented image
+    bool shown;            // An image was presented
+    bool lost;             // A present failed, the plane has to be released
+
+    VkSurfaceKHR surface;
+    VkSwapchainKHR swapchain;
+    VkExtent2D extent;
+    uint32_t image_count;
+    VkImage *images;
+    VkImageView *image_views;
+    VkFramebuffer *framebuffers;
+    VkSemaphore *draw_complete_semaphores;  // Per image
+    uint64_t *image_serials;                // Per image, content serial it holds, 0 if undefined
+
+    VkSemaphore image_acquired_semaphores[FRAME_LAG];  // Per frame slot of the allocator
+    uint32_t image_index;    // Acquired by plane_acquire()
+    bool queued;             // Acquired for the frame being recorded
+    uint64_t queued_serial;  // Content serial the queued image holds
+} PlaneAssignmentT;
+
+// A released assignment's swapchain, destroyed once the plane frames that used it completed.
+// The plane stays claimed until then
+typedef struct RetiredPlane {
+    PlaneAssignmentT assignment;
+    uint32_t plane_index;
+    uint64_t retire_serial;
+} RetiredPlaneT;
+
+struct pwc_planes {
+    struct pwc_vulkan *vulkan;
+    struct pwc_output *output;
+    VkDisplayModeKHR display_mode;  // Capabilities were queried for this mode
+
+    // Planes usable on the output's display, its primary one excluded. Planes that can
+    // reach several displays are shared through vulkan->claimed_planes
+    DisplayPlaneT *planes;
+    uint32_t plane_count;
+    uint32_t display_plane_count;  // All planes of the device, bounds the stack index
+
+    PlaneAssignmentT assignments[MAX_PLANE_ASSIGNMENTS];
+    RetiredPlaneT retired[MAX_RETIRED_PLANES];
+    uint32_t retired_count;
+
+    // The planes redrawn in one frame go out in a single submission. Own FRAME_LAG slots and
+    // serials, plane frames are paced independently of the output's
+    VkCommandBuffer cmd[FRAME_LAG];
+    VkFence fences[FRAME_LAG];
+    uint64_t serials[FRAME_LAG];
+    uint32_t frame_slot;
+    uint64_t frame_serial;      // Last submitted
+    uint64_t completed_serial;  // Last one whose fence was seen signaled
+    bool recording;
+};
+
+// Without VK_KHR_display_swapchain planes can't be positioned, plane_count is 0 then
+struct pwc_planes *create_planes(struct pwc_vulkan *vulkan, struct pwc_output *output);
+// The device must be idle
+void destroy_planes(struct pwc_planes *planes);
+// The output's display mode changed: every assignment is released and the planes are queried
+// again. plane_count stays 0 if that fails, everything is composited then
+void planes_update_mode(struct pwc_planes *planes);
+
+PlaneAssignmentT *planes_find(struct pwc_planes *planes, SceneNodeHandle node);
+// Puts node on a free plane able to show it at its geometry with the alpha its hint needs.
+// Returns NULL if no plane fits, the node stays composited then
+PlaneAssignmentT *planes_assign(struct pwc_planes *planes, SceneNodeT *node);
+// The swapchain is retired, never waited for. Not while the assignment is queued
+void planes_release(struct pwc_planes *planes, PlaneAssignmentT *assignment);
+// Whether the assigned plane can show geometry without a new swapchain (same size, and the
+// position is within the plane's limits)
+bool plane_fits(const PlaneAssignmentT *assignment, VkRect2D geometry);
+
+// Begins the frame's plane submission (graphics, outside a render pass). Returns NULL while
+// the frame slot is still in flight, the planes keep their images then. Never blocks
+VkCommandBuffer planes_begin_frame(struct pwc_planes *planes);
+// Acquires the assignment's next image for the frame without waiting and queues it. Returns
+// VK_NOT_READY while every image is queued for display, any other error means the plane
+// swapchain is unusable
+VkResult plane_acquire(struct pwc_planes *planes, PlaneAssignmentT *assignment);
+// Whether the acquired image already holds content_serial: a move only presents it again
+bool plane_image_current(const PlaneAssignmentT *assignment, uint64_t content_serial);
+// Begins the render pass on the acquired image, with the viewport set so output space
+// drawing lands on the plane
+void plane_begin_draw(struct pwc_planes *planes, PlaneAssignmentT *assignment);
+void plane_end_draw(struct pwc_planes *planes, PlaneAssignmentT *assignment, uint64_t content_serial);
+// Submits the frame, waiting on count (at most MAX_PLANE_WAITS) semaphores too, and presents every queued image at its
+// assignment's dst. Assignments whose present failed are marked lost
+void planes_submit(struct pwc_planes *planes, const VkSemaphore *semaphores, const VkPipelineStageFlags *stages, uint32_t count);
+
+#endif
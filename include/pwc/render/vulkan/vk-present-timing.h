@@ -0,0 +1,69 @@
+#ifndef _PWC_RENDER_VULKAN_PRESENT_TIMING
+#define _PWC_RENDER_VULKAN_PRESENT_TIMING
+
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// When the frames of an output reached the display. With VK_GOOGLE_display_timing the
+// driver reports each present's vblank. Otherwise a completed frame is assumed to show at
+// the first vblank after its submission, extrapolated on the refresh cycle from the last one.
+// Sequences come from the swapchain's vblank counter (VK_EXT_display_control) or are counted
+// along. All times are CLOCK_MONOTONIC.
+
+#define PRESENT_TIMING_PENDING 16
+// Frames the driver hasn't reported after this long are estimated
+#define PRESENT_TIMING_TIMEOUT_NS 100000000ull
+
+// Same bits as wp_presentation_feedback.kind
+enum PresentedFlags {
+    PRESENTED_VSYNC = 0x1,
+    PRESENTED_HW_CLOCK = 0x2,
+    PRESENTED_HW_COMPLETION = 0x4,
+    PRESENTED_ZERO_COPY = 0x8,
+};
+
+typedef struct PresentedFrame {
+    uint64_t serial;  // Output frame serial
+    bool discarded;   // Never shown (e.g. its swapchain was replaced), nothing else is set
+    uint64_t time_ns;
+    uint64_t refresh_ns;
+    uint64_t sequence;
+    uint32_t flags;
+} PresentedFrameT;
+
+typedef struct PendingPresent {
+    uint64_t serial;
+    uint64_t submit_ns;
+    uint64_t swapchain_serial;
+} PendingPresentT;
+
+struct pwc_present_timing {
+    struct pwc_vulkan *vulkan;
+    struct pwc_output *output;
+
+    PendingPresentT pending[PRESENT_TIMING_PENDING];  // Oldest first
+    uint32_t pending_count;
+
+    uint64_t refresh_ns;
+    uint64_t refresh_swapchain_serial;  // Swapchain refresh_ns was queried from
+    // Last reported vblank, base of the estimates. 0 before the first one
+    uint64_t last_time_ns;
+    uint64_t last_sequence;
+};
+
+struct pwc_present_timing *create_present_timing(struct pwc_vulkan *vulkan, struct pwc_output *output);
+void destroy_present_timing(struct pwc_present_timing *timing);
+
+// Fills *info (chained in front of next) for vkQueuePresentKHR if the driver reports
+// presents, returns what to put into VkPresentInfoKHR.pNext
+const void *present_timing_present_info(struct pwc_present_timing *timing, uint64_t serial, VkPresentTimeGOOGLE *time,
+                                        VkPresentTimesInfoGOOGLE *info, const void *next);
+// The frame was queued for presentation at now_ns
+void present_timing_submitted(struct pwc_present_timing *timing, uint64_t serial, uint64_t now_ns);
+// Frames whose presentation became known since the last call, oldest first, into frames
+// (PRESENT_TIMING_PENDING entries). Returns the count
+uint32_t present_timing_poll(struct pwc_present_timing *timing, uint64_t now_ns, PresentedFrameT *frames);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef _PWC_RENDER_VULKAN_RECORDER
+#define _PWC_RENDER_VULKAN_RECORDER
+
+#include <pwc/render/utils/thread-pool.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Parallel command recording. Each job records into its own secondary command buffer
+// allocated from the executing worker's command pool, the primary buffer then executes
+// the secondaries in the order the jobs were added.
+
+struct pwc_recorder;
+
+typedef void (*pwc_record_fn)(struct pwc_recorder *recorder, VkCommandBuffer cmd, void *arg);
+
+// One per worker thread per FRAME_LAG slot, so a slot's pools can be reset as soon as
+// the slot's fence signaled, without touching buffers of the frame still in flight
+typedef struct RecorderCommandPool {
+    VkCommandPool pool;
+    VkCommandBuffer *buffers;
+    uint32_t count;  // Allocated
+    uint32_t used;   // Handed out this frame
+} RecorderCommandPoolT;
+
+typedef struct RecordJob {
+    pwc_record_fn fn;      // NULL for prerecorded buffers
+    void *arg;
+    VkCommandBuffer target;  // Caller owned buffer for persistent jobs, NULL for transient ones
+    pwc_record_fn recorded;  // Persistent jobs: called once target was recorded successfully
+    VkCommandBuffer cmd;     // Filled in by the worker
+    struct pwc_recorder *recorder;
+} RecordJobT;
+
+struct pwc_recorder {
+    struct pwc_vulkan *vulkan;
+    struct pwc_thread_pool *threads;
+    void *user_data;
+
+    RecorderCommandPoolT *pools[FRAME_LAG];  // [threads->thread_count]
+    uint32_t frame_slot;
+
+    VkCommandBufferInheritanceInfo inheritance;
+    // Same render pass, no framebuffer: persistent buffers stay valid across swapchain images
+    VkCommandBufferInheritanceInfo persistent_inheritance;
+    VkExtent2D extent;
+    VkRect2D scissor;  // Transient jobs only, persistent ones are reused across frames and cover the extent
+
+    RecordJobT *jobs;
+    uint32_t job_count;
+    uint32_t job_capacity;
+    VkCommandBuffer *executed;
+};
+
+struct pwc_recorder *create_recorder(struct pwc_vulkan *vulkan, struct pwc_thread_pool *threads, void *user_data);
+void destroy_recorder(struct pwc_recorder *recorder);
+
+// Must be called after the fence of frame_slot has been waited on.
+// render_pass may be any pass compatible with the one persistent buffers were recorded for
+void recorder_begin_frame(struct pwc_recorder *recorder, uint32_t frame_slot, VkRenderPass render_pass, VkFramebuffer framebuffer,
+                          VkExtent2D extent, VkRect2D scissor);
+void recorder_add_job(struct pwc_recorder *recorder, pwc_record_fn fn, void *arg);
+// Records into a caller owned secondary that can be re-executed in later frames.
+// target must come from a pool with VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+// and must not be used by any frame still in flight. recorded (may be NULL) is called from
+// recorder_execute() on the calling thread, only if target ended successfully
+void recorder_add_persistent_job(struct pwc_recorder *recorder, pwc_record_fn fn, void *arg, VkCommandBuffer target,
+                                 pwc_record_fn recorded);
+// Executes an already recorded persistent secondary at this position
+void recorder_add_prerecorded(struct pwc_recorder *recorder, VkCommandBuffer cmd);
+// Records every job in parallel, then vkCmdExecuteCommands them into primary.
+// primary must be inside a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+void recorder_execute(struct pwc_recorder *recorder, VkCommandBuffer primary);
+
+#endif
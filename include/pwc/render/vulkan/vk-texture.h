@@ -0,0 +1,124 @@
+#ifndef _PWC_RENDER_VULKAN_TEXTURE
+#define _PWC_RENDER_VULKAN_TEXTURE
+
+#include <pwc/render/damage.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Client surface contents sampled by the composition. A texture has two images: an update
+// is written into the one no frame in flight samples, which then becomes the front. Images
+// are shared by the graphics and transfer families, so only damaged rects are uploaded and
+// the rest stays in place without ownership transfers. Only 32bpp formats. Imported textures
+// (dmabufs) have a single image the client renders into, acquired by the next frame after
+// every commit.
+//
+// Images have no mip levels. A draw samples nearest where texels map 1:1 onto pixels, linear
+// when scaled, and averages the footprint with the downscale variant when minified past 2x.
+
+#define TEXTURE_IMAGES 2
+#define TEXTURE_POOL_SETS 256  // Descriptor sets per pool, another pool is created when they are all taken
+#define TEXTURE_MAX_READERS 32  // Each output registers its plane frame and snapshot fences
+
+typedef struct TextureImage {
+    VkImage image;
+    VkDeviceMemory mem;
+    VkImageView view;
+    VkDescriptorSet sample_set;
+    uint32_t sample_pool;  // Index of the pool sample_set came from
+    bool initialized;      // Holds contents, SHADER_READ_ONLY_OPTIMAL
+    DamageRegionT missing;  // Updated in the other image since this one was written
+    // Per output (by index): the last frame that may sample it, set when it stops being the front
+    uint64_t retired_serial[MAX_OUTPUTS];
+    uint32_t reader_mask;  // Readers (bit per textures->readers) unsignaled when it was retired
+} TextureImageT;
+
+typedef struct TexturePool {
+    VkDescriptorPool pool;
+    uint32_t used;  // Sets allocated from it, at most TEXTURE_POOL_SETS
+} TexturePoolT;
+
+typedef struct Texture {
+    TextureImageT images[TEXTURE_IMAGES];
+    uint32_t front;
+    VkExtent2D extent;
+    VkFormat format;
+    bool opaque;    // Alpha is sampled as 1 (XRGB)
+    bool imported;  // images[0] only, never updated through texture_begin_update()
+} TextureT;
+
+struct pwc_textures {
+    struct pwc_vulkan *vulkan;
+    bool enabled;  // The pipeline was created
+
+    VkSampler sampler;          // Linear
+    VkSampler nearest_sampler;
+    VkDescriptorSetLayout set_layout;
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+    VkPipeline downscale_pipeline;  // VK_NULL_HANDLE without its shader, linear instead
+
+    // Sample sets of every texture, grown on demand and kept until destroy_textures()
+    TexturePoolT *pools;
+    uint32_t pool_count;
+    uint32_t pool_capacity;
+
+    // Fences of submissions other than output frames that sample textures (snapshots, planes)
+    VkFence readers[TEXTURE_MAX_READERS];
+    uint32_t reader_count;
+
+    // Imported images written by their client since the last frame, acquired before it samples them
+    VkImage *acquires;
+    uint32_t acquire_count;
+    uint32_t acquire_capacity;
+
+    // Images of finished textures, destroyed once no frame samples them
+    TextureImageT *retired;
+    uint32_t retired_count;
+    uint32_t retired_capacity;
+};
+
+// Textures are disabled (enabled = false) if the shaders aren't available
+struct pwc_textures *create_textures(struct pwc_vulkan *vulkan);
+// The device must be idle
+void destroy_textures(struct pwc_textures *textures);
+// Registers the fence of a submission that may sample textures besides the output frames.
+// Images retired while it is unsignaled stay in use until it signals. Must outlive textures
+bool textures_add_reader(struct pwc_textures *textures, VkFence fence);
+
+bool texture_init(struct pwc_textures *textures, TextureT *texture, VkExtent2D extent, VkFormat format, bool opaque);
+// Wraps an imported image (EXCLUSIVE sharing, SAMPLED usage), taking over image and mem, even on failure
+bool texture_import(struct pwc_textures *textures, TextureT *texture, VkImage image, VkDeviceMemory mem, VkExtent2D extent,
+                    VkFormat format, bool opaque);
+// The client committed new contents of an imported texture
+void texture_acquire_import(struct pwc_textures *textures, TextureT *texture);
+// Records the acquire barriers of imported textures written since the last call into cmd
+// (graphics, outside a render pass). Called by every submission sampling textures
+void textures_record_acquires(struct pwc_textures *textures, VkCommandBuffer cmd);
+// Images frames in flight may still sample are destroyed later by textures_sweep()
+void texture_finish(struct pwc_textures *textures, TextureT *texture);
+// The texture stopped being shown: frames submitted so far may still sample it, until
+// texture_busy() turns false
+void texture_retire(struct pwc_textures *textures, TextureT *texture);
+bool texture_busy(struct pwc_textures *textures, TextureT *texture);
+void textures_sweep(struct pwc_textures *textures);
+
+// Returns the image the next update is written into and sets *region to what it needs:
+// damage (texture space), what changed since it was the front, everything the first time.
+// NULL while frames in flight may still sample it
+TextureImageT *texture_begin_update(struct pwc_textures *textures, TextureT *texture, const DamageRegionT *damage,
+                                    DamageRegionT *region);
+// The update was submitted, the image becomes the front. Cached command buffers showing the
+// texture still use the old front, the caller has to damage the node
+void texture_end_update(struct pwc_textures *textures, TextureT *texture, const DamageRegionT *damage);
+
+// Draws the front image stretched over dst (output space) inside a pass of vulkan->render_pass
+// whose viewport maps output space, extent is the output's. uv_rect (x0, y0, x1, y1) is the
+// part shown, normalized in the image's coordinates after transform (enum
+// wl_output_transform, what the contents were rendered with), which the shader undoes.
+// Premultiplied alpha. Safe from recorder workers
+void textures_draw(struct pwc_textures *textures, VkCommandBuffer cmd, const TextureT *texture, VkRect2D dst,
+                   const float uv_rect[4], uint32_t transform, VkExtent2D extent, float opacity);
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef _PWC_RENDER_VULKAN_UPLOAD
+#define _PWC_RENDER_VULKAN_UPLOAD
+
+#include <pwc/render/damage.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Client data uploads on the transfer queue. Each upload copies through its own staging
+// buffer in a separate submission that signals a semaphore; the next frame waits on it and
+// acquires the destination from the transfer family. Large uploads then run on the copy
+// engine while the graphics queue keeps composing, instead of being serialized before the frame.
+// Each submission also signals a fence: sources copied without staging (client memory) are
+// released as soon as their copy completed, not when the frame that acquired it did.
+
+#define MAX_UPLOADS 32
+
+// Waited on by consumers of uploaded resources
+#define UPLOAD_CONSUMER_STAGES (VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+
+// Called once an upload no longer reads its source
+typedef void (*UploadReleaseFunc)(void *data);
+
+enum UploadState {
+    UPLOAD_FREE = 0,
+    UPLOAD_SUBMITTED,  // On the transfer queue, not acquired by any frame yet
+    UPLOAD_ACQUIRED,   // Acquired by a frame, recycled once that frame completed
+};
+
+typedef struct Upload {
+    enum UploadState state;
+
+    VkBuffer staging;
+    VkDeviceMemory staging_mem;
+    VkDeviceSize staging_size;
+    void *staging_map;  // Persistently mapped
+
+    VkCommandBuffer cmd;
+    VkSemaphore semaphore;  // Transfer -> graphics handoff
+    VkFence fence;          // Signaled once the copy completed
+
+    // Destination, exactly one of image/buffer is set
+    VkImage image;
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    bool concurrent;  // Image shared by both families, the frame has nothing to acquire
+
+    // Source not staged, released once the fence signaled (see uploader_release_completed()),
+    // at the latest when the acquiring frame completed
+    UploadReleaseFunc release;
+    void *release_data;
+
+    // Submission that acquired the upload, complete once *completed_serial reached serial
+    const uint64_t *completed_serial;
+    uint64_t serial;
+} UploadT;
+
+struct pwc_uploader {
+    struct pwc_vulkan *vulkan;
+    VkCommandPool pool;  // Transfer family
+    UploadT uploads[MAX_UPLOADS];
+};
+
+struct pwc_uploader *create_uploader(struct pwc_vulkan *vulkan);
+// The device must be idle
+void destroy_uploader(struct pwc_uploader *uploader);
+
+// Copies 32bpp pixels into image, which must have been created with TRANSFER_DST usage and
+// EXCLUSIVE sharing and must not be read by a frame in flight. The image ends up in
+// SHADER_READ_ONLY_OPTIMAL, owned by the graphics family, once a frame acquired it. Previous
+// contents are discarded. Returns false if no upload slot is free
+bool upload_image(struct pwc_uploader *uploader, VkImage image, VkExtent2D extent, uint32_t stride, const void *data);
+// Copies size bytes into buffer at offset, same ownership rules as upload_image()
+bool upload_buffer(struct pwc_uploader *uploader, VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size);
+
+// Copies the region's rects of 32bpp pixels (data is the whole buffer) into image, staging
+// only the rects. image must be shared by the graphics and transfer families (a TextureImageT)
+// and must not be read by a frame in flight. If it was initialized the rest is kept, otherwise
+// the region has to cover it. Returns false if no upload slot is free
+bool upload_image_region(struct pwc_uploader *uploader, VkImage image, bool initialized, const void *data, uint32_t stride,
+                         const DamageRegionT *region);
+// Same without staging, copied from src at src_offset (see upload_import_host()), which has
+// to stay valid until release(release_data) is called
+bool upload_image_region_from_buffer(struct pwc_uploader *uploader, VkImage image, bool initialized, VkBuffer src,
+                                     VkDeviceSize src_offset, uint32_t stride, const DamageRegionT *region,
+                                     UploadReleaseFunc release, void *release_data);
+// Wraps size bytes of host memory at ptr as a transfer source (VK_EXT_external_memory_host).
+// ptr and size must be multiples of vulkan->host_pointer_alignment and the memory must stay
+// mapped until the buffer is destroyed. False if the extension is missing or the driver refuses it
+bool upload_import_host(struct pwc_vulkan *vulkan, void *ptr, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *mem);
+
+// Records the acquire side of every submitted upload into cmd (graphics, outside a render pass)
+// and returns how many semaphores the submission has to wait on, written to semaphores and
+// stages. serial is the one the submission will get in its sequence (an output's frames, an
+// output's plane frames), completed_serial where that sequence tracks the last completed one.
+// Later submissions on the graphics queue are ordered after it, so other outputs can use the
+// data too
+uint32_t uploader_acquire(struct pwc_uploader *uploader, VkCommandBuffer cmd, const uint64_t *completed_serial, uint64_t serial,
+                          VkSemaphore *semaphores, VkPipelineStageFlags *stages, uint32_t max);
+// Releases the sources of uploads whose copy completed, whether a frame acquired them or not.
+// Doesn't block, true while sources are still being copied
+bool uploader_release_completed(struct pwc_uploader *uploader);
+
+#endif
@@ -16,20 +16,86 @@
 
 struct pwc_demo;
 
+#define MAX_RETIRED_SWAPCHAINS 4
+#define MAX_OUTPUTS 8
+
 typedef struct SubmissionResources {
     VkCommandBuffer cmd;
     VkFence fence;
     VkSemaphore image_acquired_semaphore;
+    uint64_t serial;  // frame_serial of the last frame submitted with these resources
 } SubmissionResourcesT;
 
+// A swapchain replaced by recreate_swapchain(). It stays alive until every frame that was
+// submitted against it has signaled its fence, then it is destroyed without any device wait
+typedef struct RetiredSwapchain {
+    VkSwapchainKHR swapchain;
+    VkSurfaceKHR surface;  // Set only when the surface was replaced as well
+    uint32_t image_count;
+    VkImage *images;
+    VkImageView *image_views;
+    VkFramebuffer *framebuffers;
+    VkSemaphore *draw_complete_semaphores;
+    uint64_t retire_serial;
+} RetiredSwapchainT;
+
 typedef struct QueueFamilyData {
     uint32_t graphics_queue_family_index;
     uint32_t present_queue_family_index;
+    uint32_t transfer_queue_family_index;
+    uint32_t compute_queue_family_index;
     bool separate_present_queue;
+    bool separate_transfer_queue;
+    bool separate_compute_queue;
 } QueueFamilyData;
 
-struct pwc_vulkan {
+// One connected display with its own surface, swapchain and frame submission state.
+// Outputs share the device, render passes and pipelines; each one presents on its own
+// refresh cycle, so frame serials and FRAME_LAG slots are per output
+struct pwc_output {
+    uint32_t index;
+
+    VkDisplayKHR display;
+    VkDisplayModeKHR display_mode;
+    VkExtent2D display_extent;
+    VkExtent2D physical_size;  // mm, zero if the display doesn't say
+    uint32_t refresh_rate;  // mHz
+    uint32_t primary_plane_index;  // Plane the composited surface scans out from
+    uint32_t primary_plane_stack_index;
+
     VkSurfaceKHR surface;
+    VkSwapchainKHR swapchain;
+    uint32_t swapchain_image_count;
+    VkImage *swapchain_images;
+    VkFormat swapchain_image_format;
+    VkExtent2D swapchain_extent;
+    VkImageView *swapchain_image_views;
+    VkFramebuffer *framebuffers;  // One per swapchain image
+    bool swapchain_transfer;  // Images have TRANSFER_SRC and TRANSFER_DST usage too
+    VkSemaphore *draw_complete_semaphores;   // Per image
+    // vulkan->swapchain_serial when the current swapchain was created, cached command
+    // buffers recorded against another value are stale
+    uint64_t swapchain_serial;
+
+    SubmissionResourcesT submission_resources[FRAME_LAG];
+    uint32_t current_submission_index;
+
+    // Frame serials: frame_serial is the last submitted frame, completed_serial the last
+    // one whose fence was seen signaled
+    uint64_t frame_serial;
+    uint64_t completed_serial;
+
+    RetiredSwapchainT retired_swapchains[MAX_RETIRED_SWAPCHAINS];
+    uint32_t retired_swapchain_count;
+
+    bool vblank_counter;  // The swapchain counts vblanks (VK_EXT_display_control)
+
+    bool swapchain_ready;
+    bool swapchain_out_of_date;  // OUT_OF_DATE/SUBOPTIMAL seen, recreate before next acquire
+    bool surface_lost;           // SURFACE_LOST seen, the surface is replaced before next acquire
+};
+
+struct pwc_vulkan {
     VkInstance instance;
     VkDevice device;
     VkPhysicalDevice physicalDevice;
@@ -40,13 +106,18 @@ struct pwc_vulkan {
     bool separate_present_queue;
     VkQueue graphics_queue;
     VkQueue present_queue;
-
-    VkSwapchainKHR swapchain;
-    uint32_t swapchain_image_count;
-    VkImage *swapchain_images;
-    VkFormat swapchain_image_format;
-    VkExtent2D swapchain_extent;
-    VkImageView *swapchain_image_views;
+    // Uploads. Same as the graphics queue unless the device has a dedicated family
+    uint32_t transfer_queue_family_index;
+    bool separate_transfer_queue;
+    VkQueue transfer_queue;
+    // Effects. Same as the graphics queue unless the device has an async compute family
+    uint32_t compute_queue_family_index;
+    bool separate_compute_queue;
+    VkQueue compute_queue;
+
+    struct pwc_output outputs[MAX_OUTPUTS];
+    uint32_t output_count;
+    uint64_t claimed_planes;  // Bit per display plane scanning out for any output
 
     // IDK below
     VkPhysicalDeviceMemoryProperties memory_properties;
@@ -57,29 +128,27 @@ struct pwc_vulkan {
     VkPhysicalDeviceProperties gpu_props;
     VkQueueFamilyProperties *queue_props;
 
-
-    SubmissionResourcesT submission_resources[FRAME_LAG];
-    uint32_t current_submission_index;
-
-    VkSemaphore *image_acquired_semaphores;  // Per image
-    VkSemaphore *draw_complete_semaphores;   // Per image
-    VkFence *fences;  // Per submission (FRAME_LAG)
-    
-    VkCommandPool cmd_pool;
+    VkCommandPool cmd_pool;  // Render thread only
     VkCommandBuffer cmd;
 
     VkCommandPool present_cmd_pool;
 
-    VkRenderPass render_pass;  // For rendering to swapchain
+    // Shared by every output, all swapchains use render_pass_format
+    VkRenderPass render_pass;  // For rendering to swapchain, clears
+    VkRenderPass render_pass_load;  // Compatible variant that keeps the image contents, for partial redraws
+    VkRenderPass render_pass_offscreen;  // Compatible variant rendering into effect images
+    VkFormat render_pass_format;
     VkPipelineLayout pipeline_layout;
     VkPipeline pipeline;  // Shared for backgrounds
     VkBuffer vertex_buffer;  // Shared quad buffer
     VkDeviceMemory vertex_mem;
     VkShaderModule vert_shader;
     VkShaderModule frag_shader;
-    VkExtent2D swapchainExtent;  // Added: Store the swapchain's extent
-    // Framebuffers for render pass (one per swapchain image)
-    VkFramebuffer *framebuffers;
+
+    // Bumped whenever the pipeline/any swapchain is (re)created, cached command buffers
+    // recorded against an older serial are stale
+    uint64_t pipeline_serial;
+    uint64_t swapchain_serial;
 
     uint32_t enabled_extension_count;
     uint32_t enabled_layer_count;
@@ -90,7 +159,29 @@ struct pwc_vulkan {
 
     bool validate;
     bool initialized;
-    bool swapchain_ready;
+    bool incremental_present;  // VK_KHR_incremental_present enabled
+    bool display_swapchain;    // VK_KHR_display_swapchain enabled, plane swapchains can be positioned
+    bool memory_budget;        // VK_EXT_memory_budget enabled, see query_memory_budget()
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR get_memory_properties2;  // NULL without VK_KHR_get_physical_device_properties2
+    PFN_vkGetPhysicalDeviceProperties2KHR get_properties2;
+    bool external_memory_host;  // VK_EXT_external_memory_host enabled, see upload_import_host()
+    VkDeviceSize host_pointer_alignment;
+    PFN_vkGetMemoryHostPointerPropertiesEXT get_memory_host_pointer_properties;
+    PFN_vkGetPhysicalDeviceFormatProperties2KHR get_format_properties2;
+    PFN_vkGetPhysicalDeviceImageFormatProperties2KHR get_image_format_properties2;
+    bool dmabuf_import;  // VK_EXT_external_memory_dma_buf + VK_EXT_image_drm_format_modifier, see vk-dmabuf.h
+    bool queue_family_foreign;  // VK_EXT_queue_family_foreign, else imports are acquired from QUEUE_FAMILY_EXTERNAL
+    PFN_vkGetMemoryFdPropertiesKHR get_memory_fd_properties;
+    bool drm_device;  // VK_EXT_physical_device_drm, the device's DRM node is known
+    uint32_t drm_render_major;
+    uint32_t drm_render_minor;
+    // Presentation feedback, see vk-present-timing.h
+    PFN_vkGetPhysicalDeviceSurfaceCapabilities2EXT get_surface_capabilities2;  // NULL without VK_EXT_display_surface_counter
+    bool display_control;  // VK_EXT_display_control enabled
+    PFN_vkGetSwapchainCounterEXT get_swapchain_counter;
+    bool display_timing;   // VK_GOOGLE_display_timing enabled
+    PFN_vkGetPastPresentationTimingGOOGLE get_past_presentation_timing;
+    PFN_vkGetRefreshCycleDurationGOOGLE get_refresh_cycle_duration;
 };
 
 int init_vulkan(struct pwc_vulkan *vulkan);
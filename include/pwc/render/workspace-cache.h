@@ -0,0 +1,89 @@
+#ifndef _PWC_RENDER_WORKSPACE_CACHE_H
+#define _PWC_RENDER_WORKSPACE_CACHE_H
+
+#include <pwc/render/scene/node.h>
+#include <pwc/render/vulkan/vk-decorations.h>
+#include <pwc/render/vulkan/vk-effects.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Offscreen snapshots of an output's workspaces, one cache per output. Switches and overviews
+// composite the snapshots right away instead of rendering every window of every workspace.
+// Stale snapshots are refreshed in their own submissions, queued behind the frames and never
+// presented, so the refresh work doesn't delay the frames on screen. Snapshots of hibernated
+// workspaces are shrunk to thumbnails until the workspace is woken.
+
+#define SNAPSHOT_SUBMISSIONS 2
+#define SNAPSHOT_DEFAULT_SCALE 0.5f
+#define SNAPSHOT_THUMBNAIL_SCALE 0.125f
+
+typedef struct WorkspaceSnapshot {
+    SceneNodeHandle workspace;  // SCENE_NODE_HANDLE_NULL once retired
+    EffectImageT image;         // render_pass_format, image.initialized once drawn
+    VkFramebuffer framebuffer;
+    uint64_t drawn_serial;      // workspace->subtree_serial it shows
+    uint64_t refreshed_ns;      // CLOCK_MONOTONIC time of the last refresh
+    uint64_t retired_serial;    // Retired only: output frame that may still sample it
+    bool hibernated;            // A thumbnail, kept as is until woken
+} WorkspaceSnapshotT;
+
+typedef struct SnapshotSubmission {
+    VkCommandBuffer cmd;
+    VkFence fence;
+    DecorationBufferT decorations;  // Instances of the snapshot being drawn
+} SnapshotSubmissionT;
+
+struct pwc_workspace_cache {
+    struct pwc_vulkan *vulkan;
+    struct pwc_effects *effects;
+    struct pwc_decorations *decorations;
+    struct pwc_output *output;
+
+    float scale;  // Of the output's size
+
+    VkCommandPool pool;
+    SnapshotSubmissionT submissions[SNAPSHOT_SUBMISSIONS];
+    uint32_t next_submission;
+
+    WorkspaceSnapshotT *snapshots;
+    uint32_t snapshot_count;
+    uint32_t snapshot_capacity;
+};
+
+struct pwc_workspace_cache *create_workspace_cache(struct pwc_vulkan *vulkan, struct pwc_effects *effects,
+                                                   struct pwc_decorations *decorations, struct pwc_output *output, float scale);
+// The device must be idle
+void destroy_workspace_cache(struct pwc_workspace_cache *cache);
+
+// NULL if the workspace has no snapshot
+WorkspaceSnapshotT *workspace_cache_find(struct pwc_workspace_cache *cache, SceneNodeHandle workspace);
+// The workspace was destroyed, its snapshot is retired
+void workspace_cache_forget(struct pwc_workspace_cache *cache, SceneNodeHandle workspace);
+// Returns the workspace's snapshot, creating it. Previous pointers into the cache may be
+// invalidated. NULL if effects are disabled (snapshots can't be sampled)
+WorkspaceSnapshotT *workspace_cache_get(struct pwc_workspace_cache *cache, SceneNodeT *workspace);
+// Also true for a woken thumbnail or one sized for a different output size
+bool workspace_snapshot_stale(struct pwc_workspace_cache *cache, const WorkspaceSnapshotT *snapshot, const SceneNodeT *workspace);
+// Retires snapshots of destroyed workspaces and frees retired ones nothing can use anymore
+void workspace_cache_sweep(struct pwc_workspace_cache *cache);
+
+// Starts recording into a free submission, NULL if all of them are still in flight
+SnapshotSubmissionT *workspace_cache_begin(struct pwc_workspace_cache *cache);
+// Begins the pass drawing the workspace's snapshot, with the viewport mapping output space
+// onto it, and returns the snapshot. One of the wrong size is replaced first, previous
+// pointers into the cache may be invalidated. NULL if no snapshot could be created
+WorkspaceSnapshotT *workspace_cache_begin_snapshot(struct pwc_workspace_cache *cache, SnapshotSubmissionT *submission, SceneNodeT *workspace);
+void workspace_cache_end_snapshot(struct pwc_workspace_cache *cache, SnapshotSubmissionT *submission, WorkspaceSnapshotT *snapshot,
+                                  const SceneNodeT *workspace, uint64_t now_ns);
+// Submits to the graphics queue. Frames submitted later see the new contents
+void workspace_cache_submit(struct pwc_workspace_cache *cache, SnapshotSubmissionT *submission);
+
+// Records replacing the workspace's snapshot by a thumbnail scaled down from it into the
+// submission. False if there's nothing to hibernate or the thumbnail couldn't be created
+bool workspace_cache_hibernate(struct pwc_workspace_cache *cache, SnapshotSubmissionT *submission, SceneNodeHandle workspace);
+// The thumbnail stays until a full size snapshot is drawn in its place
+void workspace_cache_wake(struct pwc_workspace_cache *cache, SceneNodeHandle workspace);
+
+#endif
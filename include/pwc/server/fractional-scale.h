@@ -0,0 +1,23 @@
+#ifndef _PWC_SERVER_FRACTIONAL_SCALE_H
+#define _PWC_SERVER_FRACTIONAL_SCALE_H
+
+#include <pwc/server/server.h>
+#include <pwc/server/surface.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+// wp_fractional_scale_manager_v1, on the protocol thread. A surface's preferred scale is the
+// scale of the output the render shows its tree on (see surface.h), sent whenever that
+// changes. Clients rendering at it show the buffer through a wp_viewport destination of
+// their surface size, which the render then samples 1:1.
+
+#define FRACTIONAL_SCALE_MANAGER_VERSION 1
+
+struct wl_global *create_fractional_scale_global(struct pwc_server *server);
+
+// The render shows the surface at scale (120ths)
+void fractional_scale_preferred(struct pwc_surface *surface, uint32_t scale);
+// The wl_surface is going away, its wp_fractional_scale_v1 stays inert
+void fractional_scale_surface_destroyed(struct pwc_surface *surface);
+
+#endif
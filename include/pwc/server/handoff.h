@@ -0,0 +1,128 @@
+#ifndef _PWC_SERVER_HANDOFF_H
+#define _PWC_SERVER_HANDOFF_H
+
+#include <pwc/render/utils/spsc-ring.h>
+#include <pwc/render/vulkan/vk-present-timing.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Messages between the protocol thread and the render thread, one queue per direction. A
+// queue is a bounded SPSC ring; what doesn't fit waits in the producer's backlog, so neither
+// side ever blocks on the other. The consumer is woken through an eventfd once per flushed
+// batch, not per message.
+//
+// Objects both threads know (surfaces, handed-over buffers) are freed by the protocol thread,
+// only once the render answered their destroy message: everything the render sent about them
+// was received by then.
+
+#define HANDOFF_RING_CAPACITY 1024
+
+struct pwc_surface;
+struct SurfaceCommit;
+struct SurfaceStack;
+struct ShmBuffer;
+struct DmabufBuffer;
+struct InputMap;
+
+enum HandoffMessageType {
+    // Protocol thread to render
+    HANDOFF_SURFACE_CREATE,
+    HANDOFF_SURFACE_COMMIT,
+    HANDOFF_SURFACE_DESTROY,
+    HANDOFF_SURFACE_STACK,
+    HANDOFF_SURFACE_UNMAP,
+    HANDOFF_DMABUF_IMPORT,
+    HANDOFF_DMABUF_DESTROY,
+    HANDOFF_CURSOR,
+    HANDOFF_SWITCH_WORKSPACE,
+    HANDOFF_TOGGLE_OVERVIEW,
+    // Render to protocol thread
+    HANDOFF_SURFACE_FRAME,
+    HANDOFF_SURFACE_FREED,
+    HANDOFF_SURFACE_SCALE,
+    HANDOFF_SHM_RELEASE,
+    HANDOFF_DMABUF_IMPORTED,
+    HANDOFF_DMABUF_RELEASE,
+    HANDOFF_DMABUF_FREED,
+    HANDOFF_FRAME_PRESENTED,
+    HANDOFF_INPUT_MAP,
+};
+
+typedef struct HandoffMessage {
+    enum HandoffMessageType type;
+    union {
+        struct pwc_surface *surface;  // SURFACE_CREATE, SURFACE_DESTROY, SURFACE_UNMAP, SURFACE_FREED
+        // The first of a chain (SurfaceCommitT.next), each commit names its surface
+        struct {
+            struct pwc_surface *surface;
+            struct SurfaceCommit *state;  // Owned by the render from here on
+        } commit;
+        // A stack change outside any commit: a subsurface or popup came or went
+        struct {
+            struct pwc_surface *surface;
+            struct SurfaceStack *stack;  // Owned by the render from here on
+        } stack;
+        // The surface's frame callbacks are due. Its feedback for commit goes in flight with
+        // the output's frame serial, if one was submitted (0 if not)
+        struct {
+            struct pwc_surface *surface;
+            uint64_t commit;
+            uint32_t output_index;
+            uint64_t serial;
+            uint64_t time_ns;
+        } frame;
+        // The surface's tree is shown at another output scale, in 120ths
+        struct {
+            struct pwc_surface *surface;
+            uint32_t scale;
+        } scale;
+        struct ShmBuffer *shm;  // SHM_RELEASE
+        struct {
+            struct DmabufBuffer *buffer;
+            bool imported;          // DMABUF_IMPORTED only
+            uint64_t commit_count;  // DMABUF_RELEASE only
+        } dmabuf;
+        struct {
+            uint32_t output_index;
+            PresentedFrameT frame;
+        } presented;
+        struct InputMap *input_map;  // INPUT_MAP, owned by the protocol thread from here on
+        // The focused client's cursor surface (set, NULL hides the cursor), otherwise the
+        // compositor's own one
+        struct {
+            struct pwc_surface *surface;
+            int32_t hotspot_x, hotspot_y;
+            bool set;
+        } cursor;
+        // A compositor binding, on the output under the cursor. index is SWITCH_WORKSPACE only
+        struct {
+            uint32_t output_index;
+            uint32_t index;
+        } workspace;
+    };
+} HandoffMessageT;
+
+struct pwc_handoff_queue {
+    struct pwc_spsc_ring *ring;
+    int wake_fd;  // eventfd, readable once a batch was flushed
+
+    // Producer only: what the full ring refused, oldest first
+    HandoffMessageT *backlog;
+    uint32_t backlog_count;
+    uint32_t backlog_capacity;
+    bool unflushed;  // Pushed since the last wake
+};
+
+struct pwc_handoff_queue *create_handoff_queue(void);
+void destroy_handoff_queue(struct pwc_handoff_queue *queue);
+
+// Producer only. Never blocks, a full ring queues into the backlog
+void handoff_send(struct pwc_handoff_queue *queue, const HandoffMessageT *message);
+// Producer only. Moves the backlog into the ring as far as it fits and wakes the consumer if
+// anything was pushed. False while a backlog is left
+bool handoff_flush(struct pwc_handoff_queue *queue);
+// Consumer only. Clears the wakeup, called before draining with handoff_receive()
+void handoff_clear_wake(struct pwc_handoff_queue *queue);
+bool handoff_receive(struct pwc_handoff_queue *queue, HandoffMessageT *message);
+
+#endif
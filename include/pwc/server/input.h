@@ -0,0 +1,28 @@
+#ifndef _PWC_SERVER_INPUT_H
+#define _PWC_SERVER_INPUT_H
+
+#include <pwc/server/seat.h>
+#include <pwc/server/server.h>
+#include <wayland-server-core.h>
+
+// Input devices of seat0 through libinput, read on the protocol thread. Everything libinput
+// has queued is handed to the seat as one batch per wakeup, so a burst of motion from a high
+// rate mouse costs one focus pick and one wl_pointer.motion (see seat.h). Keys only drive
+// the compositor's own bindings (seat_keyboard_key()), touch is ignored.
+
+struct udev;
+struct libinput;
+
+struct pwc_input {
+    struct pwc_seat *seat;
+    struct udev *udev;
+    struct libinput *libinput;
+    struct wl_event_source *source;
+};
+
+// NULL without access to the devices (no seat session, no udev), the compositor then runs
+// without input
+struct pwc_input *create_input(struct pwc_server *server, struct pwc_seat *seat);
+void destroy_input(struct pwc_input *input);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef _PWC_SERVER_LINUX_DMABUF_H
+#define _PWC_SERVER_LINUX_DMABUF_H
+
+#include <pwc/render/vulkan/vk-dmabuf.h>
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/server/server.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <wayland-server-core.h>
+
+// zwp_linux_dmabuf_v1. Buffers are imported by the render thread when they are created, the
+// protocol thread answers the params once it knows the outcome. The texture lives with the
+// wl_buffer, so attaching the same buffer again only acquires it. Feedback advertises one
+// tranche: what the device can import and sample. Client buffers are never scanned out
+// directly (planes only show swapchain images), so there is no scanout tranche.
+
+#define LINUX_DMABUF_VERSION 4
+
+typedef struct FormatTableEntry {
+    uint32_t format;
+    uint32_t pad;
+    uint64_t modifier;
+} FormatTableEntryT;
+
+struct pwc_linux_dmabuf {
+    struct pwc_server *server;
+    struct wl_global *global;
+    struct pwc_dmabuf_formats *formats;  // Fixed once created
+    struct wl_list buffers;  // Render thread: DmabufBufferT.link of imported ones
+
+    // Feedback: memfd holding every FormatTableEntryT, shared read-only with clients
+    int table_fd;
+    uint32_t table_size;
+    uint32_t table_count;
+    dev_t main_device;
+};
+
+typedef struct DmabufBuffer {
+    struct pwc_linux_dmabuf *linux_dmabuf;
+    DmabufAttributesT attributes;  // The fds are owned until the render imported them
+
+    // Protocol thread
+    struct wl_resource *resource;  // wl_buffer. NULL until created or once destroyed
+    bool immediate;                // create_immed, the wl_buffer exists before the import
+    struct wl_resource *params;    // Answered once imported, NULL if it went away
+    struct wl_listener params_destroy;
+    uint64_t attach_count;         // Commits showing it
+
+    // Render thread
+    struct wl_list link;
+    bool imported;
+    TextureT texture;
+    uint64_t commit_count;  // Commits received, a release only covers those
+    uint32_t show_count;    // Surfaces showing it
+    bool release_pending;   // Hidden, released once no frame samples it any more
+} DmabufBufferT;
+
+// NULL without dmabuf import support
+struct pwc_linux_dmabuf *create_linux_dmabuf(struct pwc_server *server);
+// After the clients were destroyed
+void destroy_linux_dmabuf(struct pwc_linux_dmabuf *linux_dmabuf);
+
+// Protocol thread. NULL if resource isn't a dmabuf wl_buffer
+DmabufBufferT *dmabuf_buffer_from_resource(struct wl_resource *resource);
+// Protocol thread, the render's answers
+void dmabuf_buffer_imported(DmabufBufferT *buffer, bool imported);
+void dmabuf_buffer_release(DmabufBufferT *buffer, uint64_t commit_count);
+void dmabuf_buffer_free(DmabufBufferT *buffer);
+
+// Render thread, the handed-over messages
+void dmabuf_buffer_import(DmabufBufferT *buffer);
+// Surfaces showing it already dropped it
+void dmabuf_buffer_destroy(DmabufBufferT *buffer);
+// Render thread
+void dmabuf_buffer_show(DmabufBufferT *buffer);
+// The last surface stopped showing it: wl_buffer.release follows once frames are done with it
+void dmabuf_buffer_hide(DmabufBufferT *buffer);
+// Called after every render tick
+void linux_dmabuf_send_releases(struct pwc_linux_dmabuf *linux_dmabuf);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef _PWC_SERVER_PRESENTATION_H
+#define _PWC_SERVER_PRESENTATION_H
+
+#include <pwc/render/vulkan/vk-present-timing.h>
+#include <pwc/server/server.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+// wp_presentation, on the protocol thread. A feedback follows its content update: pending
+// until the commit, then waiting for the render to report the first frame of an output
+// showing that commit, then in flight until the render knows when that frame reached the
+// display (see vk-present-timing.h). An update a newer one replaced before any frame showed
+// it is discarded. There is no wl_output global, so sync_output is never sent.
+
+#define PRESENTATION_VERSION 1
+
+typedef struct PresentationFeedback {
+    struct wl_resource *resource;
+    struct wl_list link;
+    uint64_t commit;        // pwc_surface.commit_serial of its update
+    uint32_t output_index;  // In flight only: the frame that showed the update
+    uint64_t serial;
+} PresentationFeedbackT;
+
+struct pwc_presentation {
+    struct pwc_server *server;
+    struct wl_global *global;
+    struct wl_list in_flight;  // PresentationFeedbackT.link
+};
+
+struct pwc_presentation *create_presentation(struct pwc_server *server);
+// After the clients were destroyed
+void destroy_presentation(struct pwc_presentation *presentation);
+
+// Answers every feedback of the list with discarded
+void presentation_discard(struct wl_list *feedbacks);
+// A frame of the surface whose committed feedbacks are listed shows its update commit: older
+// updates are discarded, those of commit go in flight with the output's frame serial (if one
+// was submitted, 0 otherwise). Newer ones stay in the list
+void presentation_surface_shown(struct pwc_presentation *presentation, struct wl_list *feedbacks, uint64_t commit,
+                                uint32_t output_index, uint64_t serial);
+// Older frames of the output in flight were skipped, they are discarded
+void presentation_frame_presented(struct pwc_presentation *presentation, uint32_t output_index, const PresentedFrameT *frame);
+
+#endif
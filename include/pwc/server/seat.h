@@ -0,0 +1,104 @@
+#ifndef _PWC_SERVER_SEAT_H
+#define _PWC_SERVER_SEAT_H
+
+#include <pwc/render/vulkan/vulkan.h>
+#include <pwc/server/server.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+
+// wl_seat with a pointer, and zwp_relative_pointer_manager_v1, on the protocol thread. Input
+// devices (see input.h) feed it whole batches: relative motion goes out to relative pointers
+// at full resolution as it comes, wl_pointer motion is coalesced and only sent, with the
+// focus picked once at the resulting position, when a button or axis event needs it in order
+// or when the batch ends. Every group of wl_pointer events ends with wl_pointer.frame.
+//
+// Focus is picked against an input map the render publishes whenever the visible surfaces
+// moved: outputs are laid out left to right in index order, a surface takes input on its
+// whole box. The render samples the cursor position once per frame, it never sees single
+// events.
+//
+// Clients get no keyboard input yet. Keys only drive the compositor's bindings, on the output
+// under the cursor: Super+1..9 switches to that workspace, Super+Tab toggles the overview.
+
+#define SEAT_VERSION 5
+#define RELATIVE_POINTER_MANAGER_VERSION 1
+
+struct pwc_surface;
+
+typedef struct InputTarget {
+    struct pwc_surface *surface;  // NULL once freed
+    VkRect2D box;                 // Layout space
+    float scale;                  // Layout pixels per surface coordinate
+} InputTargetT;
+
+// Built by the render, owned by the protocol thread once handed over
+typedef struct InputMap {
+    VkRect2D outputs[MAX_OUTPUTS];  // Layout space
+    uint32_t output_count;
+    uint32_t target_count;
+    InputTargetT targets[];  // Top-most first
+} InputMapT;
+
+struct pwc_seat {
+    struct pwc_server *server;
+    struct wl_global *global;
+    struct wl_global *relative_pointer_manager;
+    struct wl_list pointers;           // wl_pointer resources
+    struct wl_list relative_pointers;  // zwp_relative_pointer_v1 resources
+
+    InputMapT *map;  // NULL until the render published one
+    double x, y;     // Cursor, layout space
+    uint32_t output_index;  // Output the cursor is on
+    bool motion_pending;    // Moved since wl_pointer was last told
+    uint32_t motion_time_ms;
+    uint32_t buttons_down;  // Implicit grab: the focus doesn't change while non-zero
+    uint32_t super_down;    // Super keys held, for the bindings
+
+    struct pwc_surface *focus;  // NULL if the cursor is over no surface
+    VkOffset2D focus_origin;    // Layout position of the focused surface
+    float focus_scale;
+    uint32_t enter_serial;
+    wl_fixed_t sent_x, sent_y;  // Surface-local position wl_pointer was last told
+
+    // Set by the focused client with wl_pointer.set_cursor, reset when the focus changes:
+    // without one the compositor's own cursor is shown. Handed to the render on every change
+    bool cursor_set;
+    struct pwc_surface *cursor_surface;  // NULL hides the cursor
+    int32_t hotspot_x, hotspot_y;
+
+    // Cursor position for the render: x and y as 24.8 fixed point, x in the high half
+    _Atomic uint64_t cursor;
+};
+
+struct pwc_seat *create_seat(struct pwc_server *server);
+// After the clients were destroyed
+void destroy_seat(struct pwc_seat *seat);
+
+// Protocol thread, from input devices. Times are in microseconds
+void seat_pointer_motion(struct pwc_seat *seat, uint64_t time_us, double dx, double dy, double dx_unaccel, double dy_unaccel);
+// Absolute position in [0, 1] over the layout's bounding box
+void seat_pointer_motion_absolute(struct pwc_seat *seat, uint64_t time_us, double x, double y);
+void seat_pointer_button(struct pwc_seat *seat, uint64_t time_us, uint32_t button, bool pressed);
+// value and discrete are indexed by enum wl_pointer_axis, discrete is 0 for non-wheel sources
+void seat_pointer_axis(struct pwc_seat *seat, uint64_t time_us, enum wl_pointer_axis_source source, const bool has_axis[2],
+                       const double value[2], const int32_t discrete[2]);
+// key is a linux/input-event-codes.h code
+void seat_keyboard_key(struct pwc_seat *seat, uint64_t time_us, uint32_t key, bool pressed);
+// End of a batch: coalesced motion goes out and the render gets the new position
+void seat_pointer_flush(struct pwc_seat *seat);
+
+// Protocol thread: replaces the map (takes it over)
+void seat_set_input_map(struct pwc_seat *seat, InputMapT *map);
+// Protocol thread: the surface's resource was destroyed
+void seat_surface_destroyed(struct pwc_seat *seat, struct pwc_surface *surface);
+// Protocol thread: the surface is about to be freed, the map forgets it
+void seat_surface_freed(struct pwc_seat *seat, struct pwc_surface *surface);
+
+// Any thread: the latest cursor position, layout space
+void seat_cursor_position(struct pwc_seat *seat, double *x, double *y);
+
+#endif
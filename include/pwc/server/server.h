@@ -0,0 +1,87 @@
+#ifndef _PWC_SERVER_H
+#define _PWC_SERVER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+// The Wayland display. It runs on its own protocol thread, which only reads client requests
+// and keeps protocol state: commits are handed over to the render thread, which owns the
+// scene and the textures, and releases, frame callbacks and presentation feedback come back
+// the same way (see handoff.h). A slow frame or a fence wait never delays reading the client
+// sockets, and protocol handlers never touch render state.
+
+struct pwc_render;
+struct pwc_linux_dmabuf;
+struct pwc_presentation;
+struct pwc_seat;
+struct pwc_input;
+struct pwc_handoff_queue;
+struct PresentedFrame;
+struct InputMap;
+
+struct pwc_server {
+    struct pwc_render *render;  // Render thread only
+
+    // Protocol thread, set up before it starts
+    struct wl_display *display;
+    struct wl_event_loop *loop;
+    const char *socket;
+    struct wl_global *shm;
+    struct wl_global *compositor;
+    struct wl_global *subcompositor;
+    struct wl_global *xdg_shell;
+    struct wl_global *viewporter;
+    struct wl_global *fractional_scale;
+    struct pwc_linux_dmabuf *linux_dmabuf;  // NULL without dmabuf import
+    struct pwc_presentation *presentation;
+    struct pwc_seat *seat;    // Its cursor position is read by the render too
+    struct pwc_input *input;  // NULL without input devices
+    struct wl_event_source *wake_source;    // to_protocol's eventfd
+
+    pthread_t thread;
+    bool thread_started;
+    atomic_bool quit;
+    struct pwc_handoff_queue *to_render;    // Produced by the protocol thread
+    struct pwc_handoff_queue *to_protocol;  // Produced by the render thread
+
+    // Render thread
+    struct wl_list surfaces;  // pwc_surface.link
+    struct InputMap *input_map;  // Copy of the last one handed to the seat
+    // The cursor image the seat asked for (see HandoffMessageT.cursor), and what of it the
+    // render's cursor shows: it is only replaced, and redrawn, when one of them changed
+    bool cursor_set;
+    struct pwc_surface *cursor_surface;
+    int32_t cursor_hotspot_x, cursor_hotspot_y;
+    bool cursor_default;
+    uint64_t cursor_commit;
+};
+
+// Starts the protocol thread
+struct pwc_server *create_server(struct pwc_render *render);
+// Render thread, before the render: stops the protocol thread and destroys every client and
+// its resources
+void destroy_server(struct pwc_server *server);
+
+// Render thread: applies what the protocol thread handed over, waiting at most timeout_ms
+// (0 only polls) for it. While uploads are copying client buffers it waits at most
+// UPLOAD_POLL_MS, to release each buffer once its copy completed
+#define UPLOAD_POLL_MS 1
+void server_dispatch(struct pwc_server *server, int timeout_ms);
+// Frame callbacks of hidden surfaces (unmapped, off-workspace, occluded) are done at this rate
+#define HIDDEN_FRAME_INTERVAL_NS 1000000000ull
+
+// Called after every render tick: retries uploads refused while a texture was busy, releases
+// dmabufs no frame samples any more and shm buffers whose copy completed, completes the frame
+// callbacks of hidden surfaces and hands the seat a new input map if the visible surfaces moved
+void server_frame_done(struct pwc_server *server, uint64_t now_ns);
+// Called once the output repainted (or found nothing to repaint): completes the frame
+// callbacks of the surfaces visible on it, so clients draw on the output's cycle. If frame
+// serial was submitted (0 if not), their committed presentation feedback goes with it
+void server_output_frame(struct pwc_server *server, uint32_t output_index, uint64_t serial, uint64_t now_ns);
+// The render learned when (or that never) a frame of the output reached the display
+void server_frame_presented(struct pwc_server *server, uint32_t output_index, const struct PresentedFrame *frame);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef _PWC_SERVER_SHM_H
+#define _PWC_SERVER_SHM_H
+
+#include <pwc/render/damage.h>
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/server/server.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+#include <wayland-server-core.h>
+
+// wl_shm, and its buffers into textures. Pools are mapped on the protocol thread; a resize
+// maps the pool again, and the old mapping stays until the render let go of every buffer
+// committed from it.
+//
+// Where the driver can import host memory (VK_EXT_external_memory_host) and the pool is a
+// memfd sealed with F_SEAL_SHRINK, each mapping is imported once, by the first upload from
+// it, and the damaged rects are copied straight out of it, no CPU copy at all; the buffer is
+// released once the copy completed. Any other pool could be truncated by its client while
+// the GPU reads it, which faults the device rather than a thread that can recover, so only
+// the damaged rects are staged, under the render's own SIGBUS guard: a client truncating
+// its pool reads as zeroes and gets disconnected.
+
+#define SHM_VERSION 1
+
+// One mmap of a pool
+typedef struct ShmMapping {
+    // Protocol thread
+    void *data;
+    size_t size;
+    uint32_t refs;  // The pool while it is its current mapping, and every ShmBufferT taken from it
+    bool sealed;    // Can't shrink below size: safe to import
+
+    // Render thread, while it holds a buffer of the mapping. Destroyed with the mapping, by
+    // then no copy reads it
+    bool import_tried;
+    VkDevice import_device;
+    VkBuffer import_buffer;  // VK_NULL_HANDLE if not imported (yet)
+    VkDeviceMemory import_mem;
+} ShmMappingT;
+
+// A committed wl_shm buffer, handed to the render thread
+typedef struct ShmBuffer {
+    // Protocol thread
+    struct pwc_server *server;
+    struct wl_resource *resource;  // NULL once the client destroyed it
+    struct wl_listener destroy;
+    ShmMappingT *mapping;          // Referenced until the buffer is released
+
+    // Fixed at commit, read by the render thread
+    void *data;
+    uint32_t stride;
+    VkExtent2D extent;
+    VkFormat format;
+    bool opaque;  // Alpha is ignored (XRGB)
+    bool faulted;  // Render thread: the pool was truncated under a copy
+} ShmBufferT;
+
+struct wl_global *create_shm_global(struct pwc_server *server);
+
+// Protocol thread: size of a wl_shm buffer, false if it isn't one
+bool shm_buffer_extent(struct wl_resource *buffer, VkExtent2D *extent);
+// Protocol thread: takes the buffer over for the render, NULL if it isn't a wl_shm buffer
+ShmBufferT *shm_buffer_take(struct wl_resource *buffer);
+// Protocol thread: the render is done with it, the client gets it back
+void shm_buffer_release(ShmBufferT *buffer);
+
+// Render thread: copies the damage (buffer coordinates) of a buffer matching the texture
+// into the texture and makes it the front. Takes the buffer over, it is released once
+// nothing reads it anymore. False while the texture or the uploader is busy, the buffer is
+// untouched then
+bool shm_buffer_upload(struct pwc_server *server, TextureT *texture, ShmBufferT *buffer, const DamageRegionT *damage);
+// Render thread: gives the buffer back without uploading it
+void shm_buffer_return(struct pwc_server *server, ShmBufferT *buffer);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _PWC_SERVER_SUBCOMPOSITOR_H
+#define _PWC_SERVER_SUBCOMPOSITOR_H
+
+#include <pwc/server/server.h>
+#include <pwc/server/surface.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+// wl_subcompositor, on the protocol thread. Placement and stacking requests go into the
+// parent's pending stack and apply with the parent's next commit, which hands the new stack
+// over with it (see SurfaceStackT). A synchronized subsurface's commits are cached until its
+// parent's commit is handed over, see surface.h. A subsurface whose parent is gone stays
+// unmapped.
+
+#define SUBCOMPOSITOR_VERSION 1
+
+typedef struct Subsurface {
+    struct wl_resource *resource;
+    struct pwc_surface *surface;  // NULL once the wl_surface was destroyed
+    struct pwc_surface *parent;   // NULL once either left the other
+    SurfaceChildT child;          // parent->stack, applied position. Empty until first applied
+    struct wl_list pending_link;  // parent->pending_stack
+    int32_t pending_x, pending_y;
+    bool synchronized;            // Its own mode, a synchronized ancestor overrides it
+} SubsurfaceT;
+
+struct wl_global *create_subcompositor_global(struct pwc_server *server);
+
+// wl_surface.commit of the surface, before the commit is handed over: applies the pending
+// stacking and positions of its subsurfaces
+void subsurface_parent_commit(struct pwc_surface *surface);
+// Whether the surface's commits are cached: it or a subsurface it is below is synchronized
+bool surface_synchronized(struct pwc_surface *surface);
+// The wl_surface is going away: it leaves its parent and its subsurfaces lose theirs
+void subsurface_surface_destroyed(struct pwc_surface *surface);
+
+#endif
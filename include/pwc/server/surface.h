@@ -0,0 +1,194 @@
+#ifndef _PWC_SERVER_SURFACE_H
+#define _PWC_SERVER_SURFACE_H
+
+#include <pwc/render/damage.h>
+#include <pwc/render/scene/node.h>
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/server/server.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+// wl_compositor and wl_surface. The protocol thread keeps the double-buffered state, a commit
+// hands the update over to the render thread as a SurfaceCommitT. The render owns the
+// surface's SCENE_NODE_SURFACE node and its texture: an update is uploaded right away if the
+// texture's back image is free, otherwise it is held and retried after the next render tick.
+// A newer update replaces (and releases) a held buffer, its damage accumulates. Dmabufs were
+// imported when they were created, a commit shows them right away.
+//
+// The node sits in the surface's SCENE_NODE_SURFACE_TREE, which also holds the trees of its
+// subsurfaces and popups in stacking order (see SurfaceStackT). A tree has no parent until a
+// role maps it: toplevels become layers of a workspace, subsurfaces and popups children of
+// their parent's tree. Commits of synchronized subsurfaces are cached on the protocol thread
+// and handed over together with their parent's, in one message, so both show up in the same
+// frame. Desynchronized ones go on their own and only damage their own node.
+//
+// Buffer scale, transform and the wp_viewport crop and size never touch the pixels: the node
+// is sized in surface coordinates and samples the part of the texture it shows, the shader
+// undoes the transform (see SceneNodeT.uv_rect). Surface coordinates are multiplied by the
+// scale of the output the tree is shown on (RenderOutputT.scale), node sizes and child
+// offsets alike. Clients learn that scale through wp_fractional_scale_v1.
+
+#define COMPOSITOR_VERSION 5
+
+struct ShmBuffer;
+struct DmabufBuffer;
+struct pwc_surface;
+
+// At most one per surface for its lifetime
+enum SurfaceRole {
+    SURFACE_ROLE_NONE,
+    SURFACE_ROLE_SUBSURFACE,  // role_object is a SubsurfaceT
+    SURFACE_ROLE_XDG,         // role_object is an XdgSurfaceT, toplevel or popup
+};
+
+// Role mapping applied with a commit
+enum SurfaceMap {
+    SURFACE_MAP_KEEP,
+    SURFACE_MAP_TOPLEVEL,  // The tree becomes a layer of a workspace
+    SURFACE_MAP_UNMAP,     // Out of its workspace again
+};
+
+// Placement in a parent's tree, protocol thread
+typedef struct SurfaceChild {
+    struct pwc_surface *surface;  // The parent itself for its own entry
+    int32_t x, y;                 // Relative to the parent surface
+    struct wl_list link;          // parent->stack or parent->popups
+} SurfaceChildT;
+
+typedef struct SurfaceStackEntry {
+    struct pwc_surface *surface;
+    int32_t x, y;
+} SurfaceStackEntryT;
+
+// What a surface's tree holds, bottom to top: subsurfaces below it, its own entry (its node),
+// subsurfaces above it, popups. Replaces the tree's children as a whole
+typedef struct SurfaceStack {
+    uint32_t count;
+    SurfaceStackEntryT entries[];
+} SurfaceStackT;
+
+// wp_viewport, surface coordinates. Unset parts come from the buffer
+typedef struct SurfaceViewport {
+    bool has_source;
+    float source_x, source_y, source_width, source_height;
+    int32_t destination_width, destination_height;  // 0 while unset
+} SurfaceViewportT;
+
+// Double-buffered state, applied by wl_surface.commit
+typedef struct SurfaceState {
+    bool attached;               // wl_surface.attach since the last commit
+    struct wl_resource *buffer;  // NULL detaches
+    struct wl_listener buffer_destroy;
+    int32_t dx, dy;
+    DamageRegionT surface_damage;  // Surface coordinates
+    DamageRegionT buffer_damage;   // Buffer coordinates
+    int32_t scale;
+    int32_t transform;             // enum wl_output_transform
+    SurfaceViewportT viewport;
+    struct wl_list frame_callbacks;  // wl_callback resources
+    struct wl_list presentation_feedbacks;  // PresentationFeedbackT.link
+} SurfaceStateT;
+
+// A commit as the render sees it. Merged into the held one while that waits for its upload
+typedef struct SurfaceCommit {
+    struct pwc_surface *surface;
+    struct SurfaceCommit *next;     // Handed over along with this one, applied right after it
+    uint64_t serial;                // pwc_surface.commit_serial
+    bool attached;                  // Neither buffer detaches
+    struct ShmBuffer *shm;          // Owned until uploaded or replaced
+    struct DmabufBuffer *dmabuf;
+    DamageRegionT damage;           // Buffer coordinates
+    int32_t scale;
+    int32_t transform;
+    SurfaceViewportT viewport;
+    bool frame;                     // Frame callbacks or presentation feedback are waiting
+    // Applied right away, even while the buffer is held
+    SurfaceStackT *stack;           // NULL if the tree's children stay as they are
+    enum SurfaceMap map;
+    VkRect2D window_geometry;       // SURFACE_MAP_TOPLEVEL: the window inside the surface
+    enum ScenePlaneHint plane_hint;  // Of the tree, a fullscreen toplevel asks for a plane
+} SurfaceCommitT;
+
+struct pwc_surface {
+    struct pwc_server *server;
+
+    // Protocol thread
+    struct wl_resource *resource;  // NULL once destroyed, freed when the render let go too
+    SurfaceStateT pending;
+    int32_t scale;
+    int32_t transform;
+    SurfaceViewportT viewport;
+    VkExtent2D buffer_extent;    // Of the committed buffer, zero while there is none
+    struct wl_resource *viewport_resource;  // wp_viewport, NULL while it has none
+    struct wl_resource *fractional_scale;   // wp_fractional_scale_v1, NULL while it has none
+    uint32_t preferred_scale;    // 120ths, of the output the render last showed it on
+    int32_t offset_x, offset_y;  // Sum of committed wl_surface.offset, consumed by roles
+    uint64_t commit_serial;      // Of the last commit
+    struct wl_list frame_callbacks;  // Committed, done by the next repaint of the surface's output
+    struct wl_list presentation_feedbacks;  // Committed, oldest commit first
+    enum SurfaceRole role;
+    void *role_object;  // NULL once the client destroyed it, the role stays
+    // Its own entry and its subsurfaces, bottom to top: as applied by the last commit, and as
+    // wl_subsurface requests left it for the next one (SubsurfaceT.pending_link, pending_self)
+    struct wl_list stack;  // SurfaceChildT.link
+    SurfaceChildT self;
+    struct wl_list pending_stack;
+    struct wl_list pending_self;
+    bool pending_stack_changed;  // Order or positions, applied by the next commit
+    bool stack_changed;          // Applied but not handed over yet
+    struct wl_list popups;       // SurfaceChildT.link of mapped popups, newest on top
+    // Synchronized subsurface: commits waiting for the parent's, oldest first (linked by next)
+    SurfaceCommitT *cached;
+
+    // Render thread
+    struct wl_list link;      // pwc_server.surfaces
+    SurfaceCommitT *held;     // Committed but not uploaded yet: the texture was busy
+    uint64_t shown_commit;    // Serial of the commit the node shows
+    // How the shown buffer is seen
+    int32_t buffer_scale;
+    int32_t buffer_transform;
+    SurfaceViewportT buffer_viewport;
+    float output_scale;        // Output pixels per surface coordinate, follows the parent's
+    SurfaceStackT *tree_stack;  // What tree holds, positions in surface coordinates
+    bool frame_requested;     // Frame callbacks or feedback wait for the surface's next frame
+    uint64_t frame_done_ns;   // When callbacks were last due, throttles hidden surfaces
+    SceneNodeT *tree;         // SCENE_NODE_SURFACE_TREE, unparented until a role maps it
+    SceneNodeT *node;         // SCENE_NODE_SURFACE in tree, shows texture or the dmabuf's
+    TextureT texture;
+    bool textured;
+    // Shown imported buffer, kept (not released) until another commit replaces it
+    struct DmabufBuffer *dmabuf;
+};
+
+struct wl_global *create_compositor_global(struct pwc_server *server);
+struct pwc_surface *surface_from_resource(struct wl_resource *resource);
+
+// Protocol thread: the render's frame of the surface (see HandoffMessageT.frame) came back
+void surface_frame(struct pwc_surface *surface, uint64_t commit, uint32_t output_index, uint64_t serial, uint64_t time_ns);
+// Protocol thread: the render let go of a destroyed surface
+void surface_free(struct pwc_surface *surface);
+// Protocol thread: the surface isn't synchronized any more, its cached commits (and those of
+// its subsurfaces) apply now
+void surface_flush_cached(struct pwc_surface *surface);
+// Protocol thread: hands the surface's stack over right away, a child came or went. Stacks of
+// its cached commits are older, they are dropped
+void surface_send_stack(struct pwc_surface *surface);
+
+// Render thread, the handed-over messages
+void surface_render_create(struct pwc_surface *surface);
+void surface_render_commit(struct pwc_surface *surface, SurfaceCommitT *commit);
+void surface_render_destroy(struct pwc_surface *surface);
+// Replaces what the surface's tree holds, takes stack over
+void surface_render_stack(struct pwc_surface *surface, SurfaceStackT *stack);
+// Takes the toplevel's tree out of its workspace
+void surface_render_unmap(struct pwc_surface *surface);
+// Render thread: the client destroyed buffer, surfaces showing it show nothing
+void surface_dmabuf_destroyed(struct pwc_surface *surface, struct DmabufBuffer *buffer);
+// Render thread: uploads a held update if the texture became free
+void surface_retry_upload(struct pwc_surface *surface);
+// Render thread: hands the frame callbacks back to the protocol thread. serial is the output
+// frame that shows the surface, 0 if none does
+void surface_frame_due(struct pwc_surface *surface, uint32_t output_index, uint64_t serial, uint64_t now_ns);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _PWC_SERVER_VIEWPORTER_H
+#define _PWC_SERVER_VIEWPORTER_H
+
+#include <pwc/server/server.h>
+#include <pwc/server/surface.h>
+#include <stdbool.h>
+#include <vulkan/vulkan_core.h>
+#include <wayland-server-core.h>
+
+// wp_viewporter, on the protocol thread. set_source and set_destination go into the surface's
+// pending state (SurfaceStateT.viewport) and apply with its commit, the render crops and
+// scales while sampling (see surface.h).
+
+#define VIEWPORTER_VERSION 1
+
+struct wl_global *create_viewporter_global(struct pwc_server *server);
+
+// wl_surface.commit, before the state is applied. buffer_extent is what the surface will
+// show, zero without a buffer. False once the viewport's protocol error was posted
+bool viewport_commit(struct pwc_surface *surface, VkExtent2D buffer_extent);
+// The wl_surface is going away, its viewport's requests are errors from now on
+void viewport_surface_destroyed(struct pwc_surface *surface);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef _PWC_SERVER_XDG_SHELL_H
+#define _PWC_SERVER_XDG_SHELL_H
+
+#include <pwc/server/server.h>
+#include <pwc/server/surface.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+#include <wayland-server-core.h>
+
+// xdg_wm_base, on the protocol thread. A toplevel maps with its first buffer after the
+// initial configure: the render puts its surface tree on top of the active workspace of the
+// output under the cursor, window centered (see render_map_toplevel()). Configures leave the size to the
+// client and nothing moves or resizes windows, so most toplevel requests are accepted and
+// ignored. Fullscreen only goes into the configure states and hints the tree for a display plane. Popups are placed by their positioner in the popups of the parent surface's tree;
+// constraint adjustment is ignored, nothing keeps them on screen, and grabs grab nothing.
+
+#define XDG_WM_BASE_VERSION 2
+
+enum XdgRole {
+    XDG_ROLE_NONE,
+    XDG_ROLE_TOPLEVEL,
+    XDG_ROLE_POPUP,
+};
+
+typedef struct XdgPositioner {
+    int32_t width, height;
+    VkRect2D anchor_rect;  // Relative to the parent's window geometry
+    uint32_t anchor;       // enum xdg_positioner_anchor
+    uint32_t gravity;      // enum xdg_positioner_gravity, same values
+    int32_t offset_x, offset_y;
+} XdgPositionerT;
+
+typedef struct XdgSurface {
+    struct wl_resource *resource;
+    struct pwc_surface *surface;        // NULL once the wl_surface was destroyed
+    enum XdgRole role;
+    struct wl_resource *role_resource;  // xdg_toplevel or xdg_popup, NULL once destroyed
+    uint32_t configure_serial;          // Of the last configure, 0 until the initial one
+    bool configured;                    // A configure was acked
+    bool buffered;                      // The committed state has a buffer
+    bool mapped;
+    bool fullscreen;            // XDG_ROLE_TOPLEVEL: set_fullscreen, until unset_fullscreen
+    VkRect2D pending_geometry;  // set_window_geometry, zero extent while unset
+    VkRect2D geometry;
+
+    struct wl_list popups;      // XdgSurfaceT.popup_link of popups on it
+    // XDG_ROLE_POPUP
+    struct XdgSurface *parent;  // NULL if none was given or it went away
+    struct wl_list popup_link;
+    XdgPositionerT positioner;
+    SurfaceChildT child;        // Mapped: in the parent surface's popups
+} XdgSurfaceT;
+
+struct wl_global *create_xdg_shell_global(struct pwc_server *server);
+
+// wl_surface.commit of an xdg_surface's surface, before the commit is handed over: sends the
+// initial configure, maps and unmaps
+void xdg_surface_commit(struct pwc_surface *surface, SurfaceCommitT *commit);
+// The wl_surface is going away: it is unmapped and popups on it lose their place
+void xdg_surface_surface_destroyed(struct pwc_surface *surface);
+
+#endif
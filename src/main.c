@@ -2,6 +2,7 @@
 #include <pwc/render/render.h>
 #include <pwc/render/scene/scene.h>
 #include <pwc/render/vulkan/vulkan.h>
+#include <pwc/server/server.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -12,26 +13,22 @@ int main(int argc, char **argv) {
     printf("WAYLAND version: %s\n", WAYLAND_VERSION);  // Use _S for string (if defined; fallback to manual)
     printf("PWC version: 0.01dev\n");
 
-    struct pwc_vulkan *vulkan = calloc(1, sizeof(struct pwc_vulkan));
-    if (!vulkan) {
-        fprintf(stderr, "Failed to allocate vulkan\n");
+    struct pwc_render *render = create_render();
+    if (!render) {
+        fprintf(stderr, "Failed to create render\n");
         exit(EXIT_FAILURE);
-        // return NULL;
     }
-    vulkan->swapchain_ready = false;
-    vulkan->initialized = false;
-    vulkan->validate = true;
-    
-    init_vulkan(vulkan);
-    printf("Vulkan initialized!\n");
 
-    // struct pwc_render *render = create_render();
-    // if (!render) {
-    //     fprintf(stderr, "Failed to create render\n");
-    //     exit(EXIT_FAILURE);
-    // }
+    // Clients are served on the server's own thread from here on. The render loop applies what
+    // it hands over and destroys the server with the render
+    render->server = create_server(render);
+    if (!render->server) {
+        fprintf(stderr, "Failed to create server\n");
+        render_destroy(render);
+        exit(EXIT_FAILURE);
+    }
+
+    render_run(render);
 
-    // render_run(render);
-    
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,135 @@
+#include <pwc/render/animation.h>
+#include <pwc/render/scene/node.h>
+#include <pwc/render/scene/scene.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct pwc_timeline *create_timeline(void) {
+    struct pwc_timeline *timeline = calloc(1, sizeof(struct pwc_timeline));
+    if (!timeline) {
+        fprintf(stderr, "Failed to allocate timeline\n");
+        return NULL;
+    }
+    return timeline;
+}
+
+void destroy_timeline(struct pwc_timeline *timeline) {
+    if (!timeline) return;
+    free(timeline->animations);
+    free(timeline);
+}
+
+static float *property_value(SceneNodeT *node, enum AnimationProperty property) {
+    switch (property) {
+        case ANIMATION_OFFSET_X: return &node->transform.offset[0];
+        case ANIMATION_OFFSET_Y: return &node->transform.offset[1];
+        case ANIMATION_SCALE: return &node->transform.scale;
+        case ANIMATION_OPACITY: return &node->transform.opacity;
+    }
+    return NULL;
+}
+
+float animation_ease(enum AnimationCurve curve, float t) {
+    switch (curve) {
+        case ANIMATION_CURVE_LINEAR: return t;
+        case ANIMATION_CURVE_EASE_OUT: {
+            float u = 1.0f - t;
+            return 1.0f - u * u * u;
+        }
+        case ANIMATION_CURVE_EASE_IN_OUT: {
+            if (t < 0.5f) return 4.0f * t * t * t;
+            float u = -2.0f * t + 2.0f;
+            return 1.0f - u * u * u * 0.5f;
+        }
+    }
+    return t;
+}
+
+static AnimationT *find_animation(struct pwc_timeline *timeline, SceneNodeHandle node, enum AnimationProperty property) {
+    for (uint32_t i = 0; i < timeline->count; i++) {
+        AnimationT *animation = &timeline->animations[i];
+        if (animation->node == node && animation->property == property) return animation;
+    }
+    return NULL;
+}
+
+bool timeline_animate(struct pwc_timeline *timeline, SceneNodeT *node, enum AnimationProperty property, float to,
+                      enum AnimationCurve curve, uint64_t start_ns, uint64_t duration_ns) {
+    AnimationT *animation = find_animation(timeline, node->handle, property);
+    if (!animation) {
+        if (timeline->count >= timeline->capacity) {
+            uint32_t new_capacity = (timeline->capacity == 0) ? 16 : timeline->capacity * 2;
+            AnimationT *new_animations = realloc(timeline->animations, new_capacity * sizeof(AnimationT));
+            if (!new_animations) {
+                fprintf(stderr, "Failed to realloc animations\n");
+                return false;
+            }
+            timeline->animations = new_animations;
+            timeline->capacity = new_capacity;
+        }
+        animation = &timeline->animations[timeline->count++];
+    }
+
+    *animation = (AnimationT){
+        .node = node->handle,
+        .property = property,
+        .curve = curve,
+        .from = *property_value(node, property),
+        .to = to,
+        .start_ns = start_ns,
+        .duration_ns = duration_ns,
+    };
+    return true;
+}
+
+static void remove_animation(struct pwc_timeline *timeline, uint32_t index) {
+    timeline->animations[index] = timeline->animations[--timeline->count];
+}
+
+void timeline_cancel(struct pwc_timeline *timeline, SceneNodeT *node, enum AnimationProperty property) {
+    AnimationT *animation = find_animation(timeline, node->handle, property);
+    if (animation) remove_animation(timeline, animation - timeline->animations);
+}
+
+static bool shown_on(SceneNodeT *node, const SceneNodeHandle *workspaces, uint32_t workspace_count) {
+    SceneNodeT *workspace = node;
+    while (workspace && workspace->type != SCENE_NODE_WORKSPACE) workspace = workspace->parent;
+    // Root and detached nodes: whichever output updates first
+    if (!workspace) return true;
+
+    for (uint32_t i = 0; i < workspace_count; i++) {
+        if (workspaces[i] == workspace->handle) return true;
+    }
+    return false;
+}
+
+void timeline_update(struct pwc_timeline *timeline, struct pwc_scene *scene, const SceneNodeHandle *workspaces,
+                     uint32_t workspace_count, uint64_t time_ns) {
+    for (uint32_t i = timeline->count; i-- > 0;) {
+        AnimationT *animation = &timeline->animations[i];
+        SceneNodeT *node = scene_node_from_handle(animation->node);
+        if (!node) {
+            remove_animation(timeline, i);
+            continue;
+        }
+        if (!shown_on(node, workspaces, workspace_count)) continue;
+
+        float t = 1.0f;
+        if (time_ns < animation->start_ns) {
+            t = 0.0f;
+        } else if (time_ns - animation->start_ns < animation->duration_ns) {
+            t = (float)(time_ns - animation->start_ns) / (float)animation->duration_ns;
+        }
+
+        float *value = property_value(node, animation->property);
+        float next = animation->from + (animation->to - animation->from) * animation_ease(animation->curve, t);
+        if (next != *value) {
+            // Old and new bounds
+            scene_damage_node(scene, node);
+            *value = next;
+            scene_damage_node(scene, node);
+        }
+
+        if (t >= 1.0f) remove_animation(timeline, i);
+    }
+}
@@ -0,0 +1,214 @@
+#include <assert.h>
+#include <pwc/render/blur.h>
+#include <pwc/render/utils/macro.h>
+#include <pwc/render/vulkan/vk-effects.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct pwc_blur_cache *create_blur_cache(struct pwc_vulkan *vulkan, struct pwc_effects *effects, struct pwc_output *output) {
+    struct pwc_blur_cache *cache = calloc(1, sizeof(struct pwc_blur_cache));
+    if (!cache) {
+        fprintf(stderr, "Failed to allocate blur cache\n");
+        return NULL;
+    }
+
+    cache->vulkan = vulkan;
+    cache->effects = effects;
+    cache->output = output;
+    return cache;
+}
+
+static void destroy_entry_images(struct pwc_blur_cache *cache, BlurEntryT *entry) {
+    if (entry->framebuffer) vkDestroyFramebuffer(cache->vulkan->device, entry->framebuffer, NULL);
+    entry->framebuffer = VK_NULL_HANDLE;
+    effect_image_finish(cache->effects, &entry->backdrop);
+    for (uint32_t i = 0; i < MAX_BLUR_LEVELS; i++) {
+        effect_image_finish(cache->effects, &entry->down[i]);
+        effect_image_finish(cache->effects, &entry->up[i]);
+    }
+}
+
+void destroy_blur_cache(struct pwc_blur_cache *cache) {
+    if (!cache) return;
+
+    for (uint32_t i = 0; i < cache->entry_count; i++) {
+        destroy_entry_images(cache, &cache->entries[i]);
+    }
+    free(cache->entries);
+    free(cache);
+}
+
+BlurEntryT *blur_cache_find(struct pwc_blur_cache *cache, SceneNodeHandle node) {
+    // A handful of blurred layers per output, a scan is fine
+    for (uint32_t i = 0; i < cache->entry_count; i++) {
+        if (cache->entries[i].node == node) return &cache->entries[i];
+    }
+    return NULL;
+}
+
+void blur_cache_forget(struct pwc_blur_cache *cache, SceneNodeHandle node) {
+    BlurEntryT *entry = blur_cache_find(cache, node);
+    if (entry) entry->node = SCENE_NODE_HANDLE_NULL;
+}
+
+static BlurEntryT *push_entry(struct pwc_blur_cache *cache) {
+    if (cache->entry_count >= cache->entry_capacity) {
+        uint32_t new_capacity = (cache->entry_capacity == 0) ? 4 : cache->entry_capacity * 2;
+        BlurEntryT *new_entries = realloc(cache->entries, new_capacity * sizeof(BlurEntryT));
+        if (!new_entries) {
+            fprintf(stderr, "Failed to realloc blur entries\n");
+            return NULL;
+        }
+        cache->entries = new_entries;
+        cache->entry_capacity = new_capacity;
+    }
+
+    BlurEntryT *entry = &cache->entries[cache->entry_count++];
+    memset(entry, 0, sizeof(BlurEntryT));
+    return entry;
+}
+
+static VkExtent2D level_extent(VkExtent2D extent, uint32_t level) {
+    uint32_t width = extent.width >> level, height = extent.height >> level;
+    return (VkExtent2D){width ? width : 1, height ? height : 1};
+}
+
+static bool create_entry_images(struct pwc_blur_cache *cache, BlurEntryT *entry) {
+    struct pwc_vulkan *vulkan = cache->vulkan;
+    VkExtent2D extent = entry->region.extent;
+
+    if (!effect_image_init(cache->effects, &entry->backdrop, extent, vulkan->render_pass_format)) return false;
+
+    VkFramebufferCreateInfo framebuffer_ci = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = vulkan->render_pass_offscreen,
+        .attachmentCount = 1,
+        .pAttachments = &entry->backdrop.view,
+        .width = extent.width,
+        .height = extent.height,
+        .layers = 1,
+    };
+    if (vkCreateFramebuffer(vulkan->device, &framebuffer_ci, NULL, &entry->framebuffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create blur framebuffer\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < entry->levels; i++) {
+        if (!effect_image_init(cache->effects, &entry->down[i], level_extent(extent, i + 1), EFFECT_FORMAT)) return false;
+        if (!effect_image_init(cache->effects, &entry->up[i], level_extent(extent, i), EFFECT_FORMAT)) return false;
+    }
+    return true;
+}
+
+BlurEntryT *blur_cache_get(struct pwc_blur_cache *cache, SceneNodeT *node, VkRect2D region, uint32_t levels, bool *recreated) {
+    *recreated = false;
+    if (!cache->effects->enabled || region.extent.width == 0 || region.extent.height == 0) return NULL;
+    if (levels > MAX_BLUR_LEVELS) levels = MAX_BLUR_LEVELS;
+
+    BlurEntryT *entry = blur_cache_find(cache, node->handle);
+    if (entry && entry->levels == levels && entry->region.extent.width == region.extent.width &&
+        entry->region.extent.height == region.extent.height) {
+        // Moved only: the images fit, the backdrop signature covers the new position
+        entry->region = region;
+        return entry;
+    }
+
+    if (entry) {
+        // Frames in flight may still use the old images, they're swept once those completed
+        uint32_t index = entry - cache->entries;
+        BlurEntryT *retired = push_entry(cache);
+        if (!retired) return NULL;
+        entry = &cache->entries[index];
+        *retired = *entry;
+        retired->node = SCENE_NODE_HANDLE_NULL;
+        memset(entry, 0, sizeof(BlurEntryT));
+    } else {
+        entry = push_entry(cache);
+        if (!entry) return NULL;
+    }
+
+    entry->node = node->handle;
+    entry->region = region;
+    entry->levels = levels;
+    if (!create_entry_images(cache, entry)) {
+        fprintf(stderr, "Failed to create %ux%u blur images\n", region.extent.width, region.extent.height);
+        destroy_entry_images(cache, entry);
+        *entry = cache->entries[--cache->entry_count];
+        return NULL;
+    }
+
+    *recreated = true;
+    return entry;
+}
+
+void blur_cache_sweep(struct pwc_blur_cache *cache, uint64_t serial) {
+    struct pwc_output *output = cache->output;
+
+    for (uint32_t i = cache->entry_count; i-- > 0;) {
+        BlurEntryT *entry = &cache->entries[i];
+        if (entry->used_serial >= serial) continue;
+        entry->node = SCENE_NODE_HANDLE_NULL;
+
+        // A blur dispatched in frame N is waited on by the frame after it, so once
+        // N + 1 completed nothing reads or writes the images anymore
+        if (entry->used_serial + 1 >= output->completed_serial) continue;
+        destroy_entry_images(cache, entry);
+        *entry = cache->entries[--cache->entry_count];
+    }
+}
+
+void blur_begin_backdrop(struct pwc_blur_cache *cache, BlurEntryT *entry, VkCommandBuffer cmd) {
+    VkExtent2D extent = entry->region.extent;
+    VkExtent2D output_extent = cache->output->swapchain_extent;
+
+    VkClearValue clear = {{{0, 0, 0, 1}}};
+    VkRenderPassBeginInfo rp_bi = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = cache->vulkan->render_pass_offscreen,
+        .framebuffer = entry->framebuffer,
+        .renderArea = {{0, 0}, extent},
+        .clearValueCount = 1,
+        .pClearValues = &clear,
+    };
+    vkCmdBeginRenderPass(cmd, &rp_bi, VK_SUBPASS_CONTENTS_INLINE);
+
+    // Output space drawing lands on the backdrop
+    VkViewport viewport = {(float)-entry->region.offset.x, (float)-entry->region.offset.y,
+                           (float)output_extent.width, (float)output_extent.height, 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, extent};
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void blur_end_backdrop(struct pwc_blur_cache *cache, BlurEntryT *entry, VkCommandBuffer cmd, uint64_t serial) {
+    struct pwc_effects *effects = cache->effects;
+    float offset = BLUR_OFFSET;
+
+    vkCmdEndRenderPass(cmd);
+    entry->backdrop.initialized = true;  // The pass left it in GENERAL
+
+    // Down to the smallest level, then back up to full size
+    bool recorded = true;
+    for (uint32_t i = 0; i < entry->levels && recorded; i++) {
+        EffectImageT *src = i == 0 ? &entry->backdrop : &entry->down[i - 1];
+        recorded = effects_dispatch(effects, EFFECT_KAWASE_DOWN, src, &entry->down[i], &offset, sizeof(offset));
+    }
+    for (uint32_t i = entry->levels; i-- > 0 && recorded;) {
+        EffectImageT *src = i == entry->levels - 1 ? &entry->down[i] : &entry->up[i + 1];
+        recorded = effects_dispatch(effects, EFFECT_KAWASE_UP, src, &entry->up[i], &offset, sizeof(offset));
+    }
+
+    entry->used_serial = serial;
+    if (!recorded) {
+        // No effect batch was free, retried next frame
+        entry->backdrop_signature = 0;
+        return;
+    }
+    if (entry->result_serial == 0) entry->result_serial = serial;
+}
+
+bool blur_entry_ready(const BlurEntryT *entry, uint64_t serial) {
+    return entry->result_serial != 0 && entry->result_serial < serial;
+}
@@ -0,0 +1,148 @@
+#include <assert.h>
+#include <pwc/render/cmd-cache.h>
+#include <pwc/render/scene/node.h>
+#include <pwc/render/utils/macro.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+
+struct pwc_cmd_cache *create_cmd_cache(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    struct pwc_cmd_cache *cache = calloc(1, sizeof(struct pwc_cmd_cache));
+    if (!cache) {
+        fprintf(stderr, "Failed to allocate command cache\n");
+        return NULL;
+    }
+
+    cache->vulkan = vulkan;
+    cache->output = output;
+    return cache;
+}
+
+void destroy_cmd_cache(struct pwc_cmd_cache *cache) {
+    if (!cache) return;
+
+    for (uint32_t i = 0; i < cache->entry_count; i++) {
+        // Destroying the pool frees the entry's command buffers
+        if (cache->entries[i].pool) vkDestroyCommandPool(cache->vulkan->device, cache->entries[i].pool, NULL);
+    }
+
+    free(cache->entries);
+    free(cache);
+}
+
+void cmd_cache_invalidate_all(struct pwc_cmd_cache *cache) {
+    for (uint32_t i = 0; i < cache->entry_count; i++) {
+        memset(cache->entries[i].valid, 0, sizeof(cache->entries[i].valid));
+    }
+}
+
+void cmd_cache_evict(struct pwc_cmd_cache *cache, SceneNodeHandle node) {
+    uint32_t index = (uint32_t)(node & SCENE_NODE_HANDLE_INDEX_MASK) - 1;
+    if (index >= cache->entry_count || cache->entries[index].node != node) return;
+
+    CmdCacheEntryT *entry = &cache->entries[index];
+    if (entry->pool) vkDestroyCommandPool(cache->vulkan->device, entry->pool, NULL);
+    memset(entry, 0, sizeof(CmdCacheEntryT));
+}
+
+void cmd_cache_forget(struct pwc_cmd_cache *cache, SceneNodeHandle node) {
+    uint32_t index = (uint32_t)(node & SCENE_NODE_HANDLE_INDEX_MASK) - 1;
+    if (index >= cache->entry_count || cache->entries[index].node != node) return;
+
+    // Frames in flight may still execute the buffers, a slot is only re-recorded once its fence signaled
+    CmdCacheEntryT *entry = &cache->entries[index];
+    entry->node = SCENE_NODE_HANDLE_NULL;
+    memset(entry->valid, 0, sizeof(entry->valid));
+}
+
+static bool transform_equal(const SceneTransformT *a, SceneTransformT b) {
+    return a->offset[0] == b.offset[0] && a->offset[1] == b.offset[1] && a->scale == b.scale && a->opacity == b.opacity;
+}
+
+static CmdCacheEntryT *get_entry(struct pwc_cmd_cache *cache, SceneNodeHandle handle) {
+    uint32_t index = (uint32_t)(handle & SCENE_NODE_HANDLE_INDEX_MASK) - 1;
+
+    if (index >= cache->entry_count) {
+        uint32_t new_count = (cache->entry_count == 0) ? 64 : cache->entry_count;
+        while (new_count <= index) new_count *= 2;
+
+        CmdCacheEntryT *new_entries = realloc(cache->entries, new_count * sizeof(CmdCacheEntryT));
+        if (!new_entries) {
+            fprintf(stderr, "Failed to realloc command cache entries\n");
+            return NULL;
+        }
+        memset(&new_entries[cache->entry_count], 0, (new_count - cache->entry_count) * sizeof(CmdCacheEntryT));
+
+        cache->entries = new_entries;
+        cache->entry_count = new_count;
+    }
+
+    CmdCacheEntryT *entry = &cache->entries[index];
+    if (entry->node != handle) {
+        // Slot was reused by a new node (or never used): keep the pool and buffers,
+        // forget what they contain
+        entry->node = handle;
+        memset(entry->valid, 0, sizeof(entry->valid));
+    }
+
+    return entry;
+}
+
+VkCommandBuffer cmd_cache_lookup(struct pwc_cmd_cache *cache, SceneNodeT *node, uint32_t frame_slot, VkCommandBuffer *record_target) {
+    VkResult U_ASSERT_ONLY err;
+    struct pwc_vulkan *vulkan = cache->vulkan;
+
+    *record_target = VK_NULL_HANDLE;
+
+    CmdCacheEntryT *entry = get_entry(cache, node->handle);
+    if (!entry) return VK_NULL_HANDLE;
+
+    if (entry->valid[frame_slot] &&
+        entry->subtree_serial[frame_slot] == node->subtree_serial &&
+        transform_equal(&entry->world_transform[frame_slot], scene_node_world_transform(node)) &&
+        entry->pipeline_serial[frame_slot] == vulkan->pipeline_serial &&
+        entry->swapchain_serial[frame_slot] == cache->output->swapchain_serial) {
+        cache->hits++;
+        return entry->cmd[frame_slot];
+    }
+
+    if (!entry->pool) {
+        VkCommandPoolCreateInfo pool_ci = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .queueFamilyIndex = vulkan->graphics_queue_family_index,
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        };
+        err = vkCreateCommandPool(vulkan->device, &pool_ci, NULL, &entry->pool);
+        assert(!err);
+
+        VkCommandBufferAllocateInfo alloc_ci = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = entry->pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = FRAME_LAG,
+        };
+        err = vkAllocateCommandBuffers(vulkan->device, &alloc_ci, entry->cmd);
+        assert(!err);
+    }
+
+    // Rewritten from here on: the key is only stored by cmd_cache_commit() once recording ended
+    entry->valid[frame_slot] = false;
+    cache->misses++;
+
+    *record_target = entry->cmd[frame_slot];
+    return VK_NULL_HANDLE;
+}
+
+void cmd_cache_commit(struct pwc_cmd_cache *cache, SceneNodeT *node, uint32_t frame_slot) {
+    uint32_t index = (uint32_t)(node->handle & SCENE_NODE_HANDLE_INDEX_MASK) - 1;
+    if (index >= cache->entry_count || cache->entries[index].node != node->handle) return;
+
+    CmdCacheEntryT *entry = &cache->entries[index];
+    entry->valid[frame_slot] = true;
+    entry->subtree_serial[frame_slot] = node->subtree_serial;
+    entry->world_transform[frame_slot] = scene_node_world_transform(node);
+    entry->pipeline_serial[frame_slot] = cache->vulkan->pipeline_serial;
+    entry->swapchain_serial[frame_slot] = cache->output->swapchain_serial;
+}
@@ -0,0 +1,312 @@
+#include <assert.h>
+#include <math.h>
+#include <pwc/render/cursor.h>
+#include <pwc/render/damage.h>
+#include <pwc/render/scene/node.h>
+#include <pwc/render/utils/macro.h>
+#include <pwc/render/vulkan/vk-core.h>
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/render/vulkan/vk-upload.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+
+// Outline of the arrow, pixel corners, hotspot at the origin
+static const float arrow[][2] = {{0, 0}, {0, 17}, {4, 13}, {7, 20}, {9, 19}, {6, 12}, {12, 12}};
+
+static bool arrow_contains(float x, float y) {
+    bool inside = false;
+    for (uint32_t i = 0, j = ARRAY_SIZE(arrow) - 1; i < ARRAY_SIZE(arrow); j = i++) {
+        if ((arrow[i][1] > y) != (arrow[j][1] > y) &&
+            x < (arrow[j][0] - arrow[i][0]) * (y - arrow[i][1]) / (arrow[j][1] - arrow[i][1]) + arrow[i][0]) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+// White with a black outline, premultiplied B, G, R, A
+static void draw_arrow(uint32_t *pixels) {
+    for (uint32_t y = 0; y < CURSOR_DEFAULT_SIZE; y++) {
+        for (uint32_t x = 0; x < CURSOR_DEFAULT_SIZE; x++) {
+            float cx = x + 0.5f, cy = y + 0.5f;
+            uint32_t pixel = 0;
+            if (arrow_contains(cx, cy)) {
+                bool edge = !arrow_contains(cx - 1, cy) || !arrow_contains(cx + 1, cy) || !arrow_contains(cx, cy - 1) ||
+                            !arrow_contains(cx, cy + 1);
+                pixel = edge ? 0xff000000u : 0xffffffffu;
+            }
+            pixels[y * CURSOR_DEFAULT_SIZE + x] = pixel;
+        }
+    }
+}
+
+struct pwc_cursor *create_cursor(struct pwc_vulkan *vulkan, struct pwc_textures *textures, struct pwc_uploader *uploader) {
+    struct pwc_cursor *cursor = calloc(1, sizeof(struct pwc_cursor));
+    if (!cursor) {
+        fprintf(stderr, "Failed to allocate cursor\n");
+        return NULL;
+    }
+    cursor->textures = textures;
+    cursor->uploader = uploader;
+
+    cursor->node = create_scene_node(SCENE_NODE_SURFACE);
+    if (!cursor->node) {
+        fprintf(stderr, "Failed to create cursor node\n");
+        free(cursor);
+        return NULL;
+    }
+    cursor->node->plane_hint = SCENE_PLANE_HINT_CURSOR;
+
+    // Without textures there is no cursor at all
+    cursor->fallback_valid = texture_init(textures, &cursor->fallback, (VkExtent2D){CURSOR_DEFAULT_SIZE, CURSOR_DEFAULT_SIZE},
+                                          VK_FORMAT_B8G8R8A8_UNORM, false);
+    cursor_set_default(cursor);
+    return cursor;
+}
+
+void destroy_cursor(struct pwc_cursor *cursor) {
+    if (!cursor) return;
+    if (cursor->fallback_valid) texture_finish(cursor->textures, &cursor->fallback);
+    destroy_scene_node(cursor->node);
+    free(cursor);
+}
+
+void cursor_set_image(struct pwc_cursor *cursor, TextureT *texture, VkExtent2D size, VkOffset2D hotspot) {
+    cursor->texture = texture;
+    cursor->size = size;
+    cursor->hotspot = hotspot;
+    cursor->serial++;
+}
+
+void cursor_set_default(struct pwc_cursor *cursor) {
+    cursor_set_image(cursor, cursor->fallback_valid ? &cursor->fallback : NULL,
+                     (VkExtent2D){CURSOR_DEFAULT_SIZE, CURSOR_DEFAULT_SIZE}, (VkOffset2D){0, 0});
+}
+
+void cursor_prepare(struct pwc_cursor *cursor) {
+    if (!cursor->fallback_valid || cursor->fallback_uploaded) return;
+
+    DamageRegionT damage = {0};
+    damage_add_rect(&damage, (VkRect2D){{0, 0}, {CURSOR_DEFAULT_SIZE, CURSOR_DEFAULT_SIZE}});
+    DamageRegionT region;
+    TextureImageT *image = texture_begin_update(cursor->textures, &cursor->fallback, &damage, &region);
+    if (!image) return;
+
+    uint32_t pixels[CURSOR_DEFAULT_SIZE * CURSOR_DEFAULT_SIZE];
+    draw_arrow(pixels);
+    if (!upload_image_region(cursor->uploader, image->image, image->initialized, pixels, CURSOR_DEFAULT_SIZE * 4, &region)) return;
+    texture_end_update(cursor->textures, &cursor->fallback, &damage);
+    cursor->fallback_uploaded = true;
+    if (cursor->texture == &cursor->fallback) cursor->serial++;
+}
+
+static void destroy_save_image(struct pwc_vulkan *vulkan, CursorOverlayT *overlay) {
+    if (overlay->save) vkDestroyImage(vulkan->device, overlay->save, NULL);
+    if (overlay->save_mem) vkFreeMemory(vulkan->device, overlay->save_mem, NULL);
+    overlay->save = VK_NULL_HANDLE;
+    overlay->save_mem = VK_NULL_HANDLE;
+}
+
+void cursor_overlay_finish(struct pwc_vulkan *vulkan, CursorOverlayT *overlay) {
+    destroy_save_image(vulkan, overlay);
+    memset(overlay, 0, sizeof(CursorOverlayT));
+}
+
+static bool rect_empty(VkRect2D rect) {
+    return rect.extent.width == 0 || rect.extent.height == 0;
+}
+
+static bool rect_equal(VkRect2D a, VkRect2D b) {
+    return a.offset.x == b.offset.x && a.offset.y == b.offset.y && a.extent.width == b.extent.width &&
+           a.extent.height == b.extent.height;
+}
+
+// New images have undefined contents, they are drawn whole first
+static void sync_swapchain(CursorOverlayT *overlay, struct pwc_output *output) {
+    if (overlay->swapchain_serial == output->swapchain_serial) return;
+    memset(overlay->saved, 0, sizeof(overlay->saved));
+    overlay->swapchain_serial = output->swapchain_serial;
+}
+
+bool cursor_overlay_update(struct pwc_cursor *cursor, CursorOverlayT *overlay, struct pwc_output *output, VkOffset2D origin,
+                           bool on_plane) {
+    sync_swapchain(overlay, output);
+
+    overlay->box = (VkRect2D){
+        {(int32_t)floor(cursor->x) - origin.x - cursor->hotspot.x, (int32_t)floor(cursor->y) - origin.y - cursor->hotspot.y},
+        cursor->size,
+    };
+    overlay->clip = (VkRect2D){0};
+    if (cursor->texture && !on_plane) rect_clip(overlay->box, output->swapchain_extent, &overlay->clip);
+
+    overlay->changed = !rect_equal(overlay->clip, overlay->shown) ||
+                       (!rect_empty(overlay->clip) && overlay->shown_serial != cursor->serial);
+    return overlay->changed;
+}
+
+static bool create_save_image(struct pwc_vulkan *vulkan, CursorOverlayT *overlay) {
+    VkResult U_ASSERT_ONLY err;
+    VkImageCreateInfo image_ci = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = vulkan->render_pass_format,
+        .extent = {CURSOR_SAVE_SIZE, CURSOR_SAVE_SIZE * CURSOR_SAVE_IMAGES, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    if (vkCreateImage(vulkan->device, &image_ci, NULL, &overlay->save) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create cursor save-under\n");
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(vulkan->device, overlay->save, &requirements);
+    VkMemoryAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = find_memory_type(vulkan, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    };
+    if (alloc_info.memoryTypeIndex == UINT32_MAX ||
+        vkAllocateMemory(vulkan->device, &alloc_info, NULL, &overlay->save_mem) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate cursor save-under\n");
+        return false;
+    }
+    err = vkBindImageMemory(vulkan->device, overlay->save, overlay->save_mem, 0);
+    assert(!err);
+    return true;
+}
+
+void cursor_overlay_damage(struct pwc_cursor *cursor, CursorOverlayT *overlay, struct pwc_output *output, uint32_t image_index,
+                           DamageRegionT *damage) {
+    struct pwc_vulkan *vulkan = cursor->textures->vulkan;
+    // The swapchain may have been recreated while acquiring
+    sync_swapchain(overlay, output);
+    if (!rect_clip(overlay->clip, output->swapchain_extent, &overlay->clip)) overlay->clip = (VkRect2D){0};
+
+    overlay->saving = !rect_empty(overlay->clip) && output->swapchain_transfer && image_index < CURSOR_SAVE_IMAGES &&
+                      overlay->clip.extent.width <= CURSOR_SAVE_SIZE && overlay->clip.extent.height <= CURSOR_SAVE_SIZE;
+    if (overlay->saving && !overlay->save) {
+        // Tried once, after a failure the cursor's rects are damaged from then on
+        if (overlay->save_failed || !create_save_image(vulkan, overlay)) {
+            destroy_save_image(vulkan, overlay);
+            overlay->save_failed = true;
+            overlay->saving = false;
+        }
+    }
+
+    // A cursor composited without a save-under is only gone once the scene is drawn over it
+    if (!rect_empty(overlay->shown) && !overlay->shown_saved) damage_add_rect(damage, overlay->shown);
+    if (!overlay->saving && !rect_empty(overlay->clip)) damage_add_rect(damage, overlay->clip);
+}
+
+static void image_barrier(VkCommandBuffer cmd, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout,
+                          VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage,
+                          VkAccessFlags dst_access) {
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = src_access,
+        .dstAccessMask = dst_access,
+        .oldLayout = old_layout,
+        .newLayout = new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+static VkImageCopy save_copy(VkRect2D rect, uint32_t image_index, bool to_save) {
+    VkOffset3D screen = {rect.offset.x, rect.offset.y, 0};
+    VkOffset3D save = {0, (int32_t)(image_index * CURSOR_SAVE_SIZE), 0};
+    return (VkImageCopy){
+        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .srcOffset = to_save ? screen : save,
+        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .dstOffset = to_save ? save : screen,
+        .extent = {rect.extent.width, rect.extent.height, 1},
+    };
+}
+
+void cursor_overlay_restore(CursorOverlayT *overlay, struct pwc_output *output, VkCommandBuffer cmd, uint32_t image_index,
+                            bool whole) {
+    if (image_index >= CURSOR_SAVE_IMAGES) return;
+    VkRect2D rect = overlay->saved[image_index];
+    overlay->saved[image_index] = (VkRect2D){0};
+    if (rect_empty(rect) || whole) return;
+
+    VkImage image = output->swapchain_images[image_index];
+    // The acquire semaphore is waited for at the transfer stage too
+    image_barrier(cmd, image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    image_barrier(cmd, overlay->save, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    VkImageCopy copy = save_copy(rect, image_index, false);
+    vkCmdCopyImage(cmd, overlay->save, VK_IMAGE_LAYOUT_GENERAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+    image_barrier(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                  VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+}
+
+void cursor_overlay_draw(struct pwc_cursor *cursor, CursorOverlayT *overlay, struct pwc_output *output, VkCommandBuffer cmd,
+                         uint32_t image_index) {
+    struct pwc_vulkan *vulkan = cursor->textures->vulkan;
+    VkRect2D clip = overlay->clip;
+    overlay->shown = clip;
+    overlay->shown_saved = overlay->saving;
+    overlay->shown_serial = cursor->serial;
+    if (rect_empty(clip)) return;
+
+    VkImage image = output->swapchain_images[image_index];
+    if (overlay->saving) {
+        if (!overlay->save_initialized) {
+            image_barrier(cmd, overlay->save, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                          VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+            overlay->save_initialized = true;
+        }
+        image_barrier(cmd, image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_TRANSFER_READ_BIT);
+        // Earlier copies out of the square are done before it is overwritten
+        image_barrier(cmd, overlay->save, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_TRANSFER_WRITE_BIT);
+        VkImageCopy copy = save_copy(clip, image_index, true);
+        vkCmdCopyImage(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, overlay->save, VK_IMAGE_LAYOUT_GENERAL, 1, &copy);
+        image_barrier(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                      VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+        overlay->saved[image_index] = clip;
+    } else {
+        // Blends over what the composition (if any) just wrote
+        image_barrier(cmd, image, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                      VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    }
+
+    VkRenderPassBeginInfo rp_bi = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = vulkan->render_pass_load,
+        .framebuffer = output->framebuffers[image_index],
+        .renderArea = clip,
+    };
+    vkCmdBeginRenderPass(cmd, &rp_bi, VK_SUBPASS_CONTENTS_INLINE);
+    VkExtent2D extent = output->swapchain_extent;
+    VkViewport viewport = {0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f};
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &clip);
+    textures_draw(cursor->textures, cmd, cursor->texture, overlay->box, cursor->node->uv_rect, cursor->node->uv_transform,
+                  extent, 1.0f);
+    vkCmdEndRenderPass(cmd);
+}
@@ -0,0 +1,121 @@
+#include <pwc/render/damage.h>
+#include <stdint.h>
+
+static bool rect_is_empty(VkRect2D rect) {
+    return rect.extent.width == 0 || rect.extent.height == 0;
+}
+
+static bool rect_contains(VkRect2D outer, VkRect2D inner) {
+    return inner.offset.x >= outer.offset.x && inner.offset.y >= outer.offset.y &&
+           (int64_t)inner.offset.x + inner.extent.width <= (int64_t)outer.offset.x + outer.extent.width &&
+           (int64_t)inner.offset.y + inner.extent.height <= (int64_t)outer.offset.y + outer.extent.height;
+}
+
+static uint64_t rect_area(VkRect2D rect) {
+    return (uint64_t)rect.extent.width * rect.extent.height;
+}
+
+bool rect_intersects(VkRect2D a, VkRect2D b) {
+    if (rect_is_empty(a) || rect_is_empty(b)) return false;
+    return a.offset.x < (int64_t)b.offset.x + b.extent.width && b.offset.x < (int64_t)a.offset.x + a.extent.width &&
+           a.offset.y < (int64_t)b.offset.y + b.extent.height && b.offset.y < (int64_t)a.offset.y + a.extent.height;
+}
+
+bool rect_clip(VkRect2D rect, VkExtent2D extent, VkRect2D *out) {
+    int64_t x1 = rect.offset.x < 0 ? 0 : rect.offset.x;
+    int64_t y1 = rect.offset.y < 0 ? 0 : rect.offset.y;
+    int64_t x2 = (int64_t)rect.offset.x + rect.extent.width;
+    int64_t y2 = (int64_t)rect.offset.y + rect.extent.height;
+    if (x2 > extent.width) x2 = extent.width;
+    if (y2 > extent.height) y2 = extent.height;
+    if (x2 <= x1 || y2 <= y1) return false;
+
+    *out = (VkRect2D){{(int32_t)x1, (int32_t)y1}, {(uint32_t)(x2 - x1), (uint32_t)(y2 - y1)}};
+    return true;
+}
+
+VkRect2D rect_union(VkRect2D a, VkRect2D b) {
+    if (rect_is_empty(a)) return b;
+    if (rect_is_empty(b)) return a;
+
+    int64_t x1 = a.offset.x < b.offset.x ? a.offset.x : b.offset.x;
+    int64_t y1 = a.offset.y < b.offset.y ? a.offset.y : b.offset.y;
+    int64_t ax2 = (int64_t)a.offset.x + a.extent.width, bx2 = (int64_t)b.offset.x + b.extent.width;
+    int64_t ay2 = (int64_t)a.offset.y + a.extent.height, by2 = (int64_t)b.offset.y + b.extent.height;
+    int64_t x2 = ax2 > bx2 ? ax2 : bx2;
+    int64_t y2 = ay2 > by2 ? ay2 : by2;
+
+    return (VkRect2D){{(int32_t)x1, (int32_t)y1}, {(uint32_t)(x2 - x1), (uint32_t)(y2 - y1)}};
+}
+
+void damage_clear(DamageRegionT *damage) {
+    damage->count = 0;
+}
+
+bool damage_is_empty(const DamageRegionT *damage) {
+    return damage->count == 0;
+}
+
+void damage_add_rect(DamageRegionT *damage, VkRect2D rect) {
+    if (rect_is_empty(rect)) return;
+
+    for (uint32_t i = 0; i < damage->count; i++) {
+        if (rect_contains(damage->rects[i], rect)) return;
+        if (rect_contains(rect, damage->rects[i])) {
+            // Swallow existing rects covered by the new one
+            damage->rects[i] = damage->rects[--damage->count];
+            i--;
+        }
+    }
+
+    if (damage->count < MAX_DAMAGE_RECTS) {
+        damage->rects[damage->count++] = rect;
+        return;
+    }
+
+    // Full: merge into the rect whose union grows the least
+    uint32_t best = 0;
+    uint64_t best_cost = UINT64_MAX;
+    for (uint32_t i = 0; i < damage->count; i++) {
+        uint64_t cost = rect_area(rect_union(damage->rects[i], rect)) - rect_area(damage->rects[i]);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best = i;
+        }
+    }
+    damage->rects[best] = rect_union(damage->rects[best], rect);
+}
+
+void damage_add_region(DamageRegionT *damage, const DamageRegionT *other) {
+    for (uint32_t i = 0; i < other->count; i++) {
+        damage_add_rect(damage, other->rects[i]);
+    }
+}
+
+void damage_set_whole(DamageRegionT *damage, VkExtent2D extent) {
+    damage->count = 0;
+    damage_add_rect(damage, (VkRect2D){{0, 0}, extent});
+}
+
+void damage_clip(DamageRegionT *damage, VkExtent2D extent) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < damage->count; i++) {
+        if (rect_clip(damage->rects[i], extent, &damage->rects[kept])) kept++;
+    }
+    damage->count = kept;
+}
+
+bool damage_intersects(const DamageRegionT *damage, VkRect2D rect) {
+    for (uint32_t i = 0; i < damage->count; i++) {
+        if (rect_intersects(damage->rects[i], rect)) return true;
+    }
+    return false;
+}
+
+VkRect2D damage_bounds(const DamageRegionT *damage) {
+    VkRect2D bounds = {{0, 0}, {0, 0}};
+    for (uint32_t i = 0; i < damage->count; i++) {
+        bounds = rect_union(bounds, damage->rects[i]);
+    }
+    return bounds;
+}
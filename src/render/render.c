@@ -1,47 +1,217 @@
 #include <pwc/render/vulkan/vk-core.h>
 #include <assert.h>
+#include <pwc/render/animation.h>
+#include <pwc/render/blur.h>
+#include <pwc/render/cmd-cache.h>
+#include <pwc/render/cursor.h>
+#include <pwc/render/damage.h>
 #include <pwc/render/scene/scene.h>
 #include <pwc/render/vulkan/vulkan.h>
 #include <pwc/render/render.h>
 #include <pwc/render/utils/macro.h>
+#include <pwc/render/utils/thread-pool.h>
+#include <pwc/render/vulkan/vk-decorations.h>
+#include <pwc/render/vulkan/vk-effects.h>
+#include <pwc/render/vulkan/vk-planes.h>
+#include <pwc/render/vulkan/vk-present-timing.h>
+#include <pwc/render/vulkan/vk-recorder.h>
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/render/vulkan/vk-upload.h>
+#include <pwc/render/workspace-cache.h>
+#include <pwc/server/seat.h>
+#include <pwc/server/server.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <vulkan/vulkan_core.h>
 
 // Render должен запускать дисплей (Цикл, в котором проходится по всей сцене и вызывает draw)
 
 static void init_scene(struct pwc_scene *scene) {
-    SceneNodeT *root = create_scene_node(SCENE_NODE_ROOT, NULL);
+    SceneNodeT *root = create_scene_node(SCENE_NODE_ROOT);
     scene->root = root;
 
-    SceneNodeT *ws1 = create_scene_node(SCENE_NODE_WORKSPACE, NULL);
+    SceneNodeT *ws1 = create_scene_node(SCENE_NODE_WORKSPACE);
     scene_add_child(root, ws1);
 
-    SceneNodeT *bg1 = create_scene_node(SCENE_NODE_BACKGROUND, NULL);
+    SceneNodeT *bg1 = create_scene_node(SCENE_NODE_BACKGROUND);
     scene_add_child(ws1, bg1);
 
-    SceneNodeT *ws2 = create_scene_node(SCENE_NODE_WORKSPACE, NULL);
+    SceneNodeT *ws2 = create_scene_node(SCENE_NODE_WORKSPACE);
     scene_add_child(root, ws2);
 
-    SceneNodeT *bg2 = create_scene_node(SCENE_NODE_BACKGROUND, NULL);
+    SceneNodeT *bg2 = create_scene_node(SCENE_NODE_BACKGROUND);
     scene_add_child(ws2, bg2);
 
     print_scene(scene);
 }
 
+#define FRAME_RETRY_NS 1000000ull
+#define DEFAULT_REFRESH_RATE 60000  // mHz, for modes reporting none
+#define SWITCH_DURATION_NS 250000000ull
+// Snapshots not on screen are refreshed at most this often, however often they change
+#define SNAPSHOT_REFRESH_INTERVAL_NS 500000000ull
+#define OVERVIEW_GAP 32
+#define HIBERNATE_AFTER_NS 60000000000ull
+#define BUDGET_CHECK_INTERVAL_NS 1000000000ull
+#define BUDGET_HIGH_WATER 90  // Percent of the device local budget
+#define REFERENCE_DPI 96.0f   // Density of scale 1
+#define MAX_OUTPUT_SCALE 3.0f
+#define MAP_FADE_NS 150000000ull
+#define WINDOW_BLUR_LEVELS 3  // Blur-behind of mapped toplevels, seen through their translucent parts
+
+// Of mapped toplevels: a soft drop shadow, nothing drawn over the window itself
+static const SceneDecorationT window_decoration = {
+    .enabled = true,
+    .corner_radius = 8.0f,
+    .shadow_radius = 24.0f,
+    .shadow_offset = {0.0f, 6.0f},
+    .shadow_color = {0.0f, 0.0f, 0.0f, 0.45f},
+};
+
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Density over REFERENCE_DPI in quarter steps. Displays reporting no or implausible sizes
+// (projectors, some TVs) stay at 1
+static float output_scale(const struct pwc_output *output) {
+    if (output->physical_size.width < 100 || output->display_extent.width == 0) return 1.0f;
+    float dpi = output->display_extent.width * 25.4f / output->physical_size.width;
+    float scale = roundf(dpi / REFERENCE_DPI * 4.0f) / 4.0f;
+    return fminf(fmaxf(scale, 1.0f), MAX_OUTPUT_SCALE);
+}
+
+static bool init_render_output(struct pwc_render *render, RenderOutputT *ro, struct pwc_output *output) {
+    struct pwc_vulkan *vulkan = render->vulkan;
+    ro->render = render;
+    ro->output = output;
+    ro->scale = output_scale(output);
+
+    ro->recorder = create_recorder(vulkan, render->threads, ro);
+    if (!ro->recorder) {
+        fprintf(stderr, "Failed to create command recorder\n");
+        return false;
+    }
+
+    ro->cmd_cache = create_cmd_cache(vulkan, output);
+    if (!ro->cmd_cache) {
+        fprintf(stderr, "Failed to create command cache\n");
+        return false;
+    }
+
+    ro->planes = create_planes(vulkan, output);
+    if (!ro->planes) {
+        fprintf(stderr, "Failed to create plane allocator\n");
+        return false;
+    }
+    // Plane frames sample surfaces outside of the output's frames
+    for (uint32_t i = 0; i < FRAME_LAG; i++) {
+        if (!textures_add_reader(render->textures, ro->planes->fences[i])) return false;
+    }
+
+    ro->blur = create_blur_cache(vulkan, render->effects, output);
+    if (!ro->blur) {
+        fprintf(stderr, "Failed to create blur cache\n");
+        return false;
+    }
+
+    ro->workspace_cache = create_workspace_cache(vulkan, render->effects, render->decorations, output, SNAPSHOT_DEFAULT_SCALE);
+    if (!ro->workspace_cache) {
+        fprintf(stderr, "Failed to create workspace cache\n");
+        return false;
+    }
+    // So do snapshots
+    for (uint32_t i = 0; i < SNAPSHOT_SUBMISSIONS; i++) {
+        if (!textures_add_reader(render->textures, ro->workspace_cache->submissions[i].fence)) return false;
+    }
+
+    ro->present_timing = create_present_timing(vulkan, output);
+    if (!ro->present_timing) return false;
+
+    uint32_t refresh_rate = output->refresh_rate ? output->refresh_rate : DEFAULT_REFRESH_RATE;
+    ro->refresh_ns = 1000000000000ull / refresh_rate;
+    ro->next_frame_ns = get_time_ns();
+    ro->pending_whole = true;
+    return true;
+}
+
+static void destroy_render_output(RenderOutputT *ro) {
+    cursor_overlay_finish(ro->render->vulkan, &ro->cursor);
+    destroy_present_timing(ro->present_timing);
+    ro->present_timing = NULL;
+    destroy_workspace_cache(ro->workspace_cache);
+    ro->workspace_cache = NULL;
+    destroy_blur_cache(ro->blur);
+    ro->blur = NULL;
+    destroy_planes(ro->planes);
+    ro->planes = NULL;
+    destroy_cmd_cache(ro->cmd_cache);
+    ro->cmd_cache = NULL;
+    destroy_recorder(ro->recorder);
+    ro->recorder = NULL;
+    free(ro->image_drawn_serial);
+    ro->image_drawn_serial = NULL;
+    for (uint32_t i = 0; i < FRAME_LAG; i++) {
+        decoration_buffer_finish(ro->render->decorations, &ro->decoration_buffers[i]);
+    }
+    free(ro->decoration_instances);
+    ro->decoration_instances = NULL;
+    free(ro->decoration_runs);
+    ro->decoration_runs = NULL;
+}
+
+// Spreads the workspaces over the outputs in order, with one output it shows them all
+static void assign_workspaces(struct pwc_render *render) {
+    uint64_t now = get_time_ns();
+    uint32_t k = 0;
+    scene_node_for_each_child(workspace, render->scene->root) {
+        RenderOutputT *ro = &render->outputs[k++ % render->output_count];
+        if (ro->workspace_count >= MAX_OUTPUT_WORKSPACES) {
+            fprintf(stderr, "Too many workspaces on output %u\n", ro->output->index);
+            continue;
+        }
+        // Hibernates once hidden for the timeout from now on
+        ro->activity[ro->workspace_count] = (WorkspaceActivityT){.visible_ns = now};
+        ro->workspaces[ro->workspace_count++] = workspace->handle;
+    }
+
+    // The topmost one, it covered the others when they were all drawn stacked
+    for (uint32_t i = 0; i < render->output_count; i++) {
+        RenderOutputT *ro = &render->outputs[i];
+        if (ro->workspace_count > 0) ro->active_workspace = ro->workspace_count - 1;
+    }
+}
+
+// What the outputs cached for a destroyed node goes with it, a later node reusing its handle
+// slot starts from nothing
+static void forget_node(SceneNodeT *node, void *data) {
+    struct pwc_render *render = data;
+    for (uint32_t i = 0; i < render->output_count; i++) {
+        RenderOutputT *ro = &render->outputs[i];
+        cmd_cache_forget(ro->cmd_cache, node->handle);
+        blur_cache_forget(ro->blur, node->handle);
+        if (node->type == SCENE_NODE_WORKSPACE) workspace_cache_forget(ro->workspace_cache, node->handle);
+    }
+}
+
 struct pwc_render *create_render(void) {
     struct pwc_render *render = calloc(1, sizeof(struct pwc_render));
     if (!render) {
         fprintf(stderr, "Failed to allocate render\n");
         return NULL;
     }
+    render->hibernate_after_ns = HIBERNATE_AFTER_NS;
 
     struct pwc_vulkan *vulkan = calloc(1, sizeof(struct pwc_vulkan));
     if (!vulkan) {
         fprintf(stderr, "Failed to allocate vulkan\n");
         return NULL;
     }
-    vulkan->swapchain_ready = false;
     vulkan->initialized = false;
     vulkan->validate = true;
 
@@ -57,10 +227,86 @@ struct pwc_render *create_render(void) {
     render->scene = scene;
     render->vulkan = vulkan;
 
+    // Sized to the machine
+    render->threads = create_thread_pool(0);
+    if (!render->threads) {
+        fprintf(stderr, "Failed to create render thread pool\n");
+        return NULL;
+    }
+
+    render->uploader = create_uploader(vulkan);
+    if (!render->uploader) {
+        fprintf(stderr, "Failed to create uploader\n");
+        return NULL;
+    }
+
+    render->effects = create_effects(vulkan);
+    if (!render->effects) {
+        fprintf(stderr, "Failed to create effects\n");
+        return NULL;
+    }
+
+    render->timeline = create_timeline();
+    if (!render->timeline) {
+        fprintf(stderr, "Failed to create timeline\n");
+        return NULL;
+    }
+
+    render->decorations = create_decorations(vulkan);
+    if (!render->decorations) {
+        fprintf(stderr, "Failed to create decorations\n");
+        return NULL;
+    }
+
+    render->textures = create_textures(vulkan);
+    if (!render->textures) {
+        fprintf(stderr, "Failed to create textures\n");
+        return NULL;
+    }
+
+    render->cursor = create_cursor(vulkan, render->textures, render->uploader);
+    if (!render->cursor) {
+        fprintf(stderr, "Failed to create cursor\n");
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < vulkan->output_count; i++) {
+        if (!init_render_output(render, &render->outputs[i], &vulkan->outputs[i])) return NULL;
+        render->output_count++;
+    }
+    if (render->output_count > 0) assign_workspaces(render);
+    scene_node_set_destroy_listener(forget_node, render);
+
     return render;
 }
 
 void render_destroy(struct pwc_render *render) {
+    // Teardown only: uploads may still be in flight
+    if (render->vulkan->device) vkDeviceWaitIdle(render->vulkan->device);
+    scene_node_set_destroy_listener(NULL, NULL);
+
+    // Surfaces own textures, which poll the outputs' snapshot fences
+    destroy_server(render->server);
+    render->server = NULL;
+    destroy_cursor(render->cursor);
+    render->cursor = NULL;
+    destroy_textures(render->textures);
+    render->textures = NULL;
+    for (uint32_t i = 0; i < render->output_count; i++) {
+        destroy_render_output(&render->outputs[i]);
+    }
+    render->output_count = 0;
+    destroy_timeline(render->timeline);
+    render->timeline = NULL;
+    destroy_decorations(render->decorations);
+    render->decorations = NULL;
+    destroy_effects(render->effects);
+    render->effects = NULL;
+    destroy_uploader(render->uploader);
+    render->uploader = NULL;
+    destroy_thread_pool(render->threads);
+    render->threads = NULL;
+    free(render->scene->damage);
     destroy_scene(render->scene);
     free(render->scene);
     render->scene = NULL;
@@ -71,9 +317,12 @@ void render_destroy(struct pwc_render *render) {
     free(render);
 }
 
-// Draw a single node (customize per type; assumes NodeRenderData in node->data)
-void draw_node(SceneNodeT *node, VkCommandBuffer cmd_buffer, struct pwc_render *render, uint32_t image_index) {
-    if (!node || !node->is_dirty) return;
+// Draw a single node, tree nodes draw nothing by themselves
+// Called from recorder workers inside the frame's render pass. Always records the full
+// node, is_dirty only decides (through subtree_serial) whether a cached buffer is reused
+void draw_node(SceneNodeT *node, VkCommandBuffer cmd_buffer, RenderOutputT *ro) {
+    if (!node) return;
+    struct pwc_render *render = ro->render;
     struct pwc_scene *scene = render->scene;
     struct pwc_vulkan *vulkan = render->vulkan;
 
@@ -82,25 +331,13 @@ void draw_node(SceneNodeT *node, VkCommandBuffer cmd_buffer, struct pwc_render *
         float color[4] = {0, 0, 0, 1};  // Default black
         if (node->parent && node->parent->type == SCENE_NODE_WORKSPACE) {
             SceneNodeT *root = scene->root;  // Assume scene is accessible; add to params if needed
-            if (root->child[0] == node->parent) {
+            if (root->first_child == node->parent) {
                 color[0] = 1.0f;  // Red
-            } else if (root->child[1] == node->parent) {
+            } else if (root->first_child && root->first_child->next == node->parent) {
                 color[2] = 1.0f;  // Blue
             }
         }
 
-        // Begin render pass
-        VkClearValue clear = {{{0, 0, 0, 1}}};
-        VkRenderPassBeginInfo rp_bi = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-            .renderPass = vulkan->render_pass,
-            .framebuffer = vulkan->framebuffers[image_index],  // Use the framebuffer for this image
-            .renderArea = {{0, 0}, vulkan->swapchainExtent},
-            .clearValueCount = 1,
-            .pClearValues = &clear,
-        };
-        vkCmdBeginRenderPass(cmd_buffer, &rp_bi, VK_SUBPASS_CONTENTS_INLINE);
-
         // Bind pipeline and push color
         vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vulkan->pipeline);
         vkCmdPushConstants(cmd_buffer, vulkan->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(color), color);
@@ -109,92 +346,1063 @@ void draw_node(SceneNodeT *node, VkCommandBuffer cmd_buffer, struct pwc_render *
         VkDeviceSize offset = 0;
         vkCmdBindVertexBuffers(cmd_buffer, 0, 1, &vulkan->vertex_buffer, &offset);
         vkCmdDraw(cmd_buffer, 4, 1, 0, 0);
-
-        vkCmdEndRenderPass(cmd_buffer);
+    } else if (node->type == SCENE_NODE_SURFACE && node->texture) {
+        float opacity = scene_node_world_transform(node).opacity;
+        textures_draw(render->textures, cmd_buffer, node->texture, scene_node_transformed_geometry(node), node->uv_rect,
+                      node->uv_transform, ro->output->swapchain_extent, opacity);
     }
 
     node->is_dirty = false;
 }
 
-static void draw_scene_tree(SceneNodeT *node, VkCommandBuffer cmd_buffer, struct pwc_render *render, uint32_t image_index) {
+static void draw_scene_tree(SceneNodeT *node, VkCommandBuffer cmd_buffer, RenderOutputT *ro) {
     if (!node) return;
-    draw_node(node, cmd_buffer, render, image_index);
+    draw_node(node, cmd_buffer, ro);
     // Draw children
-    for (int i = 0; i < node->num_child; i++) {
-        draw_scene_tree(node->child[i], cmd_buffer, render, image_index);
+    scene_node_for_each_child(child, node) {
+        draw_scene_tree(child, cmd_buffer, ro);
     }
 }
 
-static void render_frame(struct pwc_render *render) {
-    struct pwc_vulkan *vulkan = render->vulkan;
-    struct pwc_scene *scene = render->scene;
+// Recorder job: one secondary command buffer per workspace subtree
+static void record_subtree(struct pwc_recorder *recorder, VkCommandBuffer cmd, void *arg) {
+    draw_scene_tree(arg, cmd, recorder->user_data);
+}
+
+// Called once a persistent record_subtree job ended its buffer
+static void commit_subtree(struct pwc_recorder *recorder, VkCommandBuffer cmd, void *arg) {
+    RenderOutputT *ro = recorder->user_data;
+    cmd_cache_commit(ro->cmd_cache, arg, ro->output->current_submission_index);
+}
+
+// Recorder job: the blurred backdrop of a layer, below its decoration. The cache isn't
+// modified while workers record
+static void record_blur(struct pwc_recorder *recorder, VkCommandBuffer cmd, void *arg) {
+    RenderOutputT *ro = recorder->user_data;
+    SceneNodeT *layer = arg;
+    BlurEntryT *blur = blur_cache_find(ro->blur, layer->handle);
+    if (blur) effects_draw(ro->render->effects, cmd, &blur->up[0], blur->region, ro->output->swapchain_extent);
+}
+
+// Recorder job: one run of decorations, arg is the run index
+static void record_decorations(struct pwc_recorder *recorder, VkCommandBuffer cmd, void *arg) {
+    RenderOutputT *ro = recorder->user_data;
+    uint32_t index = (uint32_t)(uintptr_t)arg;
+    // Dropped if the instances couldn't be written
+    if (index >= ro->decoration_run_count) return;
+
+    DecorationRunT *run = &ro->decoration_runs[index];
+    decorations_draw(ro->render->decorations, cmd, &ro->decoration_buffers[ro->output->current_submission_index],
+                     run->first, run->count, ro->output->swapchain_extent);
+}
+
+static void add_decoration(RenderOutputT *ro, SceneNodeT *layer) {
+    if (ro->decoration_count >= ro->decoration_capacity) {
+        uint32_t new_capacity = (ro->decoration_capacity == 0) ? 64 : ro->decoration_capacity * 2;
+        DecorationInstanceT *new_instances = realloc(ro->decoration_instances, new_capacity * sizeof(DecorationInstanceT));
+        if (!new_instances) {
+            fprintf(stderr, "Failed to realloc decoration instances\n");
+            return;
+        }
+        ro->decoration_instances = new_instances;
+        ro->decoration_capacity = new_capacity;
+    }
+    decoration_instance_init(&ro->decoration_instances[ro->decoration_count++], layer);
+}
+
+// Closes the current run of decorations, called before anything else is drawn
+static void flush_decorations(RenderOutputT *ro) {
+    if (ro->decoration_flushed == ro->decoration_count) return;
+
+    if (ro->decoration_run_count >= ro->decoration_run_capacity) {
+        uint32_t new_capacity = (ro->decoration_run_capacity == 0) ? 16 : ro->decoration_run_capacity * 2;
+        DecorationRunT *new_runs = realloc(ro->decoration_runs, new_capacity * sizeof(DecorationRunT));
+        if (!new_runs) {
+            fprintf(stderr, "Failed to realloc decoration runs\n");
+            ro->decoration_flushed = ro->decoration_count;
+            return;
+        }
+        ro->decoration_runs = new_runs;
+        ro->decoration_run_capacity = new_capacity;
+    }
+
+    uint32_t index = ro->decoration_run_count++;
+    ro->decoration_runs[index] = (DecorationRunT){ro->decoration_flushed, ro->decoration_count - ro->decoration_flushed};
+    ro->decoration_flushed = ro->decoration_count;
+    recorder_add_job(ro->recorder, record_decorations, (void *)(uintptr_t)index);
+}
+
+// Recorder job: a workspace snapshot, arg is the tile index
+static void record_tile(struct pwc_recorder *recorder, VkCommandBuffer cmd, void *arg) {
+    RenderOutputT *ro = recorder->user_data;
+    SnapshotTileT *tile = &ro->tiles[(uintptr_t)arg];
+    WorkspaceSnapshotT *snapshot = workspace_cache_find(ro->workspace_cache, tile->workspace);
+    if (snapshot && snapshot->image.initialized) {
+        effects_draw(ro->render->effects, cmd, &snapshot->image, tile->dst, ro->output->swapchain_extent);
+    }
+}
+
+// Shown once a switch or the overview is over
+static SceneNodeT *active_workspace(RenderOutputT *ro) {
+    if (ro->active_workspace >= ro->workspace_count) return NULL;
+    return scene_node_from_handle(ro->workspaces[ro->active_workspace]);
+}
+
+// The workspace drawn live, NULL while the output composites snapshots instead
+static SceneNodeT *live_workspace(RenderOutputT *ro) {
+    if (ro->overview || ro->switching || ro->active_workspace >= ro->workspace_count) return NULL;
+    return scene_node_from_handle(ro->workspaces[ro->active_workspace]);
+}
+
+// Moves the damage of the output's workspaces from the scene into ro->pending. A new
+// swapchain has undefined contents, so it is damaged whole
+static void collect_pending_damage(struct pwc_render *render, RenderOutputT *ro) {
+    SceneNodeT *live = live_workspace(ro);
+    for (uint32_t i = 0; i < ro->workspace_count; i++) {
+        SceneNodeT *workspace = scene_node_from_handle(ro->workspaces[i]);
+        if (!workspace) continue;
+        if (workspace != live) {
+            // Not on screen, snapshots notice the change through subtree_serial
+            DamageRegionT hidden = {0};
+            scene_take_damage(render->scene, workspace, &hidden);
+            continue;
+        }
+        if (!scene_take_damage(render->scene, workspace, &ro->pending)) ro->pending_whole = true;
+    }
+    if (ro->damage_swapchain_serial != ro->output->swapchain_serial) ro->pending_whole = true;
+}
+
+// Consumes the pending damage for the frame about to be drawn, clipped to the output.
+// Returns false if the whole output is damaged (damage is set to the full extent then)
+static bool take_frame_damage(RenderOutputT *ro, DamageRegionT *damage) {
+    struct pwc_output *output = ro->output;
+    bool partial = !ro->pending_whole;
+    *damage = ro->pending;
+    damage_clear(&ro->pending);
+    ro->pending_whole = false;
+
+    // New swapchain images have undefined contents
+    if (ro->damage_swapchain_serial != output->swapchain_serial) {
+        uint64_t *drawn = realloc(ro->image_drawn_serial, output->swapchain_image_count * sizeof(uint64_t));
+        if (drawn) {
+            memset(drawn, 0, output->swapchain_image_count * sizeof(uint64_t));
+            ro->image_drawn_serial = drawn;
+            ro->image_drawn_count = output->swapchain_image_count;
+        } else {
+            // Every image is treated as undefined, so every frame is a full redraw
+            fprintf(stderr, "Failed to realloc image damage tracking\n");
+            ro->image_drawn_count = 0;
+        }
+        ro->damage_swapchain_serial = output->swapchain_serial;
+        partial = false;
+    }
+
+    if (!partial) {
+        damage_set_whole(damage, output->swapchain_extent);
+        return false;
+    }
+
+    damage_clip(damage, output->swapchain_extent);
+    return true;
+}
+
+// What has to be repainted in an image so it shows the next frame: the frame's damage plus
+// everything damaged since the image was last drawn. Returns false if the image's contents
+// are undefined or too old, it has to be redrawn completely then
+static bool get_repaint_region(RenderOutputT *ro, uint32_t image_index, const DamageRegionT *frame_damage, DamageRegionT *repaint) {
+    uint64_t serial = ro->output->frame_serial + 1;
+
+    if (image_index >= ro->image_drawn_count) return false;
+    uint64_t drawn = ro->image_drawn_serial[image_index];
+    if (drawn == 0 || serial - drawn > DAMAGE_HISTORY) return false;
+
+    *repaint = *frame_damage;
+    for (uint64_t s = drawn + 1; s < serial; s++) {
+        damage_add_region(repaint, &ro->damage_history[s % DAMAGE_HISTORY]);
+    }
+    return true;
+}
+
+static bool layer_intersects(SceneNodeT *layer, VkRect2D area) {
+    if (layer->geometry.extent.width == 0 || layer->geometry.extent.height == 0) return true;
+    return rect_intersects(scene_node_bounds(layer), area);
+}
+
+// Hands the plane back, the node is composited again from the next frame on
+static void release_plane(struct pwc_render *render, RenderOutputT *ro, PlaneAssignmentT *assignment) {
+    SceneNodeT *node = scene_node_from_handle(assignment->node);
+    planes_release(ro->planes, assignment);
+
+    if (node && node->on_plane) {
+        node->on_plane = false;
+        scene_damage_node(render->scene, node);
+    }
+}
+
+// A plane is stacked above the whole composition, so only a layer nothing is drawn over can
+// move to one without changing what's visible. Only the live workspace is composited
+static bool layer_is_uncovered(SceneNodeT *layer) {
+    for (SceneNodeT *above = layer->next; above; above = above->next) {
+        if (layer_intersects(above, layer->geometry)) return false;
+    }
+    return true;
+}
+
+// The plane images of one output tick, presented by a single submission
+typedef struct PlaneFrame {
+    VkCommandBuffer cmd;  // Begun by the first plane presenting
+    VkSemaphore wait_semaphores[MAX_PLANE_WAITS];
+    VkPipelineStageFlags wait_stages[MAX_PLANE_WAITS];
+    uint32_t wait_count;
+} PlaneFrameT;
+
+// Presents the assignment's next image at dst once the frame is submitted, with node's subtree
+// drawn into it unless the image already holds content_serial. VK_NOT_READY if the frame slot or every image is still in use, the plane keeps
+// showing what it did. Any other error means the plane has to be released
+static VkResult present_plane(RenderOutputT *ro, PlaneFrameT *frame, PlaneAssignmentT *assignment, SceneNodeT *node, VkRect2D dst,
+                              uint64_t content_serial) {
+    struct pwc_render *render = ro->render;
+    struct pwc_planes *planes = ro->planes;
+    if (!frame->cmd) {
+        frame->cmd = planes_begin_frame(planes);
+        if (!frame->cmd) return VK_NOT_READY;
+        // Like an output frame, takes over the uploads and client written imports first: the
+        // planes may sample them, whether or not the output's frame acquired them already
+        frame->wait_count = uploader_acquire(render->uploader, frame->cmd, &planes->completed_serial, planes->frame_serial + 1,
+                                             frame->wait_semaphores, frame->wait_stages, MAX_PLANE_WAITS);
+        textures_record_acquires(render->textures, frame->cmd);
+    }
+
+    VkResult err = plane_acquire(planes, assignment);
+    if (err) return err;
+
+    assignment->dst = dst;
+    if (plane_image_current(assignment, content_serial)) return VK_SUCCESS;
+    plane_begin_draw(planes, assignment);
+    draw_scene_tree(node, frame->cmd, ro);
+    plane_end_draw(planes, assignment, content_serial);
+    return VK_SUCCESS;
+}
+
+// Submits the tick's plane images. Layers shown on their plane for the first time leave the
+// composition, planes whose present failed are released
+static void submit_plane_frame(struct pwc_render *render, RenderOutputT *ro, PlaneFrameT *frame) {
+    struct pwc_planes *planes = ro->planes;
+    if (!frame->cmd) return;
+    planes_submit(planes, frame->wait_semaphores, frame->wait_stages, frame->wait_count);
+
+    for (uint32_t i = 0; i < MAX_PLANE_ASSIGNMENTS; i++) {
+        PlaneAssignmentT *assignment = &planes->assignments[i];
+        if (assignment->node == SCENE_NODE_HANDLE_NULL) continue;
+        if (assignment->lost) {
+            release_plane(render, ro, assignment);
+            continue;
+        }
+
+        // The cursor is never in the scene
+        SceneNodeT *node = scene_node_from_handle(assignment->node);
+        if (!node || node->on_plane || !assignment->shown || node == render->cursor->node) continue;
+        // The composition stops showing it
+        scene_damage_node(render->scene, node);
+        node->on_plane = true;
+    }
+}
+
+// Moves plane hinted layers onto their own display planes and back, and redraws the planes
+// whose subtree changed or moved. A layer stays composited until its plane showed it, only
+// moving between a plane and the composition damages it
+static void update_planes(struct pwc_render *render, RenderOutputT *ro, PlaneFrameT *frame) {
+    struct pwc_planes *planes = ro->planes;
+
+    // Capabilities are per display mode, a new surface may have brought a new one. Without
+    // planes for it everything is composited
+    if (planes->display_mode != ro->output->display_mode) {
+        for (uint32_t i = 0; i < MAX_PLANE_ASSIGNMENTS; i++) {
+            if (planes->assignments[i].node != SCENE_NODE_HANDLE_NULL) release_plane(render, ro, &planes->assignments[i]);
+        }
+        planes_update_mode(planes);
+    }
+    if (planes->plane_count == 0) return;
+
+    // Nodes destroyed while on a plane
+    for (uint32_t i = 0; i < MAX_PLANE_ASSIGNMENTS; i++) {
+        PlaneAssignmentT *assignment = &planes->assignments[i];
+        if (assignment->node != SCENE_NODE_HANDLE_NULL && !scene_node_from_handle(assignment->node)) release_plane(render, ro, assignment);
+    }
+
+    SceneNodeT *live = live_workspace(ro);
+    for (uint32_t i = 0; i < ro->workspace_count; i++) {
+        SceneNodeT *workspace = scene_node_from_handle(ro->workspaces[i]);
+        if (!workspace) continue;
+
+        scene_node_for_each_child(layer, workspace) {
+            PlaneAssignmentT *assignment = planes_find(planes, layer->handle);
+            bool wanted = workspace == live && layer->plane_hint != SCENE_PLANE_HINT_NONE && layer_is_uncovered(layer);
+
+            if (assignment && (!wanted || !plane_fits(assignment, scene_node_transformed_geometry(layer)))) {
+                release_plane(render, ro, assignment);
+                assignment = NULL;
+            }
+            if (!assignment && wanted) assignment = planes_assign(planes, layer);
+            if (!assignment) continue;
+
+            VkRect2D geometry = scene_node_transformed_geometry(layer);
+            bool moved = geometry.offset.x != assignment->dst.offset.x || geometry.offset.y != assignment->dst.offset.y;
+            if (assignment->shown && !moved && assignment->drawn_serial == layer->subtree_serial) continue;
+
+            VkResult err = present_plane(ro, frame, assignment, layer, geometry, layer->subtree_serial);
+            if (err != VK_SUCCESS && err != VK_NOT_READY) release_plane(render, ro, assignment);
+        }
+    }
+}
+
+// Puts the cursor on a display plane of the output when one fits it. It is drawn into each
+// plane image once per cursor serial, a move only presents an image at the new position in the
+// output's plane frame, which synchronizes with the client cursor's uploads. Returns whether a
+// plane shows it
+static bool update_cursor_plane(struct pwc_render *render, RenderOutputT *ro, PlaneFrameT *frame, VkOffset2D origin) {
+    struct pwc_cursor *cursor = render->cursor;
+    struct pwc_planes *planes = ro->planes;
+    SceneNodeT *node = cursor->node;
+    if (planes->plane_count == 0) return false;
+
+    // The node is shared by the outputs, placed for each before it is drawn
+    node->geometry = (VkRect2D){
+        {(int32_t)floor(cursor->x) - origin.x - cursor->hotspot.x, (int32_t)floor(cursor->y) - origin.y - cursor->hotspot.y},
+        cursor->size,
+    };
+    node->texture = cursor->texture;
+    bool visible = cursor->texture && rect_intersects(node->geometry, (VkRect2D){{0, 0}, ro->output->swapchain_extent});
+
+    // Never in the scene, nothing is damaged when it moves between the plane and the overlay
+    PlaneAssignmentT *assignment = planes_find(planes, node->handle);
+    if (assignment && (!visible || !plane_fits(assignment, node->geometry))) {
+        release_plane(render, ro, assignment);
+        assignment = NULL;
+    }
+    if (!assignment && visible) assignment = planes_assign(planes, node);
+    if (!assignment) return false;
+
+    bool moved = node->geometry.offset.x != assignment->dst.offset.x || node->geometry.offset.y != assignment->dst.offset.y;
+    if (assignment->shown && !moved && assignment->drawn_serial == cursor->serial) return true;
+
+    VkResult err = present_plane(ro, frame, assignment, node, node->geometry, cursor->serial);
+    // Until the plane showed it the overlay draws it
+    if (err == VK_SUCCESS || err == VK_NOT_READY) return assignment->shown;
+    release_plane(render, ro, assignment);
+    return false;
+}
+
+static uint64_t hash_mix(uint64_t hash, uint64_t value) {
+    return hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+}
+
+// Walks the composited layers below target that reach into region, bottom to top.
+// Returns a signature of them and, if cmd is set, draws them into it
+static uint64_t backdrop_layers(RenderOutputT *ro, SceneNodeT *target, VkRect2D region, VkCommandBuffer cmd) {
+    uint64_t signature = hash_mix(0, ((uint64_t)(uint32_t)region.offset.x << 32) | (uint32_t)region.offset.y);
+    for (SceneNodeT *layer = target->parent->first_child; layer != target; layer = layer->next) {
+        if (layer->on_plane || !layer_intersects(layer, region)) continue;
+
+        // Any change below marks the layer dirty, which bumps its subtree_serial
+        signature = hash_mix(signature, layer->handle);
+        signature = hash_mix(signature, layer->subtree_serial);
+        if (cmd) draw_scene_tree(layer, cmd, ro);
+    }
+    return signature;
+}
 
-    // Skip if not ready
-    if (!vulkan->initialized || !vulkan->swapchain_ready) {
+// Re-blurs the backdrop of every blur-behind layer whose region the frame damages,
+// if what's below actually changed. Records the backdrop passes into cmd (before the
+// frame's render pass) and the blur chains into the next effect batch. A new result is
+// drawn from the next frame on, which the layer's damage makes happen
+static void update_blurs(RenderOutputT *ro, VkCommandBuffer cmd, const DamageRegionT *frame_damage) {
+    struct pwc_render *render = ro->render;
+    uint64_t serial = ro->output->frame_serial + 1;
+    SceneNodeT *live = live_workspace(ro);
+
+    if (live && render->effects->enabled) {
+        scene_node_for_each_child(layer, live) {
+            if (layer->blur_levels == 0 || layer->on_plane) continue;
+
+            VkRect2D region;
+            if (!rect_clip(scene_node_transformed_geometry(layer), ro->output->swapchain_extent, &region)) continue;
+
+            bool recreated;
+            BlurEntryT *entry = blur_cache_get(ro->blur, layer, region, layer->blur_levels, &recreated);
+            if (!entry) continue;
+            entry->used_serial = serial;
+
+            uint64_t signature = backdrop_layers(ro, layer, region, VK_NULL_HANDLE);
+            if (signature == entry->backdrop_signature) continue;
+            if (!recreated && !damage_intersects(frame_damage, region)) {
+                // Not visible yet, picked up once the damage reaches the region
+                continue;
+            }
+
+            entry->backdrop_signature = signature;
+            blur_begin_backdrop(ro->blur, entry, cmd);
+            backdrop_layers(ro, layer, region, cmd);
+            blur_end_backdrop(ro->blur, entry, cmd, serial);
+
+            // Redraws the layer with the new result next frame
+            scene_damage_node(render->scene, layer);
+        }
+    }
+
+    blur_cache_sweep(ro->blur, serial);
+}
+
+// A switch slides between snapshots, every frame of it is redrawn whole
+static void update_switch(RenderOutputT *ro, uint64_t now) {
+    if (!ro->switching) return;
+    if (now + ro->refresh_ns >= ro->switch_start_ns + SWITCH_DURATION_NS) {
+        // Over by the time this frame shows, the active workspace is drawn live again
+        ro->switching = false;
+    }
+    ro->pending_whole = true;
+}
+
+// Lays out the snapshots composited this frame (overview grid or the two sides of a
+// switch) at time and adds a job for each
+static void add_snapshot_tiles(RenderOutputT *ro, uint64_t time) {
+    VkExtent2D extent = ro->output->swapchain_extent;
+    ro->tile_count = 0;
+
+    if (ro->overview && ro->workspace_count > 0) {
+        uint32_t cols = (uint32_t)ceilf(sqrtf((float)ro->workspace_count));
+        uint32_t rows = (ro->workspace_count + cols - 1) / cols;
+        int32_t width = ((int32_t)extent.width - (int32_t)(cols + 1) * OVERVIEW_GAP) / (int32_t)cols;
+        int32_t height = ((int32_t)extent.height - (int32_t)(rows + 1) * OVERVIEW_GAP) / (int32_t)rows;
+        if (width <= 0 || height <= 0) return;
+
+        for (uint32_t i = 0; i < ro->workspace_count; i++) {
+            int32_t x = OVERVIEW_GAP + (int32_t)(i % cols) * (width + OVERVIEW_GAP);
+            int32_t y = OVERVIEW_GAP + (int32_t)(i / cols) * (height + OVERVIEW_GAP);
+            ro->tiles[ro->tile_count++] = (SnapshotTileT){ro->workspaces[i], {{x, y}, {(uint32_t)width, (uint32_t)height}}};
+        }
+    } else if (ro->switching) {
+        float t = (time > ro->switch_start_ns) ? (float)(time - ro->switch_start_ns) / SWITCH_DURATION_NS : 0.0f;
+        if (t > 1.0f) t = 1.0f;
+        // Higher indices sit to the right
+        int32_t direction = (ro->active_workspace > ro->switch_from) ? 1 : -1;
+        int32_t shift = (int32_t)(animation_ease(ANIMATION_CURVE_EASE_IN_OUT, t) * extent.width) * direction;
+
+        ro->tiles[ro->tile_count++] = (SnapshotTileT){ro->workspaces[ro->switch_from], {{-shift, 0}, extent}};
+        ro->tiles[ro->tile_count++] = (SnapshotTileT){ro->workspaces[ro->active_workspace],
+                                                      {{direction * (int32_t)extent.width - shift, 0}, extent}};
+    }
+
+    for (uint32_t i = 0; i < ro->tile_count; i++) {
+        recorder_add_job(ro->recorder, record_tile, (void *)(uintptr_t)i);
+    }
+}
+
+// Draws the workspace into its snapshot: decorations and layers in stacking order, the
+// same as a frame minus blur. Uses the output's instance array, free between frames
+static void record_snapshot(struct pwc_render *render, RenderOutputT *ro, SnapshotSubmissionT *submission,
+                            SceneNodeT *workspace, uint64_t now) {
+    struct pwc_workspace_cache *cache = ro->workspace_cache;
+    VkExtent2D extent = ro->output->swapchain_extent;
+    bool decorate = render->decorations->enabled;
+
+    ro->decoration_count = 0;
+    scene_node_for_each_child(layer, workspace) {
+        if (decorate && layer->decoration.enabled) add_decoration(ro, layer);
+    }
+    // The submission completed, its buffer is free to rewrite
+    if (!decoration_buffer_write(render->decorations, &submission->decorations, ro->decoration_instances, ro->decoration_count)) {
+        decorate = false;
+    }
+
+    // Dmabufs committed since the last frame may be sampled here first
+    textures_record_acquires(render->textures, submission->cmd);
+    WorkspaceSnapshotT *snapshot = workspace_cache_begin_snapshot(cache, submission, workspace);
+    if (!snapshot) {
+        ro->decoration_count = 0;
         return;
     }
+    uint32_t first = 0, count = 0;
+    scene_node_for_each_child(layer, workspace) {
+        bool decorated = decorate && layer->decoration.enabled;
+        if (decorated) count++;
+        if (layer->type == SCENE_NODE_CONTAINER && !layer->first_child) continue;
+
+        if (count > 0) {
+            decorations_draw(render->decorations, submission->cmd, &submission->decorations, first, count, extent);
+            first += count;
+            count = 0;
+        }
+        draw_scene_tree(layer, submission->cmd, ro);
+    }
+    if (count > 0) decorations_draw(render->decorations, submission->cmd, &submission->decorations, first, count, extent);
+    workspace_cache_end_snapshot(cache, submission, snapshot, workspace, now);
+
+    ro->decoration_count = 0;
+}
+
+// Refreshes at most one stale snapshot per tick, in its own submission queued behind the
+// frames. Snapshots on screen go first, hidden ones are throttled
+static void refresh_snapshots(struct pwc_render *render, RenderOutputT *ro, uint64_t now) {
+    struct pwc_workspace_cache *cache = ro->workspace_cache;
+    if (!render->effects->enabled || !ro->output->swapchain_ready) return;
+
+    workspace_cache_sweep(cache);
+
+    SceneNodeT *best = NULL;
+    uint64_t best_refreshed = UINT64_MAX;
+    bool best_shown = false;
+    for (uint32_t i = 0; i < ro->workspace_count; i++) {
+        SceneNodeT *workspace = scene_node_from_handle(ro->workspaces[i]);
+        // Kept as a thumbnail until woken
+        if (!workspace || ro->activity[i].hibernated) continue;
+
+        WorkspaceSnapshotT *snapshot = workspace_cache_get(cache, workspace);
+        if (!snapshot || !workspace_snapshot_stale(cache, snapshot, workspace)) continue;
+
+        bool shown = ro->overview || (ro->switching && (i == ro->switch_from || i == ro->active_workspace));
+        if (!shown && snapshot->image.initialized && now < snapshot->refreshed_ns + SNAPSHOT_REFRESH_INTERVAL_NS) continue;
+        if (best_shown && !shown) continue;
+        if (shown == best_shown && snapshot->refreshed_ns >= best_refreshed) continue;
+
+        best = workspace;
+        best_refreshed = snapshot->refreshed_ns;
+        best_shown = shown;
+    }
+    if (!best) return;
 
-    VkResult U_ASSERT_ONLY err;
-    SubmissionResourcesT current_submission = vulkan->submission_resources[vulkan->current_submission_index];
+    SnapshotSubmissionT *submission = workspace_cache_begin(cache);
+    if (!submission) return;
+
+    record_snapshot(render, ro, submission, best, now);
+    workspace_cache_submit(cache, submission);
+
+    // Composited snapshots changed
+    if (best_shown) ro->pending_whole = true;
+}
+
+// Workspaces hidden for render->hibernate_after_ns, or the longest hidden one while device
+// memory is over budget, drop their cached command buffers and keep only a thumbnail. One
+// per tick. Shown ones are woken, their buffers are recorded again on demand
+static void hibernate_workspaces(struct pwc_render *render, RenderOutputT *ro, uint64_t now) {
+    struct pwc_output *output = ro->output;
+    SceneNodeT *live = live_workspace(ro);
+
+    uint32_t candidate = UINT32_MAX;
+    for (uint32_t i = 0; i < ro->workspace_count; i++) {
+        SceneNodeT *workspace = scene_node_from_handle(ro->workspaces[i]);
+        if (!workspace) continue;
+
+        WorkspaceActivityT *activity = &ro->activity[i];
+        bool shown = workspace == live || ro->overview || (ro->switching && (i == ro->switch_from || i == ro->active_workspace));
+        if (shown) {
+            activity->visible_ns = now;
+            activity->visible_serial = output->frame_serial;
+            if (activity->hibernated) {
+                workspace_cache_wake(ro->workspace_cache, workspace->handle);
+                activity->hibernated = false;
+            }
+            continue;
+        }
+
+        // Frames that drew it may still be using its buffers
+        if (activity->hibernated || activity->visible_serial > output->completed_serial) continue;
+        bool expired = render->hibernate_after_ns && now >= activity->visible_ns + render->hibernate_after_ns;
+        if (!expired && !render->over_budget) continue;
+        if (candidate == UINT32_MAX || activity->visible_ns < ro->activity[candidate].visible_ns) candidate = i;
+    }
+    if (candidate == UINT32_MAX) return;
+
+    SnapshotSubmissionT *submission = workspace_cache_begin(ro->workspace_cache);
+    if (!submission) return;
+
+    SceneNodeT *workspace = scene_node_from_handle(ro->workspaces[candidate]);
+    scene_node_for_each_child(layer, workspace) {
+        cmd_cache_evict(ro->cmd_cache, layer->handle);
+    }
+    workspace_cache_hibernate(ro->workspace_cache, submission, workspace->handle);
+    workspace_cache_submit(ro->workspace_cache, submission);
+    ro->activity[candidate].hibernated = true;
+}
+
+// Over budget, hibernation stops waiting for the timeout
+static void update_memory_budget(struct pwc_render *render, uint64_t now) {
+    if (now < render->budget_checked_ns + BUDGET_CHECK_INTERVAL_NS) return;
+    render->budget_checked_ns = now;
+
+    VkDeviceSize usage, budget;
+    render->over_budget = query_memory_budget(render->vulkan, &usage, &budget) && usage * 100 > budget * BUDGET_HIGH_WATER;
+}
+
+// The frame's pass over the scene, into the image's draw_area (all of it unless partial)
+static void record_composition(struct pwc_render *render, RenderOutputT *ro, VkCommandBuffer cmd, uint32_t image_index, bool partial,
+                               VkRect2D draw_area, uint64_t now) {
+    struct pwc_vulkan *vulkan = render->vulkan;
+    struct pwc_output *output = ro->output;
+    VkExtent2D extent = output->swapchain_extent;
+
+    // Single render pass per frame, the content comes from secondaries recorded in parallel
+    VkRenderPass render_pass = partial ? vulkan->render_pass_load : vulkan->render_pass;
+    VkClearValue clear = {{{0, 0, 0, 1}}};
+    VkRenderPassBeginInfo rp_bi = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = render_pass,
+        .framebuffer = output->framebuffers[image_index],
+        .renderArea = draw_area,
+        .clearValueCount = 1,
+        .pClearValues = &clear,
+    };
+    vkCmdBeginRenderPass(cmd, &rp_bi, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    recorder_begin_frame(ro->recorder, output->current_submission_index, render_pass,
+                         output->framebuffers[image_index], extent, draw_area);
+
+    // Root and workspaces draw nothing by themselves. Only the active workspace is drawn live,
+    // the others are composited from their snapshots. Every layer (background,
+    // containers, windows) is its own cached secondary, so a static wallpaper is never re-recorded
+    // while windows above it change. Decorations are drawn right below their layer's
+    // contents, batched into one instanced draw per run of consecutive ones
+    uint64_t serial = output->frame_serial + 1;
+    bool decorate = render->decorations->enabled;
+    ro->decoration_count = 0;
+    ro->decoration_flushed = 0;
+    ro->decoration_run_count = 0;
+    SceneNodeT *live = live_workspace(ro);
+    if (!live) {
+        add_snapshot_tiles(ro, now + ro->refresh_ns);
+    } else {
+        scene_node_for_each_child(layer, live) {
+            if (layer->on_plane) continue;
+            // Cached buffers cover the whole output. A partial frame records only the
+            // layers under the damage, scissored to it
+            if (partial && !layer_intersects(layer, draw_area)) continue;
+
+            BlurEntryT *blur = layer->blur_levels ? blur_cache_find(ro->blur, layer->handle) : NULL;
+            if (blur && blur_entry_ready(blur, serial)) {
+                flush_decorations(ro);
+                recorder_add_job(ro->recorder, record_blur, layer);
+            }
+            if (decorate && layer->decoration.enabled) add_decoration(ro, layer);
+            // Nothing but the decoration, the run goes on
+            if (layer->type == SCENE_NODE_CONTAINER && !layer->first_child) continue;
+            flush_decorations(ro);
+
+            if (partial) {
+                recorder_add_job(ro->recorder, record_subtree, layer);
+                continue;
+            }
+
+            VkCommandBuffer target;
+            VkCommandBuffer cached = cmd_cache_lookup(ro->cmd_cache, layer, output->current_submission_index, &target);
+            if (cached) {
+                recorder_add_prerecorded(ro->recorder, cached);
+            } else if (target) {
+                recorder_add_persistent_job(ro->recorder, record_subtree, layer, target, commit_subtree);
+            } else {
+                recorder_add_job(ro->recorder, record_subtree, layer);
+            }
+        }
+    }
+    flush_decorations(ro);
+
+    // The slot's previous frame completed, its buffer is free to rewrite
+    if (!decoration_buffer_write(render->decorations, &ro->decoration_buffers[output->current_submission_index],
+                                 ro->decoration_instances, ro->decoration_count)) {
+        ro->decoration_run_count = 0;
+    }
+    recorder_execute(ro->recorder, cmd);
+
+    vkCmdEndRenderPass(cmd);
+}
+
+// Draws the next frame of one output if it's damaged. Never blocks on the GPU or the
+// display: returns false if the frame slot or a swapchain image isn't free yet, the damage
+// is kept pending and the frame has to be retried shortly
+static bool render_output_frame(struct pwc_render *render, RenderOutputT *ro, uint64_t now) {
+    struct pwc_vulkan *vulkan = render->vulkan;
+    struct pwc_output *output = ro->output;
+
+    // Recreate before acquiring, the old swapchain is retired once its frames completed
+    if (output->swapchain_out_of_date || !output->swapchain_ready) {
+        // Too many swapchains still retiring, retried once a frame completed
+        if (!recreate_swapchain(vulkan, output)) return false;
+        // Skip if not ready (e.g. zero sized surface)
+        if (!output->swapchain_ready) return true;
+    }
+
+    update_switch(ro, now);
+    PlaneFrameT plane_frame = {0};
+    update_planes(render, ro, &plane_frame);
+    VkOffset2D origin = render_output_origin(render, (uint32_t)(ro - render->outputs));
+    bool cursor_on_plane = update_cursor_plane(render, ro, &plane_frame, origin);
+    submit_plane_frame(render, ro, &plane_frame);
+    bool cursor_changed = cursor_overlay_update(render->cursor, &ro->cursor, output, origin, cursor_on_plane);
+
+    VkResult err;
+    SubmissionResourcesT *current_submission = &output->submission_resources[output->current_submission_index];
+
+    // The slot's previous frame is still in flight
+    err = vkGetFenceStatus(vulkan->device, current_submission->fence);
+    if (err == VK_NOT_READY) return false;
+    assert(!err);
+    swapchain_frame_completed(vulkan, output, current_submission->serial);
+
+    // Animations are sampled where the frame will be on screen, one refresh from now
+    timeline_update(render->timeline, render->scene, ro->workspaces, ro->workspace_count, now + ro->refresh_ns);
+
+    // Taken before acquiring: an undamaged frame is skipped without touching the swapchain
+    collect_pending_damage(render, ro);
+    if (!ro->pending_whole && damage_is_empty(&ro->pending) && !cursor_changed) return true;
 
-    // Wait for fence
-    // Invalid vkFence object
-    vkWaitForFences(vulkan->device, 1, &current_submission.fence, VK_TRUE, UINT64_MAX);
     uint32_t current_swapchain_image_index;
     do {
-        err = vkAcquireNextImageKHR(vulkan->device, vulkan->swapchain, UINT64_MAX, current_submission.image_acquired_semaphore, VK_NULL_HANDLE, &current_swapchain_image_index);
-        assert(!err);
-        if (!vulkan->swapchain_ready) return;
+        err = vkAcquireNextImageKHR(vulkan->device, output->swapchain, 0, current_submission->image_acquired_semaphore, VK_NULL_HANDLE, &current_swapchain_image_index);
+        if (err == VK_NOT_READY || err == VK_TIMEOUT) {
+            // Every image is queued for display, the damage stays pending
+            return false;
+        } else if (err == VK_ERROR_OUT_OF_DATE_KHR) {
+            // Nothing was acquired and the semaphore is untouched, recreate and retry
+            output->swapchain_out_of_date = true;
+            if (!recreate_swapchain(vulkan, output)) return false;
+            if (!output->swapchain_ready) return true;
+        } else if (err == VK_SUBOPTIMAL_KHR) {
+            // Image is acquired and the semaphore will signal: draw this frame, recreate after present
+            output->swapchain_out_of_date = true;
+            break;
+        } else if (err == VK_ERROR_SURFACE_LOST_KHR) {
+            if (!recreate_display_surface(vulkan, output)) return false;
+            if (!output->swapchain_ready) return true;
+        } else {
+            assert(!err);
+        }
     } while(err != VK_SUCCESS);
 
+    cursor_overlay_damage(render->cursor, &ro->cursor, output, current_swapchain_image_index, &ro->pending);
+    DamageRegionT frame_damage;
+    bool frame_partial = take_frame_damage(ro, &frame_damage);
+
+    // Partial redraw keeps the image contents (LOAD) and repaints only the bounds of the
+    // repaint region. Once that covers most of the output the cached full frame is cheaper
+    VkExtent2D extent = output->swapchain_extent;
+    DamageRegionT repaint;
+    bool partial = frame_partial && get_repaint_region(ro, current_swapchain_image_index, &frame_damage, &repaint);
+    VkRect2D draw_area = {{0, 0}, extent};
+    if (partial) {
+        draw_area = damage_bounds(&repaint);
+        if ((uint64_t)draw_area.extent.width * draw_area.extent.height * 2 > (uint64_t)extent.width * extent.height) {
+            partial = false;
+            draw_area = (VkRect2D){{0, 0}, extent};
+        }
+    }
+
     // Begin command buffer
     VkCommandBufferBeginInfo cmd_buf_info = {.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    vkBeginCommandBuffer(current_submission.cmd, &cmd_buf_info);
+    vkBeginCommandBuffer(current_submission->cmd, &cmd_buf_info);
+
+    // Uploads finished on the transfer queue are taken over before anything reads them,
+    // effect results computed since the last frame before they are sampled
+    VkSemaphore wait_semaphores[1 + MAX_UPLOADS + EFFECT_BATCHES] = {current_submission->image_acquired_semaphore};
+    VkPipelineStageFlags wait_stages[1 + MAX_UPLOADS + EFFECT_BATCHES] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    // The cursor's save-under is copied in and out of the image
+    if (output->swapchain_transfer) wait_stages[0] |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    uint32_t wait_count = 1;
+    wait_count += uploader_acquire(render->uploader, current_submission->cmd, &output->completed_serial, output->frame_serial + 1,
+                                   wait_semaphores + wait_count, wait_stages + wait_count, MAX_UPLOADS);
+    textures_record_acquires(render->textures, current_submission->cmd);
+    wait_count += effects_acquire(render->effects, output, output->frame_serial + 1,
+                                  wait_semaphores + wait_count, wait_stages + wait_count, EFFECT_BATCHES);
 
-    // Traverse and draw the scene
-    draw_scene_tree(render->scene->root, current_submission.cmd, render, current_swapchain_image_index);
-    
-    vkEndCommandBuffer(current_submission.cmd);
+    update_blurs(ro, current_submission->cmd, &frame_damage);
+
+    // A frame where only the cursor moved records no scene at all
+    cursor_overlay_restore(&ro->cursor, output, current_submission->cmd, current_swapchain_image_index, !partial);
+    if (!partial || !damage_is_empty(&repaint)) {
+        record_composition(render, ro, current_submission->cmd, current_swapchain_image_index, partial, draw_area, now);
+    }
+    VkRect2D cursor_shown = ro->cursor.shown;
+    cursor_overlay_draw(render->cursor, &ro->cursor, output, current_submission->cmd, current_swapchain_image_index);
+    vkEndCommandBuffer(current_submission->cmd);
 
     // Submit
-    vkResetFences(vulkan->device, 1, &current_submission.fence);
-    VkPipelineStageFlags pipe_stage_flags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    current_submission->serial = ++output->frame_serial;
+    vkResetFences(vulkan->device, 1, &current_submission->fence);
+    // Effect passes recorded during this frame run on the compute queue once it's done
+    VkSemaphore signal_semaphores[2] = {output->draw_complete_semaphores[current_swapchain_image_index],
+                                        effects_input_semaphore(render->effects)};
     VkSubmitInfo submit_info = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &current_submission.image_acquired_semaphore,
-        .pWaitDstStageMask = &pipe_stage_flags,
+        .waitSemaphoreCount = wait_count,
+        .pWaitSemaphores = wait_semaphores,
+        .pWaitDstStageMask = wait_stages,
         .commandBufferCount = 1,
-        .pCommandBuffers = &current_submission.cmd,
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &vulkan->draw_complete_semaphores[current_swapchain_image_index],
+        .pCommandBuffers = &current_submission->cmd,
+        .signalSemaphoreCount = signal_semaphores[1] ? 2 : 1,
+        .pSignalSemaphores = signal_semaphores,
     };
-    err = vkQueueSubmit(vulkan->graphics_queue, 1, &submit_info, current_submission.fence);
+    err = vkQueueSubmit(vulkan->graphics_queue, 1, &submit_info, current_submission->fence);
     assert(!err);
+    effects_submit(render->effects);
+
+    ro->damage_history[current_submission->serial % DAMAGE_HISTORY] = frame_damage;
+    if (current_swapchain_image_index < ro->image_drawn_count) {
+        ro->image_drawn_serial[current_swapchain_image_index] = current_submission->serial;
+    }
 
     // Present
     VkPresentInfoKHR present = {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
         .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &vulkan->draw_complete_semaphores[current_swapchain_image_index],
+        .pWaitSemaphores = &output->draw_complete_semaphores[current_swapchain_image_index],
         .swapchainCount = 1,
-        .pSwapchains = &vulkan->swapchain,
+        .pSwapchains = &output->swapchain,
         .pImageIndices = &current_swapchain_image_index,
     };
+
+    // Tell the display what changed since the previous present. Identity pre-transform,
+    // so output space rects are already in swapchain image space
+    VkRectLayerKHR present_rects[MAX_DAMAGE_RECTS + 2];
+    VkPresentRegionKHR present_region;
+    VkPresentRegionsKHR present_regions;
+    if (vulkan->incremental_present && frame_partial) {
+        uint32_t rect_count = 0;
+        for (uint32_t i = 0; i < frame_damage.count; i++) {
+            present_rects[rect_count++] = (VkRectLayerKHR){frame_damage.rects[i].offset, frame_damage.rects[i].extent, 0};
+        }
+        // Where the cursor was and is, neither is in the damage when the save-under handled them
+        VkRect2D cursor_rects[2] = {cursor_shown, ro->cursor.shown};
+        for (uint32_t i = 0; i < 2; i++) {
+            if (cursor_rects[i].extent.width == 0 || cursor_rects[i].extent.height == 0) continue;
+            present_rects[rect_count++] = (VkRectLayerKHR){cursor_rects[i].offset, cursor_rects[i].extent, 0};
+        }
+        present_region = (VkPresentRegionKHR){
+            .rectangleCount = rect_count,
+            .pRectangles = present_rects,
+        };
+        present_regions = (VkPresentRegionsKHR){
+            .sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR,
+            .swapchainCount = 1,
+            .pRegions = &present_region,
+        };
+        present.pNext = &present_regions;
+    }
+    // Asks the driver to report when it reached the display
+    VkPresentTimeGOOGLE present_time;
+    VkPresentTimesInfoGOOGLE present_times;
+    present.pNext = present_timing_present_info(ro->present_timing, current_submission->serial, &present_time, &present_times,
+                                                present.pNext);
+
     err = vkQueuePresentKHR(vulkan->present_queue, &present);
-    vulkan->current_submission_index = (vulkan->current_submission_index + 1) % FRAME_LAG;
-    // Handle surface loss
-    if (err == VK_ERROR_SURFACE_LOST_KHR) {
-        vkDestroySurfaceKHR(vulkan->instance, vulkan->surface, NULL);
-        create_display_surface(vulkan);  // Recreate surface (from your code)
-        // Optionally recreate swapchain here if needed
+    present_timing_submitted(ro->present_timing, current_submission->serial, get_time_ns());
+    output->current_submission_index = (output->current_submission_index + 1) % FRAME_LAG;
+
+    if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR) {
+        // Picked up at the start of the next frame, no wait here
+        output->swapchain_out_of_date = true;
+    } else if (err == VK_ERROR_SURFACE_LOST_KHR) {
+        // Surface and swapchain are retired together, destroyed once this frame completed.
+        // Deferred with a full retired list, surface_lost brings it back before the next acquire
+        recreate_display_surface(vulkan, output);
+    } else {
+        assert(!err);
+    }
+
+    return true;
+}
+
+// Each output repaints on its own refresh cycle. Outputs are driven from this one thread,
+// none of them blocks, so a slow display never holds back the others
+static void render_frame(struct pwc_render *render, uint64_t now) {
+    // However many events moved it since the last frame
+    if (render->server) seat_cursor_position(render->server->seat, &render->cursor->x, &render->cursor->y);
+    cursor_prepare(render->cursor);
+    update_memory_budget(render, now);
+    textures_sweep(render->textures);
+    for (uint32_t i = 0; i < render->output_count; i++) {
+        RenderOutputT *ro = &render->outputs[i];
+        // Presentation feedback for earlier frames, whether or not the output is due
+        PresentedFrameT presented[PRESENT_TIMING_PENDING];
+        uint32_t presented_count = present_timing_poll(ro->present_timing, now, presented);
+        for (uint32_t j = 0; j < presented_count && render->server; j++) {
+            server_frame_presented(render->server, i, &presented[j]);
+        }
+        if (ro->next_frame_ns > now) continue;
+
+        uint64_t last_serial = ro->output->frame_serial;
+        bool drawn = render_output_frame(render, ro, now);
+        // Queued behind the frame, which never waits for them
+        hibernate_workspaces(render, ro, now);
+        refresh_snapshots(render, ro, now);
+        if (!drawn) {
+            ro->next_frame_ns = now + FRAME_RETRY_NS;
+            continue;
+        }
+
+        // Stay on the output's cadence, unless it fell behind by a whole frame
+        ro->next_frame_ns += ro->refresh_ns;
+        if (ro->next_frame_ns <= now) ro->next_frame_ns = now + ro->refresh_ns;
+        // Clients shown here draw their next frame now, in time for the next repaint
+        uint64_t submitted = ro->output->frame_serial != last_serial ? ro->output->frame_serial : 0;
+        if (render->server) server_output_frame(render->server, i, submitted, now);
+    }
+}
+
+static uint64_t next_frame_deadline(struct pwc_render *render) {
+    uint64_t deadline = UINT64_MAX;
+    for (uint32_t i = 0; i < render->output_count; i++) {
+        if (render->outputs[i].next_frame_ns < deadline) deadline = render->outputs[i].next_frame_ns;
+    }
+    return deadline;
+}
+
+void render_switch_workspace(struct pwc_render *render, uint32_t output_index, uint32_t workspace_index) {
+    if (output_index >= render->output_count) return;
+    RenderOutputT *ro = &render->outputs[output_index];
+    if (workspace_index >= ro->workspace_count || workspace_index == ro->active_workspace) return;
+
+    ro->switch_from = ro->active_workspace;
+    ro->active_workspace = workspace_index;
+
+    // Without both snapshots the switch is instant
+    WorkspaceSnapshotT *from = workspace_cache_find(ro->workspace_cache, ro->workspaces[ro->switch_from]);
+    WorkspaceSnapshotT *to = workspace_cache_find(ro->workspace_cache, ro->workspaces[workspace_index]);
+    ro->switching = !ro->overview && from && from->image.initialized && to && to->image.initialized;
+    ro->switch_start_ns = get_time_ns();
+    ro->pending_whole = true;
+}
+
+void render_set_overview(struct pwc_render *render, uint32_t output_index, bool overview) {
+    if (output_index >= render->output_count) return;
+    RenderOutputT *ro = &render->outputs[output_index];
+    if (ro->overview == overview) return;
+
+    ro->overview = overview;
+    ro->switching = false;
+    ro->pending_whole = true;
+}
+
+void render_toggle_overview(struct pwc_render *render, uint32_t output_index) {
+    if (output_index >= render->output_count) return;
+    render_set_overview(render, output_index, !render->outputs[output_index].overview);
+}
+
+// An opaque surface somewhere in node's subtree hides all of rect
+static bool subtree_covers(SceneNodeT *node, VkRect2D rect) {
+    if (node->type == SCENE_NODE_SURFACE && node->texture && node->texture->opaque &&
+        scene_node_world_transform(node).opacity >= 1.0f) {
+        VkRect2D box = scene_node_transformed_geometry(node);
+        if (box.offset.x <= rect.offset.x && box.offset.y <= rect.offset.y &&
+            (int64_t)box.offset.x + box.extent.width >= (int64_t)rect.offset.x + rect.extent.width &&
+            (int64_t)box.offset.y + box.extent.height >= (int64_t)rect.offset.y + rect.extent.height) {
+            return true;
+        }
+    }
+    scene_node_for_each_child(child, node) {
+        if (subtree_covers(child, rect)) return true;
+    }
+    return false;
+}
+
+// Output under the cursor, outputs are laid out left to right. The last one past the right edge
+static RenderOutputT *cursor_output(struct pwc_render *render) {
+    int32_t x = (int32_t)floor(render->cursor->x);
+    for (uint32_t i = 0; i + 1 < render->output_count; i++) {
+        x -= (int32_t)render->outputs[i].output->swapchain_extent.width;
+        if (x < 0) return &render->outputs[i];
     }
+    return render->output_count ? &render->outputs[render->output_count - 1] : NULL;
+}
+
+bool render_map_toplevel(struct pwc_render *render, SceneNodeT *tree, VkRect2D window) {
+    RenderOutputT *ro = cursor_output(render);
+    SceneNodeT *workspace = ro ? active_workspace(ro) : NULL;
+    // Any output with a workspace to put it on
+    for (uint32_t i = 0; !workspace && i < render->output_count; i++) {
+        ro = &render->outputs[i];
+        workspace = active_workspace(ro);
+    }
+    if (!workspace) return false;
+
+    VkExtent2D extent = ro->output->swapchain_extent;
+    float width = window.extent.width * ro->scale, height = window.extent.height * ro->scale;
+    tree->transform.offset[0] = roundf((extent.width - width) / 2.0f - window.offset.x * ro->scale);
+    tree->transform.offset[1] = roundf((extent.height - height) / 2.0f - window.offset.y * ro->scale);
+    tree->blur_levels = WINDOW_BLUR_LEVELS;
+    tree->decoration = window_decoration;
+    scene_add_child(workspace, tree);
+
+    // Fades in, a tree mapped again mid-fade goes on from where it is
+    if (tree->transform.opacity >= 1.0f) tree->transform.opacity = 0.0f;
+    if (!timeline_animate(render->timeline, tree, ANIMATION_OPACITY, 1.0f, ANIMATION_CURVE_EASE_OUT, get_time_ns(), MAP_FADE_NS)) {
+        tree->transform.opacity = 1.0f;
+    }
+    return true;
+}
+
+float render_node_scale(struct pwc_render *render, SceneNodeT *node) {
+    SceneNodeT *workspace = node;
+    while (workspace && workspace->type != SCENE_NODE_WORKSPACE) workspace = workspace->parent;
+    if (!workspace) return 1.0f;
+    for (uint32_t i = 0; i < render->output_count; i++) {
+        RenderOutputT *ro = &render->outputs[i];
+        for (uint32_t j = 0; j < ro->workspace_count; j++) {
+            if (scene_node_from_handle(ro->workspaces[j]) == workspace) return ro->scale;
+        }
+    }
+    return 1.0f;
+}
+
+VkOffset2D render_output_origin(struct pwc_render *render, uint32_t output_index) {
+    int32_t x = 0;
+    for (uint32_t i = 0; i < output_index && i < render->output_count; i++) {
+        x += (int32_t)render->outputs[i].output->swapchain_extent.width;
+    }
+    return (VkOffset2D){x, 0};
+}
+
+bool render_node_visible(struct pwc_render *render, SceneNodeT *node, uint32_t *output_index) {
+    if (node->geometry.extent.width == 0 || node->geometry.extent.height == 0) return false;
+
+    // The layer is the ancestor directly below the workspace
+    SceneNodeT *layer = node;
+    while (layer->parent && layer->parent->type != SCENE_NODE_WORKSPACE) layer = layer->parent;
+    SceneNodeT *workspace = layer->parent;
+    if (!workspace) return false;
+
+    for (uint32_t i = 0; i < render->output_count; i++) {
+        RenderOutputT *ro = &render->outputs[i];
+        if (live_workspace(ro) != workspace) continue;
+
+        VkRect2D box;
+        if (!rect_clip(scene_node_transformed_geometry(node), ro->output->swapchain_extent, &box)) return false;
+        // Only whole layers stacked above are checked, not siblings inside the same layer
+        for (SceneNodeT *above = layer->next; above; above = above->next) {
+            if (subtree_covers(above, box)) return false;
+        }
+        if (output_index) *output_index = i;
+        return true;
+    }
+    return false;
 }
 
 void render_run(struct pwc_render *render) {
-    render->running = true;
+    render->running = render->vulkan->initialized && render->output_count > 0;
     while (render->running) {
-        render_frame(render);
+        uint64_t now = get_time_ns();
+        render_frame(render, now);
+        if (render->server) server_frame_done(render->server, now);
+
+        // Commits handed over by the protocol thread are applied until the next output is due,
+        // without a server just sleep
+        uint64_t deadline = next_frame_deadline(render);
+        if (render->server) {
+            while ((now = get_time_ns()) < deadline) {
+                uint64_t timeout_ms = (deadline - now + 999999) / 1000000;
+                server_dispatch(render->server, (int)(timeout_ms < INT32_MAX ? timeout_ms : INT32_MAX));
+            }
+        } else {
+            struct timespec ts = {(time_t)(deadline / 1000000000ull), (long)(deadline % 1000000000ull)};
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
 
         // Check for quit
     }
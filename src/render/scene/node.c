@@ -1,8 +1,98 @@
+#include <math.h>
 #include <pwc/render/scene/node.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-SceneNodeT *create_scene_node(enum SceneNodeType type, void *data) {
+// Handle slot table. Free slots form a singly linked FIFO through next_free, so allocating
+// and releasing a handle is O(1) and a freed slot is reused last: closing and opening windows
+// over and over cycles through every free slot instead of bumping one slot's generation.
+typedef struct SceneNodeSlot {
+    SceneNodeT *node;
+    uint32_t generation;
+    uint32_t next_free;
+} SceneNodeSlot;
+
+static SceneNodeSlot *slots = NULL;
+static uint32_t slot_count = 0;
+static uint32_t slot_capacity = 0;
+static uint32_t free_head = UINT32_MAX;
+static uint32_t free_tail = UINT32_MAX;
+
+static SceneNodeDestroyFunc destroy_listener = NULL;
+static void *destroy_listener_data = NULL;
+
+static SceneNodeHandle make_handle(uint32_t index, uint32_t generation) {
+    return ((SceneNodeHandle)generation << SCENE_NODE_HANDLE_INDEX_BITS) | (index + 1);
+}
+
+static SceneNodeHandle alloc_handle(SceneNodeT *node) {
+    uint32_t index;
+
+    if (free_head != UINT32_MAX) {
+        index = free_head;
+        free_head = slots[index].next_free;
+        if (free_head == UINT32_MAX) free_tail = UINT32_MAX;
+    } else {
+        if (slot_count >= SCENE_NODE_HANDLE_MAX_NODES) {
+            fprintf(stderr, "Scene node handle table is full\n");
+            return SCENE_NODE_HANDLE_NULL;
+        }
+
+        if (slot_count >= slot_capacity) {
+            uint32_t new_capacity = (slot_capacity == 0) ? 64 : slot_capacity * 2;
+            SceneNodeSlot *new_slots = realloc(slots, new_capacity * sizeof(SceneNodeSlot));
+            if (!new_slots) {
+                fprintf(stderr, "Failed to realloc scene node handle table\n");
+                return SCENE_NODE_HANDLE_NULL;
+            }
+
+            slots = new_slots;
+            slot_capacity = new_capacity;
+        }
+
+        index = slot_count++;
+        slots[index].generation = 0;
+    }
+
+    slots[index].node = node;
+    slots[index].next_free = UINT32_MAX;
+
+    return make_handle(index, slots[index].generation);
+}
+
+static void release_handle(SceneNodeHandle handle) {
+    if (handle == SCENE_NODE_HANDLE_NULL) return;
+
+    uint32_t index = (uint32_t)(handle & SCENE_NODE_HANDLE_INDEX_MASK) - 1;
+    slots[index].node = NULL;
+    slots[index].generation++;
+    slots[index].next_free = UINT32_MAX;
+    if (free_tail != UINT32_MAX) slots[free_tail].next_free = index;
+    else free_head = index;
+    free_tail = index;
+}
+
+void scene_node_set_destroy_listener(SceneNodeDestroyFunc func, void *data) {
+    destroy_listener = func;
+    destroy_listener_data = data;
+}
+
+SceneNodeHandle scene_node_get_handle(const SceneNodeT *node) {
+    return node ? node->handle : SCENE_NODE_HANDLE_NULL;
+}
+
+SceneNodeT *scene_node_from_handle(SceneNodeHandle handle) {
+    uint64_t index = handle & SCENE_NODE_HANDLE_INDEX_MASK;
+    if (index == 0 || index > slot_count) return NULL;
+
+    SceneNodeSlot *slot = &slots[index - 1];
+    if (slot->generation != (handle >> SCENE_NODE_HANDLE_INDEX_BITS)) return NULL;
+
+    return slot->node;
+}
+
+SceneNodeT *create_scene_node(enum SceneNodeType type) {
     SceneNodeT *node = calloc(1, sizeof(SceneNodeT));
     if (!node) {
         fprintf(stderr, "Failed to create scene node");
@@ -10,31 +100,178 @@ SceneNodeT *create_scene_node(enum SceneNodeType type, void *data) {
     }
 
     node->type = type;
-    node->data = data;
+    node->is_dirty = true;
     node->parent = NULL;
+    node->first_child = NULL;
+    node->last_child = NULL;
+    node->prev = NULL;
+    node->next = NULL;
     node->num_child = 0;
-    node->capacity = 0;
-    node->child = NULL;
+    node->transform.scale = 1.0f;
+    node->transform.opacity = 1.0f;
+    node->uv_rect[2] = 1.0f;
+    node->uv_rect[3] = 1.0f;
+
+    node->handle = alloc_handle(node);
+    if (node->handle == SCENE_NODE_HANDLE_NULL) {
+        free(node);
+        return NULL;
+    }
 
     return node;
 }
 
-void scene_add_child(SceneNodeT *src, SceneNodeT *child) {
-    if (!src || !child) return;
-    
-    if (src->num_child >= src->capacity) {
-        int new_capacity = (src->capacity == 0) ? 10 : src->capacity * 2;
-        SceneNodeT **new_array = realloc(src->child, new_capacity * sizeof(SceneNodeT *));
-        if (!new_array) {
-            fprintf(stderr, "Failed to realloc children array\n");
-            return;
-        }
+void scene_node_mark_dirty(SceneNodeT *node) {
+    if (!node) return;
 
-        src->child = new_array;
-        src->capacity = new_capacity; 
+    node->is_dirty = true;
+    for (SceneNodeT *it = node; it; it = it->parent) {
+        it->subtree_serial++;
     }
+}
+
+SceneTransformT scene_node_world_transform(const SceneNodeT *node) {
+    SceneTransformT world = {{0.0f, 0.0f}, node->transform.scale, 1.0f};
+    for (const SceneNodeT *it = node; it; it = it->parent) {
+        world.offset[0] += it->transform.offset[0];
+        world.offset[1] += it->transform.offset[1];
+        world.opacity *= it->transform.opacity;
+    }
+    return world;
+}
+
+// Transformed rect grown by margins (in untransformed pixels) before scaling
+static VkRect2D transform_rect(VkRect2D rect, SceneTransformT transform, float left, float top, float right, float bottom) {
+    float cx = rect.offset.x + rect.extent.width * 0.5f + transform.offset[0];
+    float cy = rect.offset.y + rect.extent.height * 0.5f + transform.offset[1];
+    float x0 = floorf(cx - (rect.extent.width * 0.5f + left) * transform.scale);
+    float y0 = floorf(cy - (rect.extent.height * 0.5f + top) * transform.scale);
+    float x1 = ceilf(cx + (rect.extent.width * 0.5f + right) * transform.scale);
+    float y1 = ceilf(cy + (rect.extent.height * 0.5f + bottom) * transform.scale);
+    if (x1 <= x0 || y1 <= y0) return (VkRect2D){{(int32_t)x0, (int32_t)y0}, {0, 0}};
+
+    return (VkRect2D){{(int32_t)x0, (int32_t)y0}, {(uint32_t)(x1 - x0), (uint32_t)(y1 - y0)}};
+}
+
+VkRect2D scene_node_transformed_geometry(const SceneNodeT *node) {
+    // Zero extent covers the whole output whatever the transform
+    if (node->geometry.extent.width == 0 || node->geometry.extent.height == 0) return node->geometry;
+    return transform_rect(node->geometry, scene_node_world_transform(node), 0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+VkRect2D scene_node_bounds(const SceneNodeT *node) {
+    const SceneDecorationT *decoration = &node->decoration;
+    if (!decoration->enabled || decoration->shadow_radius <= 0.0f) return scene_node_transformed_geometry(node);
+    if (node->geometry.extent.width == 0 || node->geometry.extent.height == 0) return node->geometry;
+
+    // Shadow is the geometry moved by the offset, fading out over the radius
+    float left = decoration->shadow_radius - fminf(0.0f, decoration->shadow_offset[0]);
+    float top = decoration->shadow_radius - fminf(0.0f, decoration->shadow_offset[1]);
+    float right = decoration->shadow_radius + fmaxf(0.0f, decoration->shadow_offset[0]);
+    float bottom = decoration->shadow_radius + fmaxf(0.0f, decoration->shadow_offset[1]);
+    return transform_rect(node->geometry, scene_node_world_transform(node), left, top, right, bottom);
+}
+
+void scene_node_unlink(SceneNodeT *node) {
+    if (!node || !node->parent) return;
+    SceneNodeT *parent = node->parent;
+
+    if (node->prev) node->prev->next = node->next;
+    else parent->first_child = node->next;
+
+    if (node->next) node->next->prev = node->prev;
+    else parent->last_child = node->prev;
+
+    node->prev = NULL;
+    node->next = NULL;
+    node->parent = NULL;
+    parent->num_child--;
+    scene_node_mark_dirty(parent);
+}
+
+void destroy_scene_node(SceneNodeT *node) {
+    if (!node) return;
+
+    if (destroy_listener) destroy_listener(node, destroy_listener_data);
+    scene_node_unlink(node);
+
+    SceneNodeT *child = node->first_child;
+    while (child) {
+        SceneNodeT *next = child->next;
+        // Children are torn down with the parent, skip per-child unlink bookkeeping
+        child->parent = NULL;
+        destroy_scene_node(child);
+        child = next;
+    }
+
+    release_handle(node->handle);
+    free(node);
+}
+
+// Whether node is parent or one of its ancestors: moving node under parent would cut the
+// subtree off the tree as a cycle
+static bool node_contains(const SceneNodeT *node, const SceneNodeT *parent) {
+    for (; parent; parent = parent->parent) {
+        if (parent == node) return true;
+    }
+    return false;
+}
+
+void scene_add_child(SceneNodeT *src, SceneNodeT *child) {
+    if (!src || !child || node_contains(child, src)) return;
+
+    scene_node_unlink(child);
 
-    src->child[src->num_child] = child;
-    src->num_child++;
     child->parent = src;
-}
\ No newline at end of file
+    child->prev = src->last_child;
+    child->next = NULL;
+    if (src->last_child) src->last_child->next = child;
+    else src->first_child = child;
+    src->last_child = child;
+    src->num_child++;
+    scene_node_mark_dirty(src);
+}
+
+void scene_node_place_above(SceneNodeT *node, SceneNodeT *sibling) {
+    if (!node || !sibling || !sibling->parent || node_contains(node, sibling)) return;
+    if (sibling->next == node) return;
+
+    scene_node_unlink(node);
+
+    SceneNodeT *parent = sibling->parent;
+    node->parent = parent;
+    node->prev = sibling;
+    node->next = sibling->next;
+    if (sibling->next) sibling->next->prev = node;
+    else parent->last_child = node;
+    sibling->next = node;
+    parent->num_child++;
+    scene_node_mark_dirty(parent);
+}
+
+void scene_node_place_below(SceneNodeT *node, SceneNodeT *sibling) {
+    if (!node || !sibling || !sibling->parent || node_contains(node, sibling)) return;
+    if (sibling->prev == node) return;
+
+    scene_node_unlink(node);
+
+    SceneNodeT *parent = sibling->parent;
+    node->parent = parent;
+    node->next = sibling;
+    node->prev = sibling->prev;
+    if (sibling->prev) sibling->prev->next = node;
+    else parent->first_child = node;
+    sibling->prev = node;
+    parent->num_child++;
+    scene_node_mark_dirty(parent);
+}
+
+void scene_node_raise_to_top(SceneNodeT *node) {
+    if (!node || !node->parent || node->parent->last_child == node) return;
+    scene_node_place_above(node, node->parent->last_child);
+}
+
+void scene_node_lower_to_bottom(SceneNodeT *node) {
+    if (!node || !node->parent || node->parent->first_child == node) return;
+    scene_node_place_below(node, node->parent->first_child);
+}
@@ -1,3 +1,4 @@
+#include <pwc/render/damage.h>
 #include <pwc/render/scene/node.h>
 #include <pwc/render/scene/scene.h>
 #include <stdio.h>
@@ -13,20 +14,123 @@ struct pwc_scene *create_scene(void) {
     return scene;
 }
 
-static void free_node_rec(SceneNodeT *node) {
-    if (!node) return;
-    for (int i = 0; i < node->num_child; i++) {
-        free_node_rec(node->child[i]);
+static WorkspaceDamageT *get_workspace_damage(struct pwc_scene *scene, SceneNodeT *workspace) {
+    uint32_t kept = 0;
+    WorkspaceDamageT *found = NULL;
+
+    // Drops entries of destroyed workspaces on the way, there are only a handful
+    for (uint32_t i = 0; i < scene->damage_count; i++) {
+        if (!scene_node_from_handle(scene->damage[i].workspace)) continue;
+        scene->damage[kept] = scene->damage[i];
+        if (scene->damage[kept].workspace == workspace->handle) found = &scene->damage[kept];
+        kept++;
     }
-    free(node->child);
-    free(node->data);
-    free(node);
+    scene->damage_count = kept;
+    if (found) return found;
+
+    if (scene->damage_count >= scene->damage_capacity) {
+        uint32_t new_capacity = (scene->damage_capacity == 0) ? 8 : scene->damage_capacity * 2;
+        WorkspaceDamageT *new_damage = realloc(scene->damage, new_capacity * sizeof(WorkspaceDamageT));
+        if (!new_damage) {
+            fprintf(stderr, "Failed to realloc workspace damage\n");
+            return NULL;
+        }
+        scene->damage = new_damage;
+        scene->damage_capacity = new_capacity;
+    }
+
+    // Never drawn yet: whole
+    found = &scene->damage[scene->damage_count++];
+    found->workspace = workspace->handle;
+    damage_clear(&found->damage);
+    found->whole = true;
+    found->damaged_serial = workspace->subtree_serial;
+    return found;
 }
 
-void destroy_scene(struct pwc_scene *scene) {
-    if (!scene) return;
-    
-    free_node_rec(scene->root);
+static bool node_on_plane(SceneNodeT *node) {
+    for (; node; node = node->parent) {
+        if (node->on_plane) return true;
+    }
+    return false;
+}
+
+static SceneNodeT *node_workspace(struct pwc_scene *scene, SceneNodeT *node) {
+    while (node && node->parent != scene->root) node = node->parent;
+    return node;
+}
+
+static void damage_whole_scene(struct pwc_scene *scene) {
+    scene_node_for_each_child(workspace, scene->root) {
+        WorkspaceDamageT *entry = get_workspace_damage(scene, workspace);
+        if (entry) entry->whole = true;
+    }
+}
+
+void scene_damage_node(struct pwc_scene *scene, SceneNodeT *node) {
+    scene_node_mark_dirty(node);
+
+    SceneNodeT *workspace = node_workspace(scene, node);
+    if (!workspace) {
+        damage_whole_scene(scene);
+        return;
+    }
+
+    WorkspaceDamageT *entry = get_workspace_damage(scene, workspace);
+    if (!entry) return;
+    entry->damaged_serial = workspace->subtree_serial;
+
+    // Plane contents don't touch the composited image
+    if (node_on_plane(node)) return;
+
+    if (node == workspace || node->geometry.extent.width == 0 || node->geometry.extent.height == 0) {
+        entry->whole = true;
+    } else {
+        damage_add_rect(&entry->damage, scene_node_bounds(node));
+    }
+}
+
+void scene_damage_node_region(struct pwc_scene *scene, SceneNodeT *node, const DamageRegionT *region) {
+    SceneNodeT *workspace = node_workspace(scene, node);
+    // Scaled or without a workspace, the rects don't map onto the output 1:1
+    if (!workspace || node == workspace || node->transform.scale != 1.0f) {
+        scene_damage_node(scene, node);
+        return;
+    }
+    scene_node_mark_dirty(node);
+
+    WorkspaceDamageT *entry = get_workspace_damage(scene, workspace);
+    if (!entry) return;
+    entry->damaged_serial = workspace->subtree_serial;
+    if (node_on_plane(node)) return;
+
+    VkRect2D geometry = scene_node_transformed_geometry(node);
+    for (uint32_t i = 0; i < region->count; i++) {
+        VkRect2D rect = region->rects[i];
+        VkRect2D clipped;
+        if (!rect_clip(rect, geometry.extent, &clipped)) continue;
+        clipped.offset.x += geometry.offset.x;
+        clipped.offset.y += geometry.offset.y;
+        damage_add_rect(&entry->damage, clipped);
+    }
+}
+
+void scene_damage_rect(struct pwc_scene *scene, SceneNodeT *workspace, VkRect2D rect) {
+    WorkspaceDamageT *entry = get_workspace_damage(scene, workspace);
+    if (entry) damage_add_rect(&entry->damage, rect);
+}
+
+bool scene_take_damage(struct pwc_scene *scene, SceneNodeT *workspace, DamageRegionT *out) {
+    WorkspaceDamageT *entry = get_workspace_damage(scene, workspace);
+    if (!entry) return false;
+
+    bool partial = !entry->whole && workspace->subtree_serial == entry->damaged_serial;
+    if (partial) damage_add_region(out, &entry->damage);
+
+    damage_clear(&entry->damage);
+    entry->whole = false;
+    entry->damaged_serial = workspace->subtree_serial;
+    return partial;
 }
 
 static void print_node(SceneNodeT *node, int depth) {
@@ -47,15 +151,21 @@ static void print_node(SceneNodeT *node, int depth) {
             case SCENE_NODE_CONTAINER:
                 nodetype = "CONTAINER";
                 break;
+            case SCENE_NODE_SURFACE:
+                nodetype = "SURFACE";
+                break;
+            case SCENE_NODE_SURFACE_TREE:
+                nodetype = "SURFACE_TREE";
+                break;
             default:
                 nodetype = "UNKNOWN";
                 break;
         }
-        printf("Node type: %s, Data: %s\n", nodetype, (char *)node->data);
+        printf("Node type: %s\n", nodetype);
 
-        // Print children from array
-        for (int i = 0; i < node->num_child; i++) {
-            print_node(node->child[i], depth + 1);
+        // Print children bottom -> top
+        scene_node_for_each_child(child, node) {
+            print_node(child, depth + 1);
         }
 }
 
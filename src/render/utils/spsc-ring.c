@@ -0,0 +1,62 @@
+#include <pwc/render/utils/spsc-ring.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct pwc_spsc_ring *create_spsc_ring(uint32_t capacity, uint32_t element_size) {
+    if (capacity == 0 || capacity > (1u << 31) || element_size == 0) return NULL;
+    uint32_t size = 1;
+    while (size < capacity) size <<= 1;
+
+    // The indices' cache lines need the struct aligned too
+    struct pwc_spsc_ring *ring = aligned_alloc(SPSC_RING_CACHE_LINE, sizeof(struct pwc_spsc_ring));
+    if (!ring) {
+        fprintf(stderr, "Failed to allocate ring\n");
+        return NULL;
+    }
+    memset(ring, 0, sizeof(struct pwc_spsc_ring));
+    ring->slots = calloc(size, element_size);
+    if (!ring->slots) {
+        fprintf(stderr, "Failed to allocate ring slots\n");
+        free(ring);
+        return NULL;
+    }
+    ring->element_size = element_size;
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return ring;
+}
+
+void destroy_spsc_ring(struct pwc_spsc_ring *ring) {
+    if (!ring) return;
+    free(ring->slots);
+    free(ring);
+}
+
+bool spsc_ring_push(struct pwc_spsc_ring *ring, const void *element) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    // Only reload the consumer's index when the cached one says full
+    if (tail - ring->cached_head > ring->mask) {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail - ring->cached_head > ring->mask) return false;
+    }
+    memcpy(ring->slots + (size_t)(tail & ring->mask) * ring->element_size, element, ring->element_size);
+    // Publishes the slot's contents along with the index
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+bool spsc_ring_pop(struct pwc_spsc_ring *ring, void *element) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head == ring->cached_tail) {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head == ring->cached_tail) return false;
+    }
+    memcpy(element, ring->slots + (size_t)(head & ring->mask) * ring->element_size, ring->element_size);
+    // The slot may be reused by the producer from here on
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
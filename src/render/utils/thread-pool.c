@@ -0,0 +1,151 @@
+#include <pwc/render/utils/thread-pool.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct WorkerArgs {
+    struct pwc_thread_pool *pool;
+    uint32_t index;
+} WorkerArgsT;
+
+static void *worker_main(void *data) {
+    WorkerArgsT *args = data;
+    struct pwc_thread_pool *pool = args->pool;
+    uint32_t index = args->index;
+    free(args);
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->job_count == 0 && !pool->quit) {
+            pthread_cond_wait(&pool->job_available, &pool->lock);
+        }
+        if (pool->quit && pool->job_count == 0) break;
+
+        PwcJobT job = pool->jobs[pool->job_head];
+        pool->job_head = (pool->job_head + 1) % pool->job_capacity;
+        pool->job_count--;
+        pthread_mutex_unlock(&pool->lock);
+
+        job.fn(job.arg, index);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->jobs_in_flight == 0) {
+            pthread_cond_broadcast(&pool->jobs_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+struct pwc_thread_pool *create_thread_pool(uint32_t thread_count) {
+    if (thread_count == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (cpus > 0) ? (uint32_t)cpus : 1;
+    }
+
+    struct pwc_thread_pool *pool = calloc(1, sizeof(struct pwc_thread_pool));
+    if (!pool) {
+        fprintf(stderr, "Failed to allocate thread pool\n");
+        return NULL;
+    }
+
+    pool->job_capacity = 64;
+    pool->jobs = calloc(pool->job_capacity, sizeof(PwcJobT));
+    pool->threads = calloc(thread_count, sizeof(pthread_t));
+    if (!pool->jobs || !pool->threads) {
+        fprintf(stderr, "Failed to allocate thread pool\n");
+        free(pool->jobs);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_available, NULL);
+    pthread_cond_init(&pool->jobs_done, NULL);
+
+    for (uint32_t i = 0; i < thread_count; i++) {
+        WorkerArgsT *args = malloc(sizeof(WorkerArgsT));
+        if (!args) break;
+        args->pool = pool;
+        args->index = i;
+
+        if (pthread_create(&pool->threads[i], NULL, worker_main, args) != 0) {
+            fprintf(stderr, "Failed to create worker thread %u\n", i);
+            free(args);
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    if (pool->thread_count == 0) {
+        destroy_thread_pool(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void destroy_thread_pool(struct pwc_thread_pool *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->job_available);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint32_t i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->jobs_done);
+    pthread_cond_destroy(&pool->job_available);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->jobs);
+    free(pool);
+}
+
+bool thread_pool_submit(struct pwc_thread_pool *pool, pwc_job_fn fn, void *arg) {
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->job_count >= pool->job_capacity) {
+        uint32_t new_capacity = pool->job_capacity * 2;
+        PwcJobT *new_jobs = malloc(new_capacity * sizeof(PwcJobT));
+        if (!new_jobs) {
+            pthread_mutex_unlock(&pool->lock);
+            fprintf(stderr, "Failed to grow thread pool job queue\n");
+            return false;
+        }
+
+        // Unwrap the ring into the new array
+        for (uint32_t i = 0; i < pool->job_count; i++) {
+            new_jobs[i] = pool->jobs[(pool->job_head + i) % pool->job_capacity];
+        }
+        free(pool->jobs);
+        pool->jobs = new_jobs;
+        pool->job_capacity = new_capacity;
+        pool->job_head = 0;
+    }
+
+    uint32_t tail = (pool->job_head + pool->job_count) % pool->job_capacity;
+    pool->jobs[tail].fn = fn;
+    pool->jobs[tail].arg = arg;
+    pool->job_count++;
+    pool->jobs_in_flight++;
+
+    pthread_cond_signal(&pool->job_available);
+    pthread_mutex_unlock(&pool->lock);
+
+    return true;
+}
+
+void thread_pool_wait(struct pwc_thread_pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->jobs_in_flight > 0) {
+        pthread_cond_wait(&pool->jobs_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
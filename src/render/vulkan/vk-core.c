@@ -17,6 +17,19 @@ static bool check_device_extensions_support(struct pwc_vulkan *vulkan, VkPhysica
     uint32_t device_extensions_count = 0;
     VkBool32 swapchainExtFound = 0;
     vulkan->enabled_extension_count = 0;
+    vulkan->incremental_present = false;
+    vulkan->display_swapchain = false;
+    vulkan->memory_budget = false;
+    vulkan->external_memory_host = false;
+    vulkan->dmabuf_import = false;
+    vulkan->queue_family_foreign = false;
+    vulkan->drm_device = false;
+    vulkan->display_control = false;
+    vulkan->display_timing = false;
+    bool external_memory = false, external_memory_host = false;
+    // VK_EXT_image_drm_format_modifier and its dependencies on a 1.0 device
+    bool memory_fd = false, dma_buf = false, drm_format_modifier = false, image_format_list = false, bind_memory2 = false,
+         memory_requirements2 = false, dedicated_allocation = false, ycbcr_conversion = false, maintenance1 = false;
     memset(vulkan->extension_names, 0, sizeof(vulkan->extension_names));
     
     err = vkEnumerateDeviceExtensionProperties(physical_device, NULL, &device_extensions_count, NULL);
@@ -32,6 +45,82 @@ static bool check_device_extensions_support(struct pwc_vulkan *vulkan, VkPhysica
                 swapchainExtFound = 1;
                 vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
             };
+            // Optional: lets present pass the damaged rects to the display
+            if (!strcmp(VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME, device_extensions[i].extensionName)) {
+                vulkan->incremental_present = true;
+                vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME;
+            }
+            // Optional: positions overlay plane swapchains (VkDisplayPresentInfoKHR)
+            if (!strcmp(VK_KHR_DISPLAY_SWAPCHAIN_EXTENSION_NAME, device_extensions[i].extensionName)) {
+                vulkan->display_swapchain = true;
+                vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_DISPLAY_SWAPCHAIN_EXTENSION_NAME;
+            }
+            // Optional: heap usage and budget for workspace hibernation, queried through
+            // VK_KHR_get_physical_device_properties2
+            if (!strcmp(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, device_extensions[i].extensionName) && vulkan->get_memory_properties2) {
+                vulkan->memory_budget = true;
+                vulkan->extension_names[vulkan->enabled_extension_count++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+            }
+            if (!strcmp(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME, device_extensions[i].extensionName)) external_memory = true;
+            if (!strcmp(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME, device_extensions[i].extensionName)) external_memory_host = true;
+            if (!strcmp(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME, device_extensions[i].extensionName)) memory_fd = true;
+            if (!strcmp(VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME, device_extensions[i].extensionName)) dma_buf = true;
+            if (!strcmp(VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME, device_extensions[i].extensionName)) drm_format_modifier = true;
+            if (!strcmp(VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME, device_extensions[i].extensionName)) image_format_list = true;
+            if (!strcmp(VK_KHR_BIND_MEMORY_2_EXTENSION_NAME, device_extensions[i].extensionName)) bind_memory2 = true;
+            if (!strcmp(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, device_extensions[i].extensionName)) memory_requirements2 = true;
+            if (!strcmp(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME, device_extensions[i].extensionName)) dedicated_allocation = true;
+            if (!strcmp(VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME, device_extensions[i].extensionName)) ycbcr_conversion = true;
+            if (!strcmp(VK_KHR_MAINTENANCE_1_EXTENSION_NAME, device_extensions[i].extensionName)) maintenance1 = true;
+            // Optional: ownership of imported dmabufs is taken from whoever rendered them
+            if (!strcmp(VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME, device_extensions[i].extensionName)) {
+                vulkan->queue_family_foreign = true;
+            }
+            // Optional: vblank counters of display swapchains, for presentation feedback
+            if (!strcmp(VK_EXT_DISPLAY_CONTROL_EXTENSION_NAME, device_extensions[i].extensionName) && vulkan->get_surface_capabilities2) {
+                vulkan->display_control = true;
+                vulkan->extension_names[vulkan->enabled_extension_count++] = VK_EXT_DISPLAY_CONTROL_EXTENSION_NAME;
+            }
+            // Optional: when presents actually reached the display
+            if (!strcmp(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME, device_extensions[i].extensionName)) {
+                vulkan->display_timing = true;
+                vulkan->extension_names[vulkan->enabled_extension_count++] = VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME;
+            }
+            // Optional: the DRM node behind the device, for dmabuf feedback
+            if (!strcmp(VK_EXT_PHYSICAL_DEVICE_DRM_EXTENSION_NAME, device_extensions[i].extensionName) && vulkan->get_properties2) {
+                vulkan->drm_device = true;
+                vulkan->extension_names[vulkan->enabled_extension_count++] = VK_EXT_PHYSICAL_DEVICE_DRM_EXTENSION_NAME;
+            }
+        }
+
+        // Optional: client shm memory is copied from without staging. Needs VK_KHR_external_memory
+        // on a 1.0 device and properties2 for the import alignment
+        if (external_memory && external_memory_host && vulkan->get_properties2) {
+            vulkan->external_memory_host = true;
+            vulkan->extension_names[vulkan->enabled_extension_count++] = VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME;
+        }
+        // Optional: client dmabufs are sampled in place. Modifiers are queried through properties2
+        if (external_memory && memory_fd && dma_buf && drm_format_modifier && image_format_list && bind_memory2 &&
+            memory_requirements2 && dedicated_allocation && ycbcr_conversion && maintenance1 && vulkan->get_format_properties2 &&
+            vulkan->get_image_format_properties2) {
+            vulkan->dmabuf_import = true;
+            vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME;
+            vulkan->extension_names[vulkan->enabled_extension_count++] = VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME;
+            vulkan->extension_names[vulkan->enabled_extension_count++] = VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME;
+            vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME;
+            vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_BIND_MEMORY_2_EXTENSION_NAME;
+            vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME;
+            vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME;
+            vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME;
+            vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_MAINTENANCE_1_EXTENSION_NAME;
+            if (vulkan->queue_family_foreign) {
+                vulkan->extension_names[vulkan->enabled_extension_count++] = VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME;
+            }
+        } else {
+            vulkan->queue_family_foreign = false;
+        }
+        if (vulkan->external_memory_host || vulkan->dmabuf_import) {
+            vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME;
         }
 
         assert(vulkan->enabled_extension_count < 64);
@@ -83,8 +172,8 @@ void pick_physical_device(struct pwc_vulkan *vulkan) {
     assert(!err);
 
     // Most suitable device
-    VkPhysicalDevice device;
-    uint32_t device_score;
+    VkPhysicalDevice device = VK_NULL_HANDLE;
+    uint32_t device_score = 0;
     for (int i = 0; i < deviceCount; i++) {
         uint32_t score = rate_device_suitability(devices[i], vulkan);
         if (score > device_score) {
@@ -99,6 +188,8 @@ void pick_physical_device(struct pwc_vulkan *vulkan) {
     }
 
     vulkan->physicalDevice = device;
+    // Rating enumerated extensions of every device, keep the list of the chosen one
+    check_device_extensions_support(vulkan, device);
 
     // Get properties and queueFamilies
     vkGetPhysicalDeviceProperties(vulkan->physicalDevice, &vulkan->gpu_props);
@@ -127,7 +218,7 @@ void pick_physical_device(struct pwc_vulkan *vulkan) {
 void create_logical_device(struct pwc_vulkan *vulkan) {
     VkResult U_ASSERT_ONLY err;
     float queue_priorities[1] = {0.0};
-    VkDeviceQueueCreateInfo queues[2];
+    VkDeviceQueueCreateInfo queues[4];
     queues[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     queues[0].pNext = NULL;
     queues[0].queueFamilyIndex = vulkan->graphics_queue_family_index;
@@ -159,21 +250,126 @@ void create_logical_device(struct pwc_vulkan *vulkan) {
         device.queueCreateInfoCount = 2;
     }
 
+    // Transfer queue, the present family is never transfer only
+    if (vulkan->separate_transfer_queue) {
+        VkDeviceQueueCreateInfo *transfer = &queues[device.queueCreateInfoCount++];
+        *transfer = queues[0];
+        transfer->queueFamilyIndex = vulkan->transfer_queue_family_index;
+    }
+
+    // Compute queue, may share the family picked for transfers
+    bool compute_is_transfer = vulkan->compute_queue_family_index == vulkan->transfer_queue_family_index;
+    if (vulkan->separate_compute_queue && !compute_is_transfer) {
+        VkDeviceQueueCreateInfo *compute = &queues[device.queueCreateInfoCount++];
+        *compute = queues[0];
+        compute->queueFamilyIndex = vulkan->compute_queue_family_index;
+    }
+
     err = vkCreateDevice(vulkan->physicalDevice, &device, NULL, &vulkan->device);
     assert(!err);
+
+    // Imported host pointers and sizes have to be multiples of the alignment
+    if (vulkan->external_memory_host) {
+        VkPhysicalDeviceExternalMemoryHostPropertiesEXT host_props = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT};
+        VkPhysicalDeviceProperties2 props = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &host_props};
+        vulkan->get_properties2(vulkan->physicalDevice, &props);
+        vulkan->host_pointer_alignment = host_props.minImportedHostPointerAlignment;
+
+        vulkan->get_memory_host_pointer_properties = (PFN_vkGetMemoryHostPointerPropertiesEXT)vkGetDeviceProcAddr(
+            vulkan->device, "vkGetMemoryHostPointerPropertiesEXT");
+        if (!vulkan->get_memory_host_pointer_properties) vulkan->external_memory_host = false;
+    }
+
+    if (vulkan->dmabuf_import) {
+        vulkan->get_memory_fd_properties = (PFN_vkGetMemoryFdPropertiesKHR)vkGetDeviceProcAddr(vulkan->device, "vkGetMemoryFdPropertiesKHR");
+        if (!vulkan->get_memory_fd_properties) vulkan->dmabuf_import = false;
+    }
+
+    if (vulkan->display_control) {
+        vulkan->get_swapchain_counter = (PFN_vkGetSwapchainCounterEXT)vkGetDeviceProcAddr(vulkan->device, "vkGetSwapchainCounterEXT");
+        if (!vulkan->get_swapchain_counter) vulkan->display_control = false;
+    }
+    if (vulkan->display_timing) {
+        vulkan->get_past_presentation_timing = (PFN_vkGetPastPresentationTimingGOOGLE)vkGetDeviceProcAddr(
+            vulkan->device, "vkGetPastPresentationTimingGOOGLE");
+        vulkan->get_refresh_cycle_duration = (PFN_vkGetRefreshCycleDurationGOOGLE)vkGetDeviceProcAddr(
+            vulkan->device, "vkGetRefreshCycleDurationGOOGLE");
+        if (!vulkan->get_past_presentation_timing || !vulkan->get_refresh_cycle_duration) vulkan->display_timing = false;
+    }
+
+    // dmabuf feedback names the render node clients should allocate on
+    if (vulkan->drm_device) {
+        VkPhysicalDeviceDrmPropertiesEXT drm_props = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DRM_PROPERTIES_EXT};
+        VkPhysicalDeviceProperties2 props = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &drm_props};
+        vulkan->get_properties2(vulkan->physicalDevice, &props);
+        if (drm_props.hasRender) {
+            vulkan->drm_render_major = drm_props.renderMajor;
+            vulkan->drm_render_minor = drm_props.renderMinor;
+        } else if (drm_props.hasPrimary) {
+            vulkan->drm_render_major = drm_props.primaryMajor;
+            vulkan->drm_render_minor = drm_props.primaryMinor;
+        } else {
+            vulkan->drm_device = false;
+        }
+    }
+
+    vkGetDeviceQueue(vulkan->device, vulkan->graphics_queue_family_index, 0, &vulkan->graphics_queue);
+    if (!vulkan->separate_present_queue) {
+        vulkan->present_queue = vulkan->graphics_queue;
+    } else {
+        vkGetDeviceQueue(vulkan->device, vulkan->present_queue_family_index, 0, &vulkan->present_queue);
+    }
+    if (!vulkan->separate_transfer_queue) {
+        vulkan->transfer_queue = vulkan->graphics_queue;
+    } else {
+        vkGetDeviceQueue(vulkan->device, vulkan->transfer_queue_family_index, 0, &vulkan->transfer_queue);
+    }
+    if (!vulkan->separate_compute_queue) {
+        vulkan->compute_queue = vulkan->graphics_queue;
+    } else {
+        vkGetDeviceQueue(vulkan->device, vulkan->compute_queue_family_index, 0, &vulkan->compute_queue);
+    }
+    vkGetPhysicalDeviceMemoryProperties(vulkan->physicalDevice, &vulkan->memory_properties);
+}
+
+uint32_t find_memory_type(struct pwc_vulkan *vulkan, uint32_t type_bits, VkMemoryPropertyFlags properties) {
+    for (uint32_t i = 0; i < vulkan->memory_properties.memoryTypeCount; i++) {
+        if ((type_bits & (1u << i)) && (vulkan->memory_properties.memoryTypes[i].propertyFlags & properties) == properties) return i;
+    }
+    return UINT32_MAX;
+}
+
+bool query_memory_budget(struct pwc_vulkan *vulkan, VkDeviceSize *usage, VkDeviceSize *budget) {
+    if (!vulkan->memory_budget) return false;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+    VkPhysicalDeviceMemoryProperties2 props = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+        .pNext = &budget_props,
+    };
+    vulkan->get_memory_properties2(vulkan->physicalDevice, &props);
+
+    *usage = 0;
+    *budget = 0;
+    for (uint32_t i = 0; i < props.memoryProperties.memoryHeapCount; i++) {
+        if (!(props.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) continue;
+        *usage += budget_props.heapUsage[i];
+        *budget += budget_props.heapBudget[i];
+    }
+    return *budget > 0;
 }
 
 // ==============================================================================================
 //                                             SURFACE
 // ==============================================================================================
 
-void create_display_surface(struct pwc_vulkan *vulkan) {
+// Picks the display's first mode and a free plane that can show it, then creates the
+// surface. Returns false if the display can't be used (no mode or no free plane)
+bool create_display_surface(struct pwc_vulkan *vulkan, struct pwc_output *output) {
     VkResult U_ASSERT_ONLY err;
-    uint32_t display_count;
     uint32_t mode_count;
     uint32_t plane_count;
-    VkDisplayPropertiesKHR display_props;
-    VkDisplayKHR display;
+    VkDisplayKHR display = output->display;
     VkDisplayModePropertiesKHR mode_props;
     VkDisplayPlanePropertiesKHR *plane_props;
     VkBool32 found_plane = VK_FALSE;
@@ -181,20 +377,13 @@ void create_display_surface(struct pwc_vulkan *vulkan) {
     VkExtent2D image_extent;
     VkDisplaySurfaceCreateInfoKHR create_info;
 
-    // Get first display
-    display_count = 1;
-    err = vkGetPhysicalDeviceDisplayPropertiesKHR(vulkan->physicalDevice, &display_count, &display_props);
-    assert(!err || (err == VK_INCOMPLETE));
-
-    display = display_props.display;
-
     // Get the first mode of the display
     err = vkGetDisplayModePropertiesKHR(vulkan->physicalDevice, display, &mode_count, NULL);
     assert(!err);
         
     if (mode_count == 0) {
-    	fprintf(stderr, "Cannot find any mode for the display\n");
-	    exit(EXIT_FAILURE);
+        fprintf(stderr, "Cannot find any mode for display %u\n", output->index);
+        return false;
     }
 
     mode_count = 1;
@@ -204,7 +393,7 @@ void create_display_surface(struct pwc_vulkan *vulkan) {
     // Get the list of planes
     if (vkGetPhysicalDeviceDisplayPlanePropertiesKHR(vulkan->physicalDevice, &plane_count, NULL) != VK_SUCCESS && plane_count == 0) {
         fprintf(stderr, "Cannot find any plane\n");
-        exit(EXIT_FAILURE);
+        return false;
     }
 
     plane_props = malloc(sizeof(VkDisplayPlanePropertiesKHR) * plane_count);
@@ -218,6 +407,14 @@ void create_display_surface(struct pwc_vulkan *vulkan) {
         uint32_t supported_count;
         VkDisplayKHR *supported_displays;
 
+        // claimed_planes is a 64 bit mask
+        if (plane_index >= 64) break;
+
+        // Skip planes already scanning out for another output
+        if (vulkan->claimed_planes & (1ull << plane_index)) {
+            continue;
+        }
+
         // Skip planes that are bound to a different display
         if ((plane_props[plane_index].currentDisplay != VK_NULL_HANDLE) && (plane_props[plane_index].currentDisplay != display)) {
             continue;
@@ -251,8 +448,9 @@ void create_display_surface(struct pwc_vulkan *vulkan) {
     }
 
     if (!found_plane) {
-        fprintf(stderr, "Failed to find a plane compatible with the display\n");
-        exit(EXIT_FAILURE);
+        fprintf(stderr, "Failed to find a plane compatible with display %u\n", output->index);
+        free(plane_props);
+        return false;
     }
 
     VkDisplayPlaneCapabilitiesKHR plane_capabilities;
@@ -265,7 +463,7 @@ void create_display_surface(struct pwc_vulkan *vulkan) {
         VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_BIT_KHR,
         VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_PREMULTIPLIED_BIT_KHR,
     };
-    for (uint32_t i = 0; i < sizeof(alphaModes); i++) {
+    for (uint32_t i = 0; i < ARRAY_SIZE(alphaModes); i++) {
         if (plane_capabilities.supportedAlpha & alphaModes[i]) {
             alphaMode = alphaModes[i];
             break;
@@ -285,49 +483,105 @@ void create_display_surface(struct pwc_vulkan *vulkan) {
     create_info.globalAlpha = 1.0f;
     create_info.imageExtent = image_extent;
 
+    // Remaining planes of this display are handed out by the plane allocator
+    output->display_mode = mode_props.displayMode;
+    output->display_extent = image_extent;
+    output->refresh_rate = mode_props.parameters.refreshRate;
+    output->primary_plane_index = plane_index;
+    output->primary_plane_stack_index = plane_props[plane_index].currentStackIndex;
+    vulkan->claimed_planes |= 1ull << plane_index;
+
     free(plane_props);
 
-    err = vkCreateDisplayPlaneSurfaceKHR(vulkan->instance, &create_info, NULL, &vulkan->surface);
+    err = vkCreateDisplayPlaneSurfaceKHR(vulkan->instance, &create_info, NULL, &output->surface);
+    assert(!err);
+    return true;
+}
+
+// One output per connected display, up to MAX_OUTPUTS. Only surfaces are created here,
+// swapchains need the device which is created with the first one (init_output())
+void create_outputs(struct pwc_vulkan *vulkan) {
+    VkResult U_ASSERT_ONLY err;
+    uint32_t display_count = 0;
+
+    err = vkGetPhysicalDeviceDisplayPropertiesKHR(vulkan->physicalDevice, &display_count, NULL);
     assert(!err);
+
+    if (display_count == 0) {
+        fprintf(stderr, "Cannot find any display\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkDisplayPropertiesKHR *display_props = malloc(sizeof(VkDisplayPropertiesKHR) * display_count);
+    assert(display_props);
+
+    err = vkGetPhysicalDeviceDisplayPropertiesKHR(vulkan->physicalDevice, &display_count, display_props);
+    assert(!err || (err == VK_INCOMPLETE));
+
+    for (uint32_t i = 0; i < display_count && vulkan->output_count < MAX_OUTPUTS; i++) {
+        struct pwc_output *output = &vulkan->outputs[vulkan->output_count];
+        memset(output, 0, sizeof(struct pwc_output));
+        output->index = vulkan->output_count;
+        output->display = display_props[i].display;
+        output->physical_size = display_props[i].physicalDimensions;
+
+        if (!create_display_surface(vulkan, output)) continue;
+
+        printf("Output %u: %s, %ux%u@%u.%03uHz\n", output->index, display_props[i].displayName ? display_props[i].displayName : "unnamed",
+               output->display_extent.width, output->display_extent.height, output->refresh_rate / 1000, output->refresh_rate % 1000);
+        vulkan->output_count++;
+    }
+
+    free(display_props);
+
+    if (vulkan->output_count == 0) {
+        fprintf(stderr, "Failed to find a usable display\n");
+        exit(EXIT_FAILURE);
+    }
 }
 
 // ==============================================================================================
 //                                            SWAPCHAIN
 // ==============================================================================================
 
-SwapChainSupportDetails query_swap_chain_support(struct pwc_vulkan *vulkan) {
+SwapChainSupportDetails query_swap_chain_support(struct pwc_vulkan *vulkan, struct pwc_output *output) {
     SwapChainSupportDetails details;
 
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vulkan->physicalDevice, vulkan->surface, &details.capabilities);
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vulkan->physicalDevice, output->surface, &details.capabilities);
 
+    // Heap allocated: the arrays outlive this function, free with free_swap_chain_support()
     uint32_t format_count;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(vulkan->physicalDevice, vulkan->surface, &format_count, NULL);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(vulkan->physicalDevice, output->surface, &format_count, NULL);
     details.format_count = format_count;
-    VkSurfaceFormatKHR formats[format_count];
-    details.formats = formats;
+    details.formats = malloc(sizeof(VkSurfaceFormatKHR) * (format_count ? format_count : 1));
     if (format_count != 0) {
-        vkGetPhysicalDeviceSurfaceFormatsKHR(vulkan->physicalDevice, vulkan->surface, &format_count, details.formats);
+        vkGetPhysicalDeviceSurfaceFormatsKHR(vulkan->physicalDevice, output->surface, &format_count, details.formats);
     }
 
     uint32_t present_count;
-    vkGetPhysicalDeviceSurfacePresentModesKHR(vulkan->physicalDevice, vulkan->surface, &present_count, NULL);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(vulkan->physicalDevice, output->surface, &present_count, NULL);
     details.present_count = present_count;
-    VkPresentModeKHR present_modes[present_count];
-    details.present_modes = present_modes;
+    details.present_modes = malloc(sizeof(VkPresentModeKHR) * (present_count ? present_count : 1));
     if (present_count != 0) {
-        vkGetPhysicalDeviceSurfacePresentModesKHR(vulkan->physicalDevice, vulkan->surface, &present_count, details.present_modes);
+        vkGetPhysicalDeviceSurfacePresentModesKHR(vulkan->physicalDevice, output->surface, &present_count, details.present_modes);
     }
 
     // Check if supports present
     VkBool32 *supports_present = (VkBool32 *)malloc(vulkan->queue_family_count * sizeof(VkBool32));
     details.supports_present = supports_present;
     for (uint32_t i = 0; i < vulkan->queue_family_count; i++) {
-        vkGetPhysicalDeviceSurfaceSupportKHR(vulkan->physicalDevice, i, vulkan->surface, &supports_present[i]);
+        vkGetPhysicalDeviceSurfaceSupportKHR(vulkan->physicalDevice, i, output->surface, &supports_present[i]);
     }
 
     return details;
 }
 
+void free_swap_chain_support(SwapChainSupportDetails *details) {
+    free(details->formats);
+    free(details->present_modes);
+    free(details->supports_present);
+}
+
 VkSurfaceFormatKHR choose_swap_surface_mode(const VkSurfaceFormatKHR *surface_formats, uint32_t count) {
     // Prefer non-SRGB formats
     for (uint32_t i = 0; i < count; i++) {
@@ -454,79 +708,143 @@ QueueFamilyData get_queue_family_data(struct pwc_vulkan *vulkan, VkBool32 *suppo
         exit(EXIT_FAILURE);
     }
 
+    // Uploads go to a transfer only family (the copy engine) when there is one, so they run
+    // next to composition. A compute capable one is the fallback, else the graphics queue
+    uint32_t transfer_queue_family_index = graphics_queue_family_index;
+    for (uint32_t i = 0; i < vulkan->queue_family_count; i++) {
+        VkQueueFlags flags = vulkan->queue_props[i].queueFlags;
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) continue;
+        if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+            transfer_queue_family_index = i;
+            break;
+        }
+        if (transfer_queue_family_index == graphics_queue_family_index) transfer_queue_family_index = i;
+    }
+
+    // Effects go to an async compute family, running next to raster work on the graphics queue
+    uint32_t compute_queue_family_index = graphics_queue_family_index;
+    for (uint32_t i = 0; i < vulkan->queue_family_count; i++) {
+        VkQueueFlags flags = vulkan->queue_props[i].queueFlags;
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            compute_queue_family_index = i;
+            break;
+        }
+    }
+
     data.graphics_queue_family_index = graphics_queue_family_index;
     data.present_queue_family_index = present_queue_family_index;
+    data.transfer_queue_family_index = transfer_queue_family_index;
+    data.compute_queue_family_index = compute_queue_family_index;
     data.separate_present_queue = (graphics_queue_family_index != present_queue_family_index);
+    data.separate_transfer_queue = (graphics_queue_family_index != transfer_queue_family_index);
+    data.separate_compute_queue = (graphics_queue_family_index != compute_queue_family_index);
 
     return data;
 }
 
-void create_swapchain(struct pwc_vulkan *vulkan) {
+// Creates a swapchain for output->surface. If output->swapchain is set it is passed as
+// oldSwapchain, the caller is responsible for retiring it (see recreate_swapchain)
+void create_swapchain(struct pwc_vulkan *vulkan, struct pwc_output *output) {
     VkResult U_ASSERT_ONLY err;
-    SwapChainSupportDetails swapchain_details = query_swap_chain_support(vulkan);
+    SwapChainSupportDetails swapchain_details = query_swap_chain_support(vulkan, output);
     
     VkSurfaceFormatKHR surface_format = choose_swap_surface_mode(swapchain_details.formats, swapchain_details.format_count);
+    // Outputs after the first must match the shared render pass (checked by init_output())
+    for (uint32_t i = 0; i < swapchain_details.format_count; i++) {
+        if (vulkan->render_pass_format != VK_FORMAT_UNDEFINED && swapchain_details.formats[i].format == vulkan->render_pass_format) {
+            surface_format = swapchain_details.formats[i];
+            break;
+        }
+    }
     VkPresentModeKHR present_mode = choose_swap_present_mode(swapchain_details.present_count, swapchain_details.present_modes);
     VkExtent2D extent = choose_swap_surface_extent(swapchain_details.capabilities);
     VkCompositeAlphaFlagBitsKHR composite_alpha = choose_swap_alpha_mode(swapchain_details.capabilities);
     VkSurfaceTransformFlagsKHR pre_transform = choose_swap_pre_transform(swapchain_details.capabilities);
     uint32_t image_count = get_swap_image_count(swapchain_details.capabilities);
+    // Transfers let the cursor overlay save and restore what it covers
+    VkImageUsageFlags transfer = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    output->swapchain_transfer = (swapchain_details.capabilities.supportedUsageFlags & transfer) == transfer;
 
     VkSwapchainCreateInfoKHR swapchain_ci = {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-        .surface = vulkan->surface,
+        .surface = output->surface,
         .minImageCount = image_count,
         .imageFormat = surface_format.format,
         .imageColorSpace = surface_format.colorSpace,
         .imageExtent = extent,
         .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (output->swapchain_transfer ? transfer : 0),
         .presentMode = present_mode,
         .pQueueFamilyIndices = NULL,
         .queueFamilyIndexCount = 0,
         .clipped = VK_FALSE, // Can't clip when we took all display for render
         .compositeAlpha = composite_alpha,
         .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        .oldSwapchain = VK_NULL_HANDLE,
+        .oldSwapchain = output->swapchain,
         .preTransform = pre_transform
     };
 
-    QueueFamilyData queue_family_data = get_queue_family_data(vulkan, swapchain_details.supports_present);
-    vulkan->present_queue_family_index = queue_family_data.present_queue_family_index;
-    vulkan->graphics_queue_family_index = queue_family_data.graphics_queue_family_index;
-    vulkan->separate_present_queue = queue_family_data.separate_present_queue;
+    // Device is created together with the first swapchain, recreation and other outputs keep it
+    if (vulkan->device == VK_NULL_HANDLE) {
+        QueueFamilyData queue_family_data = get_queue_family_data(vulkan, swapchain_details.supports_present);
+        vulkan->present_queue_family_index = queue_family_data.present_queue_family_index;
+        vulkan->graphics_queue_family_index = queue_family_data.graphics_queue_family_index;
+        vulkan->separate_present_queue = queue_family_data.separate_present_queue;
+        vulkan->transfer_queue_family_index = queue_family_data.transfer_queue_family_index;
+        vulkan->separate_transfer_queue = queue_family_data.separate_transfer_queue;
+        vulkan->compute_queue_family_index = queue_family_data.compute_queue_family_index;
+        vulkan->separate_compute_queue = queue_family_data.separate_compute_queue;
+
+        // if (vulkan->separate_present_queue) {
+        //     swapchain_ci.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+        // } else {
+        //     swapchain_ci.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        // }
+
+        create_logical_device(vulkan);
+    }
 
-    // if (vulkan->separate_present_queue) {
-    //     swapchain_ci.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-    // } else {
-    //     swapchain_ci.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    // }
+    free_swap_chain_support(&swapchain_details);
 
-    create_logical_device(vulkan);
+    // Counted vblanks give presentation feedback its sequence numbers
+    VkSwapchainCounterCreateInfoEXT counter_ci = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_COUNTER_CREATE_INFO_EXT,
+        .surfaceCounters = VK_SURFACE_COUNTER_VBLANK_BIT_EXT,
+    };
+    output->vblank_counter = false;
+    if (vulkan->display_control) {
+        VkSurfaceCapabilities2EXT caps = {.sType = VK_STRUCTURE_TYPE_SURFACE_CAPABILITIES_2_EXT};
+        if (vulkan->get_surface_capabilities2(vulkan->physicalDevice, output->surface, &caps) == VK_SUCCESS &&
+            (caps.supportedSurfaceCounters & VK_SURFACE_COUNTER_VBLANK_BIT_EXT)) {
+            swapchain_ci.pNext = &counter_ci;
+            output->vblank_counter = true;
+        }
+    }
 
-    err = vkCreateSwapchainKHR(vulkan->device, &swapchain_ci, NULL, &vulkan->swapchain);
+    err = vkCreateSwapchainKHR(vulkan->device, &swapchain_ci, NULL, &output->swapchain);
     assert(!err);
 
-    vkGetSwapchainImagesKHR(vulkan->device, vulkan->swapchain, &image_count, NULL);
-    vulkan->swapchain_images = (VkImage*)malloc(sizeof(VkImage) * image_count);;
+    vkGetSwapchainImagesKHR(vulkan->device, output->swapchain, &image_count, NULL);
+    output->swapchain_images = (VkImage*)malloc(sizeof(VkImage) * image_count);;
 
-    vkGetSwapchainImagesKHR(vulkan->device, vulkan->swapchain, &image_count, vulkan->swapchain_images);
-    vulkan->swapchain_image_count = image_count;
+    vkGetSwapchainImagesKHR(vulkan->device, output->swapchain, &image_count, output->swapchain_images);
+    output->swapchain_image_count = image_count;
     
-    vulkan->swapchain_extent = extent;
-    vulkan->swapchain_image_format = surface_format.format;
+    output->swapchain_extent = extent;
+    output->swapchain_image_format = surface_format.format;
+    output->swapchain_serial = ++vulkan->swapchain_serial;
 }
 
-void create_image_views(struct pwc_vulkan *vulkan) {
+void create_image_views(struct pwc_vulkan *vulkan, struct pwc_output *output) {
     VkResult U_ASSERT_ONLY err;
-    vulkan->swapchain_image_views = (VkImageView*)malloc(sizeof(VkImageView) * vulkan->swapchain_image_count);
+    output->swapchain_image_views = (VkImageView*)malloc(sizeof(VkImageView) * output->swapchain_image_count);
 
-    for (uint32_t i = 0; i < vulkan->swapchain_image_count; i++) {
+    for (uint32_t i = 0; i < output->swapchain_image_count; i++) {
         VkImageViewCreateInfo create_info = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-            .image = vulkan->swapchain_images[i],
+            .image = output->swapchain_images[i],
             .viewType = VK_IMAGE_VIEW_TYPE_2D,
-            .format = vulkan->swapchain_image_format,
+            .format = output->swapchain_image_format,
             .components = {
                 VK_COMPONENT_SWIZZLE_IDENTITY,
                 VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -542,8 +860,347 @@ void create_image_views(struct pwc_vulkan *vulkan) {
             },
         };
 
-        err = vkCreateImageView(vulkan->device, &create_info, NULL, &vulkan->swapchain_image_views[i]);
+        err = vkCreateImageView(vulkan->device, &create_info, NULL, &output->swapchain_image_views[i]);
+        assert(!err);
+    }
+}
+
+static VkRenderPass create_color_render_pass(struct pwc_vulkan *vulkan, VkFormat format, VkAttachmentLoadOp load_op,
+                                             VkImageLayout initial_layout, VkImageLayout final_layout) {
+    VkResult U_ASSERT_ONLY err;
+    VkRenderPass render_pass;
+
+    const VkAttachmentDescription color_attachment = {
+        .format = format,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = load_op,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = initial_layout,
+        .finalLayout = final_layout,
+    };
+    const VkAttachmentReference color_reference = {
+        .attachment = 0,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    };
+    const VkSubpassDescription subpass = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color_reference,
+    };
+    // Image layout transition waits for the acquire semaphore (signaled at COLOR_ATTACHMENT_OUTPUT)
+    const VkSubpassDependency dependency = {
+        .srcSubpass = VK_SUBPASS_EXTERNAL,
+        .dstSubpass = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT,
+    };
+    const VkRenderPassCreateInfo rp_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &color_attachment,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 1,
+        .pDependencies = &dependency,
+    };
+
+    err = vkCreateRenderPass(vulkan->device, &rp_info, NULL, &render_pass);
+    assert(!err);
+    return render_pass;
+}
+
+// The passes differ only in load op and layouts, so they are compatible: the same
+// framebuffers, pipelines and cached secondaries work with any of them. Created once, for
+// the first output's format; every other output has to use the same format
+void create_render_pass(struct pwc_vulkan *vulkan, VkFormat format) {
+    // Full redraw: UNDEFINED -> PRESENT_SRC, the pass clears so old contents don't matter
+    vulkan->render_pass = create_color_render_pass(vulkan, format, VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                                   VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    // Partial redraw: the image keeps what was presented from it last time (buffer age)
+    vulkan->render_pass_load = create_color_render_pass(vulkan, format, VK_ATTACHMENT_LOAD_OP_LOAD,
+                                                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    // Offscreen: into effect images, which stay in GENERAL
+    vulkan->render_pass_offscreen = create_color_render_pass(vulkan, format, VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                                             VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    vulkan->render_pass_format = format;
+}
+
+void create_framebuffers(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    VkResult U_ASSERT_ONLY err;
+    output->framebuffers = (VkFramebuffer*)malloc(sizeof(VkFramebuffer) * output->swapchain_image_count);
+
+    for (uint32_t i = 0; i < output->swapchain_image_count; i++) {
+        VkFramebufferCreateInfo fb_info = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass = vulkan->render_pass,
+            .attachmentCount = 1,
+            .pAttachments = &output->swapchain_image_views[i],
+            .width = output->swapchain_extent.width,
+            .height = output->swapchain_extent.height,
+            .layers = 1,
+        };
+        err = vkCreateFramebuffer(vulkan->device, &fb_info, NULL, &output->framebuffers[i]);
+        assert(!err);
+    }
+}
+
+void create_image_semaphores(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    VkResult U_ASSERT_ONLY err;
+    VkSemaphoreCreateInfo semaphore_ci = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+
+    output->draw_complete_semaphores = (VkSemaphore*)malloc(sizeof(VkSemaphore) * output->swapchain_image_count);
+    for (uint32_t i = 0; i < output->swapchain_image_count; i++) {
+        err = vkCreateSemaphore(vulkan->device, &semaphore_ci, NULL, &output->draw_complete_semaphores[i]);
+        assert(!err);
+    }
+}
+
+// One primary command buffer, fence and acquire semaphore per FRAME_LAG slot of the output
+void create_submission_resources(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    VkResult U_ASSERT_ONLY err;
+
+    // Shared by every output
+    if (vulkan->cmd_pool == VK_NULL_HANDLE) {
+        VkCommandPoolCreateInfo pool_ci = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .queueFamilyIndex = vulkan->graphics_queue_family_index,
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,  // Allow individual resets
+        };
+        err = vkCreateCommandPool(vulkan->device, &pool_ci, NULL, &vulkan->cmd_pool);
+        assert(!err);
+    }
+
+    VkCommandBufferAllocateInfo alloc_ci = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = vulkan->cmd_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    // Signaled, so the first wait on every slot returns immediately
+    VkFenceCreateInfo fence_ci = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+    };
+    VkSemaphoreCreateInfo semaphore_ci = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+
+    for (int i = 0; i < FRAME_LAG; i++) {
+        SubmissionResourcesT *submission = &output->submission_resources[i];
+        err = vkAllocateCommandBuffers(vulkan->device, &alloc_ci, &submission->cmd);
+        assert(!err);
+        err = vkCreateFence(vulkan->device, &fence_ci, NULL, &submission->fence);
+        assert(!err);
+        err = vkCreateSemaphore(vulkan->device, &semaphore_ci, NULL, &submission->image_acquired_semaphore);
+        assert(!err);
+        submission->serial = 0;
+    }
+}
+
+// ==============================================================================================
+//                                      SWAPCHAIN LIFECYCLE
+// ==============================================================================================
+
+static void destroy_retired_swapchain(struct pwc_vulkan *vulkan, RetiredSwapchainT *retired) {
+    for (uint32_t i = 0; i < retired->image_count; i++) {
+        if (retired->framebuffers) vkDestroyFramebuffer(vulkan->device, retired->framebuffers[i], NULL);
+        if (retired->image_views) vkDestroyImageView(vulkan->device, retired->image_views[i], NULL);
+        if (retired->draw_complete_semaphores) vkDestroySemaphore(vulkan->device, retired->draw_complete_semaphores[i], NULL);
+    }
+    free(retired->framebuffers);
+    free(retired->image_views);
+    free(retired->draw_complete_semaphores);
+    free(retired->images);
+
+    if (retired->swapchain) vkDestroySwapchainKHR(vulkan->device, retired->swapchain, NULL);
+    // Surface must outlive every swapchain created from it
+    if (retired->surface) vkDestroySurfaceKHR(vulkan->instance, retired->surface, NULL);
+}
+
+void release_retired_swapchains(struct pwc_vulkan *vulkan, struct pwc_output *output, bool force) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < output->retired_swapchain_count; i++) {
+        RetiredSwapchainT *retired = &output->retired_swapchains[i];
+        if (force || retired->retire_serial <= output->completed_serial) {
+            destroy_retired_swapchain(vulkan, retired);
+        } else {
+            output->retired_swapchains[kept++] = *retired;
+        }
+    }
+    output->retired_swapchain_count = kept;
+}
+
+// Called once the fence of the output's frame with this serial was seen signaled
+void swapchain_frame_completed(struct pwc_vulkan *vulkan, struct pwc_output *output, uint64_t serial) {
+    if (serial > output->completed_serial) output->completed_serial = serial;
+    if (output->retired_swapchain_count > 0) release_retired_swapchains(vulkan, output, false);
+}
+
+void poll_frames_completed(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    for (int i = 0; i < FRAME_LAG; i++) {
+        SubmissionResourcesT *submission = &output->submission_resources[i];
+        if (!submission->fence) continue;
+        if (vkGetFenceStatus(vulkan->device, submission->fence) == VK_SUCCESS) {
+            swapchain_frame_completed(vulkan, output, submission->serial);
+        }
+    }
+}
+
+// Moves the per-image objects of the output's swapchain into its retired list.
+// With replace_surface the surface goes too and the next swapchain has no oldSwapchain.
+// Returns false if the list is still full, recreating faster than frames complete
+static bool retire_swapchain(struct pwc_vulkan *vulkan, struct pwc_output *output, bool replace_surface) {
+    if (output->retired_swapchain_count >= MAX_RETIRED_SWAPCHAINS) {
+        poll_frames_completed(vulkan, output);
+        if (output->retired_swapchain_count >= MAX_RETIRED_SWAPCHAINS) return false;
+    }
+
+    RetiredSwapchainT *retired = &output->retired_swapchains[output->retired_swapchain_count++];
+    *retired = (RetiredSwapchainT){
+        .swapchain = output->swapchain,
+        .surface = replace_surface ? output->surface : VK_NULL_HANDLE,
+        .image_count = output->swapchain_image_count,
+        .images = output->swapchain_images,
+        .image_views = output->swapchain_image_views,
+        .framebuffers = output->framebuffers,
+        .draw_complete_semaphores = output->draw_complete_semaphores,
+        .retire_serial = output->frame_serial,
+    };
+
+    output->swapchain_images = NULL;
+    output->swapchain_image_views = NULL;
+    output->framebuffers = NULL;
+    output->draw_complete_semaphores = NULL;
+    output->swapchain_image_count = 0;
+    if (replace_surface) {
+        output->swapchain = VK_NULL_HANDLE;
+        output->surface = VK_NULL_HANDLE;
+        // The new surface may pick the same plane again
+        vulkan->claimed_planes &= ~(1ull << output->primary_plane_index);
+    }
+    // Otherwise output->swapchain stays set so create_swapchain() passes it as oldSwapchain
+    return true;
+}
+
+// Rebuilds only what depends on the swapchain images. The shared render pass (and everything
+// compatible with it: pipelines, cached secondaries) survives, the format never changes
+static void rebuild_swapchain_resources(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    create_swapchain(vulkan, output);
+    create_image_views(vulkan, output);
+    create_framebuffers(vulkan, output);
+    create_image_semaphores(vulkan, output);
+
+    output->swapchain_out_of_date = false;
+    output->swapchain_ready = true;
+}
+
+// OUT_OF_DATE / SUBOPTIMAL / resize: new swapchain with oldSwapchain, old one retired lazily
+bool recreate_swapchain(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    // Surface was lost and couldn't be replaced yet (display gone, or its retirement deferred)
+    if (output->surface == VK_NULL_HANDLE || output->surface_lost) return recreate_display_surface(vulkan, output);
+
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vulkan->physicalDevice, output->surface, &capabilities);
+
+    // Zero sized surface (display off): keep the old swapchain and try again later
+    if (capabilities.currentExtent.width == 0 || capabilities.currentExtent.height == 0) {
+        output->swapchain_ready = false;
+        return true;
+    }
+
+    if (!retire_swapchain(vulkan, output, false)) return false;
+    rebuild_swapchain_resources(vulkan, output);
+    return true;
+}
+
+// Surface lost or display mode switched: the surface itself has to be replaced
+bool recreate_display_surface(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    if (output->surface != VK_NULL_HANDLE && !retire_swapchain(vulkan, output, true)) {
+        // The lost surface is never used again, recreate_swapchain() comes back here
+        output->surface_lost = true;
+        output->swapchain_ready = false;
+        return false;
+    }
+    output->surface_lost = false;
+
+    if (!create_display_surface(vulkan, output)) {
+        output->swapchain_ready = false;
+        return true;
+    }
+    rebuild_swapchain_resources(vulkan, output);
+    return true;
+}
+
+// Whether an output can be driven by the device and render pass created for the first one
+static bool output_supported(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    VkBool32 supports_present = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(vulkan->physicalDevice, vulkan->present_queue_family_index, output->surface, &supports_present);
+    if (!supports_present) return false;
+
+    SwapChainSupportDetails details = query_swap_chain_support(vulkan, output);
+    bool found = false;
+    for (uint32_t i = 0; i < details.format_count; i++) {
+        if (details.formats[i].format == vulkan->render_pass_format) {
+            found = true;
+            break;
+        }
+    }
+    free_swap_chain_support(&details);
+
+    return found;
+}
+
+// Swapchain and frame resources of one output. The first output also creates the device,
+// the shared render passes and the pipeline. Returns false if the output can't be used
+bool init_output(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    if (vulkan->device != VK_NULL_HANDLE && !output_supported(vulkan, output)) {
+        fprintf(stderr, "Output %u can't present with the shared device and format, skipped\n", output->index);
+        return false;
+    }
+
+    create_swapchain(vulkan, output);
+    create_image_views(vulkan, output);
+    if (vulkan->render_pass == VK_NULL_HANDLE) {
+        create_render_pass(vulkan, output->swapchain_image_format);
+        create_graphics_pipeline(vulkan);
+    }
+    create_framebuffers(vulkan, output);
+    create_image_semaphores(vulkan, output);
+    create_submission_resources(vulkan, output);
+
+    output->swapchain_ready = true;
+    return true;
+}
+
+// Teardown, or an output that failed init_output(): nothing of it may be in flight
+void destroy_output(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    if (vulkan->device) {
+        release_retired_swapchains(vulkan, output, true);
+
+        for (uint32_t i = 0; i < output->swapchain_image_count; i++) {
+            if (output->framebuffers) vkDestroyFramebuffer(vulkan->device, output->framebuffers[i], NULL);
+            if (output->swapchain_image_views) vkDestroyImageView(vulkan->device, output->swapchain_image_views[i], NULL);
+            if (output->draw_complete_semaphores) vkDestroySemaphore(vulkan->device, output->draw_complete_semaphores[i], NULL);
+        }
+        // Command buffers go with the shared pool
+        for (int i = 0; i < FRAME_LAG; i++) {
+            if (output->submission_resources[i].fence) vkDestroyFence(vulkan->device, output->submission_resources[i].fence, NULL);
+            if (output->submission_resources[i].image_acquired_semaphore) vkDestroySemaphore(vulkan->device, output->submission_resources[i].image_acquired_semaphore, NULL);
+        }
+        if (output->swapchain) vkDestroySwapchainKHR(vulkan->device, output->swapchain, NULL);
+    }
+    free(output->framebuffers);
+    free(output->swapchain_image_views);
+    free(output->draw_complete_semaphores);
+    free(output->swapchain_images);
+
+    if (output->surface) {
+        vkDestroySurfaceKHR(vulkan->instance, output->surface, NULL);
+        vulkan->claimed_planes &= ~(1ull << output->primary_plane_index);
     }
+    memset(output, 0, sizeof(struct pwc_output));
 }
 
 // ==============================================================================================
@@ -590,108 +1247,56 @@ void read_file(const char *path, ShaderFile *shader) {
     fclose(pfile);
 }
 
-void create_graphics_pipeline(struct pwc_vulkan *vulkan) {
-    ShaderFile vertShader = {0};
-    ShaderFile fragShader = {0};
-    read_file("/home/dietcokelover/projects/pwc/include/pwc/render/shaders/frag.spv", &fragShader);
-    read_file("/home/dietcokelover/projects/pwc/include/pwc/render/shaders/vert.spv", &vertShader);
-}
-
-void init_swapchain(struct pwc_vulkan *vulkan) {
-    VkResult U_ASSERT_ONLY err;
-
-    // Iterate over each queue to learn whether it supports presenting
-    VkBool32 *supports_present = (VkBool32 *)malloc(vulkan->queue_family_count * sizeof(VkBool32));
-    for (uint32_t i = 0; i < vulkan->queue_family_count; i++) {
-        vkGetPhysicalDeviceSurfaceSupportKHR(vulkan->physicalDevice, i, vulkan->surface, &supports_present[i]);
-    }
-
-    // Seearch for a graphics and a present queue in the array of queue
-    // families, try to find one that supports both
-    uint32_t graphics_queue_family_index = UINT32_MAX;
-    uint32_t present_queue_family_index = UINT32_MAX;
-    for (uint32_t i = 0; i < vulkan->queue_family_count; i++) {
-        if ((vulkan->queue_props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0) {
-            if (graphics_queue_family_index == UINT32_MAX) {
-                graphics_queue_family_index = i;
-            }
+// Set by the build to where the compiled shaders are
+#ifndef PWC_SHADER_DIR
+#define PWC_SHADER_DIR "shaders"
+#endif
 
-            if (supports_present[i] == VK_TRUE) {
-                graphics_queue_family_index = i;
-                present_queue_family_index = i;
-                break;
-            }
-        }
-    }
+VkShaderModule load_shader(struct pwc_vulkan *vulkan, const char *name) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", PWC_SHADER_DIR, name);
 
-    if (present_queue_family_index == UINT32_MAX) {
-        // If didn't find a queue that supports both graphics and present, then
-        // find a separate present queue.
-        for (uint32_t i = 0; i < vulkan->queue_family_count; ++i) {
-            present_queue_family_index = i;
-            break;
-        }
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open shader %s\n", path);
+        return VK_NULL_HANDLE;
     }
 
-    // Generate error if couldn't find both graphics and present queue
-    if (graphics_queue_family_index == UINT32_MAX || present_queue_family_index == UINT32_MAX) {
-        fprintf(stderr, "[Swapchain initialization failure]\nCouldn't find both graphics and present queues\n");
-        exit(EXIT_FAILURE);
+    fseek(file, 0L, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+
+    // SPIR-V is a stream of 32 bit words
+    uint32_t *code = size > 0 && size % 4 == 0 ? malloc(size) : NULL;
+    bool read = code && fread(code, size, 1, file) == 1;
+    fclose(file);
+    if (!read) {
+        fprintf(stderr, "Failed to read shader %s\n", path);
+        free(code);
+        return VK_NULL_HANDLE;
     }
 
-    vulkan->graphics_queue_family_index = graphics_queue_family_index;
-    vulkan->present_queue_family_index = present_queue_family_index;
-    vulkan->separate_present_queue = (vulkan->graphics_queue_family_index != vulkan->present_queue_family_index);
-    free(supports_present);
-
-    printf("Creating logical device\n");
-    create_logical_device(vulkan);
-
-    vkGetDeviceQueue(vulkan->device, vulkan->graphics_queue_family_index, 0, &vulkan->graphics_queue);
-
-    if (!vulkan->separate_present_queue) {
-        vulkan->present_queue = vulkan->graphics_queue;
-    } else {
-        vkGetDeviceQueue(vulkan->device, vulkan->present_queue_family_index, 0, &vulkan->present_queue);
-    }
-
-    // Get the list of VkFormat's that are supported
-    uint32_t format_count;
-    err = vkGetPhysicalDeviceSurfaceFormatsKHR(vulkan->physicalDevice, vulkan->surface, &format_count, NULL);
-    assert(!err);
-    VkSurfaceFormatKHR *surface_formats = (VkSurfaceFormatKHR *)malloc(format_count * sizeof(VkSurfaceFormatKHR));
-    err = vkGetPhysicalDeviceSurfaceFormatsKHR(vulkan->physicalDevice, vulkan->surface, &format_count, surface_formats);
-    assert(!err);
-    VkSurfaceFormatKHR surface_format = choose_swap_surface_mode(surface_formats, format_count);
-    // vulkan->format = surface_format.format;
-    // vulkan->color_space = surface_format.colorSpace;
-    free(surface_formats);
-    
-    // Create command pool
-    VkCommandPoolCreateInfo pool_ci = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .queueFamilyIndex = vulkan->graphics_queue_family_index,
-        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,  // Allow individual resets
+    VkShaderModuleCreateInfo module_ci = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = size,
+        .pCode = code,
     };
-    err = vkCreateCommandPool(vulkan->device, &pool_ci, NULL, &vulkan->cmd_pool);
-    assert(!err);
-    // Allocate command buffers (one per FRAME_LAG)
-    VkCommandBufferAllocateInfo alloc_ci = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = vulkan->cmd_pool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = FRAME_LAG,
-    };
-    VkCommandBuffer cmd_buffers[FRAME_LAG];
-    err = vkAllocateCommandBuffers(vulkan->device, &alloc_ci, cmd_buffers);
-    assert(!err);
-    // Assign to submission resources
-    for (int i = 0; i < FRAME_LAG; i++) {
-        vulkan->submission_resources[i].cmd = cmd_buffers[i];
+    VkShaderModule module = VK_NULL_HANDLE;
+    if (vkCreateShaderModule(vulkan->device, &module_ci, NULL, &module) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create shader module %s\n", path);
+        module = VK_NULL_HANDLE;
     }
+    free(code);
+    return module;
+}
 
-    // Get Memory information and properties
-    vkGetPhysicalDeviceMemoryProperties(vulkan->physicalDevice, &vulkan->memory_properties);
+void create_graphics_pipeline(struct pwc_vulkan *vulkan) {
+    ShaderFile vertShader = {0};
+    ShaderFile fragShader = {0};
+    read_file("/home/dietcokelover/projects/pwc/include/pwc/render/shaders/frag.spv", &fragShader);
+    read_file("/home/dietcokelover/projects/pwc/include/pwc/render/shaders/vert.spv", &vertShader);
+
+    vulkan->pipeline_serial++;
 }
 
 static VkBool32 check_validation_layers(uint32_t check_count, char **check_names, uint32_t layer_count, VkLayerProperties *layers) {
@@ -748,6 +1353,8 @@ void create_vulkan_instance(struct pwc_vulkan *vulkan) {
 
     VkBool32 surfaceExtFound = false;
     VkBool32 platformSurfaceExtFound = false;
+    VkBool32 properties2ExtFound = false;
+    bool surfaceCounterExtFound = false;
     bool portabilityEnumerationActive = false;
     memset(vulkan->extension_names, 0, sizeof(vulkan->extension_names));
 
@@ -769,8 +1376,18 @@ void create_vulkan_instance(struct pwc_vulkan *vulkan) {
                 vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_DISPLAY_EXTENSION_NAME;
             }
             if (!strcmp(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, instance_extensions[i].extensionName)) {
+                properties2ExtFound = true;
                 vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
             }
+            // Needed by VK_EXT_display_control's swapchain counters
+            if (!strcmp(VK_EXT_DISPLAY_SURFACE_COUNTER_EXTENSION_NAME, instance_extensions[i].extensionName)) {
+                surfaceCounterExtFound = true;
+                vulkan->extension_names[vulkan->enabled_extension_count++] = VK_EXT_DISPLAY_SURFACE_COUNTER_EXTENSION_NAME;
+            }
+            // Needed by the device's external memory extensions on a 1.0 instance
+            if (!strcmp(VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME, instance_extensions[i].extensionName)) {
+                vulkan->extension_names[vulkan->enabled_extension_count++] = VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME;
+            }
             if (!strcmp(VK_EXT_DEBUG_UTILS_EXTENSION_NAME, instance_extensions[i].extensionName)) {
                 if (vulkan->validate) {
                     vulkan->extension_names[vulkan->enabled_extension_count++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
@@ -832,6 +1449,27 @@ void create_vulkan_instance(struct pwc_vulkan *vulkan) {
         fprintf(stderr, "vkCreateInstanceFailed\n");
         exit(EXIT_FAILURE);
     }
+
+    // Instance extension commands aren't exported by the loader
+    vulkan->get_memory_properties2 = NULL;
+    vulkan->get_properties2 = NULL;
+    vulkan->get_format_properties2 = NULL;
+    vulkan->get_image_format_properties2 = NULL;
+    vulkan->get_surface_capabilities2 = NULL;
+    if (surfaceCounterExtFound) {
+        vulkan->get_surface_capabilities2 = (PFN_vkGetPhysicalDeviceSurfaceCapabilities2EXT)vkGetInstanceProcAddr(
+            vulkan->instance, "vkGetPhysicalDeviceSurfaceCapabilities2EXT");
+    }
+    if (properties2ExtFound) {
+        vulkan->get_memory_properties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(
+            vulkan->instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+        vulkan->get_properties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(
+            vulkan->instance, "vkGetPhysicalDeviceProperties2KHR");
+        vulkan->get_format_properties2 = (PFN_vkGetPhysicalDeviceFormatProperties2KHR)vkGetInstanceProcAddr(
+            vulkan->instance, "vkGetPhysicalDeviceFormatProperties2KHR");
+        vulkan->get_image_format_properties2 = (PFN_vkGetPhysicalDeviceImageFormatProperties2KHR)vkGetInstanceProcAddr(
+            vulkan->instance, "vkGetPhysicalDeviceImageFormatProperties2KHR");
+    }
 }
 
 // Prepares cmd_pool, render_pass, render_pipeline
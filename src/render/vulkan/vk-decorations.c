@@ -0,0 +1,249 @@
+#include <assert.h>
+#include <pwc/render/utils/macro.h>
+#include <pwc/render/vulkan/vk-core.h>
+#include <pwc/render/vulkan/vk-decorations.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+
+#define DECORATION_ATTRIBUTES (sizeof(DecorationInstanceT) / (4 * sizeof(float)))
+
+static bool create_decoration_pipeline(struct pwc_decorations *decorations) {
+    VkResult U_ASSERT_ONLY err;
+    struct pwc_vulkan *vulkan = decorations->vulkan;
+
+    VkPushConstantRange push_range = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = 2 * sizeof(float),
+    };
+    VkPipelineLayoutCreateInfo layout_ci = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    };
+    err = vkCreatePipelineLayout(vulkan->device, &layout_ci, NULL, &decorations->pipeline_layout);
+    assert(!err);
+
+    VkShaderModule vert = load_shader(vulkan, "decoration.vert.spv");
+    VkShaderModule frag = load_shader(vulkan, "decoration.frag.spv");
+    if (!vert || !frag) {
+        if (vert) vkDestroyShaderModule(vulkan->device, vert, NULL);
+        if (frag) vkDestroyShaderModule(vulkan->device, frag, NULL);
+        return false;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2] = {
+        {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, .stage = VK_SHADER_STAGE_VERTEX_BIT, .module = vert, .pName = "main"},
+        {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, .stage = VK_SHADER_STAGE_FRAGMENT_BIT, .module = frag, .pName = "main"},
+    };
+
+    // The quad's corners come from gl_VertexIndex, the only buffer is per instance
+    VkVertexInputBindingDescription binding = {
+        .binding = 0,
+        .stride = sizeof(DecorationInstanceT),
+        .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+    };
+    VkVertexInputAttributeDescription attributes[DECORATION_ATTRIBUTES];
+    for (uint32_t i = 0; i < DECORATION_ATTRIBUTES; i++) {
+        attributes[i] = (VkVertexInputAttributeDescription){
+            .location = i,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+            .offset = i * 4 * sizeof(float),
+        };
+    }
+    VkPipelineVertexInputStateCreateInfo vertex_input = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &binding,
+        .vertexAttributeDescriptionCount = DECORATION_ATTRIBUTES,
+        .pVertexAttributeDescriptions = attributes,
+    };
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+    };
+    // Viewport and scissor are set by whoever owns the pass
+    VkPipelineViewportStateCreateInfo viewport_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+    VkDynamicState dynamic_states[2] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = ARRAY_SIZE(dynamic_states),
+        .pDynamicStates = dynamic_states,
+    };
+    VkPipelineRasterizationStateCreateInfo rasterization = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        .lineWidth = 1.0f,
+    };
+    VkPipelineMultisampleStateCreateInfo multisample = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    };
+    // Premultiplied over, instances are blended in order so later windows stack on top
+    VkPipelineColorBlendAttachmentState blend_attachment = {
+        .blendEnable = VK_TRUE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+    VkPipelineColorBlendStateCreateInfo blend = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &blend_attachment,
+    };
+    VkGraphicsPipelineCreateInfo pipeline_ci = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = ARRAY_SIZE(stages),
+        .pStages = stages,
+        .pVertexInputState = &vertex_input,
+        .pInputAssemblyState = &input_assembly,
+        .pViewportState = &viewport_state,
+        .pRasterizationState = &rasterization,
+        .pMultisampleState = &multisample,
+        .pColorBlendState = &blend,
+        .pDynamicState = &dynamic_state,
+        .layout = decorations->pipeline_layout,
+        .renderPass = vulkan->render_pass,
+        .subpass = 0,
+    };
+    VkResult result = vkCreateGraphicsPipelines(vulkan->device, VK_NULL_HANDLE, 1, &pipeline_ci, NULL, &decorations->pipeline);
+    vkDestroyShaderModule(vulkan->device, vert, NULL);
+    vkDestroyShaderModule(vulkan->device, frag, NULL);
+    if (result) {
+        fprintf(stderr, "Failed to create decoration pipeline\n");
+        return false;
+    }
+    return true;
+}
+
+struct pwc_decorations *create_decorations(struct pwc_vulkan *vulkan) {
+    struct pwc_decorations *decorations = calloc(1, sizeof(struct pwc_decorations));
+    if (!decorations) {
+        fprintf(stderr, "Failed to allocate decorations\n");
+        return NULL;
+    }
+    decorations->vulkan = vulkan;
+
+    decorations->enabled = create_decoration_pipeline(decorations);
+    if (!decorations->enabled) fprintf(stderr, "Decoration shaders unavailable, decorations disabled\n");
+    return decorations;
+}
+
+void destroy_decorations(struct pwc_decorations *decorations) {
+    if (!decorations) return;
+    VkDevice device = decorations->vulkan->device;
+
+    if (decorations->pipeline) vkDestroyPipeline(device, decorations->pipeline, NULL);
+    if (decorations->pipeline_layout) vkDestroyPipelineLayout(device, decorations->pipeline_layout, NULL);
+    free(decorations);
+}
+
+void decoration_instance_init(DecorationInstanceT *instance, const SceneNodeT *node) {
+    const SceneDecorationT *decoration = &node->decoration;
+    SceneTransformT transform = scene_node_world_transform(node);
+    float scale = transform.scale;
+
+    // Scaled around the geometry's center, then moved
+    float width = node->geometry.extent.width * scale, height = node->geometry.extent.height * scale;
+    float x = node->geometry.offset.x + (node->geometry.extent.width - width) * 0.5f + transform.offset[0];
+    float y = node->geometry.offset.y + (node->geometry.extent.height - height) * 0.5f + transform.offset[1];
+
+    *instance = (DecorationInstanceT){
+        .rect = {x, y, width, height},
+        .shape = {decoration->corner_radius * scale, decoration->border_width * scale, decoration->shadow_radius * scale, transform.opacity},
+        .shadow = {decoration->shadow_offset[0] * scale, decoration->shadow_offset[1] * scale, 0.0f, 0.0f},
+    };
+    memcpy(instance->fill_color, decoration->fill_color, sizeof(instance->fill_color));
+    memcpy(instance->border_color, decoration->border_color, sizeof(instance->border_color));
+    memcpy(instance->shadow_color, decoration->shadow_color, sizeof(instance->shadow_color));
+}
+
+void decoration_buffer_finish(struct pwc_decorations *decorations, DecorationBufferT *buffer) {
+    VkDevice device = decorations->vulkan->device;
+    if (buffer->buffer) vkDestroyBuffer(device, buffer->buffer, NULL);
+    if (buffer->mem) vkFreeMemory(device, buffer->mem, NULL);
+    memset(buffer, 0, sizeof(DecorationBufferT));
+}
+
+static bool ensure_capacity(struct pwc_decorations *decorations, DecorationBufferT *buffer, uint32_t count) {
+    VkResult U_ASSERT_ONLY err;
+    struct pwc_vulkan *vulkan = decorations->vulkan;
+    if (buffer->capacity >= count) return true;
+
+    uint32_t capacity = buffer->capacity ? buffer->capacity : 64;
+    while (capacity < count) capacity *= 2;
+    decoration_buffer_finish(decorations, buffer);
+
+    VkBufferCreateInfo buffer_ci = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = capacity * sizeof(DecorationInstanceT),
+        .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    err = vkCreateBuffer(vulkan->device, &buffer_ci, NULL, &buffer->buffer);
+    assert(!err);
+
+    // Rewritten every frame and read once, not worth a copy to device local memory
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(vulkan->device, buffer->buffer, &requirements);
+    uint32_t type = find_memory_type(vulkan, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (type == UINT32_MAX) {
+        fprintf(stderr, "No host visible memory for decorations\n");
+        decoration_buffer_finish(decorations, buffer);
+        return false;
+    }
+
+    VkMemoryAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = type,
+    };
+    if (vkAllocateMemory(vulkan->device, &alloc_info, NULL, &buffer->mem) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate %lu bytes of decoration memory\n", (unsigned long)requirements.size);
+        decoration_buffer_finish(decorations, buffer);
+        return false;
+    }
+    err = vkBindBufferMemory(vulkan->device, buffer->buffer, buffer->mem, 0);
+    assert(!err);
+    err = vkMapMemory(vulkan->device, buffer->mem, 0, VK_WHOLE_SIZE, 0, &buffer->map);
+    assert(!err);
+
+    buffer->capacity = capacity;
+    return true;
+}
+
+bool decoration_buffer_write(struct pwc_decorations *decorations, DecorationBufferT *buffer,
+                             const DecorationInstanceT *instances, uint32_t count) {
+    if (!decorations->enabled) return false;
+    if (count == 0) return true;
+    if (!ensure_capacity(decorations, buffer, count)) return false;
+
+    memcpy(buffer->map, instances, count * sizeof(DecorationInstanceT));
+    return true;
+}
+
+void decorations_draw(struct pwc_decorations *decorations, VkCommandBuffer cmd, const DecorationBufferT *buffer,
+                      uint32_t first, uint32_t count, VkExtent2D extent) {
+    if (!decorations->enabled || !buffer->buffer || count == 0) return;
+
+    float push[2] = {(float)extent.width, (float)extent.height};
+    VkDeviceSize offset = 0;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, decorations->pipeline);
+    vkCmdPushConstants(cmd, decorations->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), push);
+    vkCmdBindVertexBuffers(cmd, 0, 1, &buffer->buffer, &offset);
+    vkCmdDraw(cmd, 4, count, 0, first);
+}
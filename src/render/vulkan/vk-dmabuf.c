@@ -0,0 +1,266 @@
+#include <drm_fourcc.h>
+#include <fcntl.h>
+#include <pwc/render/vulkan/vk-core.h>
+#include <pwc/render/vulkan/vk-dmabuf.h>
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vulkan/vulkan_core.h>
+
+// Single plane RGB formats the texture shader samples. Little endian: ARGB8888 is B, G, R, A
+// in memory
+static const struct {
+    uint32_t drm_format;
+    VkFormat vk_format;
+    bool opaque;
+} format_table[] = {
+    {DRM_FORMAT_ARGB8888, VK_FORMAT_B8G8R8A8_UNORM, false},
+    {DRM_FORMAT_XRGB8888, VK_FORMAT_B8G8R8A8_UNORM, true},
+    {DRM_FORMAT_ABGR8888, VK_FORMAT_R8G8B8A8_UNORM, false},
+    {DRM_FORMAT_XBGR8888, VK_FORMAT_R8G8B8A8_UNORM, true},
+    {DRM_FORMAT_ARGB2101010, VK_FORMAT_A2R10G10B10_UNORM_PACK32, false},
+    {DRM_FORMAT_XRGB2101010, VK_FORMAT_A2R10G10B10_UNORM_PACK32, true},
+    {DRM_FORMAT_ABGR2101010, VK_FORMAT_A2B10G10R10_UNORM_PACK32, false},
+    {DRM_FORMAT_XBGR2101010, VK_FORMAT_A2B10G10R10_UNORM_PACK32, true},
+};
+
+// A modifier is usable if images with it can be sampled and imported from a dmabuf
+static bool query_modifier(struct pwc_vulkan *vulkan, VkFormat format, const VkDrmFormatModifierPropertiesEXT *props,
+                           DmabufModifierT *modifier) {
+    if (!(props->drmFormatModifierTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) return false;
+
+    VkPhysicalDeviceImageDrmFormatModifierInfoEXT modifier_info = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT,
+        .drmFormatModifier = props->drmFormatModifier,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkPhysicalDeviceExternalImageFormatInfo external_info = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO,
+        .pNext = &modifier_info,
+        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT,
+    };
+    VkPhysicalDeviceImageFormatInfo2 info = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2,
+        .pNext = &external_info,
+        .format = format,
+        .type = VK_IMAGE_TYPE_2D,
+        .tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT,
+    };
+    VkExternalImageFormatProperties external_props = {.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES};
+    VkImageFormatProperties2 image_props = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2,
+        .pNext = &external_props,
+    };
+    if (vulkan->get_image_format_properties2(vulkan->physicalDevice, &info, &image_props) != VK_SUCCESS) return false;
+    if (!(external_props.externalMemoryProperties.externalMemoryFeatures & VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT)) return false;
+
+    modifier->modifier = props->drmFormatModifier;
+    modifier->plane_count = props->drmFormatModifierPlaneCount;
+    modifier->max_extent = (VkExtent2D){image_props.imageFormatProperties.maxExtent.width,
+                                        image_props.imageFormatProperties.maxExtent.height};
+    return true;
+}
+
+static bool query_format(struct pwc_vulkan *vulkan, DmabufFormatT *format) {
+    VkDrmFormatModifierPropertiesListEXT list = {.sType = VK_STRUCTURE_TYPE_DRM_FORMAT_MODIFIER_PROPERTIES_LIST_EXT};
+    VkFormatProperties2 props = {
+        .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2,
+        .pNext = &list,
+    };
+    vulkan->get_format_properties2(vulkan->physicalDevice, format->vk_format, &props);
+    if (list.drmFormatModifierCount == 0) return false;
+
+    VkDrmFormatModifierPropertiesEXT *modifier_props = calloc(list.drmFormatModifierCount, sizeof(VkDrmFormatModifierPropertiesEXT));
+    format->modifiers = calloc(list.drmFormatModifierCount, sizeof(DmabufModifierT));
+    if (!modifier_props || !format->modifiers) {
+        fprintf(stderr, "Failed to allocate dmabuf modifiers\n");
+        free(modifier_props);
+        free(format->modifiers);
+        format->modifiers = NULL;
+        return false;
+    }
+    list.pDrmFormatModifierProperties = modifier_props;
+    vulkan->get_format_properties2(vulkan->physicalDevice, format->vk_format, &props);
+
+    for (uint32_t i = 0; i < list.drmFormatModifierCount; i++) {
+        if (query_modifier(vulkan, format->vk_format, &modifier_props[i], &format->modifiers[format->modifier_count])) {
+            format->modifier_count++;
+        }
+    }
+    free(modifier_props);
+    if (format->modifier_count == 0) {
+        free(format->modifiers);
+        format->modifiers = NULL;
+        return false;
+    }
+    return true;
+}
+
+struct pwc_dmabuf_formats *create_dmabuf_formats(struct pwc_vulkan *vulkan) {
+    struct pwc_dmabuf_formats *formats = calloc(1, sizeof(struct pwc_dmabuf_formats));
+    if (!formats) {
+        fprintf(stderr, "Failed to allocate dmabuf formats\n");
+        return NULL;
+    }
+    formats->vulkan = vulkan;
+    if (!vulkan->dmabuf_import) return formats;
+
+    uint32_t table_size = sizeof(format_table) / sizeof(format_table[0]);
+    formats->formats = calloc(table_size, sizeof(DmabufFormatT));
+    if (!formats->formats) {
+        fprintf(stderr, "Failed to allocate dmabuf formats\n");
+        free(formats);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < table_size; i++) {
+        DmabufFormatT *format = &formats->formats[formats->format_count];
+        format->drm_format = format_table[i].drm_format;
+        format->vk_format = format_table[i].vk_format;
+        format->opaque = format_table[i].opaque;
+        if (query_format(vulkan, format)) formats->format_count++;
+    }
+    printf("Dmabuf import: %u formats\n", formats->format_count);
+    return formats;
+}
+
+void destroy_dmabuf_formats(struct pwc_dmabuf_formats *formats) {
+    if (!formats) return;
+    for (uint32_t i = 0; i < formats->format_count; i++) {
+        free(formats->formats[i].modifiers);
+    }
+    free(formats->formats);
+    free(formats);
+}
+
+const DmabufModifierT *dmabuf_find_modifier(const struct pwc_dmabuf_formats *formats, uint32_t drm_format, uint64_t modifier,
+                                            const DmabufFormatT **format) {
+    for (uint32_t i = 0; i < formats->format_count; i++) {
+        if (formats->formats[i].drm_format != drm_format) continue;
+        for (uint32_t j = 0; j < formats->formats[i].modifier_count; j++) {
+            if (formats->formats[i].modifiers[j].modifier != modifier) continue;
+            if (format) *format = &formats->formats[i];
+            return &formats->formats[i].modifiers[j];
+        }
+        return NULL;
+    }
+    return NULL;
+}
+
+// Disjoint planes need one memory binding per plane, only the common single dmabuf case is imported
+static bool planes_share_dmabuf(const DmabufAttributesT *attributes) {
+    struct stat first;
+    if (fstat(attributes->fds[0], &first) != 0) return false;
+    for (uint32_t i = 1; i < attributes->plane_count; i++) {
+        struct stat plane;
+        if (fstat(attributes->fds[i], &plane) != 0) return false;
+        if (plane.st_dev != first.st_dev || plane.st_ino != first.st_ino) return false;
+    }
+    return true;
+}
+
+static bool import_memory(struct pwc_vulkan *vulkan, VkImage image, int fd, VkDeviceMemory *mem) {
+    VkMemoryFdPropertiesKHR fd_props = {.sType = VK_STRUCTURE_TYPE_MEMORY_FD_PROPERTIES_KHR};
+    if (vulkan->get_memory_fd_properties(vulkan->device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT, fd, &fd_props) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to get dmabuf memory properties\n");
+        return false;
+    }
+    VkMemoryRequirements mem_reqs;
+    vkGetImageMemoryRequirements(vulkan->device, image, &mem_reqs);
+    uint32_t type = find_memory_type(vulkan, mem_reqs.memoryTypeBits & fd_props.memoryTypeBits, 0);
+    if (type == UINT32_MAX) {
+        fprintf(stderr, "No memory type for dmabuf import\n");
+        return false;
+    }
+
+    // A successful import owns the fd
+    int import_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (import_fd < 0) {
+        fprintf(stderr, "Failed to dup dmabuf fd\n");
+        return false;
+    }
+    VkImportMemoryFdInfoKHR import_info = {
+        .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,
+        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT,
+        .fd = import_fd,
+    };
+    VkMemoryDedicatedAllocateInfo dedicated_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .pNext = &import_info,
+        .image = image,
+    };
+    VkMemoryAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = &dedicated_info,
+        .allocationSize = mem_reqs.size,
+        .memoryTypeIndex = type,
+    };
+    if (vkAllocateMemory(vulkan->device, &alloc_info, NULL, mem) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to import dmabuf memory\n");
+        close(import_fd);
+        return false;
+    }
+    if (vkBindImageMemory(vulkan->device, image, *mem, 0) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to bind dmabuf memory\n");
+        vkFreeMemory(vulkan->device, *mem, NULL);
+        return false;
+    }
+    return true;
+}
+
+bool dmabuf_import(struct pwc_dmabuf_formats *formats, struct pwc_textures *textures, TextureT *texture,
+                   const DmabufAttributesT *attributes) {
+    struct pwc_vulkan *vulkan = formats->vulkan;
+    const DmabufFormatT *format;
+    const DmabufModifierT *modifier = dmabuf_find_modifier(formats, attributes->format, attributes->modifier, &format);
+    if (!modifier || modifier->plane_count != attributes->plane_count) return false;
+    if (attributes->width > modifier->max_extent.width || attributes->height > modifier->max_extent.height) return false;
+    if (!planes_share_dmabuf(attributes)) return false;
+
+    VkSubresourceLayout plane_layouts[DMABUF_MAX_PLANES] = {0};
+    for (uint32_t i = 0; i < attributes->plane_count; i++) {
+        plane_layouts[i].offset = attributes->offsets[i];
+        plane_layouts[i].rowPitch = attributes->strides[i];
+    }
+    VkImageDrmFormatModifierExplicitCreateInfoEXT modifier_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_EXPLICIT_CREATE_INFO_EXT,
+        .drmFormatModifier = attributes->modifier,
+        .drmFormatModifierPlaneCount = attributes->plane_count,
+        .pPlaneLayouts = plane_layouts,
+    };
+    VkExternalMemoryImageCreateInfo external_info = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+        .pNext = &modifier_info,
+        .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT,
+    };
+    VkImageCreateInfo image_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext = &external_info,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format->vk_format,
+        .extent = {attributes->width, attributes->height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    VkImage image;
+    if (vkCreateImage(vulkan->device, &image_info, NULL, &image) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create dmabuf image\n");
+        return false;
+    }
+    VkDeviceMemory mem;
+    if (!import_memory(vulkan, image, attributes->fds[0], &mem)) {
+        vkDestroyImage(vulkan->device, image, NULL);
+        return false;
+    }
+    return texture_import(textures, texture, image, mem, (VkExtent2D){attributes->width, attributes->height}, format->vk_format,
+                          format->opaque);
+}
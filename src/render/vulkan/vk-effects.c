@@ -0,0 +1,586 @@
+#include <assert.h>
+#include <pwc/render/utils/macro.h>
+#include <pwc/render/vulkan/vk-core.h>
+#include <pwc/render/vulkan/vk-effects.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+
+#define EFFECT_GROUP_SIZE 8  // local_size of every effect shader
+
+static const char *effect_shaders[EFFECT_PIPELINE_COUNT] = {
+    [EFFECT_DOWNSCALE] = "downscale.comp.spv",
+    [EFFECT_KAWASE_DOWN] = "kawase-down.comp.spv",
+    [EFFECT_KAWASE_UP] = "kawase-up.comp.spv",
+};
+
+static bool create_effect_pipelines(struct pwc_effects *effects) {
+    struct pwc_vulkan *vulkan = effects->vulkan;
+
+    for (uint32_t i = 0; i < EFFECT_PIPELINE_COUNT; i++) {
+        VkShaderModule module = load_shader(vulkan, effect_shaders[i]);
+        if (!module) return false;
+
+        VkComputePipelineCreateInfo pipeline_ci = {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = module,
+                .pName = "main",
+            },
+            .layout = effects->pipeline_layout,
+        };
+        VkResult err = vkCreateComputePipelines(vulkan->device, VK_NULL_HANDLE, 1, &pipeline_ci, NULL, &effects->pipelines[i]);
+        vkDestroyShaderModule(vulkan->device, module, NULL);
+        if (err) {
+            fprintf(stderr, "Failed to create effect pipeline %s\n", effect_shaders[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool create_blit_pipeline(struct pwc_effects *effects) {
+    VkResult U_ASSERT_ONLY err;
+    struct pwc_vulkan *vulkan = effects->vulkan;
+
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .pImmutableSamplers = &effects->sampler,
+    };
+    VkDescriptorSetLayoutCreateInfo set_layout_ci = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &binding,
+    };
+    err = vkCreateDescriptorSetLayout(vulkan->device, &set_layout_ci, NULL, &effects->blit_set_layout);
+    assert(!err);
+
+    VkPushConstantRange push_range = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = 4 * sizeof(float),
+    };
+    VkPipelineLayoutCreateInfo layout_ci = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &effects->blit_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    };
+    err = vkCreatePipelineLayout(vulkan->device, &layout_ci, NULL, &effects->blit_pipeline_layout);
+    assert(!err);
+
+    VkShaderModule vert = load_shader(vulkan, "blit.vert.spv");
+    VkShaderModule frag = load_shader(vulkan, "blit.frag.spv");
+    if (!vert || !frag) {
+        if (vert) vkDestroyShaderModule(vulkan->device, vert, NULL);
+        if (frag) vkDestroyShaderModule(vulkan->device, frag, NULL);
+        return false;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2] = {
+        {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, .stage = VK_SHADER_STAGE_VERTEX_BIT, .module = vert, .pName = "main"},
+        {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, .stage = VK_SHADER_STAGE_FRAGMENT_BIT, .module = frag, .pName = "main"},
+    };
+    VkPipelineVertexInputStateCreateInfo vertex_input = {.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+    };
+    // Viewport and scissor are set by whoever owns the pass
+    VkPipelineViewportStateCreateInfo viewport_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+    VkDynamicState dynamic_states[2] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = ARRAY_SIZE(dynamic_states),
+        .pDynamicStates = dynamic_states,
+    };
+    VkPipelineRasterizationStateCreateInfo rasterization = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        .lineWidth = 1.0f,
+    };
+    VkPipelineMultisampleStateCreateInfo multisample = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    };
+    // Effect results replace what's under them
+    VkPipelineColorBlendAttachmentState blend_attachment = {
+        .blendEnable = VK_FALSE,
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+    VkPipelineColorBlendStateCreateInfo blend = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &blend_attachment,
+    };
+    VkGraphicsPipelineCreateInfo pipeline_ci = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = ARRAY_SIZE(stages),
+        .pStages = stages,
+        .pVertexInputState = &vertex_input,
+        .pInputAssemblyState = &input_assembly,
+        .pViewportState = &viewport_state,
+        .pRasterizationState = &rasterization,
+        .pMultisampleState = &multisample,
+        .pColorBlendState = &blend,
+        .pDynamicState = &dynamic_state,
+        .layout = effects->blit_pipeline_layout,
+        .renderPass = vulkan->render_pass,
+        .subpass = 0,
+    };
+    VkResult result = vkCreateGraphicsPipelines(vulkan->device, VK_NULL_HANDLE, 1, &pipeline_ci, NULL, &effects->blit_pipeline);
+    vkDestroyShaderModule(vulkan->device, vert, NULL);
+    vkDestroyShaderModule(vulkan->device, frag, NULL);
+    if (result) {
+        fprintf(stderr, "Failed to create blit pipeline\n");
+        return false;
+    }
+
+    VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, EFFECT_MAX_IMAGES};
+    VkDescriptorPoolCreateInfo pool_ci = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+        .maxSets = EFFECT_MAX_IMAGES,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+    err = vkCreateDescriptorPool(vulkan->device, &pool_ci, NULL, &effects->image_descriptor_pool);
+    assert(!err);
+    return true;
+}
+
+struct pwc_effects *create_effects(struct pwc_vulkan *vulkan) {
+    VkResult U_ASSERT_ONLY err;
+
+    struct pwc_effects *effects = calloc(1, sizeof(struct pwc_effects));
+    if (!effects) {
+        fprintf(stderr, "Failed to allocate effects\n");
+        return NULL;
+    }
+    effects->vulkan = vulkan;
+
+    VkCommandPoolCreateInfo pool_ci = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = vulkan->compute_queue_family_index,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+    };
+    err = vkCreateCommandPool(vulkan->device, &pool_ci, NULL, &effects->pool);
+    assert(!err);
+
+    VkSamplerCreateInfo sampler_ci = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = 0.0f,
+    };
+    err = vkCreateSampler(vulkan->device, &sampler_ci, NULL, &effects->sampler);
+    assert(!err);
+
+    VkDescriptorSetLayoutBinding bindings[2] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = &effects->sampler,
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        },
+    };
+    VkDescriptorSetLayoutCreateInfo set_layout_ci = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = ARRAY_SIZE(bindings),
+        .pBindings = bindings,
+    };
+    err = vkCreateDescriptorSetLayout(vulkan->device, &set_layout_ci, NULL, &effects->set_layout);
+    assert(!err);
+
+    VkPushConstantRange push_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = EFFECT_PUSH_SIZE,
+    };
+    VkPipelineLayoutCreateInfo layout_ci = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &effects->set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    };
+    err = vkCreatePipelineLayout(vulkan->device, &layout_ci, NULL, &effects->pipeline_layout);
+    assert(!err);
+
+    if (!create_effect_pipelines(effects) || !create_blit_pipeline(effects)) {
+        fprintf(stderr, "Compute shaders unavailable, effects disabled\n");
+        return effects;
+    }
+
+    VkDescriptorPoolSize pool_sizes[2] = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, EFFECT_MAX_PASSES},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, EFFECT_MAX_PASSES},
+    };
+    VkDescriptorPoolCreateInfo descriptor_pool_ci = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = EFFECT_MAX_PASSES,
+        .poolSizeCount = ARRAY_SIZE(pool_sizes),
+        .pPoolSizes = pool_sizes,
+    };
+    VkCommandBufferAllocateInfo alloc_ci = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = effects->pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkSemaphoreCreateInfo semaphore_ci = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+
+    for (uint32_t i = 0; i < EFFECT_BATCHES; i++) {
+        EffectBatchT *batch = &effects->batches[i];
+        err = vkAllocateCommandBuffers(vulkan->device, &alloc_ci, &batch->cmd);
+        assert(!err);
+        err = vkCreateDescriptorPool(vulkan->device, &descriptor_pool_ci, NULL, &batch->descriptor_pool);
+        assert(!err);
+        err = vkCreateSemaphore(vulkan->device, &semaphore_ci, NULL, &batch->input_semaphore);
+        assert(!err);
+        err = vkCreateSemaphore(vulkan->device, &semaphore_ci, NULL, &batch->done_semaphore);
+        assert(!err);
+    }
+
+    if (vulkan->separate_compute_queue) {
+        printf("Effects on async compute queue family %u\n", vulkan->compute_queue_family_index);
+    }
+    effects->enabled = true;
+    return effects;
+}
+
+void destroy_effects(struct pwc_effects *effects) {
+    if (!effects) return;
+    VkDevice device = effects->vulkan->device;
+
+    for (uint32_t i = 0; i < EFFECT_BATCHES; i++) {
+        EffectBatchT *batch = &effects->batches[i];
+        if (batch->descriptor_pool) vkDestroyDescriptorPool(device, batch->descriptor_pool, NULL);
+        if (batch->input_semaphore) vkDestroySemaphore(device, batch->input_semaphore, NULL);
+        if (batch->done_semaphore) vkDestroySemaphore(device, batch->done_semaphore, NULL);
+    }
+    for (uint32_t i = 0; i < EFFECT_PIPELINE_COUNT; i++) {
+        if (effects->pipelines[i]) vkDestroyPipeline(device, effects->pipelines[i], NULL);
+    }
+    if (effects->blit_pipeline) vkDestroyPipeline(device, effects->blit_pipeline, NULL);
+    if (effects->blit_pipeline_layout) vkDestroyPipelineLayout(device, effects->blit_pipeline_layout, NULL);
+    if (effects->blit_set_layout) vkDestroyDescriptorSetLayout(device, effects->blit_set_layout, NULL);
+    if (effects->image_descriptor_pool) vkDestroyDescriptorPool(device, effects->image_descriptor_pool, NULL);
+    if (effects->pipeline_layout) vkDestroyPipelineLayout(device, effects->pipeline_layout, NULL);
+    if (effects->set_layout) vkDestroyDescriptorSetLayout(device, effects->set_layout, NULL);
+    if (effects->sampler) vkDestroySampler(device, effects->sampler, NULL);
+    // Frees the command buffers
+    if (effects->pool) vkDestroyCommandPool(device, effects->pool, NULL);
+    free(effects);
+}
+
+bool effect_image_init(struct pwc_effects *effects, EffectImageT *image, VkExtent2D extent, VkFormat format) {
+    VkResult U_ASSERT_ONLY err;
+    struct pwc_vulkan *vulkan = effects->vulkan;
+    memset(image, 0, sizeof(EffectImageT));
+    if (!effects->enabled) return false;
+
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (format == EFFECT_FORMAT) usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+
+    // Concurrent: no ownership transfers between the graphics and compute queues
+    uint32_t families[2] = {vulkan->graphics_queue_family_index, vulkan->compute_queue_family_index};
+    VkImageCreateInfo image_ci = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = {extent.width, extent.height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = usage,
+        .sharingMode = vulkan->separate_compute_queue ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = vulkan->separate_compute_queue ? 2 : 0,
+        .pQueueFamilyIndices = families,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    if (vkCreateImage(vulkan->device, &image_ci, NULL, &image->image) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create %ux%u effect image\n", extent.width, extent.height);
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(vulkan->device, image->image, &requirements);
+    VkMemoryAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = find_memory_type(vulkan, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    };
+    if (alloc_info.memoryTypeIndex == UINT32_MAX ||
+        vkAllocateMemory(vulkan->device, &alloc_info, NULL, &image->mem) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate %ux%u effect image\n", extent.width, extent.height);
+        effect_image_finish(effects, image);
+        return false;
+    }
+    err = vkBindImageMemory(vulkan->device, image->image, image->mem, 0);
+    assert(!err);
+
+    VkImageViewCreateInfo view_ci = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = format,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    err = vkCreateImageView(vulkan->device, &view_ci, NULL, &image->view);
+    assert(!err);
+
+    VkDescriptorSetAllocateInfo set_ai = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = effects->image_descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &effects->blit_set_layout,
+    };
+    if (vkAllocateDescriptorSets(vulkan->device, &set_ai, &image->sample_set) != VK_SUCCESS) {
+        fprintf(stderr, "Out of effect image descriptors\n");
+        image->sample_set = VK_NULL_HANDLE;
+        effect_image_finish(effects, image);
+        return false;
+    }
+    VkDescriptorImageInfo image_info = {.imageView = image->view, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = image->sample_set,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &image_info,
+    };
+    vkUpdateDescriptorSets(vulkan->device, 1, &write, 0, NULL);
+
+    image->extent = extent;
+    image->format = format;
+    return true;
+}
+
+void effect_image_finish(struct pwc_effects *effects, EffectImageT *image) {
+    VkDevice device = effects->vulkan->device;
+    if (image->sample_set) vkFreeDescriptorSets(device, effects->image_descriptor_pool, 1, &image->sample_set);
+    if (image->view) vkDestroyImageView(device, image->view, NULL);
+    if (image->image) vkDestroyImage(device, image->image, NULL);
+    if (image->mem) vkFreeMemory(device, image->mem, NULL);
+    memset(image, 0, sizeof(EffectImageT));
+}
+
+// Batches whose results were waited on by a completed frame are free again
+static void recycle_batches(struct pwc_effects *effects) {
+    for (uint32_t i = 0; i < EFFECT_BATCHES; i++) {
+        EffectBatchT *batch = &effects->batches[i];
+        if (batch->state == EFFECT_BATCH_ACQUIRED && batch->serial <= batch->output->completed_serial) {
+            batch->state = EFFECT_BATCH_FREE;
+        }
+    }
+}
+
+static EffectBatchT *get_recording_batch(struct pwc_effects *effects) {
+    VkResult U_ASSERT_ONLY err;
+    if (effects->recording) return effects->recording;
+
+    recycle_batches(effects);
+
+    EffectBatchT *batch = NULL;
+    for (uint32_t i = 0; i < EFFECT_BATCHES; i++) {
+        if (effects->batches[i].state == EFFECT_BATCH_FREE) {
+            batch = &effects->batches[i];
+            break;
+        }
+    }
+    if (!batch) return NULL;
+
+    // The frame that waited on the batch completed, so its buffer and sets are idle
+    err = vkResetDescriptorPool(effects->vulkan->device, batch->descriptor_pool, 0);
+    assert(!err);
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    err = vkBeginCommandBuffer(batch->cmd, &begin_info);
+    assert(!err);
+
+    batch->state = EFFECT_BATCH_RECORDING;
+    batch->pass_count = 0;
+    batch->output = NULL;
+    batch->serial = 0;
+    effects->recording = batch;
+    return batch;
+}
+
+bool effects_dispatch(struct pwc_effects *effects, enum EffectPipeline pipeline, EffectImageT *src, EffectImageT *dst,
+                      const void *push, uint32_t push_size) {
+    VkResult U_ASSERT_ONLY err;
+    struct pwc_vulkan *vulkan = effects->vulkan;
+    if (!effects->enabled) return false;
+
+    EffectBatchT *batch = get_recording_batch(effects);
+    if (!batch || batch->pass_count >= EFFECT_MAX_PASSES) return false;
+
+    // Earlier passes of the batch may write src or dst, and a fresh dst has to leave UNDEFINED
+    VkImageMemoryBarrier barriers[2];
+    uint32_t barrier_count = 0;
+    VkMemoryBarrier pass_barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    EffectImageT *images[2] = {src, dst};
+    for (uint32_t i = 0; i < 2; i++) {
+        if (images[i]->initialized || (i == 1 && src == dst)) continue;
+        barriers[barrier_count++] = (VkImageMemoryBarrier){
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = images[i]->image,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+        };
+        images[i]->initialized = true;
+    }
+    vkCmdPipelineBarrier(batch->cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         batch->pass_count > 0 ? 1 : 0, &pass_barrier, 0, NULL, barrier_count, barriers);
+
+    VkDescriptorSet set;
+    VkDescriptorSetAllocateInfo set_ai = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = batch->descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &effects->set_layout,
+    };
+    err = vkAllocateDescriptorSets(vulkan->device, &set_ai, &set);
+    assert(!err);
+
+    VkDescriptorImageInfo src_info = {.imageView = src->view, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorImageInfo dst_info = {.imageView = dst->view, .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+    VkWriteDescriptorSet writes[2] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &src_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = 1,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .pImageInfo = &dst_info,
+        },
+    };
+    vkUpdateDescriptorSets(vulkan->device, ARRAY_SIZE(writes), writes, 0, NULL);
+
+    vkCmdBindPipeline(batch->cmd, VK_PIPELINE_BIND_POINT_COMPUTE, effects->pipelines[pipeline]);
+    vkCmdBindDescriptorSets(batch->cmd, VK_PIPELINE_BIND_POINT_COMPUTE, effects->pipeline_layout, 0, 1, &set, 0, NULL);
+    if (push && push_size > 0) {
+        assert(push_size <= EFFECT_PUSH_SIZE);
+        vkCmdPushConstants(batch->cmd, effects->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, push_size, push);
+    }
+    vkCmdDispatch(batch->cmd, (dst->extent.width + EFFECT_GROUP_SIZE - 1) / EFFECT_GROUP_SIZE,
+                  (dst->extent.height + EFFECT_GROUP_SIZE - 1) / EFFECT_GROUP_SIZE, 1);
+
+    batch->pass_count++;
+    return true;
+}
+
+void effects_draw(struct pwc_effects *effects, VkCommandBuffer cmd, const EffectImageT *image, VkRect2D dst, VkExtent2D extent) {
+    if (!effects->enabled || !image->sample_set) return;
+
+    float rect[4] = {
+        2.0f * dst.offset.x / extent.width - 1.0f,
+        2.0f * dst.offset.y / extent.height - 1.0f,
+        2.0f * (dst.offset.x + (float)dst.extent.width) / extent.width - 1.0f,
+        2.0f * (dst.offset.y + (float)dst.extent.height) / extent.height - 1.0f,
+    };
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, effects->blit_pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, effects->blit_pipeline_layout, 0, 1, &image->sample_set, 0, NULL);
+    vkCmdPushConstants(cmd, effects->blit_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(rect), rect);
+    vkCmdDraw(cmd, 4, 1, 0, 0);
+}
+
+VkSemaphore effects_input_semaphore(struct pwc_effects *effects) {
+    return effects->recording ? effects->recording->input_semaphore : VK_NULL_HANDLE;
+}
+
+void effects_submit(struct pwc_effects *effects) {
+    VkResult U_ASSERT_ONLY err;
+    EffectBatchT *batch = effects->recording;
+    if (!batch) return;
+
+    err = vkEndCommandBuffer(batch->cmd);
+    assert(!err);
+
+    // Waiting on the frame's signal orders the batch after all graphics work submitted so
+    // far: what it reads is drawn, and earlier frames are done sampling what it overwrites
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &batch->input_semaphore,
+        .pWaitDstStageMask = &wait_stage,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &batch->cmd,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &batch->done_semaphore,
+    };
+    err = vkQueueSubmit(effects->vulkan->compute_queue, 1, &submit_info, VK_NULL_HANDLE);
+    assert(!err);
+
+    batch->state = EFFECT_BATCH_SUBMITTED;
+    effects->recording = NULL;
+}
+
+uint32_t effects_acquire(struct pwc_effects *effects, struct pwc_output *output, uint64_t serial,
+                         VkSemaphore *semaphores, VkPipelineStageFlags *stages, uint32_t max) {
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < EFFECT_BATCHES && count < max; i++) {
+        EffectBatchT *batch = &effects->batches[i];
+        if (batch->state != EFFECT_BATCH_SUBMITTED) continue;
+
+        // Results are only sampled, raster work before the fragment stage isn't held back
+        semaphores[count] = batch->done_semaphore;
+        stages[count] = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        count++;
+
+        batch->state = EFFECT_BATCH_ACQUIRED;
+        batch->output = output;
+        batch->serial = serial;
+    }
+
+    return count;
+}
@@ -0,0 +1,567 @@
+#include <assert.h>
+#include <pwc/render/scene/node.h>
+#include <pwc/render/utils/macro.h>
+#include <pwc/render/vulkan/vk-core.h>
+#include <pwc/render/vulkan/vk-planes.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+
+static bool plane_supports_display(VkPhysicalDevice physical_device, uint32_t plane_index, VkDisplayKHR display) {
+    VkResult U_ASSERT_ONLY err;
+    uint32_t supported_count = 0;
+    bool found = false;
+
+    err = vkGetDisplayPlaneSupportedDisplaysKHR(physical_device, plane_index, &supported_count, NULL);
+    assert(!err);
+    if (supported_count == 0) return false;
+
+    VkDisplayKHR *supported_displays = malloc(sizeof(VkDisplayKHR) * supported_count);
+    assert(supported_displays);
+
+    err = vkGetDisplayPlaneSupportedDisplaysKHR(physical_device, plane_index, &supported_count, supported_displays);
+    assert(!err);
+
+    for (uint32_t i = 0; i < supported_count; i++) {
+        if (supported_displays[i] == display) {
+            found = true;
+            break;
+        }
+    }
+
+    free(supported_displays);
+    return found;
+}
+
+// Planes of the output's display usable with its current mode
+static void query_planes(struct pwc_planes *planes) {
+    VkResult err;
+    struct pwc_vulkan *vulkan = planes->vulkan;
+    struct pwc_output *output = planes->output;
+
+    planes->plane_count = 0;
+    planes->display_mode = output->display_mode;
+    // Plane position/size is only settable per present through VkDisplayPresentInfoKHR
+    if (!vulkan->display_swapchain) return;
+
+    uint32_t count = 0;
+    err = vkGetPhysicalDeviceDisplayPlanePropertiesKHR(vulkan->physicalDevice, &count, NULL);
+    if (err || count <= 1) return;
+    // The device's planes don't change, the array is kept across modes
+    if (!planes->planes) {
+        planes->planes = calloc(count, sizeof(DisplayPlaneT));
+        if (!planes->planes) {
+            fprintf(stderr, "Failed to allocate display planes\n");
+            return;
+        }
+        planes->display_plane_count = count;
+    }
+    count = planes->display_plane_count;
+
+    VkDisplayPlanePropertiesKHR *plane_props = malloc(sizeof(VkDisplayPlanePropertiesKHR) * count);
+    if (!plane_props) {
+        fprintf(stderr, "Failed to allocate display planes\n");
+        return;
+    }
+    err = vkGetPhysicalDeviceDisplayPlanePropertiesKHR(vulkan->physicalDevice, &count, plane_props);
+    if (err != VK_SUCCESS && err != VK_INCOMPLETE) {
+        free(plane_props);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        // claimed_planes is a 64 bit mask
+        if (i >= 64) break;
+        if (i == output->primary_plane_index) continue;
+        // Skip planes that are bound to a different display
+        if (plane_props[i].currentDisplay != VK_NULL_HANDLE && plane_props[i].currentDisplay != output->display) continue;
+        if (!plane_supports_display(vulkan->physicalDevice, i, output->display)) continue;
+
+        DisplayPlaneT *plane = &planes->planes[planes->plane_count++];
+        plane->index = i;
+        plane->in_use = false;
+        vkGetDisplayPlaneCapabilitiesKHR(vulkan->physicalDevice, output->display_mode, i, &plane->capabilities);
+    }
+
+    free(plane_props);
+    printf("Output %u: display planes available for scanout: %u\n", output->index, planes->plane_count);
+}
+
+struct pwc_planes *create_planes(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    VkResult U_ASSERT_ONLY err;
+
+    struct pwc_planes *planes = calloc(1, sizeof(struct pwc_planes));
+    if (!planes) {
+        fprintf(stderr, "Failed to allocate plane allocator\n");
+        return NULL;
+    }
+
+    planes->vulkan = vulkan;
+    planes->output = output;
+
+    VkCommandBufferAllocateInfo alloc_ci = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = vulkan->cmd_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = FRAME_LAG,
+    };
+    err = vkAllocateCommandBuffers(vulkan->device, &alloc_ci, planes->cmd);
+    assert(!err);
+
+    VkFenceCreateInfo fence_ci = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+    };
+    for (int i = 0; i < FRAME_LAG; i++) {
+        err = vkCreateFence(vulkan->device, &fence_ci, NULL, &planes->fences[i]);
+        assert(!err);
+    }
+
+    query_planes(planes);
+    return planes;
+}
+
+// Swapchain objects of an assignment, without any wait
+static void destroy_plane_swapchain(struct pwc_vulkan *vulkan, PlaneAssignmentT *assignment) {
+    for (int i = 0; i < FRAME_LAG; i++) {
+        if (assignment->image_acquired_semaphores[i]) vkDestroySemaphore(vulkan->device, assignment->image_acquired_semaphores[i], NULL);
+    }
+    for (uint32_t i = 0; i < assignment->image_count; i++) {
+        if (assignment->framebuffers && assignment->framebuffers[i]) vkDestroyFramebuffer(vulkan->device, assignment->framebuffers[i], NULL);
+        if (assignment->image_views && assignment->image_views[i]) vkDestroyImageView(vulkan->device, assignment->image_views[i], NULL);
+        if (assignment->draw_complete_semaphores && assignment->draw_complete_semaphores[i]) {
+            vkDestroySemaphore(vulkan->device, assignment->draw_complete_semaphores[i], NULL);
+        }
+    }
+    free(assignment->framebuffers);
+    free(assignment->image_views);
+    free(assignment->draw_complete_semaphores);
+    free(assignment->image_serials);
+    free(assignment->images);
+
+    if (assignment->swapchain) vkDestroySwapchainKHR(vulkan->device, assignment->swapchain, NULL);
+    if (assignment->surface) vkDestroySurfaceKHR(vulkan->instance, assignment->surface, NULL);
+}
+
+// The plane can be claimed again once the swapchain on it is gone
+static void release_retired_planes(struct pwc_planes *planes, bool force) {
+    struct pwc_vulkan *vulkan = planes->vulkan;
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < planes->retired_count; i++) {
+        RetiredPlaneT *retired = &planes->retired[i];
+        if (!force && retired->retire_serial > planes->completed_serial) {
+            planes->retired[kept++] = *retired;
+            continue;
+        }
+        destroy_plane_swapchain(vulkan, &retired->assignment);
+        vulkan->claimed_planes &= ~(1ull << retired->plane_index);
+        for (uint32_t j = 0; j < planes->plane_count; j++) {
+            if (planes->planes[j].index == retired->plane_index) planes->planes[j].in_use = false;
+        }
+    }
+    planes->retired_count = kept;
+}
+
+// Notes the plane frames whose fence is signaled and destroys what only they used
+static void poll_planes_completed(struct pwc_planes *planes) {
+    for (int i = 0; i < FRAME_LAG; i++) {
+        if (planes->serials[i] <= planes->completed_serial) continue;
+        if (vkGetFenceStatus(planes->vulkan->device, planes->fences[i]) == VK_SUCCESS) planes->completed_serial = planes->serials[i];
+    }
+    if (planes->retired_count > 0) release_retired_planes(planes, false);
+}
+
+void destroy_planes(struct pwc_planes *planes) {
+    if (!planes) return;
+    struct pwc_vulkan *vulkan = planes->vulkan;
+
+    for (uint32_t i = 0; i < MAX_PLANE_ASSIGNMENTS; i++) {
+        if (planes->assignments[i].node != SCENE_NODE_HANDLE_NULL) planes_release(planes, &planes->assignments[i]);
+    }
+    release_retired_planes(planes, true);
+
+    for (int i = 0; i < FRAME_LAG; i++) {
+        if (planes->fences[i]) vkDestroyFence(vulkan->device, planes->fences[i], NULL);
+    }
+    if (planes->cmd[0]) vkFreeCommandBuffers(vulkan->device, vulkan->cmd_pool, FRAME_LAG, planes->cmd);
+
+    free(planes->planes);
+    free(planes);
+}
+
+void planes_update_mode(struct pwc_planes *planes) {
+    for (uint32_t i = 0; i < MAX_PLANE_ASSIGNMENTS; i++) {
+        if (planes->assignments[i].node != SCENE_NODE_HANDLE_NULL) planes_release(planes, &planes->assignments[i]);
+    }
+    query_planes(planes);
+}
+
+PlaneAssignmentT *planes_find(struct pwc_planes *planes, SceneNodeHandle node) {
+    for (uint32_t i = 0; i < MAX_PLANE_ASSIGNMENTS; i++) {
+        if (planes->assignments[i].node == node) return &planes->assignments[i];
+    }
+    return NULL;
+}
+
+// Rendered 1:1, so the source is always the whole image and src/dst extents are equal
+static bool capabilities_fit(const VkDisplayPlaneCapabilitiesKHR *caps, VkRect2D dst) {
+    const VkExtent2D e = dst.extent;
+
+    if (dst.offset.x < caps->minDstPosition.x || dst.offset.x > caps->maxDstPosition.x) return false;
+    if (dst.offset.y < caps->minDstPosition.y || dst.offset.y > caps->maxDstPosition.y) return false;
+    if (e.width < caps->minDstExtent.width || e.width > caps->maxDstExtent.width) return false;
+    if (e.height < caps->minDstExtent.height || e.height > caps->maxDstExtent.height) return false;
+
+    if (caps->minSrcPosition.x > 0 || caps->minSrcPosition.y > 0) return false;
+    if (e.width < caps->minSrcExtent.width || e.width > caps->maxSrcExtent.width) return false;
+    if (e.height < caps->minSrcExtent.height || e.height > caps->maxSrcExtent.height) return false;
+
+    return true;
+}
+
+// Cursors need per-pixel alpha, overlays prefer opaque scanout
+static bool choose_plane_alpha(const VkDisplayPlaneCapabilitiesKHR *caps, enum ScenePlaneHint hint, VkDisplayPlaneAlphaFlagBitsKHR *alpha) {
+    const VkDisplayPlaneAlphaFlagBitsKHR cursor_modes[] = {
+        VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_PREMULTIPLIED_BIT_KHR,
+        VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_BIT_KHR,
+    };
+    const VkDisplayPlaneAlphaFlagBitsKHR overlay_modes[] = {
+        VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR,
+        VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_PREMULTIPLIED_BIT_KHR,
+        VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_BIT_KHR,
+    };
+    const VkDisplayPlaneAlphaFlagBitsKHR *modes = (hint == SCENE_PLANE_HINT_CURSOR) ? cursor_modes : overlay_modes;
+    uint32_t mode_count = (hint == SCENE_PLANE_HINT_CURSOR) ? ARRAY_SIZE(cursor_modes) : ARRAY_SIZE(overlay_modes);
+
+    for (uint32_t i = 0; i < mode_count; i++) {
+        if (caps->supportedAlpha & modes[i]) {
+            *alpha = modes[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// The surface must take the composition's swapchain format, otherwise the shared render
+// pass and pipelines are not compatible with it
+static bool choose_plane_format(struct pwc_vulkan *vulkan, VkSurfaceKHR surface, VkSurfaceFormatKHR *format) {
+    uint32_t format_count = 0;
+    bool found = false;
+
+    vkGetPhysicalDeviceSurfaceFormatsKHR(vulkan->physicalDevice, surface, &format_count, NULL);
+    if (format_count == 0) return false;
+
+    VkSurfaceFormatKHR *formats = malloc(sizeof(VkSurfaceFormatKHR) * format_count);
+    if (!formats) return false;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(vulkan->physicalDevice, surface, &format_count, formats);
+
+    for (uint32_t i = 0; i < format_count; i++) {
+        if (formats[i].format == vulkan->render_pass_format) {
+            *format = formats[i];
+            found = true;
+            break;
+        }
+    }
+
+    free(formats);
+    return found;
+}
+
+static bool create_plane_swapchain(struct pwc_planes *planes, PlaneAssignmentT *assignment, uint32_t stack_index, VkDisplayPlaneAlphaFlagBitsKHR alpha) {
+    VkResult U_ASSERT_ONLY err;
+    struct pwc_vulkan *vulkan = planes->vulkan;
+
+    VkDisplaySurfaceCreateInfoKHR surface_ci = {
+        .sType = VK_STRUCTURE_TYPE_DISPLAY_SURFACE_CREATE_INFO_KHR,
+        .displayMode = planes->output->display_mode,
+        .planeIndex = assignment->plane->index,
+        .planeStackIndex = stack_index,
+        .transform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+        .alphaMode = alpha,
+        .globalAlpha = 1.0f,
+        .imageExtent = assignment->extent,
+    };
+    if (vkCreateDisplayPlaneSurfaceKHR(vulkan->instance, &surface_ci, NULL, &assignment->surface) != VK_SUCCESS) return false;
+
+    VkBool32 supports_present = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(vulkan->physicalDevice, vulkan->present_queue_family_index, assignment->surface, &supports_present);
+    VkSurfaceFormatKHR format;
+    if (!supports_present || !choose_plane_format(vulkan, assignment->surface, &format)) return false;
+
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vulkan->physicalDevice, assignment->surface, &capabilities);
+
+    VkSwapchainCreateInfoKHR swapchain_ci = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+        .surface = assignment->surface,
+        .minImageCount = get_swap_image_count(capabilities),
+        .imageFormat = format.format,
+        .imageColorSpace = format.colorSpace,
+        .imageExtent = assignment->extent,
+        .imageArrayLayers = 1,
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+        .compositeAlpha = choose_swap_alpha_mode(capabilities),
+        .presentMode = VK_PRESENT_MODE_FIFO_KHR,  // Always supported
+        .clipped = VK_TRUE,
+    };
+    if (vkCreateSwapchainKHR(vulkan->device, &swapchain_ci, NULL, &assignment->swapchain) != VK_SUCCESS) return false;
+
+    vkGetSwapchainImagesKHR(vulkan->device, assignment->swapchain, &assignment->image_count, NULL);
+    assignment->images = malloc(sizeof(VkImage) * assignment->image_count);
+    assignment->image_views = calloc(assignment->image_count, sizeof(VkImageView));
+    assignment->framebuffers = calloc(assignment->image_count, sizeof(VkFramebuffer));
+    assignment->draw_complete_semaphores = calloc(assignment->image_count, sizeof(VkSemaphore));
+    assignment->image_serials = calloc(assignment->image_count, sizeof(uint64_t));
+    if (!assignment->images || !assignment->image_views || !assignment->framebuffers || !assignment->draw_complete_semaphores ||
+        !assignment->image_serials) {
+        fprintf(stderr, "Failed to allocate plane swapchain images\n");
+        return false;
+    }
+    vkGetSwapchainImagesKHR(vulkan->device, assignment->swapchain, &assignment->image_count, assignment->images);
+
+    VkSemaphoreCreateInfo semaphore_ci = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    for (uint32_t i = 0; i < assignment->image_count; i++) {
+        VkImageViewCreateInfo view_ci = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = assignment->images[i],
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = format.format,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+        };
+        err = vkCreateImageView(vulkan->device, &view_ci, NULL, &assignment->image_views[i]);
+        assert(!err);
+
+        VkFramebufferCreateInfo fb_ci = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass = vulkan->render_pass,
+            .attachmentCount = 1,
+            .pAttachments = &assignment->image_views[i],
+            .width = assignment->extent.width,
+            .height = assignment->extent.height,
+            .layers = 1,
+        };
+        err = vkCreateFramebuffer(vulkan->device, &fb_ci, NULL, &assignment->framebuffers[i]);
+        assert(!err);
+
+        err = vkCreateSemaphore(vulkan->device, &semaphore_ci, NULL, &assignment->draw_complete_semaphores[i]);
+        assert(!err);
+    }
+
+    for (int i = 0; i < FRAME_LAG; i++) {
+        err = vkCreateSemaphore(vulkan->device, &semaphore_ci, NULL, &assignment->image_acquired_semaphores[i]);
+        assert(!err);
+    }
+
+    return true;
+}
+
+PlaneAssignmentT *planes_assign(struct pwc_planes *planes, SceneNodeT *node) {
+    VkRect2D dst = scene_node_transformed_geometry(node);
+    if (node->plane_hint == SCENE_PLANE_HINT_NONE || dst.extent.width == 0 || dst.extent.height == 0) return NULL;
+
+    uint32_t slot;
+    for (slot = 0; slot < MAX_PLANE_ASSIGNMENTS; slot++) {
+        if (planes->assignments[slot].node == SCENE_NODE_HANDLE_NULL) break;
+    }
+    if (slot == MAX_PLANE_ASSIGNMENTS) return NULL;
+
+    // Cursor on top of everything, overlays stacked right above the primary plane
+    uint32_t stack_index = (node->plane_hint == SCENE_PLANE_HINT_CURSOR) ? planes->display_plane_count - 1
+                                                                         : planes->output->primary_plane_stack_index + 1 + slot;
+    if (stack_index >= planes->display_plane_count) return NULL;
+
+    for (uint32_t i = 0; i < planes->plane_count; i++) {
+        DisplayPlaneT *plane = &planes->planes[i];
+        VkDisplayPlaneAlphaFlagBitsKHR alpha;
+
+        // Another output's allocator (or primary surface) may hold it
+        if (plane->in_use || (planes->vulkan->claimed_planes & (1ull << plane->index))) continue;
+        if (!capabilities_fit(&plane->capabilities, dst)) continue;
+        if (!choose_plane_alpha(&plane->capabilities, node->plane_hint, &alpha)) continue;
+
+        PlaneAssignmentT *assignment = &planes->assignments[slot];
+        memset(assignment, 0, sizeof(PlaneAssignmentT));
+        assignment->node = node->handle;
+        assignment->plane = plane;
+        assignment->dst = dst;
+        assignment->extent = dst.extent;
+        plane->in_use = true;
+        planes->vulkan->claimed_planes |= 1ull << plane->index;
+
+        if (create_plane_swapchain(planes, assignment, stack_index, alpha)) return assignment;
+
+        // Driver refused after all, try the next plane
+        planes_release(planes, assignment);
+    }
+
+    return NULL;
+}
+
+void planes_release(struct pwc_planes *planes, PlaneAssignmentT *assignment) {
+    assert(!assignment->queued);
+
+    if (assignment->plane) {
+        poll_planes_completed(planes);
+        assert(planes->retired_count < MAX_RETIRED_PLANES);
+        // Plane frames submitted so far may still use it
+        planes->retired[planes->retired_count++] = (RetiredPlaneT){
+            .assignment = *assignment,
+            .plane_index = assignment->plane->index,
+            .retire_serial = planes->frame_serial,
+        };
+        release_retired_planes(planes, false);
+    }
+    memset(assignment, 0, sizeof(PlaneAssignmentT));
+}
+
+bool plane_fits(const PlaneAssignmentT *assignment, VkRect2D geometry) {
+    if (geometry.extent.width != assignment->extent.width || geometry.extent.height != assignment->extent.height) return false;
+    return capabilities_fit(&assignment->plane->capabilities, geometry);
+}
+
+VkCommandBuffer planes_begin_frame(struct pwc_planes *planes) {
+    VkResult U_ASSERT_ONLY err;
+    uint32_t slot = planes->frame_slot;
+    if (planes->recording) return planes->cmd[slot];
+
+    poll_planes_completed(planes);
+    if (planes->serials[slot] > planes->completed_serial) return VK_NULL_HANDLE;
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    err = vkBeginCommandBuffer(planes->cmd[slot], &begin_info);
+    assert(!err);
+    planes->recording = true;
+    return planes->cmd[slot];
+}
+
+VkResult plane_acquire(struct pwc_planes *planes, PlaneAssignmentT *assignment) {
+    assert(planes->recording && !assignment->queued);
+
+    // The slot's previous frame completed, so did the wait on its semaphore
+    VkResult err = vkAcquireNextImageKHR(planes->vulkan->device, assignment->swapchain, 0,
+                                         assignment->image_acquired_semaphores[planes->frame_slot], VK_NULL_HANDLE,
+                                         &assignment->image_index);
+    if (err == VK_TIMEOUT) return VK_NOT_READY;
+    // SUBOPTIMAL still acquired an image. OUT_OF_DATE / SURFACE_LOST: not worth recreating,
+    // the node goes back to composition
+    if (err != VK_SUCCESS && err != VK_SUBOPTIMAL_KHR) return err;
+
+    assignment->queued = true;
+    assignment->queued_serial = assignment->image_serials[assignment->image_index];
+    return VK_SUCCESS;
+}
+
+bool plane_image_current(const PlaneAssignmentT *assignment, uint64_t content_serial) {
+    return content_serial != 0 && assignment->image_serials[assignment->image_index] == content_serial;
+}
+
+void plane_begin_draw(struct pwc_planes *planes, PlaneAssignmentT *assignment) {
+    struct pwc_vulkan *vulkan = planes->vulkan;
+    VkCommandBuffer cmd = planes->cmd[planes->frame_slot];
+
+    // Transparent, so a cursor's per-pixel alpha shows what's below
+    VkClearValue clear = {{{0, 0, 0, 0}}};
+    VkRenderPassBeginInfo rp_bi = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = vulkan->render_pass,
+        .framebuffer = assignment->framebuffers[assignment->image_index],
+        .renderArea = {{0, 0}, assignment->extent},
+        .clearValueCount = 1,
+        .pClearValues = &clear,
+    };
+    vkCmdBeginRenderPass(cmd, &rp_bi, VK_SUBPASS_CONTENTS_INLINE);
+
+    // Scene nodes draw in output space: shift the output so dst lands on the image origin
+    VkViewport viewport = {(float)-assignment->dst.offset.x, (float)-assignment->dst.offset.y,
+                           (float)planes->output->swapchain_extent.width, (float)planes->output->swapchain_extent.height, 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, assignment->extent};
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void plane_end_draw(struct pwc_planes *planes, PlaneAssignmentT *assignment, uint64_t content_serial) {
+    vkCmdEndRenderPass(planes->cmd[planes->frame_slot]);
+    assignment->image_serials[assignment->image_index] = content_serial;
+    assignment->queued_serial = content_serial;
+}
+
+void planes_submit(struct pwc_planes *planes, const VkSemaphore *semaphores, const VkPipelineStageFlags *stages, uint32_t count) {
+    VkResult err;
+    struct pwc_vulkan *vulkan = planes->vulkan;
+    uint32_t slot = planes->frame_slot;
+    VkCommandBuffer cmd = planes->cmd[slot];
+    assert(planes->recording && count <= MAX_PLANE_WAITS);
+
+    err = vkEndCommandBuffer(cmd);
+    assert(!err);
+    planes->recording = false;
+
+    VkSemaphore wait_semaphores[MAX_PLANE_ASSIGNMENTS + MAX_PLANE_WAITS];
+    VkPipelineStageFlags wait_stages[MAX_PLANE_ASSIGNMENTS + MAX_PLANE_WAITS];
+    VkSemaphore signal_semaphores[MAX_PLANE_ASSIGNMENTS];
+    uint32_t wait_count = 0, signal_count = 0;
+    for (uint32_t i = 0; i < MAX_PLANE_ASSIGNMENTS; i++) {
+        PlaneAssignmentT *assignment = &planes->assignments[i];
+        if (!assignment->queued) continue;
+        wait_semaphores[wait_count] = assignment->image_acquired_semaphores[slot];
+        wait_stages[wait_count++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        signal_semaphores[signal_count++] = assignment->draw_complete_semaphores[assignment->image_index];
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        wait_semaphores[wait_count] = semaphores[i];
+        wait_stages[wait_count++] = stages[i];
+    }
+
+    vkResetFences(vulkan->device, 1, &planes->fences[slot]);
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = wait_count,
+        .pWaitSemaphores = wait_semaphores,
+        .pWaitDstStageMask = wait_stages,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmd,
+        .signalSemaphoreCount = signal_count,
+        .pSignalSemaphores = signal_semaphores,
+    };
+    err = vkQueueSubmit(vulkan->graphics_queue, 1, &submit_info, planes->fences[slot]);
+    assert(!err);
+    planes->serials[slot] = ++planes->frame_serial;
+    planes->frame_slot = (slot + 1) % FRAME_LAG;
+
+    // Each plane has its own position, presented one by one
+    for (uint32_t i = 0; i < MAX_PLANE_ASSIGNMENTS; i++) {
+        PlaneAssignmentT *assignment = &planes->assignments[i];
+        if (!assignment->queued) continue;
+        assignment->queued = false;
+
+        VkDisplayPresentInfoKHR display_present = {
+            .sType = VK_STRUCTURE_TYPE_DISPLAY_PRESENT_INFO_KHR,
+            .srcRect = {{0, 0}, assignment->extent},
+            .dstRect = assignment->dst,
+            .persistent = VK_FALSE,
+        };
+        VkPresentInfoKHR present = {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+            .pNext = &display_present,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &assignment->draw_complete_semaphores[assignment->image_index],
+            .swapchainCount = 1,
+            .pSwapchains = &assignment->swapchain,
+            .pImageIndices = &assignment->image_index,
+        };
+        err = vkQueuePresentKHR(vulkan->present_queue, &present);
+        if (err != VK_SUCCESS && err != VK_SUBOPTIMAL_KHR) {
+            assignment->lost = true;
+            continue;
+        }
+        assignment->shown = true;
+        assignment->drawn_serial = assignment->queued_serial;
+    }
+}
@@ -0,0 +1,172 @@
+#include <pwc/render/vulkan/vk-core.h>
+#include <pwc/render/vulkan/vk-present-timing.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+
+struct pwc_present_timing *create_present_timing(struct pwc_vulkan *vulkan, struct pwc_output *output) {
+    struct pwc_present_timing *timing = calloc(1, sizeof(struct pwc_present_timing));
+    if (!timing) {
+        fprintf(stderr, "Failed to allocate present timing\n");
+        return NULL;
+    }
+    timing->vulkan = vulkan;
+    timing->output = output;
+    // Mode refresh until the driver tells better
+    timing->refresh_ns = output->refresh_rate ? 1000000000000ull / output->refresh_rate : 16666667ull;
+    return timing;
+}
+
+void destroy_present_timing(struct pwc_present_timing *timing) {
+    free(timing);
+}
+
+const void *present_timing_present_info(struct pwc_present_timing *timing, uint64_t serial, VkPresentTimeGOOGLE *time,
+                                        VkPresentTimesInfoGOOGLE *info, const void *next) {
+    if (!timing->vulkan->display_timing) return next;
+    *time = (VkPresentTimeGOOGLE){
+        .presentID = (uint32_t)serial,
+        .desiredPresentTime = 0,
+    };
+    *info = (VkPresentTimesInfoGOOGLE){
+        .sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE,
+        .pNext = next,
+        .swapchainCount = 1,
+        .pTimes = time,
+    };
+    return info;
+}
+
+void present_timing_submitted(struct pwc_present_timing *timing, uint64_t serial, uint64_t now_ns) {
+    // Never reported, whoever waits for it gives up once a newer frame is
+    if (timing->pending_count == PRESENT_TIMING_PENDING) {
+        memmove(&timing->pending[0], &timing->pending[1], (PRESENT_TIMING_PENDING - 1) * sizeof(PendingPresentT));
+        timing->pending_count--;
+    }
+    timing->pending[timing->pending_count++] = (PendingPresentT){
+        .serial = serial,
+        .submit_ns = now_ns,
+        .swapchain_serial = timing->output->swapchain_serial,
+    };
+}
+
+static void pop_pending(struct pwc_present_timing *timing, uint32_t count) {
+    memmove(&timing->pending[0], &timing->pending[count], (timing->pending_count - count) * sizeof(PendingPresentT));
+    timing->pending_count -= count;
+}
+
+// The display timing refresh is per swapchain
+static void update_refresh(struct pwc_present_timing *timing) {
+    struct pwc_vulkan *vulkan = timing->vulkan;
+    struct pwc_output *output = timing->output;
+    if (!vulkan->display_timing || !output->swapchain || timing->refresh_swapchain_serial == output->swapchain_serial) return;
+
+    VkRefreshCycleDurationGOOGLE duration;
+    if (vulkan->get_refresh_cycle_duration(vulkan->device, output->swapchain, &duration) == VK_SUCCESS &&
+        duration.refreshDuration > 0) {
+        timing->refresh_ns = duration.refreshDuration;
+    }
+    timing->refresh_swapchain_serial = output->swapchain_serial;
+}
+
+// Vblank count at time_ns: read back from the swapchain counter, else counted on from the
+// last reported vblank
+static uint64_t sequence_at(struct pwc_present_timing *timing, uint64_t time_ns, uint64_t now_ns) {
+    struct pwc_vulkan *vulkan = timing->vulkan;
+    struct pwc_output *output = timing->output;
+    uint64_t refresh = timing->refresh_ns;
+
+    uint64_t counter;
+    if (output->vblank_counter && output->swapchain &&
+        vulkan->get_swapchain_counter(vulkan->device, output->swapchain, VK_SURFACE_COUNTER_VBLANK_BIT_EXT, &counter) == VK_SUCCESS) {
+        uint64_t behind = now_ns > time_ns ? (now_ns - time_ns + refresh / 2) / refresh : 0;
+        return counter > behind ? counter - behind : 0;
+    }
+    if (timing->last_time_ns == 0 || time_ns <= timing->last_time_ns) return timing->last_sequence;
+    return timing->last_sequence + (time_ns - timing->last_time_ns + refresh / 2) / refresh;
+}
+
+static void report(struct pwc_present_timing *timing, PresentedFrameT *frame, uint64_t serial, uint64_t time_ns, uint32_t flags,
+                   uint64_t now_ns) {
+    uint64_t sequence = sequence_at(timing, time_ns, now_ns);
+    *frame = (PresentedFrameT){
+        .serial = serial,
+        .time_ns = time_ns,
+        .refresh_ns = timing->refresh_ns,
+        .sequence = sequence,
+        .flags = flags,
+    };
+    timing->last_time_ns = time_ns;
+    timing->last_sequence = sequence;
+}
+
+// Presents to the current swapchain the driver reported. Earlier ones it skipped never showed
+static uint32_t poll_display_timing(struct pwc_present_timing *timing, uint64_t now_ns, PresentedFrameT *frames) {
+    struct pwc_vulkan *vulkan = timing->vulkan;
+    struct pwc_output *output = timing->output;
+    VkPastPresentationTimingGOOGLE past[PRESENT_TIMING_PENDING];
+    uint32_t past_count = PRESENT_TIMING_PENDING;
+    VkResult result = vulkan->get_past_presentation_timing(vulkan->device, output->swapchain, &past_count, past);
+    if (result != VK_SUCCESS && result != VK_INCOMPLETE) return 0;
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < past_count; i++) {
+        uint32_t match = UINT32_MAX;
+        for (uint32_t j = 0; j < timing->pending_count; j++) {
+            if ((uint32_t)timing->pending[j].serial == past[i].presentID) {
+                match = j;
+                break;
+            }
+        }
+        if (match == UINT32_MAX) continue;
+
+        for (uint32_t j = 0; j < match; j++) {
+            frames[count++] = (PresentedFrameT){.serial = timing->pending[j].serial, .discarded = true};
+        }
+        report(timing, &frames[count++], timing->pending[match].serial, past[i].actualPresentTime,
+               PRESENTED_VSYNC | PRESENTED_HW_CLOCK | PRESENTED_HW_COMPLETION, now_ns);
+        pop_pending(timing, match + 1);
+    }
+    return count;
+}
+
+uint32_t present_timing_poll(struct pwc_present_timing *timing, uint64_t now_ns, PresentedFrameT *frames) {
+    struct pwc_vulkan *vulkan = timing->vulkan;
+    struct pwc_output *output = timing->output;
+    if (timing->pending_count == 0) return 0;
+    update_refresh(timing);
+
+    uint32_t count = 0;
+    if (vulkan->display_timing && output->swapchain) count = poll_display_timing(timing, now_ns, frames);
+
+    // Estimated: the first vblank after the submission, once the frame completed
+    if (timing->pending_count > 0 && timing->pending[0].serial > output->completed_serial) {
+        poll_frames_completed(vulkan, output);
+    }
+    uint64_t refresh = timing->refresh_ns;
+    while (timing->pending_count > 0) {
+        PendingPresentT *pending = &timing->pending[0];
+        if (pending->serial > output->completed_serial) break;
+        // The driver reports it soon, unless it went quiet
+        bool reported = vulkan->display_timing && pending->swapchain_serial == output->swapchain_serial;
+        if (reported && now_ns - pending->submit_ns < PRESENT_TIMING_TIMEOUT_NS) break;
+
+        uint64_t time_ns = now_ns;
+        if (timing->last_time_ns != 0) {
+            uint64_t cycles = 1;
+            if (pending->submit_ns > timing->last_time_ns) {
+                cycles = (pending->submit_ns - timing->last_time_ns + refresh - 1) / refresh;
+                if (cycles == 0) cycles = 1;
+            }
+            time_ns = timing->last_time_ns + cycles * refresh;
+            // Still queued for that vblank
+            if (time_ns > now_ns) break;
+        }
+        report(timing, &frames[count++], pending->serial, time_ns, PRESENTED_VSYNC, now_ns);
+        pop_pending(timing, 1);
+    }
+    return count;
+}
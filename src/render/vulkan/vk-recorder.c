@@ -0,0 +1,253 @@
+#include <assert.h>
+#include <pwc/render/utils/macro.h>
+#include <pwc/render/utils/thread-pool.h>
+#include <pwc/render/vulkan/vk-recorder.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vulkan/vulkan_core.h>
+
+struct pwc_recorder *create_recorder(struct pwc_vulkan *vulkan, struct pwc_thread_pool *threads, void *user_data) {
+    VkResult U_ASSERT_ONLY err;
+
+    struct pwc_recorder *recorder = calloc(1, sizeof(struct pwc_recorder));
+    if (!recorder) {
+        fprintf(stderr, "Failed to allocate recorder\n");
+        return NULL;
+    }
+
+    recorder->vulkan = vulkan;
+    recorder->threads = threads;
+    recorder->user_data = user_data;
+
+    for (uint32_t slot = 0; slot < FRAME_LAG; slot++) {
+        recorder->pools[slot] = calloc(threads->thread_count, sizeof(RecorderCommandPoolT));
+        if (!recorder->pools[slot]) {
+            fprintf(stderr, "Failed to allocate recorder command pools\n");
+            destroy_recorder(recorder);
+            return NULL;
+        }
+
+        for (uint32_t i = 0; i < threads->thread_count; i++) {
+            // Secondaries are re-recorded every frame, the whole pool is reset at once
+            VkCommandPoolCreateInfo pool_ci = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .queueFamilyIndex = vulkan->graphics_queue_family_index,
+                .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            };
+            err = vkCreateCommandPool(vulkan->device, &pool_ci, NULL, &recorder->pools[slot][i].pool);
+            assert(!err);
+        }
+    }
+
+    return recorder;
+}
+
+void destroy_recorder(struct pwc_recorder *recorder) {
+    if (!recorder) return;
+
+    for (uint32_t slot = 0; slot < FRAME_LAG; slot++) {
+        if (!recorder->pools[slot]) continue;
+
+        for (uint32_t i = 0; i < recorder->threads->thread_count; i++) {
+            RecorderCommandPoolT *pool = &recorder->pools[slot][i];
+            // Destroying the pool frees its command buffers
+            if (pool->pool) vkDestroyCommandPool(recorder->vulkan->device, pool->pool, NULL);
+            free(pool->buffers);
+        }
+        free(recorder->pools[slot]);
+    }
+
+    free(recorder->jobs);
+    free(recorder->executed);
+    free(recorder);
+}
+
+void recorder_begin_frame(struct pwc_recorder *recorder, uint32_t frame_slot, VkRenderPass render_pass, VkFramebuffer framebuffer,
+                          VkExtent2D extent, VkRect2D scissor) {
+    VkResult U_ASSERT_ONLY err;
+
+    recorder->frame_slot = frame_slot;
+    recorder->job_count = 0;
+    recorder->extent = extent;
+    recorder->scissor = scissor;
+    recorder->inheritance = (VkCommandBufferInheritanceInfo){
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .renderPass = render_pass,
+        .subpass = 0,
+        .framebuffer = framebuffer,
+    };
+    recorder->persistent_inheritance = recorder->inheritance;
+    recorder->persistent_inheritance.framebuffer = VK_NULL_HANDLE;
+
+    for (uint32_t i = 0; i < recorder->threads->thread_count; i++) {
+        RecorderCommandPoolT *pool = &recorder->pools[frame_slot][i];
+        if (pool->used == 0) continue;
+
+        err = vkResetCommandPool(recorder->vulkan->device, pool->pool, 0);
+        assert(!err);
+        pool->used = 0;
+    }
+}
+
+static RecordJobT *push_job(struct pwc_recorder *recorder) {
+    if (recorder->job_count >= recorder->job_capacity) {
+        uint32_t new_capacity = (recorder->job_capacity == 0) ? 16 : recorder->job_capacity * 2;
+        RecordJobT *new_jobs = realloc(recorder->jobs, new_capacity * sizeof(RecordJobT));
+        VkCommandBuffer *new_executed = realloc(recorder->executed, new_capacity * sizeof(VkCommandBuffer));
+        if (new_jobs) recorder->jobs = new_jobs;
+        if (new_executed) recorder->executed = new_executed;
+        if (!new_jobs || !new_executed) {
+            fprintf(stderr, "Failed to realloc recorder jobs\n");
+            return NULL;
+        }
+        recorder->job_capacity = new_capacity;
+    }
+
+    RecordJobT *job = &recorder->jobs[recorder->job_count++];
+    job->fn = NULL;
+    job->arg = NULL;
+    job->target = VK_NULL_HANDLE;
+    job->recorded = NULL;
+    job->cmd = VK_NULL_HANDLE;
+    job->recorder = recorder;
+
+    return job;
+}
+
+void recorder_add_job(struct pwc_recorder *recorder, pwc_record_fn fn, void *arg) {
+    RecordJobT *job = push_job(recorder);
+    if (!job) return;
+
+    job->fn = fn;
+    job->arg = arg;
+}
+
+void recorder_add_persistent_job(struct pwc_recorder *recorder, pwc_record_fn fn, void *arg, VkCommandBuffer target,
+                                 pwc_record_fn recorded) {
+    RecordJobT *job = push_job(recorder);
+    if (!job) return;
+
+    job->fn = fn;
+    job->arg = arg;
+    job->target = target;
+    job->recorded = recorded;
+}
+
+void recorder_add_prerecorded(struct pwc_recorder *recorder, VkCommandBuffer cmd) {
+    RecordJobT *job = push_job(recorder);
+    if (!job) return;
+
+    job->cmd = cmd;
+}
+
+static VkCommandBuffer get_secondary(struct pwc_recorder *recorder, uint32_t worker_index) {
+    VkResult U_ASSERT_ONLY err;
+    RecorderCommandPoolT *pool = &recorder->pools[recorder->frame_slot][worker_index];
+
+    if (pool->used >= pool->count) {
+        uint32_t new_count = (pool->count == 0) ? 4 : pool->count * 2;
+        VkCommandBuffer *new_buffers = realloc(pool->buffers, new_count * sizeof(VkCommandBuffer));
+        if (!new_buffers) {
+            fprintf(stderr, "Failed to realloc secondary command buffers\n");
+            return VK_NULL_HANDLE;
+        }
+        pool->buffers = new_buffers;
+
+        VkCommandBufferAllocateInfo alloc_ci = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pool->pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = new_count - pool->count,
+        };
+        err = vkAllocateCommandBuffers(recorder->vulkan->device, &alloc_ci, &pool->buffers[pool->count]);
+        assert(!err);
+        pool->count = new_count;
+    }
+
+    return pool->buffers[pool->used++];
+}
+
+static void record_job(void *arg, uint32_t worker_index) {
+    VkResult err;
+    RecordJobT *job = arg;
+    struct pwc_recorder *recorder = job->recorder;
+
+    VkCommandBuffer cmd;
+    VkRect2D scissor;
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+    };
+
+    if (job->target) {
+        // Persistent: begin implicitly resets the buffer (pool has RESET_COMMAND_BUFFER_BIT)
+        cmd = job->target;
+        begin_info.pInheritanceInfo = &recorder->persistent_inheritance;
+        scissor = (VkRect2D){{0, 0}, recorder->extent};
+    } else {
+        // Only this worker ever touches its own pool, no locking needed
+        cmd = get_secondary(recorder, worker_index);
+        if (!cmd) return;
+        begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        begin_info.pInheritanceInfo = &recorder->inheritance;
+        scissor = recorder->scissor;
+    }
+
+    err = vkBeginCommandBuffer(cmd, &begin_info);
+    if (err != VK_SUCCESS) {
+        fprintf(stderr, "Failed to begin secondary command buffer\n");
+        return;
+    }
+
+    // Viewport/scissor are not inherited by secondaries
+    VkViewport viewport = {0, 0, (float)recorder->extent.width, (float)recorder->extent.height, 0.0f, 1.0f};
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    job->fn(recorder, cmd, job->arg);
+
+    // A buffer that failed to end is neither executed nor reported as recorded
+    err = vkEndCommandBuffer(cmd);
+    if (err != VK_SUCCESS) {
+        fprintf(stderr, "Failed to end secondary command buffer\n");
+        return;
+    }
+    job->cmd = cmd;
+}
+
+void recorder_execute(struct pwc_recorder *recorder, VkCommandBuffer primary) {
+    if (recorder->job_count == 0) return;
+
+    uint32_t pending = 0;
+    RecordJobT *last = NULL;
+    for (uint32_t i = 0; i < recorder->job_count; i++) {
+        if (recorder->jobs[i].fn) {
+            pending++;
+            last = &recorder->jobs[i];
+        }
+    }
+
+    // A single job isn't worth a thread hop
+    if (pending == 1) {
+        record_job(last, 0);
+    } else if (pending > 1) {
+        for (uint32_t i = 0; i < recorder->job_count; i++) {
+            if (!recorder->jobs[i].fn) continue;
+            if (!thread_pool_submit(recorder->threads, record_job, &recorder->jobs[i])) {
+                fprintf(stderr, "Failed to submit record job %u\n", i);
+            }
+        }
+        thread_pool_wait(recorder->threads);
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < recorder->job_count; i++) {
+        RecordJobT *job = &recorder->jobs[i];
+        if (!job->cmd) continue;
+        recorder->executed[count++] = job->cmd;
+        if (job->target && job->recorded) job->recorded(recorder, job->cmd, job->arg);
+    }
+
+    if (count > 0) vkCmdExecuteCommands(primary, count, recorder->executed);
+}
@@ -0,0 +1,599 @@
+#include <assert.h>
+#include <math.h>
+#include <pwc/render/utils/macro.h>
+#include <pwc/render/vulkan/vk-core.h>
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+
+typedef struct TexturePush {
+    float rect[4];
+    float uv_rect[4];
+    float opacity;
+    uint32_t transform;
+    uint32_t sampling;  // TEXTURE_SAMPLING_*
+} TexturePushT;
+
+enum TextureSampling {
+    TEXTURE_SAMPLING_LINEAR,
+    TEXTURE_SAMPLING_NEAREST,
+    TEXTURE_SAMPLING_DOWNSCALE,  // textures->downscale_pipeline
+};
+
+// Texels are 1:1 within this, in texels
+#define TEXEL_EPSILON 0.01f
+
+// Every variant shares surface.vert and the pipeline layout
+static bool create_texture_pipeline(struct pwc_textures *textures, const char *frag_name, VkPipeline *pipeline) {
+    struct pwc_vulkan *vulkan = textures->vulkan;
+
+    VkShaderModule vert = load_shader(vulkan, "surface.vert.spv");
+    VkShaderModule frag = load_shader(vulkan, frag_name);
+    if (!vert || !frag) {
+        if (vert) vkDestroyShaderModule(vulkan->device, vert, NULL);
+        if (frag) vkDestroyShaderModule(vulkan->device, frag, NULL);
+        return false;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2] = {
+        {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, .stage = VK_SHADER_STAGE_VERTEX_BIT, .module = vert, .pName = "main"},
+        {.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, .stage = VK_SHADER_STAGE_FRAGMENT_BIT, .module = frag, .pName = "main"},
+    };
+    VkPipelineVertexInputStateCreateInfo vertex_input = {.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+    };
+    // Viewport and scissor are set by whoever owns the pass
+    VkPipelineViewportStateCreateInfo viewport_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+    VkDynamicState dynamic_states[2] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = ARRAY_SIZE(dynamic_states),
+        .pDynamicStates = dynamic_states,
+    };
+    VkPipelineRasterizationStateCreateInfo rasterization = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        .lineWidth = 1.0f,
+    };
+    VkPipelineMultisampleStateCreateInfo multisample = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    };
+    // Premultiplied over
+    VkPipelineColorBlendAttachmentState blend_attachment = {
+        .blendEnable = VK_TRUE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+    VkPipelineColorBlendStateCreateInfo blend = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &blend_attachment,
+    };
+    VkGraphicsPipelineCreateInfo pipeline_ci = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = ARRAY_SIZE(stages),
+        .pStages = stages,
+        .pVertexInputState = &vertex_input,
+        .pInputAssemblyState = &input_assembly,
+        .pViewportState = &viewport_state,
+        .pRasterizationState = &rasterization,
+        .pMultisampleState = &multisample,
+        .pColorBlendState = &blend,
+        .pDynamicState = &dynamic_state,
+        .layout = textures->pipeline_layout,
+        .renderPass = vulkan->render_pass,
+        .subpass = 0,
+    };
+    VkResult result = vkCreateGraphicsPipelines(vulkan->device, VK_NULL_HANDLE, 1, &pipeline_ci, NULL, pipeline);
+    vkDestroyShaderModule(vulkan->device, vert, NULL);
+    vkDestroyShaderModule(vulkan->device, frag, NULL);
+    if (result) {
+        fprintf(stderr, "Failed to create texture pipeline %s\n", frag_name);
+        return false;
+    }
+    return true;
+}
+
+struct pwc_textures *create_textures(struct pwc_vulkan *vulkan) {
+    VkResult U_ASSERT_ONLY err;
+
+    struct pwc_textures *textures = calloc(1, sizeof(struct pwc_textures));
+    if (!textures) {
+        fprintf(stderr, "Failed to allocate textures\n");
+        return NULL;
+    }
+    textures->vulkan = vulkan;
+
+    VkSamplerCreateInfo sampler_ci = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = 0.0f,
+    };
+    err = vkCreateSampler(vulkan->device, &sampler_ci, NULL, &textures->sampler);
+    assert(!err);
+    sampler_ci.magFilter = VK_FILTER_NEAREST;
+    sampler_ci.minFilter = VK_FILTER_NEAREST;
+    err = vkCreateSampler(vulkan->device, &sampler_ci, NULL, &textures->nearest_sampler);
+    assert(!err);
+
+    // The same image through either sampler, see TEXTURE_SAMPLING_NEAREST
+    VkDescriptorSetLayoutBinding bindings[2] = {
+        {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = &textures->sampler,
+        },
+        {
+            .binding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = &textures->nearest_sampler,
+        },
+    };
+    VkDescriptorSetLayoutCreateInfo set_layout_ci = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = ARRAY_SIZE(bindings),
+        .pBindings = bindings,
+    };
+    err = vkCreateDescriptorSetLayout(vulkan->device, &set_layout_ci, NULL, &textures->set_layout);
+    assert(!err);
+
+    VkPushConstantRange push_range = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        .offset = 0,
+        .size = sizeof(TexturePushT),
+    };
+    VkPipelineLayoutCreateInfo layout_ci = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &textures->set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    };
+    err = vkCreatePipelineLayout(vulkan->device, &layout_ci, NULL, &textures->pipeline_layout);
+    assert(!err);
+
+    textures->enabled = create_texture_pipeline(textures, "surface.frag.spv", &textures->pipeline);
+    if (!textures->enabled) {
+        fprintf(stderr, "Surface shaders unavailable, client surfaces are not drawn\n");
+    } else if (!create_texture_pipeline(textures, "surface-downscale.frag.spv", &textures->downscale_pipeline)) {
+        textures->downscale_pipeline = VK_NULL_HANDLE;
+        fprintf(stderr, "Downscale shader unavailable, minified surfaces are sampled linearly\n");
+    }
+    return textures;
+}
+
+static void destroy_image(struct pwc_textures *textures, TextureImageT *image) {
+    VkDevice device = textures->vulkan->device;
+    if (image->sample_set) {
+        TexturePoolT *pool = &textures->pools[image->sample_pool];
+        vkFreeDescriptorSets(device, pool->pool, 1, &image->sample_set);
+        pool->used--;
+    }
+    if (image->view) vkDestroyImageView(device, image->view, NULL);
+    if (image->image) vkDestroyImage(device, image->image, NULL);
+    if (image->mem) vkFreeMemory(device, image->mem, NULL);
+    memset(image, 0, sizeof(TextureImageT));
+}
+
+void destroy_textures(struct pwc_textures *textures) {
+    if (!textures) return;
+    VkDevice device = textures->vulkan->device;
+
+    for (uint32_t i = 0; i < textures->retired_count; i++) {
+        destroy_image(textures, &textures->retired[i]);
+    }
+    free(textures->retired);
+    free(textures->acquires);
+    if (textures->pipeline) vkDestroyPipeline(device, textures->pipeline, NULL);
+    if (textures->downscale_pipeline) vkDestroyPipeline(device, textures->downscale_pipeline, NULL);
+    if (textures->pipeline_layout) vkDestroyPipelineLayout(device, textures->pipeline_layout, NULL);
+    for (uint32_t i = 0; i < textures->pool_count; i++) {
+        vkDestroyDescriptorPool(device, textures->pools[i].pool, NULL);
+    }
+    free(textures->pools);
+    if (textures->set_layout) vkDestroyDescriptorSetLayout(device, textures->set_layout, NULL);
+    if (textures->sampler) vkDestroySampler(device, textures->sampler, NULL);
+    if (textures->nearest_sampler) vkDestroySampler(device, textures->nearest_sampler, NULL);
+    free(textures);
+}
+
+// From the first pool with a set left, counted here: Vulkan 1.0 doesn't report exhaustion
+static bool alloc_sample_set(struct pwc_textures *textures, TextureImageT *image) {
+    struct pwc_vulkan *vulkan = textures->vulkan;
+    uint32_t index = 0;
+    while (index < textures->pool_count && textures->pools[index].used >= TEXTURE_POOL_SETS) index++;
+
+    if (index == textures->pool_count) {
+        if (textures->pool_count >= textures->pool_capacity) {
+            uint32_t new_capacity = (textures->pool_capacity == 0) ? 4 : textures->pool_capacity * 2;
+            TexturePoolT *new_pools = realloc(textures->pools, new_capacity * sizeof(TexturePoolT));
+            if (!new_pools) {
+                fprintf(stderr, "Failed to realloc texture descriptor pools\n");
+                return false;
+            }
+            textures->pools = new_pools;
+            textures->pool_capacity = new_capacity;
+        }
+        // Each set holds the image twice, once per sampler
+        VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * TEXTURE_POOL_SETS};
+        VkDescriptorPoolCreateInfo pool_ci = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+            .maxSets = TEXTURE_POOL_SETS,
+            .poolSizeCount = 1,
+            .pPoolSizes = &pool_size,
+        };
+        VkDescriptorPool pool;
+        if (vkCreateDescriptorPool(vulkan->device, &pool_ci, NULL, &pool) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create a texture descriptor pool\n");
+            return false;
+        }
+        textures->pools[textures->pool_count++] = (TexturePoolT){pool, 0};
+    }
+
+    TexturePoolT *pool = &textures->pools[index];
+    VkDescriptorSetAllocateInfo set_ai = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = pool->pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &textures->set_layout,
+    };
+    if (vkAllocateDescriptorSets(vulkan->device, &set_ai, &image->sample_set) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate a texture descriptor set\n");
+        image->sample_set = VK_NULL_HANDLE;
+        return false;
+    }
+    pool->used++;
+    image->sample_pool = index;
+    return true;
+}
+
+static bool create_sample_set(struct pwc_textures *textures, TextureImageT *image, VkFormat format, bool opaque) {
+    VkResult U_ASSERT_ONLY err;
+    struct pwc_vulkan *vulkan = textures->vulkan;
+
+    VkImageViewCreateInfo view_ci = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image->image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = format,
+        .components = {.a = opaque ? VK_COMPONENT_SWIZZLE_ONE : VK_COMPONENT_SWIZZLE_IDENTITY},
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    err = vkCreateImageView(vulkan->device, &view_ci, NULL, &image->view);
+    assert(!err);
+
+    if (!alloc_sample_set(textures, image)) return false;
+    VkDescriptorImageInfo image_info = {.imageView = image->view, .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkWriteDescriptorSet writes[2];
+    for (uint32_t i = 0; i < ARRAY_SIZE(writes); i++) {
+        writes[i] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = image->sample_set,
+            .dstBinding = i,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &image_info,
+        };
+    }
+    vkUpdateDescriptorSets(vulkan->device, ARRAY_SIZE(writes), writes, 0, NULL);
+    return true;
+}
+
+static bool create_image(struct pwc_textures *textures, TextureImageT *image, VkExtent2D extent, VkFormat format, bool opaque) {
+    VkResult U_ASSERT_ONLY err;
+    struct pwc_vulkan *vulkan = textures->vulkan;
+
+    // Concurrent: uploads update rects in place without ownership transfers
+    uint32_t families[2] = {vulkan->graphics_queue_family_index, vulkan->transfer_queue_family_index};
+    VkImageCreateInfo image_ci = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = {extent.width, extent.height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = vulkan->separate_transfer_queue ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = vulkan->separate_transfer_queue ? 2 : 0,
+        .pQueueFamilyIndices = families,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    if (vkCreateImage(vulkan->device, &image_ci, NULL, &image->image) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create %ux%u texture\n", extent.width, extent.height);
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(vulkan->device, image->image, &requirements);
+    VkMemoryAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = find_memory_type(vulkan, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    };
+    if (alloc_info.memoryTypeIndex == UINT32_MAX ||
+        vkAllocateMemory(vulkan->device, &alloc_info, NULL, &image->mem) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate %ux%u texture\n", extent.width, extent.height);
+        return false;
+    }
+    err = vkBindImageMemory(vulkan->device, image->image, image->mem, 0);
+    assert(!err);
+    return create_sample_set(textures, image, format, opaque);
+}
+
+bool texture_init(struct pwc_textures *textures, TextureT *texture, VkExtent2D extent, VkFormat format, bool opaque) {
+    memset(texture, 0, sizeof(TextureT));
+    if (!textures->enabled || extent.width == 0 || extent.height == 0) return false;
+
+    for (uint32_t i = 0; i < TEXTURE_IMAGES; i++) {
+        if (!create_image(textures, &texture->images[i], extent, format, opaque)) {
+            for (uint32_t j = 0; j <= i; j++) destroy_image(textures, &texture->images[j]);
+            return false;
+        }
+    }
+    texture->extent = extent;
+    texture->format = format;
+    texture->opaque = opaque;
+    return true;
+}
+
+bool textures_add_reader(struct pwc_textures *textures, VkFence fence) {
+    if (textures->reader_count >= TEXTURE_MAX_READERS) {
+        fprintf(stderr, "Too many texture readers\n");
+        return false;
+    }
+    textures->readers[textures->reader_count++] = fence;
+    return true;
+}
+
+// Every frame submitted so far may sample the image, and so may every reader in flight.
+// A reader fence reused for a later submission only makes the wait longer
+static void retire_image(struct pwc_textures *textures, TextureImageT *image) {
+    struct pwc_vulkan *vulkan = textures->vulkan;
+    for (uint32_t i = 0; i < vulkan->output_count; i++) {
+        image->retired_serial[i] = vulkan->outputs[i].frame_serial;
+    }
+    image->reader_mask = 0;
+    for (uint32_t i = 0; i < textures->reader_count; i++) {
+        if (vkGetFenceStatus(vulkan->device, textures->readers[i]) == VK_NOT_READY) image->reader_mask |= 1u << i;
+    }
+}
+
+static bool image_in_flight(struct pwc_textures *textures, TextureImageT *image) {
+    struct pwc_vulkan *vulkan = textures->vulkan;
+    for (uint32_t i = 0; i < vulkan->output_count; i++) {
+        struct pwc_output *output = &vulkan->outputs[i];
+        if (image->retired_serial[i] <= output->completed_serial) continue;
+        // An idle output only looks at the slot it reuses next
+        poll_frames_completed(vulkan, output);
+        if (image->retired_serial[i] > output->completed_serial) return true;
+    }
+    for (uint32_t i = 0; i < textures->reader_count; i++) {
+        if (!(image->reader_mask & (1u << i))) continue;
+        if (vkGetFenceStatus(vulkan->device, textures->readers[i]) == VK_NOT_READY) return true;
+        image->reader_mask &= ~(1u << i);
+    }
+    return false;
+}
+
+bool texture_import(struct pwc_textures *textures, TextureT *texture, VkImage image, VkDeviceMemory mem, VkExtent2D extent,
+                    VkFormat format, bool opaque) {
+    memset(texture, 0, sizeof(TextureT));
+    texture->images[0].image = image;
+    texture->images[0].mem = mem;
+    if (!textures->enabled || !create_sample_set(textures, &texture->images[0], format, opaque)) {
+        destroy_image(textures, &texture->images[0]);
+        return false;
+    }
+    // Contents are the client's, SHADER_READ_ONLY_OPTIMAL once acquired
+    texture->images[0].initialized = true;
+    texture->extent = extent;
+    texture->format = format;
+    texture->opaque = opaque;
+    texture->imported = true;
+    texture_acquire_import(textures, texture);
+    return true;
+}
+
+void texture_acquire_import(struct pwc_textures *textures, TextureT *texture) {
+    VkImage image = texture->images[0].image;
+    for (uint32_t i = 0; i < textures->acquire_count; i++) {
+        if (textures->acquires[i] == image) return;
+    }
+    if (textures->acquire_count >= textures->acquire_capacity) {
+        uint32_t new_capacity = (textures->acquire_capacity == 0) ? 16 : textures->acquire_capacity * 2;
+        VkImage *new_acquires = realloc(textures->acquires, new_capacity * sizeof(VkImage));
+        if (!new_acquires) {
+            fprintf(stderr, "Failed to realloc texture acquires\n");
+            return;
+        }
+        textures->acquires = new_acquires;
+        textures->acquire_capacity = new_capacity;
+    }
+    textures->acquires[textures->acquire_count++] = image;
+}
+
+// Implicit sync orders the client's rendering before the submission. Ownership isn't released
+// back between commits: cached command buffers don't tell which frame sampled the image last,
+// and for uncompressed modifiers the transfer is a no-op anyway
+void textures_record_acquires(struct pwc_textures *textures, VkCommandBuffer cmd) {
+    if (textures->acquire_count == 0) return;
+    struct pwc_vulkan *vulkan = textures->vulkan;
+
+    VkImageMemoryBarrier barriers[16];
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < textures->acquire_count; i++) {
+        barriers[count++] = (VkImageMemoryBarrier){
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .srcQueueFamilyIndex = vulkan->queue_family_foreign ? VK_QUEUE_FAMILY_FOREIGN_EXT : VK_QUEUE_FAMILY_EXTERNAL,
+            .dstQueueFamilyIndex = vulkan->graphics_queue_family_index,
+            .image = textures->acquires[i],
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+        };
+        if (count == ARRAY_SIZE(barriers) || i + 1 == textures->acquire_count) {
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL,
+                                 count, barriers);
+            count = 0;
+        }
+    }
+    textures->acquire_count = 0;
+}
+
+void texture_retire(struct pwc_textures *textures, TextureT *texture) {
+    retire_image(textures, &texture->images[texture->front]);
+}
+
+bool texture_busy(struct pwc_textures *textures, TextureT *texture) {
+    return image_in_flight(textures, &texture->images[texture->front]);
+}
+
+void texture_finish(struct pwc_textures *textures, TextureT *texture) {
+    // Never acquired, nothing to wait for
+    for (uint32_t i = 0; i < textures->acquire_count; i++) {
+        if (textures->acquires[i] != texture->images[0].image) continue;
+        textures->acquires[i] = textures->acquires[--textures->acquire_count];
+        break;
+    }
+    for (uint32_t i = 0; i < TEXTURE_IMAGES; i++) {
+        TextureImageT *image = &texture->images[i];
+        if (!image->image) continue;
+        if (i == texture->front) retire_image(textures, image);
+        if (!image_in_flight(textures, image)) {
+            destroy_image(textures, image);
+            continue;
+        }
+
+        if (textures->retired_count >= textures->retired_capacity) {
+            uint32_t new_capacity = (textures->retired_capacity == 0) ? 16 : textures->retired_capacity * 2;
+            TextureImageT *new_retired = realloc(textures->retired, new_capacity * sizeof(TextureImageT));
+            if (!new_retired) {
+                // Leaking beats destroying an image the GPU may still read
+                fprintf(stderr, "Failed to realloc retired textures\n");
+                continue;
+            }
+            textures->retired = new_retired;
+            textures->retired_capacity = new_capacity;
+        }
+        textures->retired[textures->retired_count++] = *image;
+    }
+    memset(texture, 0, sizeof(TextureT));
+}
+
+void textures_sweep(struct pwc_textures *textures) {
+    for (uint32_t i = textures->retired_count; i-- > 0;) {
+        if (image_in_flight(textures, &textures->retired[i])) continue;
+        destroy_image(textures, &textures->retired[i]);
+        textures->retired[i] = textures->retired[--textures->retired_count];
+    }
+}
+
+TextureImageT *texture_begin_update(struct pwc_textures *textures, TextureT *texture, const DamageRegionT *damage,
+                                    DamageRegionT *region) {
+    TextureImageT *back = &texture->images[(texture->front + 1) % TEXTURE_IMAGES];
+    if (image_in_flight(textures, back)) return NULL;
+
+    if (!back->initialized) {
+        damage_set_whole(region, texture->extent);
+        return back;
+    }
+    *region = back->missing;
+    damage_add_region(region, damage);
+    damage_clip(region, texture->extent);
+    return back;
+}
+
+void texture_end_update(struct pwc_textures *textures, TextureT *texture, const DamageRegionT *damage) {
+    uint32_t back_index = (texture->front + 1) % TEXTURE_IMAGES;
+    TextureImageT *front = &texture->images[texture->front];
+    TextureImageT *back = &texture->images[back_index];
+
+    back->initialized = true;
+    damage_clear(&back->missing);
+    // The old front lacks this update, it gets it with the next one
+    damage_add_region(&front->missing, damage);
+    retire_image(textures, front);
+    texture->front = back_index;
+}
+
+static bool whole_texel(float texels) {
+    return fabsf(texels - roundf(texels)) < TEXEL_EPSILON;
+}
+
+// By how many pixels a shown texel covers: nearest when exactly one and aligned (the client
+// rendered at the output's scale), the downscale variant when less than half, linear
+// otherwise
+static enum TextureSampling choose_sampling(struct pwc_textures *textures, const TextureT *texture, VkRect2D dst,
+                                            const float uv_rect[4], uint32_t transform) {
+    // uv_rect is in surface orientation, 90 and 270 swap the image's axes
+    bool swapped = transform & 1;
+    float image_width = (float)(swapped ? texture->extent.height : texture->extent.width);
+    float image_height = (float)(swapped ? texture->extent.width : texture->extent.height);
+    float texels_x = fabsf(uv_rect[2] - uv_rect[0]) * image_width;
+    float texels_y = fabsf(uv_rect[3] - uv_rect[1]) * image_height;
+    if (texels_x <= 0.0f || texels_y <= 0.0f) return TEXTURE_SAMPLING_LINEAR;
+
+    if (fabsf(dst.extent.width - texels_x) < TEXEL_EPSILON && fabsf(dst.extent.height - texels_y) < TEXEL_EPSILON &&
+        whole_texel(uv_rect[0] * image_width) && whole_texel(uv_rect[1] * image_height)) {
+        return TEXTURE_SAMPLING_NEAREST;
+    }
+    float ratio = fminf(dst.extent.width / texels_x, dst.extent.height / texels_y);
+    if (ratio < 0.5f && textures->downscale_pipeline) return TEXTURE_SAMPLING_DOWNSCALE;
+    return TEXTURE_SAMPLING_LINEAR;
+}
+
+void textures_draw(struct pwc_textures *textures, VkCommandBuffer cmd, const TextureT *texture, VkRect2D dst,
+                   const float uv_rect[4], uint32_t transform, VkExtent2D extent, float opacity) {
+    const TextureImageT *image = &texture->images[texture->front];
+    if (!textures->enabled || !image->initialized) return;
+
+    enum TextureSampling sampling = choose_sampling(textures, texture, dst, uv_rect, transform);
+    TexturePushT push = {
+        .rect = {
+            2.0f * dst.offset.x / extent.width - 1.0f,
+            2.0f * dst.offset.y / extent.height - 1.0f,
+            2.0f * (dst.offset.x + (float)dst.extent.width) / extent.width - 1.0f,
+            2.0f * (dst.offset.y + (float)dst.extent.height) / extent.height - 1.0f,
+        },
+        .uv_rect = {uv_rect[0], uv_rect[1], uv_rect[2], uv_rect[3]},
+        .opacity = opacity,
+        .transform = transform,
+        .sampling = sampling,
+    };
+    VkPipeline pipeline = sampling == TEXTURE_SAMPLING_DOWNSCALE ? textures->downscale_pipeline : textures->pipeline;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, textures->pipeline_layout, 0, 1, &image->sample_set, 0, NULL);
+    vkCmdPushConstants(cmd, textures->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+    vkCmdDraw(cmd, 4, 1, 0, 0);
+}
@@ -0,0 +1,489 @@
+#include <assert.h>
+#include <pwc/render/utils/macro.h>
+#include <pwc/render/vulkan/vk-core.h>
+#include <pwc/render/vulkan/vk-upload.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan_core.h>
+
+#define UPLOAD_CONSUMER_ACCESS (VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT)
+
+struct pwc_uploader *create_uploader(struct pwc_vulkan *vulkan) {
+    VkResult U_ASSERT_ONLY err;
+
+    struct pwc_uploader *uploader = calloc(1, sizeof(struct pwc_uploader));
+    if (!uploader) {
+        fprintf(stderr, "Failed to allocate uploader\n");
+        return NULL;
+    }
+    uploader->vulkan = vulkan;
+
+    VkCommandPoolCreateInfo pool_ci = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = vulkan->transfer_queue_family_index,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+    };
+    err = vkCreateCommandPool(vulkan->device, &pool_ci, NULL, &uploader->pool);
+    assert(!err);
+
+    if (vulkan->separate_transfer_queue) {
+        printf("Uploads on transfer queue family %u\n", vulkan->transfer_queue_family_index);
+    }
+
+    return uploader;
+}
+
+static void destroy_staging(struct pwc_vulkan *vulkan, UploadT *upload) {
+    if (upload->staging) vkDestroyBuffer(vulkan->device, upload->staging, NULL);
+    if (upload->staging_mem) vkFreeMemory(vulkan->device, upload->staging_mem, NULL);
+    upload->staging = VK_NULL_HANDLE;
+    upload->staging_mem = VK_NULL_HANDLE;
+    upload->staging_map = NULL;
+    upload->staging_size = 0;
+}
+
+void destroy_uploader(struct pwc_uploader *uploader) {
+    if (!uploader) return;
+    struct pwc_vulkan *vulkan = uploader->vulkan;
+
+    for (uint32_t i = 0; i < MAX_UPLOADS; i++) {
+        UploadT *upload = &uploader->uploads[i];
+        if (upload->release) upload->release(upload->release_data);
+        destroy_staging(vulkan, upload);
+        if (upload->semaphore) vkDestroySemaphore(vulkan->device, upload->semaphore, NULL);
+        if (upload->fence) vkDestroyFence(vulkan->device, upload->fence, NULL);
+    }
+    // Frees the command buffers
+    if (uploader->pool) vkDestroyCommandPool(vulkan->device, uploader->pool, NULL);
+    free(uploader);
+}
+
+// Uploads whose acquiring frame completed are free again
+static void recycle_uploads(struct pwc_uploader *uploader) {
+    for (uint32_t i = 0; i < MAX_UPLOADS; i++) {
+        UploadT *upload = &uploader->uploads[i];
+        if (upload->state == UPLOAD_ACQUIRED && upload->serial <= *upload->completed_serial) {
+            upload->state = UPLOAD_FREE;
+            if (upload->release) upload->release(upload->release_data);
+            upload->release = NULL;
+        }
+    }
+}
+
+static bool ensure_staging(struct pwc_vulkan *vulkan, UploadT *upload, VkDeviceSize size) {
+    VkResult U_ASSERT_ONLY err;
+    if (upload->staging_size >= size) return true;
+    destroy_staging(vulkan, upload);
+
+    VkBufferCreateInfo buffer_ci = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    err = vkCreateBuffer(vulkan->device, &buffer_ci, NULL, &upload->staging);
+    assert(!err);
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(vulkan->device, upload->staging, &requirements);
+    uint32_t type = find_memory_type(vulkan, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (type == UINT32_MAX) {
+        fprintf(stderr, "No host visible memory for staging\n");
+        destroy_staging(vulkan, upload);
+        return false;
+    }
+
+    VkMemoryAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = type,
+    };
+    if (vkAllocateMemory(vulkan->device, &alloc_info, NULL, &upload->staging_mem) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to allocate %lu bytes of staging memory\n", (unsigned long)requirements.size);
+        destroy_staging(vulkan, upload);
+        return false;
+    }
+    err = vkBindBufferMemory(vulkan->device, upload->staging, upload->staging_mem, 0);
+    assert(!err);
+    err = vkMapMemory(vulkan->device, upload->staging_mem, 0, VK_WHOLE_SIZE, 0, &upload->staging_map);
+    assert(!err);
+
+    upload->staging_size = size;
+    return true;
+}
+
+// Returns a free upload with a staging buffer of at least size bytes and its command
+// buffer begun, or NULL if every slot is in flight
+static UploadT *begin_upload(struct pwc_uploader *uploader, VkDeviceSize size) {
+    VkResult U_ASSERT_ONLY err;
+    struct pwc_vulkan *vulkan = uploader->vulkan;
+
+    recycle_uploads(uploader);
+
+    UploadT *upload = NULL;
+    for (uint32_t i = 0; i < MAX_UPLOADS; i++) {
+        if (uploader->uploads[i].state == UPLOAD_FREE) {
+            upload = &uploader->uploads[i];
+            break;
+        }
+    }
+    if (!upload) {
+        fprintf(stderr, "No free upload slot\n");
+        return NULL;
+    }
+    if (!ensure_staging(vulkan, upload, size)) return NULL;
+
+    if (!upload->cmd) {
+        VkCommandBufferAllocateInfo alloc_ci = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = uploader->pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        err = vkAllocateCommandBuffers(vulkan->device, &alloc_ci, &upload->cmd);
+        assert(!err);
+
+        VkSemaphoreCreateInfo semaphore_ci = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        err = vkCreateSemaphore(vulkan->device, &semaphore_ci, NULL, &upload->semaphore);
+        assert(!err);
+
+        VkFenceCreateInfo fence_ci = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        err = vkCreateFence(vulkan->device, &fence_ci, NULL, &upload->fence);
+        assert(!err);
+    }
+
+    // The frame that waited on the semaphore completed, so the buffer is no longer executing
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    err = vkBeginCommandBuffer(upload->cmd, &begin_info);
+    assert(!err);
+
+    upload->image = VK_NULL_HANDLE;
+    upload->buffer = VK_NULL_HANDLE;
+    upload->concurrent = false;
+    upload->release = NULL;
+    upload->release_data = NULL;
+    upload->completed_serial = NULL;
+    upload->serial = 0;
+    return upload;
+}
+
+static void submit_upload(struct pwc_uploader *uploader, UploadT *upload) {
+    VkResult U_ASSERT_ONLY err;
+    struct pwc_vulkan *vulkan = uploader->vulkan;
+
+    err = vkEndCommandBuffer(upload->cmd);
+    assert(!err);
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &upload->cmd,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &upload->semaphore,
+    };
+    // Free slots completed their last submission, its fence is signaled
+    err = vkResetFences(vulkan->device, 1, &upload->fence);
+    assert(!err);
+    err = vkQueueSubmit(vulkan->transfer_queue, 1, &submit_info, upload->fence);
+    assert(!err);
+
+    upload->state = UPLOAD_SUBMITTED;
+}
+
+// Release half of the ownership transfer. On a shared family, or for an image both families
+// share, it is a plain barrier and the frame has nothing left to acquire
+static VkImageMemoryBarrier image_handoff_barrier(struct pwc_vulkan *vulkan, VkImage image, bool concurrent) {
+    bool separate = vulkan->separate_transfer_queue;
+    bool transfer = separate && !concurrent;
+    return (VkImageMemoryBarrier){
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = separate ? 0 : VK_ACCESS_SHADER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = transfer ? vulkan->transfer_queue_family_index : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = transfer ? vulkan->graphics_queue_family_index : VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+}
+
+static VkBufferMemoryBarrier buffer_handoff_barrier(struct pwc_vulkan *vulkan, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+    bool separate = vulkan->separate_transfer_queue;
+    return (VkBufferMemoryBarrier){
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = separate ? 0 : UPLOAD_CONSUMER_ACCESS,
+        .srcQueueFamilyIndex = separate ? vulkan->transfer_queue_family_index : VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = separate ? vulkan->graphics_queue_family_index : VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .offset = offset,
+        .size = size,
+    };
+}
+
+static VkPipelineStageFlags handoff_dst_stages(struct pwc_vulkan *vulkan) {
+    // Shader stages don't exist on a transfer only queue
+    return vulkan->separate_transfer_queue ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : UPLOAD_CONSUMER_STAGES;
+}
+
+bool upload_image(struct pwc_uploader *uploader, VkImage image, VkExtent2D extent, uint32_t stride, const void *data) {
+    struct pwc_vulkan *vulkan = uploader->vulkan;
+    VkDeviceSize size = (VkDeviceSize)stride * extent.height;
+
+    UploadT *upload = begin_upload(uploader, size);
+    if (!upload) return false;
+    memcpy(upload->staging_map, data, size);
+    upload->image = image;
+    upload->size = size;
+
+    // UNDEFINED: the old contents are replaced, no ownership has to be taken back first
+    VkImageMemoryBarrier to_transfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    vkCmdPipelineBarrier(upload->cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &to_transfer);
+
+    VkBufferImageCopy region = {
+        .bufferOffset = 0,
+        .bufferRowLength = stride / 4,
+        .bufferImageHeight = extent.height,
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {extent.width, extent.height, 1},
+    };
+    vkCmdCopyBufferToImage(upload->cmd, upload->staging, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    VkImageMemoryBarrier release = image_handoff_barrier(vulkan, image, false);
+    vkCmdPipelineBarrier(upload->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, handoff_dst_stages(vulkan), 0, 0, NULL, 0, NULL, 1, &release);
+
+    submit_upload(uploader, upload);
+    return true;
+}
+
+bool upload_buffer(struct pwc_uploader *uploader, VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size) {
+    struct pwc_vulkan *vulkan = uploader->vulkan;
+
+    UploadT *upload = begin_upload(uploader, size);
+    if (!upload) return false;
+    memcpy(upload->staging_map, data, size);
+    upload->buffer = buffer;
+    upload->offset = offset;
+    upload->size = size;
+
+    VkBufferCopy region = {.srcOffset = 0, .dstOffset = offset, .size = size};
+    vkCmdCopyBuffer(upload->cmd, upload->staging, buffer, 1, &region);
+
+    VkBufferMemoryBarrier release = buffer_handoff_barrier(vulkan, buffer, offset, size);
+    vkCmdPipelineBarrier(upload->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, handoff_dst_stages(vulkan), 0, 0, NULL, 1, &release, 0, NULL);
+
+    submit_upload(uploader, upload);
+    return true;
+}
+
+// Records copying regions of src into an image shared by both families. Outside the regions
+// the contents are kept, unless the image was never written
+static void record_image_copies(struct pwc_vulkan *vulkan, UploadT *upload, VkImage image, bool initialized,
+                                VkBuffer src, const VkBufferImageCopy *regions, uint32_t count) {
+    VkImageMemoryBarrier to_transfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = initialized ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    vkCmdPipelineBarrier(upload->cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &to_transfer);
+
+    vkCmdCopyBufferToImage(upload->cmd, src, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, count, regions);
+
+    VkImageMemoryBarrier release = image_handoff_barrier(vulkan, image, true);
+    vkCmdPipelineBarrier(upload->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, handoff_dst_stages(vulkan), 0, 0, NULL, 0, NULL, 1, &release);
+
+    upload->image = image;
+    upload->concurrent = true;
+}
+
+bool upload_image_region(struct pwc_uploader *uploader, VkImage image, bool initialized, const void *data, uint32_t stride,
+                         const DamageRegionT *region) {
+    VkDeviceSize size = 0;
+    for (uint32_t i = 0; i < region->count; i++) {
+        size += (VkDeviceSize)region->rects[i].extent.width * 4 * region->rects[i].extent.height;
+    }
+    if (size == 0) return true;
+
+    UploadT *upload = begin_upload(uploader, size);
+    if (!upload) return false;
+    upload->size = size;
+
+    // Only the rects are staged, packed one after the other
+    VkBufferImageCopy copies[MAX_DAMAGE_RECTS];
+    VkDeviceSize offset = 0;
+    for (uint32_t i = 0; i < region->count; i++) {
+        VkRect2D rect = region->rects[i];
+        size_t row = (size_t)rect.extent.width * 4;
+        const uint8_t *src = (const uint8_t *)data + (size_t)rect.offset.y * stride + (size_t)rect.offset.x * 4;
+        uint8_t *dst = (uint8_t *)upload->staging_map + offset;
+        for (uint32_t y = 0; y < rect.extent.height; y++) {
+            memcpy(dst + y * row, src + (size_t)y * stride, row);
+        }
+
+        copies[i] = (VkBufferImageCopy){
+            .bufferOffset = offset,
+            .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+            .imageOffset = {rect.offset.x, rect.offset.y, 0},
+            .imageExtent = {rect.extent.width, rect.extent.height, 1},
+        };
+        offset += row * rect.extent.height;
+    }
+
+    record_image_copies(uploader->vulkan, upload, image, initialized, upload->staging, copies, region->count);
+    submit_upload(uploader, upload);
+    return true;
+}
+
+bool upload_image_region_from_buffer(struct pwc_uploader *uploader, VkImage image, bool initialized, VkBuffer src,
+                                     VkDeviceSize src_offset, uint32_t stride, const DamageRegionT *region,
+                                     UploadReleaseFunc release, void *release_data) {
+    UploadT *upload = begin_upload(uploader, 0);
+    if (!upload) return false;
+
+    // Straight from the client's rows, nothing is copied on the CPU
+    VkBufferImageCopy copies[MAX_DAMAGE_RECTS];
+    for (uint32_t i = 0; i < region->count; i++) {
+        VkRect2D rect = region->rects[i];
+        copies[i] = (VkBufferImageCopy){
+            .bufferOffset = src_offset + (VkDeviceSize)rect.offset.y * stride + (VkDeviceSize)rect.offset.x * 4,
+            .bufferRowLength = stride / 4,
+            .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+            .imageOffset = {rect.offset.x, rect.offset.y, 0},
+            .imageExtent = {rect.extent.width, rect.extent.height, 1},
+        };
+    }
+
+    record_image_copies(uploader->vulkan, upload, image, initialized, src, copies, region->count);
+    upload->release = release;
+    upload->release_data = release_data;
+    submit_upload(uploader, upload);
+    return true;
+}
+
+bool upload_import_host(struct pwc_vulkan *vulkan, void *ptr, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *mem) {
+    VkResult U_ASSERT_ONLY err;
+    *buffer = VK_NULL_HANDLE;
+    *mem = VK_NULL_HANDLE;
+    if (!vulkan->external_memory_host) return false;
+
+    VkMemoryHostPointerPropertiesEXT host_props = {.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT};
+    if (vulkan->get_memory_host_pointer_properties(vulkan->device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+                                                   ptr, &host_props) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkExternalMemoryBufferCreateInfo external_ci = {
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO,
+        .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+    };
+    VkBufferCreateInfo buffer_ci = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = &external_ci,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    if (vkCreateBuffer(vulkan->device, &buffer_ci, NULL, buffer) != VK_SUCCESS) return false;
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(vulkan->device, *buffer, &requirements);
+    uint32_t type = find_memory_type(vulkan, requirements.memoryTypeBits & host_props.memoryTypeBits, 0);
+    VkImportMemoryHostPointerInfoEXT import = {
+        .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT,
+        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+        .pHostPointer = ptr,
+    };
+    VkMemoryAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = &import,
+        .allocationSize = size,
+        .memoryTypeIndex = type,
+    };
+    if (type == UINT32_MAX || requirements.size > size ||
+        vkAllocateMemory(vulkan->device, &alloc_info, NULL, mem) != VK_SUCCESS) {
+        vkDestroyBuffer(vulkan->device, *buffer, NULL);
+        *buffer = VK_NULL_HANDLE;
+        *mem = VK_NULL_HANDLE;
+        return false;
+    }
+    err = vkBindBufferMemory(vulkan->device, *buffer, *mem, 0);
+    assert(!err);
+    return true;
+}
+
+uint32_t uploader_acquire(struct pwc_uploader *uploader, VkCommandBuffer cmd, const uint64_t *completed_serial, uint64_t serial,
+                          VkSemaphore *semaphores, VkPipelineStageFlags *stages, uint32_t max) {
+    struct pwc_vulkan *vulkan = uploader->vulkan;
+    uint32_t count = 0;
+
+    recycle_uploads(uploader);
+
+    for (uint32_t i = 0; i < MAX_UPLOADS && count < max; i++) {
+        UploadT *upload = &uploader->uploads[i];
+        if (upload->state != UPLOAD_SUBMITTED) continue;
+
+        // Acquire half, must match the release recorded on the transfer queue
+        if (vulkan->separate_transfer_queue && !upload->concurrent) {
+            if (upload->image) {
+                VkImageMemoryBarrier acquire = image_handoff_barrier(vulkan, upload->image, false);
+                acquire.srcAccessMask = 0;
+                acquire.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                vkCmdPipelineBarrier(cmd, UPLOAD_CONSUMER_STAGES, UPLOAD_CONSUMER_STAGES, 0, 0, NULL, 0, NULL, 1, &acquire);
+            } else {
+                VkBufferMemoryBarrier acquire = buffer_handoff_barrier(vulkan, upload->buffer, upload->offset, upload->size);
+                acquire.srcAccessMask = 0;
+                acquire.dstAccessMask = UPLOAD_CONSUMER_ACCESS;
+                vkCmdPipelineBarrier(cmd, UPLOAD_CONSUMER_STAGES, UPLOAD_CONSUMER_STAGES, 0, 0, NULL, 1, &acquire, 0, NULL);
+            }
+        }
+
+        semaphores[count] = upload->semaphore;
+        stages[count] = UPLOAD_CONSUMER_STAGES;
+        count++;
+
+        upload->state = UPLOAD_ACQUIRED;
+        upload->completed_serial = completed_serial;
+        upload->serial = serial;
+    }
+
+    return count;
+}
+
+bool uploader_release_completed(struct pwc_uploader *uploader) {
+    VkDevice device = uploader->vulkan->device;
+    bool copying = false;
+    for (uint32_t i = 0; i < MAX_UPLOADS; i++) {
+        UploadT *upload = &uploader->uploads[i];
+        if (upload->state == UPLOAD_FREE || !upload->release) continue;
+        if (vkGetFenceStatus(device, upload->fence) != VK_SUCCESS) {
+            copying = true;
+            continue;
+        }
+        upload->release(upload->release_data);
+        upload->release = NULL;
+    }
+    return copying;
+}
@@ -4,38 +4,25 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 void cleanup_vulkan(struct pwc_vulkan *vulkan) {
-    if (vulkan->framebuffers) {
-        for (uint32_t i = 0; i < vulkan->swapchain_image_count; i++) vkDestroyFramebuffer(vulkan->device, vulkan->framebuffers[i], NULL);
-        free(vulkan->framebuffers);
-    }
+    // Teardown only: waiting for the device is fine here
+    if (vulkan->device) vkDeviceWaitIdle(vulkan->device);
+    for (uint32_t i = 0; i < vulkan->output_count; i++) destroy_output(vulkan, &vulkan->outputs[i]);
+    vulkan->output_count = 0;
+
     if (vulkan->pipeline) vkDestroyPipeline(vulkan->device, vulkan->pipeline, NULL);
     if (vulkan->pipeline_layout) vkDestroyPipelineLayout(vulkan->device, vulkan->pipeline_layout, NULL);
     if (vulkan->render_pass) vkDestroyRenderPass(vulkan->device, vulkan->render_pass, NULL);
+    if (vulkan->render_pass_load) vkDestroyRenderPass(vulkan->device, vulkan->render_pass_load, NULL);
+    if (vulkan->render_pass_offscreen) vkDestroyRenderPass(vulkan->device, vulkan->render_pass_offscreen, NULL);
     if (vulkan->vertex_buffer) vkDestroyBuffer(vulkan->device, vulkan->vertex_buffer, NULL);
     if (vulkan->vertex_mem) vkFreeMemory(vulkan->device, vulkan->vertex_mem, NULL);
     if (vulkan->vert_shader) vkDestroyShaderModule(vulkan->device, vulkan->vert_shader, NULL);
     if (vulkan->frag_shader) vkDestroyShaderModule(vulkan->device, vulkan->frag_shader, NULL);
-    if (vulkan->fences) {
-        for (int i = 0; i < FRAME_LAG; i++) vkDestroyFence(vulkan->device, vulkan->fences[i], NULL);
-        free(vulkan->fences);
-    }
-    if (vulkan->draw_complete_semaphores) {
-        for (uint32_t i = 0; i < vulkan->swapchain_image_count; i++) vkDestroySemaphore(vulkan->device, vulkan->draw_complete_semaphores[i], NULL);
-        free(vulkan->draw_complete_semaphores);
-    }
-    if (vulkan->image_acquired_semaphores) {
-        for (uint32_t i = 0; i < vulkan->swapchain_image_count; i++) vkDestroySemaphore(vulkan->device, vulkan->image_acquired_semaphores[i], NULL);
-        free(vulkan->image_acquired_semaphores);
-    }
-    if (vulkan->swapchain_image_views) {
-        for (uint32_t i = 0; i < vulkan->swapchain_image_count; i++) vkDestroyImageView(vulkan->device, vulkan->swapchain_image_views[i], NULL);
-        free(vulkan->swapchain_image_views);
-    }
-    if (vulkan->swapchain) vkDestroySwapchainKHR(vulkan->device, vulkan->swapchain, NULL);
-    free(vulkan->swapchain_images);
     if (vulkan->cmd_pool) vkDestroyCommandPool(vulkan->device, vulkan->cmd_pool, NULL);  // Added
     if (vulkan->device) vkDestroyDevice(vulkan->device, NULL);
     if (vulkan->instance) vkDestroyInstance(vulkan->instance, NULL);
@@ -44,10 +31,31 @@ void cleanup_vulkan(struct pwc_vulkan *vulkan) {
 int init_vulkan(struct pwc_vulkan *vulkan) {
     create_vulkan_instance(vulkan);
     pick_physical_device(vulkan);
-    create_display_surface(vulkan);
-    create_swapchain(vulkan);
-    create_image_views(vulkan);
-    create_graphics_pipeline(vulkan);
+    create_outputs(vulkan);
+
+    // Outputs that can't be driven are dropped, the rest stay packed
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < vulkan->output_count; i++) {
+        struct pwc_output *output = &vulkan->outputs[i];
+        if (!init_output(vulkan, output)) {
+            destroy_output(vulkan, output);
+            continue;
+        }
+        if (kept != i) {
+            vulkan->outputs[kept] = *output;
+            memset(output, 0, sizeof(struct pwc_output));
+        }
+        vulkan->outputs[kept].index = kept;
+        kept++;
+    }
+    vulkan->output_count = kept;
+
+    if (vulkan->output_count == 0) {
+        fprintf(stderr, "No output could be initialized\n");
+        return EXIT_FAILURE;
+    }
+
+    vulkan->initialized = true;
 
     return EXIT_SUCCESS;
 };
\ No newline at end of file
@@ -0,0 +1,314 @@
+#include <assert.h>
+#include <pwc/render/utils/macro.h>
+#include <pwc/render/vulkan/vk-decorations.h>
+#include <pwc/render/vulkan/vk-effects.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <pwc/render/workspace-cache.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct pwc_workspace_cache *create_workspace_cache(struct pwc_vulkan *vulkan, struct pwc_effects *effects,
+                                                   struct pwc_decorations *decorations, struct pwc_output *output, float scale) {
+    VkResult U_ASSERT_ONLY err;
+
+    struct pwc_workspace_cache *cache = calloc(1, sizeof(struct pwc_workspace_cache));
+    if (!cache) {
+        fprintf(stderr, "Failed to allocate workspace cache\n");
+        return NULL;
+    }
+    cache->vulkan = vulkan;
+    cache->effects = effects;
+    cache->decorations = decorations;
+    cache->output = output;
+    cache->scale = scale;
+
+    VkCommandPoolCreateInfo pool_ci = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = vulkan->graphics_queue_family_index,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+    };
+    err = vkCreateCommandPool(vulkan->device, &pool_ci, NULL, &cache->pool);
+    assert(!err);
+
+    VkCommandBufferAllocateInfo cmd_ai = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = cache->pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    // Signaled, so the first begin doesn't wait for anything
+    VkFenceCreateInfo fence_ci = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+    };
+    for (uint32_t i = 0; i < SNAPSHOT_SUBMISSIONS; i++) {
+        err = vkAllocateCommandBuffers(vulkan->device, &cmd_ai, &cache->submissions[i].cmd);
+        assert(!err);
+        err = vkCreateFence(vulkan->device, &fence_ci, NULL, &cache->submissions[i].fence);
+        assert(!err);
+    }
+
+    return cache;
+}
+
+static void destroy_snapshot(struct pwc_workspace_cache *cache, WorkspaceSnapshotT *snapshot) {
+    if (snapshot->framebuffer) vkDestroyFramebuffer(cache->vulkan->device, snapshot->framebuffer, NULL);
+    effect_image_finish(cache->effects, &snapshot->image);
+}
+
+void destroy_workspace_cache(struct pwc_workspace_cache *cache) {
+    if (!cache) return;
+    VkDevice device = cache->vulkan->device;
+
+    for (uint32_t i = 0; i < cache->snapshot_count; i++) {
+        destroy_snapshot(cache, &cache->snapshots[i]);
+    }
+    free(cache->snapshots);
+    for (uint32_t i = 0; i < SNAPSHOT_SUBMISSIONS; i++) {
+        decoration_buffer_finish(cache->decorations, &cache->submissions[i].decorations);
+        if (cache->submissions[i].fence) vkDestroyFence(device, cache->submissions[i].fence, NULL);
+    }
+    // Frees the command buffers
+    if (cache->pool) vkDestroyCommandPool(device, cache->pool, NULL);
+    free(cache);
+}
+
+WorkspaceSnapshotT *workspace_cache_find(struct pwc_workspace_cache *cache, SceneNodeHandle workspace) {
+    for (uint32_t i = 0; i < cache->snapshot_count; i++) {
+        if (cache->snapshots[i].workspace == workspace) return &cache->snapshots[i];
+    }
+    return NULL;
+}
+
+// Sampled by frames up to the output's current one, freed by workspace_cache_sweep()
+static void retire_snapshot(struct pwc_workspace_cache *cache, WorkspaceSnapshotT *snapshot) {
+    snapshot->workspace = SCENE_NODE_HANDLE_NULL;
+    snapshot->retired_serial = cache->output->frame_serial;
+}
+
+void workspace_cache_forget(struct pwc_workspace_cache *cache, SceneNodeHandle workspace) {
+    WorkspaceSnapshotT *snapshot = workspace_cache_find(cache, workspace);
+    if (snapshot) retire_snapshot(cache, snapshot);
+}
+
+static bool create_snapshot(struct pwc_workspace_cache *cache, WorkspaceSnapshotT *snapshot, VkExtent2D extent) {
+    struct pwc_vulkan *vulkan = cache->vulkan;
+
+    if (!effect_image_init(cache->effects, &snapshot->image, extent, vulkan->render_pass_format)) return false;
+
+    VkFramebufferCreateInfo framebuffer_ci = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = vulkan->render_pass_offscreen,
+        .attachmentCount = 1,
+        .pAttachments = &snapshot->image.view,
+        .width = extent.width,
+        .height = extent.height,
+        .layers = 1,
+    };
+    if (vkCreateFramebuffer(vulkan->device, &framebuffer_ci, NULL, &snapshot->framebuffer) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create snapshot framebuffer\n");
+        return false;
+    }
+    return true;
+}
+
+// The output's size times scale, zero if the output has none
+static VkExtent2D scaled_extent(struct pwc_workspace_cache *cache, float scale) {
+    VkExtent2D output_extent = cache->output->swapchain_extent;
+    return (VkExtent2D){(uint32_t)(output_extent.width * scale), (uint32_t)(output_extent.height * scale)};
+}
+
+// Appends a snapshot not assigned to any workspace yet. Previous pointers into the cache
+// may be invalidated
+static WorkspaceSnapshotT *add_snapshot(struct pwc_workspace_cache *cache, VkExtent2D extent) {
+    if (extent.width == 0 || extent.height == 0) return NULL;
+
+    if (cache->snapshot_count >= cache->snapshot_capacity) {
+        uint32_t new_capacity = (cache->snapshot_capacity == 0) ? 4 : cache->snapshot_capacity * 2;
+        WorkspaceSnapshotT *new_snapshots = realloc(cache->snapshots, new_capacity * sizeof(WorkspaceSnapshotT));
+        if (!new_snapshots) {
+            fprintf(stderr, "Failed to realloc workspace snapshots\n");
+            return NULL;
+        }
+        cache->snapshots = new_snapshots;
+        cache->snapshot_capacity = new_capacity;
+    }
+
+    WorkspaceSnapshotT *snapshot = &cache->snapshots[cache->snapshot_count];
+    memset(snapshot, 0, sizeof(WorkspaceSnapshotT));
+    if (!create_snapshot(cache, snapshot, extent)) {
+        fprintf(stderr, "Failed to create %ux%u workspace snapshot\n", extent.width, extent.height);
+        destroy_snapshot(cache, snapshot);
+        return NULL;
+    }
+    cache->snapshot_count++;
+    return snapshot;
+}
+
+WorkspaceSnapshotT *workspace_cache_get(struct pwc_workspace_cache *cache, SceneNodeT *workspace) {
+    if (!cache->effects->enabled) return NULL;
+
+    WorkspaceSnapshotT *snapshot = workspace_cache_find(cache, workspace->handle);
+    if (snapshot) return snapshot;
+
+    snapshot = add_snapshot(cache, scaled_extent(cache, cache->scale));
+    if (snapshot) snapshot->workspace = workspace->handle;
+    return snapshot;
+}
+
+bool workspace_snapshot_stale(struct pwc_workspace_cache *cache, const WorkspaceSnapshotT *snapshot, const SceneNodeT *workspace) {
+    if (!snapshot->image.initialized || snapshot->drawn_serial != workspace->subtree_serial) return true;
+    // Thumbnails are only good enough while hibernated, the output may have been resized
+    VkExtent2D extent = scaled_extent(cache, cache->scale);
+    return !snapshot->hibernated && (snapshot->image.extent.width != extent.width || snapshot->image.extent.height != extent.height);
+}
+
+void workspace_cache_sweep(struct pwc_workspace_cache *cache) {
+    VkDevice device = cache->vulkan->device;
+
+    bool refreshing = false;
+    for (uint32_t i = 0; i < SNAPSHOT_SUBMISSIONS; i++) {
+        if (vkGetFenceStatus(device, cache->submissions[i].fence) == VK_NOT_READY) refreshing = true;
+    }
+
+    for (uint32_t i = cache->snapshot_count; i-- > 0;) {
+        WorkspaceSnapshotT *snapshot = &cache->snapshots[i];
+        if (snapshot->workspace != SCENE_NODE_HANDLE_NULL) {
+            if (!scene_node_from_handle(snapshot->workspace)) retire_snapshot(cache, snapshot);
+            continue;
+        }
+        if (refreshing || snapshot->retired_serial > cache->output->completed_serial) continue;
+
+        destroy_snapshot(cache, snapshot);
+        cache->snapshots[i] = cache->snapshots[--cache->snapshot_count];
+    }
+}
+
+SnapshotSubmissionT *workspace_cache_begin(struct pwc_workspace_cache *cache) {
+    VkResult U_ASSERT_ONLY err;
+    SnapshotSubmissionT *submission = &cache->submissions[cache->next_submission];
+
+    // Refreshes are best effort, never wait for one
+    if (vkGetFenceStatus(cache->vulkan->device, submission->fence) != VK_SUCCESS) return NULL;
+    cache->next_submission = (cache->next_submission + 1) % SNAPSHOT_SUBMISSIONS;
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    err = vkBeginCommandBuffer(submission->cmd, &begin_info);
+    assert(!err);
+
+    // Frames queued before may still sample the snapshots about to be overwritten
+    vkCmdPipelineBarrier(submission->cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         0, 0, NULL, 0, NULL, 0, NULL);
+    return submission;
+}
+
+static void begin_pass(struct pwc_workspace_cache *cache, VkCommandBuffer cmd, WorkspaceSnapshotT *snapshot) {
+    VkExtent2D extent = snapshot->image.extent;
+    VkClearValue clear = {{{0, 0, 0, 1}}};
+    VkRenderPassBeginInfo rp_bi = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = cache->vulkan->render_pass_offscreen,
+        .framebuffer = snapshot->framebuffer,
+        .renderArea = {{0, 0}, extent},
+        .clearValueCount = 1,
+        .pClearValues = &clear,
+    };
+    vkCmdBeginRenderPass(cmd, &rp_bi, VK_SUBPASS_CONTENTS_INLINE);
+
+    // Output space shrinks onto the snapshot
+    VkViewport viewport = {0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, extent};
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+WorkspaceSnapshotT *workspace_cache_begin_snapshot(struct pwc_workspace_cache *cache, SnapshotSubmissionT *submission, SceneNodeT *workspace) {
+    WorkspaceSnapshotT *snapshot = workspace_cache_get(cache, workspace);
+    if (!snapshot) return NULL;
+
+    VkExtent2D extent = scaled_extent(cache, cache->scale);
+    if (!snapshot->hibernated && (snapshot->image.extent.width != extent.width || snapshot->image.extent.height != extent.height)) {
+        // A woken thumbnail or a resized output, frames keep sampling the old one until
+        // the replacement is drawn
+        WorkspaceSnapshotT *replacement = add_snapshot(cache, extent);
+        if (!replacement) return NULL;
+        snapshot = workspace_cache_find(cache, workspace->handle);
+        retire_snapshot(cache, snapshot);
+        replacement->workspace = workspace->handle;
+        snapshot = replacement;
+    }
+
+    begin_pass(cache, submission->cmd, snapshot);
+    return snapshot;
+}
+
+void workspace_cache_end_snapshot(struct pwc_workspace_cache *cache, SnapshotSubmissionT *submission, WorkspaceSnapshotT *snapshot,
+                                  const SceneNodeT *workspace, uint64_t now_ns) {
+    vkCmdEndRenderPass(submission->cmd);
+    snapshot->image.initialized = true;  // The pass left it in GENERAL
+    snapshot->drawn_serial = workspace->subtree_serial;
+    snapshot->refreshed_ns = now_ns;
+}
+
+void workspace_cache_submit(struct pwc_workspace_cache *cache, SnapshotSubmissionT *submission) {
+    VkResult U_ASSERT_ONLY err;
+    struct pwc_vulkan *vulkan = cache->vulkan;
+
+    // Frames queued after sample what was drawn
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(submission->cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 1, &barrier, 0, NULL, 0, NULL);
+    err = vkEndCommandBuffer(submission->cmd);
+    assert(!err);
+
+    err = vkResetFences(vulkan->device, 1, &submission->fence);
+    assert(!err);
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &submission->cmd,
+    };
+    err = vkQueueSubmit(vulkan->graphics_queue, 1, &submit_info, submission->fence);
+    assert(!err);
+}
+
+bool workspace_cache_hibernate(struct pwc_workspace_cache *cache, SnapshotSubmissionT *submission, SceneNodeHandle workspace) {
+    WorkspaceSnapshotT *snapshot = workspace_cache_find(cache, workspace);
+    if (!snapshot || snapshot->hibernated) return false;
+    if (!snapshot->image.initialized) {
+        // Nothing worth keeping
+        retire_snapshot(cache, snapshot);
+        return true;
+    }
+
+    WorkspaceSnapshotT *thumbnail = add_snapshot(cache, scaled_extent(cache, SNAPSHOT_THUMBNAIL_SCALE));
+    if (!thumbnail) return false;
+    snapshot = workspace_cache_find(cache, workspace);
+
+    // Scaled down from the snapshot, the workspace itself isn't drawn again
+    VkExtent2D output_extent = cache->output->swapchain_extent;
+    begin_pass(cache, submission->cmd, thumbnail);
+    effects_draw(cache->effects, submission->cmd, &snapshot->image, (VkRect2D){{0, 0}, output_extent}, output_extent);
+    vkCmdEndRenderPass(submission->cmd);
+
+    thumbnail->image.initialized = true;
+    thumbnail->drawn_serial = snapshot->drawn_serial;
+    thumbnail->refreshed_ns = snapshot->refreshed_ns;
+    thumbnail->hibernated = true;
+    retire_snapshot(cache, snapshot);
+    thumbnail->workspace = workspace;
+    return true;
+}
+
+void workspace_cache_wake(struct pwc_workspace_cache *cache, SceneNodeHandle workspace) {
+    WorkspaceSnapshotT *snapshot = workspace_cache_find(cache, workspace);
+    if (snapshot) snapshot->hibernated = false;
+}
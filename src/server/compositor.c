@@ -0,0 +1,821 @@
+#include <assert.h>
+#include <math.h>
+#include <pwc/render/damage.h>
+#include <pwc/render/render.h>
+#include <pwc/render/scene/node.h>
+#include <pwc/render/scene/scene.h>
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/server/fractional-scale.h>
+#include <pwc/server/handoff.h>
+#include <pwc/server/linux-dmabuf.h>
+#include <pwc/server/presentation.h>
+#include <pwc/server/seat.h>
+#include <pwc/server/server.h>
+#include <pwc/server/shm.h>
+#include <pwc/server/subcompositor.h>
+#include <pwc/server/surface.h>
+#include <pwc/server/viewporter.h>
+#include <pwc/server/xdg-shell.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+
+static const struct wl_surface_interface surface_impl;
+
+struct pwc_surface *surface_from_resource(struct wl_resource *resource) {
+    assert(wl_resource_instance_of(resource, &wl_surface_interface, &surface_impl));
+    return wl_resource_get_user_data(resource);
+}
+
+// Protocol rects may be huge (INT32_MAX is "everything") or negative, damage rects are clipped
+// to the texture later
+static VkRect2D damage_rect(int64_t x, int64_t y, int64_t width, int64_t height) {
+    if (x < 0) {
+        width += x;
+        x = 0;
+    }
+    if (y < 0) {
+        height += y;
+        y = 0;
+    }
+    if (width < 0) width = 0;
+    if (height < 0) height = 0;
+    if (x > INT32_MAX) x = INT32_MAX;
+    if (y > INT32_MAX) y = INT32_MAX;
+    if (width > INT32_MAX) width = INT32_MAX;
+    if (height > INT32_MAX) height = INT32_MAX;
+    return (VkRect2D){{(int32_t)x, (int32_t)y}, {(uint32_t)width, (uint32_t)height}};
+}
+
+static void callback_handle_resource_destroy(struct wl_resource *resource) {
+    wl_list_remove(wl_resource_get_link(resource));
+}
+
+static void destroy_callbacks(struct wl_list *callbacks) {
+    struct wl_resource *callback, *tmp;
+    wl_resource_for_each_safe(callback, tmp, callbacks) {
+        wl_resource_destroy(callback);
+    }
+}
+
+static void pending_handle_buffer_destroy(struct wl_listener *listener, void *data) {
+    SurfaceStateT *pending = wl_container_of(listener, pending, buffer_destroy);
+    wl_list_remove(&pending->buffer_destroy.link);
+    pending->buffer = NULL;
+}
+
+static void set_pending_buffer(SurfaceStateT *pending, struct wl_resource *buffer) {
+    if (pending->buffer) wl_list_remove(&pending->buffer_destroy.link);
+    pending->buffer = buffer;
+    if (buffer) {
+        pending->buffer_destroy.notify = pending_handle_buffer_destroy;
+        wl_resource_add_destroy_listener(buffer, &pending->buffer_destroy);
+    }
+}
+
+void surface_frame(struct pwc_surface *surface, uint64_t commit, uint32_t output_index, uint64_t serial, uint64_t time_ns) {
+    if (!surface->resource) return;
+    uint32_t time_ms = (uint32_t)(time_ns / 1000000);
+    struct wl_resource *callback, *tmp;
+    wl_resource_for_each_safe(callback, tmp, &surface->frame_callbacks) {
+        wl_callback_send_done(callback, time_ms);
+        wl_resource_destroy(callback);
+    }
+    presentation_surface_shown(surface->server->presentation, &surface->presentation_feedbacks, commit, output_index, serial);
+}
+
+void surface_free(struct pwc_surface *surface) {
+    free(surface);
+}
+
+// The tree's children as the surface stacks them now: subsurfaces and itself, then popups.
+// NULL without memory, the stack stays changed then
+static SurfaceStackT *surface_build_stack(struct pwc_surface *surface) {
+    uint32_t count = (uint32_t)(wl_list_length(&surface->stack) + wl_list_length(&surface->popups));
+    SurfaceStackT *stack = malloc(sizeof(SurfaceStackT) + count * sizeof(SurfaceStackEntryT));
+    if (!stack) {
+        fprintf(stderr, "Failed to allocate surface stack\n");
+        return NULL;
+    }
+    stack->count = 0;
+    SurfaceChildT *child;
+    wl_list_for_each(child, &surface->stack, link) {
+        stack->entries[stack->count++] = (SurfaceStackEntryT){child->surface, child->x, child->y};
+    }
+    wl_list_for_each(child, &surface->popups, link) {
+        stack->entries[stack->count++] = (SurfaceStackEntryT){child->surface, child->x, child->y};
+    }
+    return stack;
+}
+
+void surface_send_stack(struct pwc_surface *surface) {
+    SurfaceStackT *stack = surface_build_stack(surface);
+    if (!stack) {
+        surface->stack_changed = true;
+        return;
+    }
+    surface->stack_changed = false;
+    for (SurfaceCommitT *cached = surface->cached; cached; cached = cached->next) {
+        free(cached->stack);
+        cached->stack = NULL;
+    }
+    handoff_send(surface->server->to_render,
+                 &(HandoffMessageT){.type = HANDOFF_SURFACE_STACK, .stack = {surface, stack}});
+}
+
+// Appends the cached commits of the surface's synchronized subsurfaces (recursively), then
+// its own, at tail. Returns the new tail
+static SurfaceCommitT **take_cached(struct pwc_surface *surface, SurfaceCommitT **tail) {
+    SurfaceChildT *child;
+    wl_list_for_each(child, &surface->stack, link) {
+        if (child->surface != surface && surface_synchronized(child->surface)) tail = take_cached(child->surface, tail);
+    }
+    *tail = surface->cached;
+    surface->cached = NULL;
+    while (*tail) tail = &(*tail)->next;
+    return tail;
+}
+
+// One message, so the render applies the whole chain before its next frame
+static void surface_send_commit(struct pwc_surface *surface, SurfaceCommitT *commit) {
+    SurfaceCommitT *head = NULL;
+    *take_cached(surface, &head) = commit;
+    if (!head) return;
+    handoff_send(surface->server->to_render, &(HandoffMessageT){.type = HANDOFF_SURFACE_COMMIT, .commit = {surface, head}});
+}
+
+void surface_flush_cached(struct pwc_surface *surface) {
+    surface_send_commit(surface, NULL);
+}
+
+// Only trees below a workspace are on screen, damaging anything else would damage the whole
+// scene (see scene_damage_node()). Neither is an empty node, it shows nothing
+static void damage_mapped(struct pwc_scene *scene, SceneNodeT *node) {
+    if (node->geometry.extent.width == 0 || node->geometry.extent.height == 0) return;
+    for (SceneNodeT *it = node->parent; it; it = it->parent) {
+        if (it->type == SCENE_NODE_WORKSPACE) {
+            scene_damage_node(scene, node);
+            return;
+        }
+    }
+}
+
+static bool node_mapped(SceneNodeT *node) {
+    for (SceneNodeT *it = node->parent; it; it = it->parent) {
+        if (it->type == SCENE_NODE_WORKSPACE) return true;
+    }
+    return false;
+}
+
+static void surface_damage_whole(struct pwc_surface *surface) {
+    damage_mapped(surface->server->render->scene, surface->node);
+}
+
+// A tree's geometry bounds its children as their offsets place them, and so on up through
+// the trees it is stacked in
+static void update_tree_bounds(SceneNodeT *tree) {
+    for (; tree && tree->type == SCENE_NODE_SURFACE_TREE; tree = tree->parent) {
+        VkRect2D bounds = {{0, 0}, {0, 0}};
+        scene_node_for_each_child(child, tree) {
+            VkRect2D box = child->geometry;
+            box.offset.x += (int32_t)child->transform.offset[0];
+            box.offset.y += (int32_t)child->transform.offset[1];
+            bounds = rect_union(bounds, box);
+        }
+        tree->geometry = bounds;
+    }
+}
+
+// Buffer coordinates (normalized) to surface ones, in place: the transform is undone. The
+// shader's buffer_coords() goes the other way
+static void surface_coords(int32_t transform, float *x, float *y) {
+    float bx = *x, by = *y;
+    switch (transform) {
+    case WL_OUTPUT_TRANSFORM_90: *x = by, *y = 1.0f - bx; break;
+    case WL_OUTPUT_TRANSFORM_180: *x = 1.0f - bx, *y = 1.0f - by; break;
+    case WL_OUTPUT_TRANSFORM_270: *x = 1.0f - by, *y = bx; break;
+    case WL_OUTPUT_TRANSFORM_FLIPPED: *x = 1.0f - bx; break;
+    case WL_OUTPUT_TRANSFORM_FLIPPED_90: *x = 1.0f - by, *y = 1.0f - bx; break;
+    case WL_OUTPUT_TRANSFORM_FLIPPED_180: *y = 1.0f - by; break;
+    case WL_OUTPUT_TRANSFORM_FLIPPED_270: *x = by, *y = bx; break;
+    default: break;
+    }
+}
+
+// Damaged buffer rect as the node shows it: transformed back, cropped to the node's uv_rect and
+// stretched over its geometry. Rounded out, empty if it's outside what the node shows
+static VkRect2D buffer_rect_to_node(const SceneNodeT *node, VkExtent2D buffer, VkRect2D rect) {
+    float x0 = (float)rect.offset.x / buffer.width, y0 = (float)rect.offset.y / buffer.height;
+    float x1 = (float)((int64_t)rect.offset.x + rect.extent.width) / buffer.width;
+    float y1 = (float)((int64_t)rect.offset.y + rect.extent.height) / buffer.height;
+    surface_coords((int32_t)node->uv_transform, &x0, &y0);
+    surface_coords((int32_t)node->uv_transform, &x1, &y1);
+
+    const float *uv = node->uv_rect;
+    VkExtent2D extent = node->geometry.extent;
+    float scale_x = extent.width / (uv[2] - uv[0]), scale_y = extent.height / (uv[3] - uv[1]);
+    float left = fmaxf(floorf((fminf(x0, x1) - uv[0]) * scale_x), 0.0f);
+    float top = fmaxf(floorf((fminf(y0, y1) - uv[1]) * scale_y), 0.0f);
+    float right = fminf(ceilf((fmaxf(x0, x1) - uv[0]) * scale_x), (float)extent.width);
+    float bottom = fminf(ceilf((fmaxf(y0, y1) - uv[1]) * scale_y), (float)extent.height);
+    if (right <= left || bottom <= top) return (VkRect2D){{0, 0}, {0, 0}};
+    return (VkRect2D){{(int32_t)left, (int32_t)top}, {(uint32_t)(right - left), (uint32_t)(bottom - top)}};
+}
+
+// Sizes the node in output pixels and points it at the part of its texture it shows: buffer
+// scale and transform, then the viewport's source crop and destination size, then the output
+// scale. A changed view (or replaced texture) damages the node as it was and as it is, new
+// contents only where damage (buffer coordinates) says
+static void surface_update_view(struct pwc_surface *surface, const DamageRegionT *damage, bool replaced) {
+    SceneNodeT *node = surface->node;
+    if (!node->texture) return;
+    VkExtent2D buffer = node->texture->extent;
+    bool swapped = surface->buffer_transform & 1;
+    float width = (float)(swapped ? buffer.height : buffer.width) / surface->buffer_scale;
+    float height = (float)(swapped ? buffer.width : buffer.height) / surface->buffer_scale;
+    if (width <= 0.0f || height <= 0.0f) return;
+
+    const SurfaceViewportT *viewport = &surface->buffer_viewport;
+    float uv_rect[4] = {0.0f, 0.0f, 1.0f, 1.0f};
+    float size[2] = {width, height};
+    if (viewport->has_source) {
+        uv_rect[0] = viewport->source_x / width;
+        uv_rect[1] = viewport->source_y / height;
+        uv_rect[2] = (viewport->source_x + viewport->source_width) / width;
+        uv_rect[3] = (viewport->source_y + viewport->source_height) / height;
+        size[0] = viewport->source_width;
+        size[1] = viewport->source_height;
+    }
+    if (viewport->destination_width > 0) {
+        size[0] = (float)viewport->destination_width;
+        size[1] = (float)viewport->destination_height;
+    }
+    VkExtent2D extent = {(uint32_t)roundf(size[0] * surface->output_scale), (uint32_t)roundf(size[1] * surface->output_scale)};
+
+    if (replaced || node->uv_transform != (uint32_t)surface->buffer_transform ||
+        memcmp(node->uv_rect, uv_rect, sizeof(uv_rect)) != 0 || node->geometry.extent.width != extent.width ||
+        node->geometry.extent.height != extent.height) {
+        surface_damage_whole(surface);
+        memcpy(node->uv_rect, uv_rect, sizeof(uv_rect));
+        node->uv_transform = (uint32_t)surface->buffer_transform;
+        node->geometry.extent = extent;
+        surface_damage_whole(surface);
+        return;
+    }
+    if (!node_mapped(node)) return;
+    DamageRegionT node_damage = {0};
+    for (uint32_t i = 0; i < damage->count; i++) {
+        VkRect2D rect = buffer_rect_to_node(node, buffer, damage->rects[i]);
+        if (rect.extent.width > 0 && rect.extent.height > 0) damage_add_rect(&node_damage, rect);
+    }
+    scene_damage_node_region(surface->server->render->scene, node, &node_damage);
+}
+
+// The commit's buffer scale, transform and viewport apply from now on
+static void surface_take_view(struct pwc_surface *surface, const SurfaceCommitT *commit) {
+    surface->buffer_scale = commit->scale;
+    surface->buffer_transform = commit->transform;
+    surface->buffer_viewport = commit->viewport;
+}
+
+// The node stops showing its texture or dmabuf
+static void surface_unmap_texture(struct pwc_surface *surface) {
+    if (!surface->textured && !surface->dmabuf) return;
+    surface_damage_whole(surface);
+    if (surface->textured) texture_finish(surface->server->render->textures, &surface->texture);
+    if (surface->dmabuf) dmabuf_buffer_hide(surface->dmabuf);
+    surface->textured = false;
+    surface->dmabuf = NULL;
+    surface->node->texture = NULL;
+    surface->node->geometry.extent = (VkExtent2D){0, 0};
+    update_tree_bounds(surface->tree);
+}
+
+// The client destroyed the buffer it showed, there is nothing left to hide or release
+void surface_dmabuf_destroyed(struct pwc_surface *surface, DmabufBufferT *buffer) {
+    if (surface->dmabuf != buffer) return;
+    surface_damage_whole(surface);
+    surface->dmabuf = NULL;
+    surface->node->texture = NULL;
+    surface->node->geometry.extent = (VkExtent2D){0, 0};
+    update_tree_bounds(surface->tree);
+}
+
+// The buffer was imported when it was created. Committing it again only acquires the
+// client's new contents
+static void surface_show_dmabuf(struct pwc_surface *surface, DmabufBufferT *dmabuf, const SurfaceCommitT *commit) {
+    struct pwc_render *render = surface->server->render;
+    bool replaced = surface->dmabuf != dmabuf;
+    if (replaced) {
+        surface_unmap_texture(surface);
+        surface->dmabuf = dmabuf;
+        dmabuf_buffer_show(dmabuf);
+        surface->node->texture = &dmabuf->texture;
+    }
+    texture_acquire_import(render->textures, &dmabuf->texture);
+    surface_take_view(surface, commit);
+    surface_update_view(surface, &commit->damage, replaced);
+}
+
+// False while the texture is busy, the buffer is kept then
+static bool surface_upload_shm(struct pwc_surface *surface, ShmBufferT *buffer, const SurfaceCommitT *commit) {
+    struct pwc_render *render = surface->server->render;
+    TextureT *texture = &surface->texture;
+    VkExtent2D extent = buffer->extent;
+    bool recreated = !surface->textured || texture->extent.width != extent.width || texture->extent.height != extent.height ||
+                     texture->format != buffer->format || texture->opaque != buffer->opaque;
+    if (recreated) {
+        surface_unmap_texture(surface);
+        surface->textured = texture_init(render->textures, texture, extent, buffer->format, buffer->opaque);
+        if (!surface->textured) {
+            shm_buffer_return(surface->server, buffer);
+            return true;
+        }
+        surface->node->texture = texture;
+    }
+
+    if (!shm_buffer_upload(surface->server, texture, buffer, &commit->damage)) return false;
+
+    // The texture's front changed either way, cached draws of the node are stale
+    surface_take_view(surface, commit);
+    surface_update_view(surface, &commit->damage, recreated);
+    return true;
+}
+
+void surface_retry_upload(struct pwc_surface *surface) {
+    SurfaceCommitT *held = surface->held;
+    if (!held) return;
+
+    if (held->shm) {
+        if (!surface_upload_shm(surface, held->shm, held)) return;
+    } else if (held->dmabuf && held->dmabuf->imported) {
+        surface_show_dmabuf(surface, held->dmabuf, held);
+    } else if (held->attached) {
+        // Detached, or a dmabuf the device couldn't import
+        surface_unmap_texture(surface);
+    } else {
+        // Same contents, seen through a new scale, transform or viewport maybe
+        surface_take_view(surface, held);
+        surface_update_view(surface, &held->damage, false);
+    }
+    surface->shown_commit = held->serial;
+    surface->held = NULL;
+    free(held);
+    update_tree_bounds(surface->tree);
+}
+
+void surface_render_create(struct pwc_surface *surface) {
+    surface->tree = create_scene_node(SCENE_NODE_SURFACE_TREE);
+    surface->node = create_scene_node(SCENE_NODE_SURFACE);
+    if (!surface->tree || !surface->node) {
+        fprintf(stderr, "Failed to create surface nodes, the surface stays invisible\n");
+        destroy_scene_node(surface->tree);
+        destroy_scene_node(surface->node);
+        surface->tree = NULL;
+        surface->node = NULL;
+    }
+    scene_add_child(surface->tree, surface->node);
+    surface->buffer_scale = 1;
+    surface->output_scale = 1.0f;
+    wl_list_insert(&surface->server->surfaces, &surface->link);
+}
+
+static void surface_set_output_scale(struct pwc_surface *surface, float scale);
+
+// Offsets the children's trees by their stack positions at the surface's output scale, which
+// they take on. Entries stay valid: a child that goes away is dropped by a new stack first
+static void surface_place_children(struct pwc_surface *surface) {
+    SurfaceStackT *stack = surface->tree_stack;
+    if (!stack) return;
+    for (uint32_t i = 0; i < stack->count; i++) {
+        SurfaceStackEntryT *entry = &stack->entries[i];
+        SceneNodeT *child = entry->surface->tree;
+        if (entry->surface == surface || !child || child->parent != surface->tree) continue;
+        child->transform.offset[0] = roundf(entry->x * surface->output_scale);
+        child->transform.offset[1] = roundf(entry->y * surface->output_scale);
+        surface_set_output_scale(entry->surface, surface->output_scale);
+    }
+}
+
+// The tree is shown at another output scale: it is resized along with its children's, and
+// the client is told to render at it
+static void surface_set_output_scale(struct pwc_surface *surface, float scale) {
+    if (!surface->tree || surface->output_scale == scale) return;
+    struct pwc_scene *scene = surface->server->render->scene;
+    damage_mapped(scene, surface->tree);
+    surface->output_scale = scale;
+    surface_update_view(surface, &(DamageRegionT){0}, true);
+    surface_place_children(surface);
+    update_tree_bounds(surface->tree);
+    damage_mapped(scene, surface->tree);
+    handoff_send(surface->server->to_protocol, &(HandoffMessageT){
+                                                   .type = HANDOFF_SURFACE_SCALE,
+                                                   .scale = {surface, (uint32_t)lroundf(scale * 120.0f)},
+                                               });
+}
+
+void surface_render_stack(struct pwc_surface *surface, SurfaceStackT *stack) {
+    SceneNodeT *tree = surface->tree;
+    if (!tree) {
+        free(stack);
+        return;
+    }
+    struct pwc_scene *scene = surface->server->render->scene;
+
+    // Damaged as it was and as it ends up, whatever moved inside
+    damage_mapped(scene, tree);
+    while (tree->first_child) scene_node_unlink(tree->first_child);
+    for (uint32_t i = 0; i < stack->count; i++) {
+        SurfaceStackEntryT *entry = &stack->entries[i];
+        if (entry->surface == surface) {
+            scene_add_child(tree, surface->node);
+            continue;
+        }
+        if (entry->surface->tree) scene_add_child(tree, entry->surface->tree);
+    }
+    free(surface->tree_stack);
+    surface->tree_stack = stack;
+    surface_place_children(surface);
+    update_tree_bounds(tree);
+    damage_mapped(scene, tree);
+}
+
+void surface_render_unmap(struct pwc_surface *surface) {
+    SceneNodeT *tree = surface->tree;
+    if (!tree || !tree->parent || tree->parent->type != SCENE_NODE_WORKSPACE) return;
+    damage_mapped(surface->server->render->scene, tree);
+    scene_node_unlink(tree);
+}
+
+void surface_render_commit(struct pwc_surface *surface, SurfaceCommitT *commit) {
+    struct pwc_render *render = surface->server->render;
+    if (commit->dmabuf) commit->dmabuf->commit_count++;
+    surface->frame_requested |= commit->frame;
+    if (commit->stack) surface_render_stack(surface, commit->stack);
+    commit->stack = NULL;
+    if (commit->map == SURFACE_MAP_UNMAP) surface_render_unmap(surface);
+    if (surface->tree) surface->tree->plane_hint = commit->plane_hint;
+    if (!surface->node) {
+        if (commit->shm) shm_buffer_return(surface->server, commit->shm);
+        surface->shown_commit = commit->serial;
+        free(commit);
+        return;
+    }
+
+    // Mapped once the buffer had its chance to upload, a held one shows up a little later
+    enum SurfaceMap map = commit->map;
+    VkRect2D window_geometry = commit->window_geometry;
+    SurfaceCommitT *held = surface->held;
+    if (!held) {
+        surface->held = commit;
+        surface_retry_upload(surface);
+    } else {
+        // A buffer still waiting for its upload is replaced, its damage is kept
+        if (commit->attached) {
+            if (held->shm) shm_buffer_return(surface->server, held->shm);
+            held->attached = true;
+            held->shm = commit->shm;
+            held->dmabuf = commit->dmabuf;
+        }
+        damage_add_region(&held->damage, &commit->damage);
+        held->serial = commit->serial;
+        held->scale = commit->scale;
+        held->transform = commit->transform;
+        held->viewport = commit->viewport;
+        free(commit);
+        surface_retry_upload(surface);
+    }
+
+    if (map == SURFACE_MAP_TOPLEVEL && !surface->tree->parent && render_map_toplevel(render, surface->tree, window_geometry)) {
+        surface_set_output_scale(surface, render_node_scale(render, surface->tree));
+        damage_mapped(render->scene, surface->tree);
+    }
+}
+
+void surface_render_destroy(struct pwc_surface *surface) {
+    struct pwc_server *server = surface->server;
+    if (surface->held) {
+        if (surface->held->shm) shm_buffer_return(server, surface->held->shm);
+        free(surface->held);
+        surface->held = NULL;
+    }
+    free(surface->tree_stack);
+    surface->tree_stack = NULL;
+    // The seat's reset comes later, until then the cursor is hidden
+    if (server->cursor_surface == surface) server->cursor_surface = NULL;
+    if (surface->tree) {
+        surface_unmap_texture(surface);
+        damage_mapped(server->render->scene, surface->tree);
+        // Trees of subsurfaces and popups belong to their surfaces, they are only left unparented
+        SceneNodeT *child = surface->tree->first_child;
+        while (child) {
+            SceneNodeT *next = child->next;
+            if (child != surface->node) scene_node_unlink(child);
+            child = next;
+        }
+        SceneNodeT *parent = surface->tree->parent;
+        destroy_scene_node(surface->tree);
+        update_tree_bounds(parent);
+    }
+    wl_list_remove(&surface->link);
+    handoff_send(server->to_protocol, &(HandoffMessageT){.type = HANDOFF_SURFACE_FREED, .surface = surface});
+}
+
+void surface_frame_due(struct pwc_surface *surface, uint32_t output_index, uint64_t serial, uint64_t now_ns) {
+    surface->frame_done_ns = now_ns;
+    // Feedback of the held update waits for a frame showing it
+    if (!surface->held) surface->frame_requested = false;
+    handoff_send(surface->server->to_protocol, &(HandoffMessageT){
+                                                   .type = HANDOFF_SURFACE_FRAME,
+                                                   .frame = {surface, surface->shown_commit, output_index, serial, now_ns},
+                                               });
+}
+
+static void surface_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void surface_handle_attach(struct wl_client *client, struct wl_resource *resource, struct wl_resource *buffer,
+                                  int32_t x, int32_t y) {
+    struct pwc_surface *surface = surface_from_resource(resource);
+    if ((x != 0 || y != 0) && wl_resource_get_version(resource) >= WL_SURFACE_OFFSET_SINCE_VERSION) {
+        wl_resource_post_error(resource, WL_SURFACE_ERROR_INVALID_OFFSET, "Offset must be set with wl_surface.offset");
+        return;
+    }
+    surface->pending.attached = true;
+    surface->pending.dx += x;
+    surface->pending.dy += y;
+    set_pending_buffer(&surface->pending, buffer);
+}
+
+static void surface_handle_damage(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y,
+                                  int32_t width, int32_t height) {
+    struct pwc_surface *surface = surface_from_resource(resource);
+    damage_add_rect(&surface->pending.surface_damage, damage_rect(x, y, width, height));
+}
+
+static void surface_handle_frame(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    struct pwc_surface *surface = surface_from_resource(resource);
+    struct wl_resource *callback = wl_resource_create(client, &wl_callback_interface, 1, id);
+    if (!callback) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(callback, NULL, NULL, callback_handle_resource_destroy);
+    wl_list_insert(surface->pending.frame_callbacks.prev, wl_resource_get_link(callback));
+}
+
+// Regions only matter for input and occlusion culling: input takes the whole surface box (see
+// seat.h) and occlusion only trusts opaque formats
+static void surface_handle_set_opaque_region(struct wl_client *client, struct wl_resource *resource, struct wl_resource *region) {}
+static void surface_handle_set_input_region(struct wl_client *client, struct wl_resource *resource, struct wl_resource *region) {}
+
+// Size of what a commit would show, zero without a buffer. Buffers that are neither shm nor
+// dmabuf are released and leave it as it was
+static VkExtent2D pending_buffer_extent(struct pwc_surface *surface) {
+    SurfaceStateT *pending = &surface->pending;
+    if (!pending->attached) return surface->buffer_extent;
+    if (!pending->buffer) return (VkExtent2D){0, 0};
+    DmabufBufferT *dmabuf = dmabuf_buffer_from_resource(pending->buffer);
+    if (dmabuf) return (VkExtent2D){dmabuf->attributes.width, dmabuf->attributes.height};
+    VkExtent2D extent;
+    if (shm_buffer_extent(pending->buffer, &extent)) return extent;
+    return surface->buffer_extent;
+}
+
+static void surface_handle_commit(struct wl_client *client, struct wl_resource *resource) {
+    struct pwc_surface *surface = surface_from_resource(resource);
+    SurfaceStateT *pending = &surface->pending;
+    VkExtent2D buffer_extent = pending_buffer_extent(surface);
+    if (!viewport_commit(surface, buffer_extent)) return;
+    SurfaceCommitT *commit = calloc(1, sizeof(SurfaceCommitT));
+    if (!commit) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    commit->surface = surface;
+    commit->serial = ++surface->commit_serial;
+
+    if (pending->attached) {
+        commit->attached = true;
+        if (pending->buffer) {
+            commit->dmabuf = dmabuf_buffer_from_resource(pending->buffer);
+            if (commit->dmabuf) commit->dmabuf->attach_count++;
+            if (!commit->dmabuf) commit->shm = shm_buffer_take(pending->buffer);
+            if (!commit->dmabuf && !commit->shm) {
+                // Neither shm nor dmabuf, the client gets it back and the surface keeps its contents
+                wl_buffer_send_release(pending->buffer);
+                commit->attached = false;
+            }
+            set_pending_buffer(pending, NULL);
+        }
+    }
+
+    surface->scale = pending->scale;
+    surface->transform = pending->transform;
+    surface->viewport = pending->viewport;
+    surface->buffer_extent = buffer_extent;
+    surface->offset_x += pending->dx;
+    surface->offset_y += pending->dy;
+    commit->scale = surface->scale;
+    commit->transform = surface->transform;
+    commit->viewport = surface->viewport;
+
+    // Surface damage is in surface coordinates. Through a transform or viewport it damages the
+    // whole buffer (clipped to the texture later), otherwise only the scale applies
+    bool direct = surface->transform == WL_OUTPUT_TRANSFORM_NORMAL && !surface->viewport.has_source &&
+                  surface->viewport.destination_width == 0;
+    if (commit->shm || commit->dmabuf) {
+        damage_add_region(&commit->damage, &pending->buffer_damage);
+        if (!direct && !damage_is_empty(&pending->surface_damage)) {
+            damage_add_rect(&commit->damage, damage_rect(0, 0, INT32_MAX, INT32_MAX));
+        } else {
+            for (uint32_t i = 0; i < pending->surface_damage.count; i++) {
+                VkRect2D rect = pending->surface_damage.rects[i];
+                damage_add_rect(&commit->damage, damage_rect((int64_t)rect.offset.x * surface->scale,
+                                                             (int64_t)rect.offset.y * surface->scale,
+                                                             (int64_t)rect.extent.width * surface->scale,
+                                                             (int64_t)rect.extent.height * surface->scale));
+            }
+        }
+    }
+
+    wl_list_insert_list(surface->frame_callbacks.prev, &pending->frame_callbacks);
+    wl_list_init(&pending->frame_callbacks);
+    PresentationFeedbackT *feedback;
+    wl_list_for_each(feedback, &pending->presentation_feedbacks, link) {
+        feedback->commit = commit->serial;
+    }
+    wl_list_insert_list(surface->presentation_feedbacks.prev, &pending->presentation_feedbacks);
+    wl_list_init(&pending->presentation_feedbacks);
+    commit->frame = !wl_list_empty(&surface->frame_callbacks) || !wl_list_empty(&surface->presentation_feedbacks);
+
+    pending->attached = false;
+    pending->dx = 0;
+    pending->dy = 0;
+    damage_clear(&pending->surface_damage);
+    damage_clear(&pending->buffer_damage);
+
+    subsurface_parent_commit(surface);
+    if (surface->stack_changed) {
+        commit->stack = surface_build_stack(surface);
+        surface->stack_changed = !commit->stack;
+    }
+    if (surface->role == SURFACE_ROLE_XDG) xdg_surface_commit(surface, commit);
+
+    // Shown along with the parent's next commit
+    if (surface_synchronized(surface)) {
+        SurfaceCommitT **tail = &surface->cached;
+        while (*tail) tail = &(*tail)->next;
+        *tail = commit;
+        return;
+    }
+    surface_send_commit(surface, commit);
+}
+
+static void surface_handle_set_buffer_transform(struct wl_client *client, struct wl_resource *resource, int32_t transform) {
+    struct pwc_surface *surface = surface_from_resource(resource);
+    if (transform < WL_OUTPUT_TRANSFORM_NORMAL || transform > WL_OUTPUT_TRANSFORM_FLIPPED_270) {
+        wl_resource_post_error(resource, WL_SURFACE_ERROR_INVALID_TRANSFORM, "Invalid transform %d", transform);
+        return;
+    }
+    surface->pending.transform = transform;
+}
+
+static void surface_handle_set_buffer_scale(struct wl_client *client, struct wl_resource *resource, int32_t scale) {
+    struct pwc_surface *surface = surface_from_resource(resource);
+    if (scale <= 0) {
+        wl_resource_post_error(resource, WL_SURFACE_ERROR_INVALID_SCALE, "Invalid scale %d", scale);
+        return;
+    }
+    surface->pending.scale = scale;
+}
+
+static void surface_handle_damage_buffer(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y,
+                                         int32_t width, int32_t height) {
+    struct pwc_surface *surface = surface_from_resource(resource);
+    damage_add_rect(&surface->pending.buffer_damage, damage_rect(x, y, width, height));
+}
+
+static void surface_handle_offset(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y) {
+    struct pwc_surface *surface = surface_from_resource(resource);
+    surface->pending.dx = x;
+    surface->pending.dy = y;
+}
+
+static const struct wl_surface_interface surface_impl = {
+    .destroy = surface_handle_destroy,
+    .attach = surface_handle_attach,
+    .damage = surface_handle_damage,
+    .frame = surface_handle_frame,
+    .set_opaque_region = surface_handle_set_opaque_region,
+    .set_input_region = surface_handle_set_input_region,
+    .commit = surface_handle_commit,
+    .set_buffer_transform = surface_handle_set_buffer_transform,
+    .set_buffer_scale = surface_handle_set_buffer_scale,
+    .damage_buffer = surface_handle_damage_buffer,
+    .offset = surface_handle_offset,
+};
+
+// The render side goes next, the surface is freed once it let go
+static void surface_handle_resource_destroy(struct wl_resource *resource) {
+    struct pwc_surface *surface = surface_from_resource(resource);
+
+    set_pending_buffer(&surface->pending, NULL);
+    destroy_callbacks(&surface->pending.frame_callbacks);
+    destroy_callbacks(&surface->frame_callbacks);
+    presentation_discard(&surface->pending.presentation_feedbacks);
+    presentation_discard(&surface->presentation_feedbacks);
+    seat_surface_destroyed(surface->server->seat, surface);
+    viewport_surface_destroyed(surface);
+    fractional_scale_surface_destroyed(surface);
+    xdg_surface_surface_destroyed(surface);
+    subsurface_surface_destroyed(surface);
+    // Nothing shows them any more, the render only releases their buffers
+    surface_flush_cached(surface);
+
+    surface->resource = NULL;
+    handoff_send(surface->server->to_render, &(HandoffMessageT){.type = HANDOFF_SURFACE_DESTROY, .surface = surface});
+}
+
+static void compositor_handle_create_surface(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    struct pwc_server *server = wl_resource_get_user_data(resource);
+
+    struct pwc_surface *surface = calloc(1, sizeof(struct pwc_surface));
+    if (!surface) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    surface->resource = wl_resource_create(client, &wl_surface_interface, wl_resource_get_version(resource), id);
+    if (!surface->resource) {
+        free(surface);
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    surface->server = server;
+    surface->scale = 1;
+    surface->pending.scale = 1;
+    surface->transform = WL_OUTPUT_TRANSFORM_NORMAL;
+    surface->pending.transform = WL_OUTPUT_TRANSFORM_NORMAL;
+    surface->preferred_scale = 120;
+    wl_list_init(&surface->pending.frame_callbacks);
+    wl_list_init(&surface->frame_callbacks);
+    wl_list_init(&surface->pending.presentation_feedbacks);
+    wl_list_init(&surface->presentation_feedbacks);
+    surface->self.surface = surface;
+    wl_list_init(&surface->stack);
+    wl_list_insert(&surface->stack, &surface->self.link);
+    wl_list_init(&surface->pending_stack);
+    wl_list_insert(&surface->pending_stack, &surface->pending_self);
+    wl_list_init(&surface->popups);
+    wl_resource_set_implementation(surface->resource, &surface_impl, surface, surface_handle_resource_destroy);
+    // Its node is created by the render
+    handoff_send(server->to_render, &(HandoffMessageT){.type = HANDOFF_SURFACE_CREATE, .surface = surface});
+}
+
+// Regions are accepted and ignored, see surface_handle_set_opaque_region()
+static void region_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void region_handle_add(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y, int32_t width,
+                              int32_t height) {}
+static void region_handle_subtract(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y,
+                                   int32_t width, int32_t height) {}
+
+static const struct wl_region_interface region_impl = {
+    .destroy = region_handle_destroy,
+    .add = region_handle_add,
+    .subtract = region_handle_subtract,
+};
+
+static void compositor_handle_create_region(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    struct wl_resource *region = wl_resource_create(client, &wl_region_interface, 1, id);
+    if (!region) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(region, &region_impl, NULL, NULL);
+}
+
+static const struct wl_compositor_interface compositor_impl = {
+    .create_surface = compositor_handle_create_surface,
+    .create_region = compositor_handle_create_region,
+};
+
+static void compositor_bind(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client, &wl_compositor_interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &compositor_impl, data, NULL);
+}
+
+struct wl_global *create_compositor_global(struct pwc_server *server) {
+    return wl_global_create(server->display, &wl_compositor_interface, COMPOSITOR_VERSION, server, compositor_bind);
+}
@@ -0,0 +1,78 @@
+#include <assert.h>
+#include <fractional-scale-v1-protocol.h>
+#include <pwc/server/fractional-scale.h>
+#include <pwc/server/server.h>
+#include <pwc/server/surface.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+static const struct wp_fractional_scale_v1_interface fractional_scale_impl;
+
+void fractional_scale_preferred(struct pwc_surface *surface, uint32_t scale) {
+    if (!surface->resource || surface->preferred_scale == scale) return;
+    surface->preferred_scale = scale;
+    if (surface->fractional_scale) wp_fractional_scale_v1_send_preferred_scale(surface->fractional_scale, scale);
+}
+
+void fractional_scale_surface_destroyed(struct pwc_surface *surface) {
+    if (!surface->fractional_scale) return;
+    wl_resource_set_user_data(surface->fractional_scale, NULL);
+    surface->fractional_scale = NULL;
+}
+
+static void fractional_scale_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static const struct wp_fractional_scale_v1_interface fractional_scale_impl = {
+    .destroy = fractional_scale_handle_destroy,
+};
+
+static void fractional_scale_handle_resource_destroy(struct wl_resource *resource) {
+    assert(wl_resource_instance_of(resource, &wp_fractional_scale_v1_interface, &fractional_scale_impl));
+    struct pwc_surface *surface = wl_resource_get_user_data(resource);
+    if (surface) surface->fractional_scale = NULL;
+}
+
+static void manager_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void manager_handle_get_fractional_scale(struct wl_client *client, struct wl_resource *resource, uint32_t id,
+                                                struct wl_resource *surface_resource) {
+    struct pwc_surface *surface = surface_from_resource(surface_resource);
+    if (surface->fractional_scale) {
+        wl_resource_post_error(resource, WP_FRACTIONAL_SCALE_MANAGER_V1_ERROR_FRACTIONAL_SCALE_EXISTS,
+                               "wl_surface@%u already has a fractional scale", wl_resource_get_id(surface_resource));
+        return;
+    }
+    struct wl_resource *fractional_scale =
+        wl_resource_create(client, &wp_fractional_scale_v1_interface, wl_resource_get_version(resource), id);
+    if (!fractional_scale) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(fractional_scale, &fractional_scale_impl, surface, fractional_scale_handle_resource_destroy);
+    surface->fractional_scale = fractional_scale;
+    // Known right away, the client can size its first buffer
+    wp_fractional_scale_v1_send_preferred_scale(fractional_scale, surface->preferred_scale);
+}
+
+static const struct wp_fractional_scale_manager_v1_interface manager_impl = {
+    .destroy = manager_handle_destroy,
+    .get_fractional_scale = manager_handle_get_fractional_scale,
+};
+
+static void manager_bind(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client, &wp_fractional_scale_manager_v1_interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &manager_impl, data, NULL);
+}
+
+struct wl_global *create_fractional_scale_global(struct pwc_server *server) {
+    return wl_global_create(server->display, &wp_fractional_scale_manager_v1_interface, FRACTIONAL_SCALE_MANAGER_VERSION, server,
+                            manager_bind);
+}
@@ -0,0 +1,85 @@
+#include <pwc/render/utils/spsc-ring.h>
+#include <pwc/server/handoff.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+struct pwc_handoff_queue *create_handoff_queue(void) {
+    struct pwc_handoff_queue *queue = calloc(1, sizeof(struct pwc_handoff_queue));
+    if (!queue) {
+        fprintf(stderr, "Failed to allocate handoff queue\n");
+        return NULL;
+    }
+    queue->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (queue->wake_fd < 0) {
+        fprintf(stderr, "Failed to create handoff eventfd\n");
+        free(queue);
+        return NULL;
+    }
+    queue->ring = create_spsc_ring(HANDOFF_RING_CAPACITY, sizeof(HandoffMessageT));
+    if (!queue->ring) {
+        destroy_handoff_queue(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+void destroy_handoff_queue(struct pwc_handoff_queue *queue) {
+    if (!queue) return;
+    destroy_spsc_ring(queue->ring);
+    if (queue->wake_fd >= 0) close(queue->wake_fd);
+    free(queue->backlog);
+    free(queue);
+}
+
+void handoff_send(struct pwc_handoff_queue *queue, const HandoffMessageT *message) {
+    // Behind a backlog the message has to wait too, to stay in order
+    if (queue->backlog_count == 0 && spsc_ring_push(queue->ring, message)) {
+        queue->unflushed = true;
+        return;
+    }
+    if (queue->backlog_count == queue->backlog_capacity) {
+        uint32_t capacity = queue->backlog_capacity ? queue->backlog_capacity * 2 : 64;
+        HandoffMessageT *backlog = realloc(queue->backlog, capacity * sizeof(HandoffMessageT));
+        if (!backlog) {
+            fprintf(stderr, "Failed to grow handoff backlog, message %d lost\n", message->type);
+            return;
+        }
+        queue->backlog = backlog;
+        queue->backlog_capacity = capacity;
+    }
+    queue->backlog[queue->backlog_count++] = *message;
+}
+
+bool handoff_flush(struct pwc_handoff_queue *queue) {
+    uint32_t pushed = 0;
+    while (pushed < queue->backlog_count && spsc_ring_push(queue->ring, &queue->backlog[pushed])) {
+        pushed++;
+    }
+    if (pushed > 0) {
+        queue->backlog_count -= pushed;
+        for (uint32_t i = 0; i < queue->backlog_count; i++) {
+            queue->backlog[i] = queue->backlog[pushed + i];
+        }
+        queue->unflushed = true;
+    }
+
+    if (queue->unflushed) {
+        uint64_t one = 1;
+        // Only fails if the counter is about to overflow, it is readable then anyway
+        write(queue->wake_fd, &one, sizeof(one));
+        queue->unflushed = false;
+    }
+    return queue->backlog_count == 0;
+}
+
+void handoff_clear_wake(struct pwc_handoff_queue *queue) {
+    uint64_t count;
+    read(queue->wake_fd, &count, sizeof(count));
+}
+
+bool handoff_receive(struct pwc_handoff_queue *queue, HandoffMessageT *message) {
+    return spsc_ring_pop(queue->ring, message);
+}
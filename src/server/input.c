@@ -0,0 +1,148 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <libinput.h>
+#include <libudev.h>
+#include <pwc/server/input.h>
+#include <pwc/server/seat.h>
+#include <pwc/server/server.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+
+// Devices are opened directly, the compositor needs access to /dev/input
+static int open_restricted(const char *path, int flags, void *user_data) {
+    int fd = open(path, flags | O_CLOEXEC);
+    return fd < 0 ? -errno : fd;
+}
+
+static void close_restricted(int fd, void *user_data) {
+    close(fd);
+}
+
+static const struct libinput_interface libinput_impl = {
+    .open_restricted = open_restricted,
+    .close_restricted = close_restricted,
+};
+
+static enum wl_pointer_axis_source axis_source(enum libinput_pointer_axis_source source) {
+    switch (source) {
+        case LIBINPUT_POINTER_AXIS_SOURCE_FINGER:
+            return WL_POINTER_AXIS_SOURCE_FINGER;
+        case LIBINPUT_POINTER_AXIS_SOURCE_CONTINUOUS:
+            return WL_POINTER_AXIS_SOURCE_CONTINUOUS;
+        case LIBINPUT_POINTER_AXIS_SOURCE_WHEEL_TILT:
+            return WL_POINTER_AXIS_SOURCE_WHEEL_TILT;
+        default:
+            return WL_POINTER_AXIS_SOURCE_WHEEL;
+    }
+}
+
+static void handle_pointer_axis(struct pwc_seat *seat, struct libinput_event_pointer *event) {
+    static const enum libinput_pointer_axis axes[2] = {
+        [WL_POINTER_AXIS_VERTICAL_SCROLL] = LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL,
+        [WL_POINTER_AXIS_HORIZONTAL_SCROLL] = LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL,
+    };
+    enum libinput_pointer_axis_source source = libinput_event_pointer_get_axis_source(event);
+    bool has_axis[2] = {false, false};
+    double value[2] = {0.0, 0.0};
+    int32_t discrete[2] = {0, 0};
+    for (uint32_t i = 0; i < 2; i++) {
+        if (!libinput_event_pointer_has_axis(event, axes[i])) continue;
+        has_axis[i] = true;
+        value[i] = libinput_event_pointer_get_axis_value(event, axes[i]);
+        if (source == LIBINPUT_POINTER_AXIS_SOURCE_WHEEL) {
+            discrete[i] = (int32_t)libinput_event_pointer_get_axis_value_discrete(event, axes[i]);
+        }
+    }
+    seat_pointer_axis(seat, libinput_event_pointer_get_time_usec(event), axis_source(source), has_axis, value, discrete);
+}
+
+static void handle_event(struct pwc_seat *seat, struct libinput_event *event) {
+    struct libinput_event_pointer *pointer;
+    struct libinput_event_keyboard *keyboard;
+    switch (libinput_event_get_type(event)) {
+        case LIBINPUT_EVENT_KEYBOARD_KEY:
+            keyboard = libinput_event_get_keyboard_event(event);
+            seat_keyboard_key(seat, libinput_event_keyboard_get_time_usec(keyboard), libinput_event_keyboard_get_key(keyboard),
+                              libinput_event_keyboard_get_key_state(keyboard) == LIBINPUT_KEY_STATE_PRESSED);
+            break;
+        case LIBINPUT_EVENT_POINTER_MOTION:
+            pointer = libinput_event_get_pointer_event(event);
+            seat_pointer_motion(seat, libinput_event_pointer_get_time_usec(pointer), libinput_event_pointer_get_dx(pointer),
+                                libinput_event_pointer_get_dy(pointer), libinput_event_pointer_get_dx_unaccelerated(pointer),
+                                libinput_event_pointer_get_dy_unaccelerated(pointer));
+            break;
+        case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
+            pointer = libinput_event_get_pointer_event(event);
+            seat_pointer_motion_absolute(seat, libinput_event_pointer_get_time_usec(pointer),
+                                         libinput_event_pointer_get_absolute_x_transformed(pointer, 1),
+                                         libinput_event_pointer_get_absolute_y_transformed(pointer, 1));
+            break;
+        case LIBINPUT_EVENT_POINTER_BUTTON:
+            pointer = libinput_event_get_pointer_event(event);
+            seat_pointer_button(seat, libinput_event_pointer_get_time_usec(pointer), libinput_event_pointer_get_button(pointer),
+                                libinput_event_pointer_get_button_state(pointer) == LIBINPUT_BUTTON_STATE_PRESSED);
+            break;
+        case LIBINPUT_EVENT_POINTER_AXIS:
+            handle_pointer_axis(seat, libinput_event_get_pointer_event(event));
+            break;
+        default:
+            break;
+    }
+}
+
+// One batch: whatever arrived since the last wakeup
+static int handle_input(int fd, uint32_t mask, void *data) {
+    struct pwc_input *input = data;
+    if (libinput_dispatch(input->libinput) != 0) {
+        fprintf(stderr, "Failed to dispatch libinput events\n");
+        return 0;
+    }
+    struct libinput_event *event;
+    while ((event = libinput_get_event(input->libinput))) {
+        handle_event(input->seat, event);
+        libinput_event_destroy(event);
+    }
+    seat_pointer_flush(input->seat);
+    return 0;
+}
+
+struct pwc_input *create_input(struct pwc_server *server, struct pwc_seat *seat) {
+    struct pwc_input *input = calloc(1, sizeof(struct pwc_input));
+    if (!input) {
+        fprintf(stderr, "Failed to allocate input\n");
+        return NULL;
+    }
+    input->seat = seat;
+
+    input->udev = udev_new();
+    if (!input->udev) {
+        fprintf(stderr, "Failed to create udev context\n");
+        destroy_input(input);
+        return NULL;
+    }
+    input->libinput = libinput_udev_create_context(&libinput_impl, input, input->udev);
+    if (!input->libinput || libinput_udev_assign_seat(input->libinput, "seat0") != 0) {
+        fprintf(stderr, "Failed to open the input devices of seat0\n");
+        destroy_input(input);
+        return NULL;
+    }
+    input->source = wl_event_loop_add_fd(server->loop, libinput_get_fd(input->libinput), WL_EVENT_READABLE, handle_input, input);
+    if (!input->source) {
+        fprintf(stderr, "Failed to watch the libinput fd\n");
+        destroy_input(input);
+        return NULL;
+    }
+    return input;
+}
+
+void destroy_input(struct pwc_input *input) {
+    if (!input) return;
+    if (input->source) wl_event_source_remove(input->source);
+    if (input->libinput) libinput_unref(input->libinput);
+    if (input->udev) udev_unref(input->udev);
+    free(input);
+}
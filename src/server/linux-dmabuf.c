@@ -0,0 +1,538 @@
+// memfd_create
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <fcntl.h>
+#include <linux-dmabuf-v1-protocol.h>
+#include <pwc/render/render.h>
+#include <pwc/render/vulkan/vk-dmabuf.h>
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/server/handoff.h>
+#include <pwc/server/linux-dmabuf.h>
+#include <pwc/server/server.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+
+// zwp_linux_buffer_params_v1, fds are owned until the params object goes away
+typedef struct BufferParams {
+    struct pwc_linux_dmabuf *linux_dmabuf;
+    DmabufAttributesT attributes;
+    bool has_modifier;
+    bool used;
+} BufferParamsT;
+
+static const struct wl_buffer_interface buffer_impl;
+static const struct zwp_linux_buffer_params_v1_interface params_impl;
+
+DmabufBufferT *dmabuf_buffer_from_resource(struct wl_resource *resource) {
+    if (!wl_resource_instance_of(resource, &wl_buffer_interface, &buffer_impl)) return NULL;
+    return wl_resource_get_user_data(resource);
+}
+
+void dmabuf_buffer_show(DmabufBufferT *buffer) {
+    buffer->show_count++;
+    buffer->release_pending = false;
+}
+
+void dmabuf_buffer_hide(DmabufBufferT *buffer) {
+    if (--buffer->show_count > 0) return;
+    texture_retire(buffer->linux_dmabuf->server->render->textures, &buffer->texture);
+    buffer->release_pending = true;
+}
+
+void linux_dmabuf_send_releases(struct pwc_linux_dmabuf *linux_dmabuf) {
+    struct pwc_server *server = linux_dmabuf->server;
+    DmabufBufferT *buffer;
+    wl_list_for_each(buffer, &linux_dmabuf->buffers, link) {
+        if (!buffer->release_pending || texture_busy(server->render->textures, &buffer->texture)) continue;
+        buffer->release_pending = false;
+        handoff_send(server->to_protocol, &(HandoffMessageT){
+                                              .type = HANDOFF_DMABUF_RELEASE,
+                                              .dmabuf = {.buffer = buffer, .commit_count = buffer->commit_count},
+                                          });
+    }
+}
+
+void dmabuf_buffer_import(DmabufBufferT *buffer) {
+    struct pwc_linux_dmabuf *linux_dmabuf = buffer->linux_dmabuf;
+    struct pwc_server *server = linux_dmabuf->server;
+    buffer->imported = dmabuf_import(linux_dmabuf->formats, server->render->textures, &buffer->texture, &buffer->attributes);
+    // Imported memory holds its own fd
+    for (uint32_t i = 0; i < DMABUF_MAX_PLANES; i++) {
+        if (buffer->attributes.fds[i] != -1) close(buffer->attributes.fds[i]);
+        buffer->attributes.fds[i] = -1;
+    }
+    if (buffer->imported) wl_list_insert(&linux_dmabuf->buffers, &buffer->link);
+    handoff_send(server->to_protocol, &(HandoffMessageT){
+                                          .type = HANDOFF_DMABUF_IMPORTED,
+                                          .dmabuf = {.buffer = buffer, .imported = buffer->imported},
+                                      });
+}
+
+void dmabuf_buffer_destroy(DmabufBufferT *buffer) {
+    struct pwc_server *server = buffer->linux_dmabuf->server;
+    if (buffer->imported) {
+        texture_finish(server->render->textures, &buffer->texture);
+        wl_list_remove(&buffer->link);
+    }
+    handoff_send(server->to_protocol, &(HandoffMessageT){.type = HANDOFF_DMABUF_FREED, .dmabuf = {.buffer = buffer}});
+}
+
+static void buffer_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static const struct wl_buffer_interface buffer_impl = {
+    .destroy = buffer_handle_destroy,
+};
+
+static void send_destroy(DmabufBufferT *buffer) {
+    handoff_send(buffer->linux_dmabuf->server->to_render,
+                 &(HandoffMessageT){.type = HANDOFF_DMABUF_DESTROY, .dmabuf = {.buffer = buffer}});
+}
+
+// Surfaces showing the buffer drop it when the render gets to the destroy
+static void buffer_handle_resource_destroy(struct wl_resource *resource) {
+    DmabufBufferT *buffer = wl_resource_get_user_data(resource);
+    buffer->resource = NULL;
+    send_destroy(buffer);
+}
+
+static void detach_params(DmabufBufferT *buffer) {
+    if (!buffer->params) return;
+    wl_list_remove(&buffer->params_destroy.link);
+    buffer->params = NULL;
+}
+
+static void buffer_handle_params_destroy(struct wl_listener *listener, void *data) {
+    DmabufBufferT *buffer = wl_container_of(listener, buffer, params_destroy);
+    detach_params(buffer);
+}
+
+static bool create_wl_buffer(DmabufBufferT *buffer, struct wl_client *client, uint32_t id) {
+    buffer->resource = wl_resource_create(client, &wl_buffer_interface, 1, id);
+    if (!buffer->resource) return false;
+    wl_resource_set_implementation(buffer->resource, &buffer_impl, buffer, buffer_handle_resource_destroy);
+    return true;
+}
+
+void dmabuf_buffer_imported(DmabufBufferT *buffer, bool imported) {
+    struct wl_resource *params = buffer->params;
+    detach_params(buffer);
+
+    if (buffer->immediate) {
+        // The client already uses the id, failing can only be fatal
+        if (imported || !buffer->resource) return;
+        if (params) {
+            wl_resource_post_error(params, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_WL_BUFFER, "Failed to import the dmabuf");
+        } else {
+            wl_client_post_implementation_error(wl_resource_get_client(buffer->resource), "Failed to import the dmabuf");
+        }
+        return;
+    }
+
+    if (params && imported) {
+        if (create_wl_buffer(buffer, wl_resource_get_client(params), 0)) {
+            zwp_linux_buffer_params_v1_send_created(params, buffer->resource);
+            return;
+        }
+        wl_resource_post_no_memory(params);
+    } else if (params) {
+        zwp_linux_buffer_params_v1_send_failed(params);
+    }
+    // Never got a wl_buffer
+    send_destroy(buffer);
+}
+
+// Only if no commit of it is in flight to the render, the release would be taken for that one
+void dmabuf_buffer_release(DmabufBufferT *buffer, uint64_t commit_count) {
+    if (buffer->resource && buffer->attach_count == commit_count) wl_buffer_send_release(buffer->resource);
+}
+
+void dmabuf_buffer_free(DmabufBufferT *buffer) {
+    free(buffer);
+}
+
+static BufferParamsT *params_from_resource(struct wl_resource *resource) {
+    assert(wl_resource_instance_of(resource, &zwp_linux_buffer_params_v1_interface, &params_impl));
+    return wl_resource_get_user_data(resource);
+}
+
+static void params_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void params_handle_add(struct wl_client *client, struct wl_resource *resource, int32_t fd, uint32_t plane_idx,
+                              uint32_t offset, uint32_t stride, uint32_t modifier_hi, uint32_t modifier_lo) {
+    BufferParamsT *params = params_from_resource(resource);
+    DmabufAttributesT *attributes = &params->attributes;
+    uint64_t modifier = ((uint64_t)modifier_hi << 32) | modifier_lo;
+
+    if (params->used) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ALREADY_USED, "Params were already used");
+        close(fd);
+        return;
+    }
+    if (plane_idx >= DMABUF_MAX_PLANES) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_IDX, "Plane index %u out of bounds", plane_idx);
+        close(fd);
+        return;
+    }
+    if (attributes->fds[plane_idx] != -1) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_SET, "Plane %u was already set", plane_idx);
+        close(fd);
+        return;
+    }
+    if (params->has_modifier && attributes->modifier != modifier) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_FORMAT, "Planes have different modifiers");
+        close(fd);
+        return;
+    }
+
+    params->has_modifier = true;
+    attributes->modifier = modifier;
+    attributes->fds[plane_idx] = fd;
+    attributes->offsets[plane_idx] = offset;
+    attributes->strides[plane_idx] = stride;
+    if (plane_idx + 1 > attributes->plane_count) attributes->plane_count = plane_idx + 1;
+}
+
+// Posts the protocol error and returns false if the params can't describe a buffer. A
+// buffer the device can't import isn't an error, create answers it with failed
+static bool params_validate(BufferParamsT *params, struct wl_resource *resource, int32_t width, int32_t height,
+                            uint32_t format) {
+    DmabufAttributesT *attributes = &params->attributes;
+    if (params->used) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ALREADY_USED, "Params were already used");
+        return false;
+    }
+    params->used = true;
+
+    if (attributes->plane_count == 0) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE, "No planes were added");
+        return false;
+    }
+    for (uint32_t i = 0; i < attributes->plane_count; i++) {
+        if (attributes->fds[i] != -1) continue;
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE, "Plane %u is missing", i);
+        return false;
+    }
+
+    struct pwc_dmabuf_formats *formats = params->linux_dmabuf->formats;
+    bool known = false;
+    for (uint32_t i = 0; i < formats->format_count; i++) {
+        if (formats->formats[i].drm_format == format) known = true;
+    }
+    if (!known) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_FORMAT, "Format 0x%08x isn't supported", format);
+        return false;
+    }
+    if (width <= 0 || height <= 0) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_DIMENSIONS, "Invalid size %dx%d", width, height);
+        return false;
+    }
+
+    // Planes have to fit their dmabuf, if its size is known. Only the first plane has a
+    // known height, the others depend on the modifier
+    for (uint32_t i = 0; i < attributes->plane_count; i++) {
+        uint64_t end = (uint64_t)attributes->offsets[i] + attributes->strides[i];
+        if (i == 0) end = (uint64_t)attributes->offsets[i] + (uint64_t)attributes->strides[i] * (uint32_t)height;
+        off_t size = lseek(attributes->fds[i], 0, SEEK_END);
+        bool overflow = end > UINT32_MAX;
+        bool outside = size != -1 && ((uint64_t)attributes->offsets[i] >= (uint64_t)size || end > (uint64_t)size);
+        if (overflow || outside) {
+            wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_OUT_OF_BOUNDS, "Plane %u is out of bounds", i);
+            return false;
+        }
+    }
+
+    attributes->width = (uint32_t)width;
+    attributes->height = (uint32_t)height;
+    attributes->format = format;
+    return true;
+}
+
+// Takes the params' fds over, the render imports them. NULL if the buffer can't be imported
+static DmabufBufferT *params_take_buffer(BufferParamsT *params, struct wl_client *client, struct wl_resource *resource,
+                                         uint32_t flags) {
+    // Inverted or interlaced buffers would need a different sampling of the texture
+    if (flags != 0) return NULL;
+
+    DmabufBufferT *buffer = calloc(1, sizeof(DmabufBufferT));
+    if (!buffer) {
+        wl_client_post_no_memory(client);
+        return NULL;
+    }
+    buffer->linux_dmabuf = params->linux_dmabuf;
+    buffer->attributes = params->attributes;
+    for (uint32_t i = 0; i < DMABUF_MAX_PLANES; i++) {
+        params->attributes.fds[i] = -1;
+    }
+    buffer->params = resource;
+    buffer->params_destroy.notify = buffer_handle_params_destroy;
+    wl_resource_add_destroy_listener(resource, &buffer->params_destroy);
+    return buffer;
+}
+
+static void send_import(DmabufBufferT *buffer) {
+    handoff_send(buffer->linux_dmabuf->server->to_render,
+                 &(HandoffMessageT){.type = HANDOFF_DMABUF_IMPORT, .dmabuf = {.buffer = buffer}});
+}
+
+static void params_handle_create(struct wl_client *client, struct wl_resource *resource, int32_t width, int32_t height,
+                                 uint32_t format, uint32_t flags) {
+    BufferParamsT *params = params_from_resource(resource);
+    if (!params_validate(params, resource, width, height, format)) return;
+
+    // created or failed follows the import
+    DmabufBufferT *buffer = params_take_buffer(params, client, resource, flags);
+    if (!buffer) {
+        zwp_linux_buffer_params_v1_send_failed(resource);
+        return;
+    }
+    send_import(buffer);
+}
+
+static void params_handle_create_immed(struct wl_client *client, struct wl_resource *resource, uint32_t buffer_id, int32_t width,
+                                       int32_t height, uint32_t format, uint32_t flags) {
+    BufferParamsT *params = params_from_resource(resource);
+    if (!params_validate(params, resource, width, height, format)) return;
+
+    DmabufBufferT *buffer = params_take_buffer(params, client, resource, flags);
+    if (!buffer) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_WL_BUFFER, "Failed to import the dmabuf");
+        return;
+    }
+    buffer->immediate = true;
+    if (!create_wl_buffer(buffer, client, buffer_id)) {
+        detach_params(buffer);
+        for (uint32_t i = 0; i < buffer->attributes.plane_count; i++) {
+            close(buffer->attributes.fds[i]);
+        }
+        free(buffer);
+        wl_client_post_no_memory(client);
+        return;
+    }
+    // Commits of it are handed over after the import, they find it imported or not
+    send_import(buffer);
+}
+
+static const struct zwp_linux_buffer_params_v1_interface params_impl = {
+    .destroy = params_handle_destroy,
+    .add = params_handle_add,
+    .create = params_handle_create,
+    .create_immed = params_handle_create_immed,
+};
+
+static void params_handle_resource_destroy(struct wl_resource *resource) {
+    BufferParamsT *params = params_from_resource(resource);
+    // Unless a buffer took them over
+    for (uint32_t i = 0; i < DMABUF_MAX_PLANES; i++) {
+        if (params->attributes.fds[i] != -1) close(params->attributes.fds[i]);
+    }
+    free(params);
+}
+
+static void linux_dmabuf_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void linux_dmabuf_handle_create_params(struct wl_client *client, struct wl_resource *resource, uint32_t params_id) {
+    struct pwc_linux_dmabuf *linux_dmabuf = wl_resource_get_user_data(resource);
+    BufferParamsT *params = calloc(1, sizeof(BufferParamsT));
+    if (!params) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    params->linux_dmabuf = linux_dmabuf;
+    for (uint32_t i = 0; i < DMABUF_MAX_PLANES; i++) {
+        params->attributes.fds[i] = -1;
+    }
+
+    struct wl_resource *params_resource =
+        wl_resource_create(client, &zwp_linux_buffer_params_v1_interface, wl_resource_get_version(resource), params_id);
+    if (!params_resource) {
+        free(params);
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(params_resource, &params_impl, params, params_handle_resource_destroy);
+}
+
+static void feedback_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static const struct zwp_linux_dmabuf_feedback_v1_interface feedback_impl = {
+    .destroy = feedback_handle_destroy,
+};
+
+// Every format sits in the one sampling tranche of the device's node
+static void send_feedback(struct pwc_linux_dmabuf *linux_dmabuf, struct wl_resource *resource) {
+    struct wl_array device = {
+        .size = sizeof(dev_t),
+        .alloc = 0,
+        .data = &linux_dmabuf->main_device,
+    };
+    struct wl_array indices;
+    wl_array_init(&indices);
+    uint16_t *index = wl_array_add(&indices, linux_dmabuf->table_count * sizeof(uint16_t));
+    if (!index) {
+        wl_resource_post_no_memory(resource);
+        return;
+    }
+    for (uint32_t i = 0; i < linux_dmabuf->table_count; i++) {
+        index[i] = (uint16_t)i;
+    }
+
+    zwp_linux_dmabuf_feedback_v1_send_format_table(resource, linux_dmabuf->table_fd, linux_dmabuf->table_size);
+    zwp_linux_dmabuf_feedback_v1_send_main_device(resource, &device);
+    zwp_linux_dmabuf_feedback_v1_send_tranche_target_device(resource, &device);
+    zwp_linux_dmabuf_feedback_v1_send_tranche_flags(resource, 0);
+    zwp_linux_dmabuf_feedback_v1_send_tranche_formats(resource, &indices);
+    zwp_linux_dmabuf_feedback_v1_send_tranche_done(resource);
+    zwp_linux_dmabuf_feedback_v1_send_done(resource);
+    wl_array_release(&indices);
+}
+
+static void create_feedback(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    struct pwc_linux_dmabuf *linux_dmabuf = wl_resource_get_user_data(resource);
+    struct wl_resource *feedback =
+        wl_resource_create(client, &zwp_linux_dmabuf_feedback_v1_interface, wl_resource_get_version(resource), id);
+    if (!feedback) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(feedback, &feedback_impl, linux_dmabuf, NULL);
+    send_feedback(linux_dmabuf, feedback);
+}
+
+static void linux_dmabuf_handle_get_default_feedback(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    create_feedback(client, resource, id);
+}
+
+// Surfaces are only ever sampled, they get the default feedback
+static void linux_dmabuf_handle_get_surface_feedback(struct wl_client *client, struct wl_resource *resource, uint32_t id,
+                                                     struct wl_resource *surface) {
+    create_feedback(client, resource, id);
+}
+
+static const struct zwp_linux_dmabuf_v1_interface linux_dmabuf_impl = {
+    .destroy = linux_dmabuf_handle_destroy,
+    .create_params = linux_dmabuf_handle_create_params,
+    .get_default_feedback = linux_dmabuf_handle_get_default_feedback,
+    .get_surface_feedback = linux_dmabuf_handle_get_surface_feedback,
+};
+
+static void linux_dmabuf_bind(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct pwc_linux_dmabuf *linux_dmabuf = data;
+    struct wl_resource *resource = wl_resource_create(client, &zwp_linux_dmabuf_v1_interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &linux_dmabuf_impl, linux_dmabuf, NULL);
+
+    // Feedback replaced the format events in version 4
+    if (version >= ZWP_LINUX_DMABUF_V1_GET_DEFAULT_FEEDBACK_SINCE_VERSION) return;
+    struct pwc_dmabuf_formats *formats = linux_dmabuf->formats;
+    for (uint32_t i = 0; i < formats->format_count; i++) {
+        DmabufFormatT *format = &formats->formats[i];
+        zwp_linux_dmabuf_v1_send_format(resource, format->drm_format);
+        if (version < ZWP_LINUX_DMABUF_V1_MODIFIER_SINCE_VERSION) continue;
+        for (uint32_t j = 0; j < format->modifier_count; j++) {
+            uint64_t modifier = format->modifiers[j].modifier;
+            zwp_linux_dmabuf_v1_send_modifier(resource, format->drm_format, (uint32_t)(modifier >> 32), (uint32_t)modifier);
+        }
+    }
+}
+
+// The table is sealed, clients can only map it read-only or privately
+static bool create_format_table(struct pwc_linux_dmabuf *linux_dmabuf) {
+    struct pwc_dmabuf_formats *formats = linux_dmabuf->formats;
+    for (uint32_t i = 0; i < formats->format_count; i++) {
+        linux_dmabuf->table_count += formats->formats[i].modifier_count;
+    }
+    if (linux_dmabuf->table_count > UINT16_MAX + 1) linux_dmabuf->table_count = UINT16_MAX + 1;
+    linux_dmabuf->table_size = linux_dmabuf->table_count * sizeof(FormatTableEntryT);
+
+    FormatTableEntryT *entries = calloc(linux_dmabuf->table_count, sizeof(FormatTableEntryT));
+    if (!entries) {
+        fprintf(stderr, "Failed to allocate dmabuf format table\n");
+        return false;
+    }
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < formats->format_count; i++) {
+        for (uint32_t j = 0; j < formats->formats[i].modifier_count && count < linux_dmabuf->table_count; j++) {
+            entries[count++] = (FormatTableEntryT){
+                .format = formats->formats[i].drm_format,
+                .modifier = formats->formats[i].modifiers[j].modifier,
+            };
+        }
+    }
+
+    linux_dmabuf->table_fd = memfd_create("pwc-dmabuf-formats", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (linux_dmabuf->table_fd < 0) {
+        fprintf(stderr, "Failed to create dmabuf format table\n");
+        free(entries);
+        return false;
+    }
+    bool written = write(linux_dmabuf->table_fd, entries, linux_dmabuf->table_size) == (ssize_t)linux_dmabuf->table_size;
+    free(entries);
+    if (!written ||
+        fcntl(linux_dmabuf->table_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+        fprintf(stderr, "Failed to write dmabuf format table\n");
+        close(linux_dmabuf->table_fd);
+        linux_dmabuf->table_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+struct pwc_linux_dmabuf *create_linux_dmabuf(struct pwc_server *server) {
+    struct pwc_render *render = server->render;
+    if (!render->textures->enabled || !render->vulkan->dmabuf_import) return NULL;
+
+    struct pwc_linux_dmabuf *linux_dmabuf = calloc(1, sizeof(struct pwc_linux_dmabuf));
+    if (!linux_dmabuf) {
+        fprintf(stderr, "Failed to allocate linux-dmabuf\n");
+        return NULL;
+    }
+    linux_dmabuf->server = server;
+    linux_dmabuf->table_fd = -1;
+    wl_list_init(&linux_dmabuf->buffers);
+
+    linux_dmabuf->formats = create_dmabuf_formats(render->vulkan);
+    if (!linux_dmabuf->formats || linux_dmabuf->formats->format_count == 0) {
+        destroy_linux_dmabuf(linux_dmabuf);
+        return NULL;
+    }
+
+    // Feedback needs the device's node, without it clients get the version 3 format events
+    uint32_t version = 3;
+    if (render->vulkan->drm_device && create_format_table(linux_dmabuf)) {
+        linux_dmabuf->main_device = makedev(render->vulkan->drm_render_major, render->vulkan->drm_render_minor);
+        version = LINUX_DMABUF_VERSION;
+    }
+    linux_dmabuf->global = wl_global_create(server->display, &zwp_linux_dmabuf_v1_interface, version, linux_dmabuf, linux_dmabuf_bind);
+    if (!linux_dmabuf->global) {
+        fprintf(stderr, "Failed to create zwp_linux_dmabuf_v1\n");
+        destroy_linux_dmabuf(linux_dmabuf);
+        return NULL;
+    }
+    return linux_dmabuf;
+}
+
+void destroy_linux_dmabuf(struct pwc_linux_dmabuf *linux_dmabuf) {
+    if (!linux_dmabuf) return;
+    if (linux_dmabuf->global) wl_global_destroy(linux_dmabuf->global);
+    if (linux_dmabuf->table_fd >= 0) close(linux_dmabuf->table_fd);
+    destroy_dmabuf_formats(linux_dmabuf->formats);
+    free(linux_dmabuf);
+}
@@ -0,0 +1,122 @@
+#include <presentation-time-protocol.h>
+#include <pwc/render/vulkan/vk-present-timing.h>
+#include <pwc/server/presentation.h>
+#include <pwc/server/server.h>
+#include <pwc/server/surface.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+
+static void feedback_handle_resource_destroy(struct wl_resource *resource) {
+    PresentationFeedbackT *feedback = wl_resource_get_user_data(resource);
+    wl_list_remove(&feedback->link);
+    free(feedback);
+}
+
+void presentation_discard(struct wl_list *feedbacks) {
+    PresentationFeedbackT *feedback, *tmp;
+    wl_list_for_each_safe(feedback, tmp, feedbacks, link) {
+        wp_presentation_feedback_send_discarded(feedback->resource);
+        wl_resource_destroy(feedback->resource);
+    }
+}
+
+void presentation_surface_shown(struct pwc_presentation *presentation, struct wl_list *feedbacks, uint64_t commit,
+                                uint32_t output_index, uint64_t serial) {
+    PresentationFeedbackT *feedback, *tmp;
+    wl_list_for_each_safe(feedback, tmp, feedbacks, link) {
+        if (feedback->commit > commit) break;
+        if (feedback->commit < commit) {
+            wp_presentation_feedback_send_discarded(feedback->resource);
+            wl_resource_destroy(feedback->resource);
+        } else if (serial != 0) {
+            feedback->output_index = output_index;
+            feedback->serial = serial;
+            wl_list_remove(&feedback->link);
+            wl_list_insert(presentation->in_flight.prev, &feedback->link);
+        }
+    }
+}
+
+void presentation_frame_presented(struct pwc_presentation *presentation, uint32_t output_index, const PresentedFrameT *frame) {
+    uint64_t seconds = frame->time_ns / 1000000000ull;
+    uint32_t refresh = frame->refresh_ns > UINT32_MAX ? 0 : (uint32_t)frame->refresh_ns;
+
+    PresentationFeedbackT *feedback, *tmp;
+    wl_list_for_each_safe(feedback, tmp, &presentation->in_flight, link) {
+        if (feedback->output_index != output_index || feedback->serial > frame->serial) continue;
+        if (feedback->serial < frame->serial || frame->discarded) {
+            wp_presentation_feedback_send_discarded(feedback->resource);
+        } else {
+            wp_presentation_feedback_send_presented(feedback->resource, (uint32_t)(seconds >> 32), (uint32_t)seconds,
+                                                    (uint32_t)(frame->time_ns % 1000000000ull), refresh,
+                                                    (uint32_t)(frame->sequence >> 32), (uint32_t)frame->sequence, frame->flags);
+        }
+        wl_resource_destroy(feedback->resource);
+    }
+}
+
+static void presentation_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void presentation_handle_feedback(struct wl_client *client, struct wl_resource *resource, struct wl_resource *surface_resource,
+                                         uint32_t callback) {
+    struct pwc_surface *surface = surface_from_resource(surface_resource);
+    PresentationFeedbackT *feedback = calloc(1, sizeof(PresentationFeedbackT));
+    if (!feedback) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    feedback->resource = wl_resource_create(client, &wp_presentation_feedback_interface, wl_resource_get_version(resource), callback);
+    if (!feedback->resource) {
+        free(feedback);
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(feedback->resource, NULL, feedback, feedback_handle_resource_destroy);
+    wl_list_insert(surface->pending.presentation_feedbacks.prev, &feedback->link);
+}
+
+static const struct wp_presentation_interface presentation_impl = {
+    .destroy = presentation_handle_destroy,
+    .feedback = presentation_handle_feedback,
+};
+
+static void presentation_bind(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client, &wp_presentation_interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &presentation_impl, data, NULL);
+    wp_presentation_send_clock_id(resource, CLOCK_MONOTONIC);
+}
+
+struct pwc_presentation *create_presentation(struct pwc_server *server) {
+    struct pwc_presentation *presentation = calloc(1, sizeof(struct pwc_presentation));
+    if (!presentation) {
+        fprintf(stderr, "Failed to allocate presentation\n");
+        return NULL;
+    }
+    presentation->server = server;
+    wl_list_init(&presentation->in_flight);
+
+    presentation->global = wl_global_create(server->display, &wp_presentation_interface, PRESENTATION_VERSION, presentation,
+                                            presentation_bind);
+    if (!presentation->global) {
+        fprintf(stderr, "Failed to create wp_presentation\n");
+        free(presentation);
+        return NULL;
+    }
+    return presentation;
+}
+
+void destroy_presentation(struct pwc_presentation *presentation) {
+    if (!presentation) return;
+    wl_global_destroy(presentation->global);
+    free(presentation);
+}
@@ -0,0 +1,447 @@
+#include <linux/input-event-codes.h>
+#include <math.h>
+#include <pwc/server/handoff.h>
+#include <pwc/server/seat.h>
+#include <pwc/server/server.h>
+#include <pwc/server/surface.h>
+#include <relative-pointer-unstable-v1-protocol.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+
+static struct wl_client *focus_client(struct pwc_seat *seat) {
+    if (!seat->focus || !seat->focus->resource) return NULL;
+    return wl_resource_get_client(seat->focus->resource);
+}
+
+static void send_frame(struct pwc_seat *seat, struct wl_client *client) {
+    struct wl_resource *pointer;
+    wl_resource_for_each(pointer, &seat->pointers) {
+        if (wl_resource_get_client(pointer) != client) continue;
+        if (wl_resource_get_version(pointer) >= WL_POINTER_FRAME_SINCE_VERSION) wl_pointer_send_frame(pointer);
+    }
+}
+
+static void send_enter(struct pwc_seat *seat, struct wl_resource *pointer) {
+    wl_pointer_send_enter(pointer, seat->enter_serial, seat->focus->resource, seat->sent_x, seat->sent_y);
+}
+
+// The render shows the cursor image (see HandoffMessageT.cursor)
+static void send_cursor(struct pwc_seat *seat) {
+    handoff_send(seat->server->to_render, &(HandoffMessageT){
+                                              .type = HANDOFF_CURSOR,
+                                              .cursor = {seat->cursor_surface, seat->hotspot_x, seat->hotspot_y, seat->cursor_set},
+                                          });
+}
+
+// Back to the compositor's own cursor
+static void reset_cursor(struct pwc_seat *seat) {
+    if (!seat->cursor_set) return;
+    seat->cursor_set = false;
+    seat->cursor_surface = NULL;
+    send_cursor(seat);
+}
+
+static bool box_contains(VkRect2D box, double x, double y) {
+    return x >= box.offset.x && y >= box.offset.y && x < (double)box.offset.x + box.extent.width &&
+           y < (double)box.offset.y + box.extent.height;
+}
+
+// Keeps the cursor on an output: off all of them, it stays on the edge of the last one
+static void clamp_cursor(struct pwc_seat *seat) {
+    InputMapT *map = seat->map;
+    if (!map || map->output_count == 0) return;
+    for (uint32_t i = 0; i < map->output_count; i++) {
+        if (box_contains(map->outputs[i], seat->x, seat->y)) {
+            seat->output_index = i;
+            return;
+        }
+    }
+    if (seat->output_index >= map->output_count) seat->output_index = 0;
+    VkRect2D box = map->outputs[seat->output_index];
+    seat->x = fmin(fmax(seat->x, box.offset.x), (double)box.offset.x + box.extent.width - 1.0 / 256);
+    seat->y = fmin(fmax(seat->y, box.offset.y), (double)box.offset.y + box.extent.height - 1.0 / 256);
+}
+
+static InputTargetT *pick_target(struct pwc_seat *seat) {
+    InputMapT *map = seat->map;
+    if (!map) return NULL;
+    for (uint32_t i = 0; i < map->target_count; i++) {
+        InputTargetT *target = &map->targets[i];
+        if (target->surface && target->surface->resource && box_contains(target->box, seat->x, seat->y)) return target;
+    }
+    return NULL;
+}
+
+// Brings wl_pointer up to the cursor position: focus picked there, enter/leave or one motion,
+// then a frame
+static void update_pointer(struct pwc_seat *seat) {
+    seat->motion_pending = false;
+    struct pwc_surface *focus = seat->focus;
+    VkOffset2D origin = seat->focus_origin;
+    float scale = seat->focus_scale;
+    if (seat->buttons_down == 0 || !focus_client(seat)) {
+        InputTargetT *target = pick_target(seat);
+        focus = target ? target->surface : NULL;
+        if (target) {
+            origin = target->box.offset;
+            scale = target->scale;
+        }
+    } else if (seat->map) {
+        // Grabbed: follows the surface if it moved
+        for (uint32_t i = 0; i < seat->map->target_count; i++) {
+            if (seat->map->targets[i].surface != focus) continue;
+            origin = seat->map->targets[i].box.offset;
+            scale = seat->map->targets[i].scale;
+        }
+    }
+    wl_fixed_t x = wl_fixed_from_double((seat->x - origin.x) / scale);
+    wl_fixed_t y = wl_fixed_from_double((seat->y - origin.y) / scale);
+
+    struct wl_resource *pointer;
+    if (focus != seat->focus) {
+        struct wl_client *old_client = focus_client(seat);
+        if (old_client) {
+            uint32_t serial = wl_display_next_serial(seat->server->display);
+            wl_resource_for_each(pointer, &seat->pointers) {
+                if (wl_resource_get_client(pointer) == old_client) wl_pointer_send_leave(pointer, serial, seat->focus->resource);
+            }
+            send_frame(seat, old_client);
+        }
+        seat->focus = focus;
+        seat->focus_origin = origin;
+        seat->focus_scale = scale;
+        seat->buttons_down = 0;
+        reset_cursor(seat);
+        if (!focus) return;
+
+        seat->enter_serial = wl_display_next_serial(seat->server->display);
+        seat->sent_x = x;
+        seat->sent_y = y;
+        struct wl_client *client = focus_client(seat);
+        wl_resource_for_each(pointer, &seat->pointers) {
+            if (wl_resource_get_client(pointer) == client) send_enter(seat, pointer);
+        }
+        send_frame(seat, client);
+        return;
+    }
+
+    seat->focus_origin = origin;
+    seat->focus_scale = scale;
+    struct wl_client *client = focus_client(seat);
+    if (!client || (x == seat->sent_x && y == seat->sent_y)) return;
+    seat->sent_x = x;
+    seat->sent_y = y;
+    wl_resource_for_each(pointer, &seat->pointers) {
+        if (wl_resource_get_client(pointer) == client) wl_pointer_send_motion(pointer, seat->motion_time_ms, x, y);
+    }
+    send_frame(seat, client);
+}
+
+static void publish_cursor(struct pwc_seat *seat) {
+    uint32_t x = (uint32_t)(int32_t)lround(seat->x * 256.0);
+    uint32_t y = (uint32_t)(int32_t)lround(seat->y * 256.0);
+    atomic_store_explicit(&seat->cursor, (uint64_t)x << 32 | y, memory_order_relaxed);
+}
+
+void seat_cursor_position(struct pwc_seat *seat, double *x, double *y) {
+    uint64_t cursor = atomic_load_explicit(&seat->cursor, memory_order_relaxed);
+    *x = (int32_t)(uint32_t)(cursor >> 32) / 256.0;
+    *y = (int32_t)(uint32_t)cursor / 256.0;
+}
+
+void seat_pointer_motion(struct pwc_seat *seat, uint64_t time_us, double dx, double dy, double dx_unaccel, double dy_unaccel) {
+    seat->x += dx;
+    seat->y += dy;
+    clamp_cursor(seat);
+    seat->motion_pending = true;
+    seat->motion_time_ms = (uint32_t)(time_us / 1000);
+
+    // Every event, unclamped and uncoalesced
+    struct wl_client *client = focus_client(seat);
+    if (!client) return;
+    struct wl_resource *relative;
+    wl_resource_for_each(relative, &seat->relative_pointers) {
+        if (wl_resource_get_client(relative) != client) continue;
+        zwp_relative_pointer_v1_send_relative_motion(relative, (uint32_t)(time_us >> 32), (uint32_t)time_us,
+                                                     wl_fixed_from_double(dx), wl_fixed_from_double(dy),
+                                                     wl_fixed_from_double(dx_unaccel), wl_fixed_from_double(dy_unaccel));
+    }
+}
+
+void seat_pointer_motion_absolute(struct pwc_seat *seat, uint64_t time_us, double x, double y) {
+    InputMapT *map = seat->map;
+    if (!map || map->output_count == 0) return;
+    // Bounding box of the layout
+    int64_t x0 = INT32_MAX, y0 = INT32_MAX, x1 = INT32_MIN, y1 = INT32_MIN;
+    for (uint32_t i = 0; i < map->output_count; i++) {
+        VkRect2D box = map->outputs[i];
+        if (box.offset.x < x0) x0 = box.offset.x;
+        if (box.offset.y < y0) y0 = box.offset.y;
+        if ((int64_t)box.offset.x + box.extent.width > x1) x1 = (int64_t)box.offset.x + box.extent.width;
+        if ((int64_t)box.offset.y + box.extent.height > y1) y1 = (int64_t)box.offset.y + box.extent.height;
+    }
+    seat->x = x0 + x * (double)(x1 - x0);
+    seat->y = y0 + y * (double)(y1 - y0);
+    clamp_cursor(seat);
+    seat->motion_pending = true;
+    seat->motion_time_ms = (uint32_t)(time_us / 1000);
+}
+
+void seat_pointer_button(struct pwc_seat *seat, uint64_t time_us, uint32_t button, bool pressed) {
+    // The button goes to whatever is under the cursor by now
+    if (seat->motion_pending) update_pointer(seat);
+    struct wl_client *client = focus_client(seat);
+    if (pressed) {
+        seat->buttons_down++;
+    } else if (seat->buttons_down > 0) {
+        seat->buttons_down--;
+        // The grab ended, the surface under the cursor may not be the focus
+        if (seat->buttons_down == 0) seat->motion_pending = true;
+    }
+    if (!client) return;
+
+    uint32_t serial = wl_display_next_serial(seat->server->display);
+    uint32_t state = pressed ? WL_POINTER_BUTTON_STATE_PRESSED : WL_POINTER_BUTTON_STATE_RELEASED;
+    struct wl_resource *pointer;
+    wl_resource_for_each(pointer, &seat->pointers) {
+        if (wl_resource_get_client(pointer) == client) wl_pointer_send_button(pointer, serial, (uint32_t)(time_us / 1000), button, state);
+    }
+    send_frame(seat, client);
+}
+
+void seat_keyboard_key(struct pwc_seat *seat, uint64_t time_us, uint32_t key, bool pressed) {
+    if (key == KEY_LEFTMETA || key == KEY_RIGHTMETA) {
+        if (pressed) seat->super_down++;
+        else if (seat->super_down > 0) seat->super_down--;
+        return;
+    }
+    if (!pressed || seat->super_down == 0) return;
+
+    HandoffMessageT message = {.workspace = {seat->output_index, 0}};
+    if (key >= KEY_1 && key <= KEY_9) {
+        message.type = HANDOFF_SWITCH_WORKSPACE;
+        message.workspace.index = key - KEY_1;
+    } else if (key == KEY_TAB) {
+        message.type = HANDOFF_TOGGLE_OVERVIEW;
+    } else {
+        return;
+    }
+    handoff_send(seat->server->to_render, &message);
+}
+
+void seat_pointer_axis(struct pwc_seat *seat, uint64_t time_us, enum wl_pointer_axis_source source, const bool has_axis[2],
+                       const double value[2], const int32_t discrete[2]) {
+    if (seat->motion_pending) update_pointer(seat);
+    struct wl_client *client = focus_client(seat);
+    if (!client) return;
+
+    uint32_t time_ms = (uint32_t)(time_us / 1000);
+    struct wl_resource *pointer;
+    wl_resource_for_each(pointer, &seat->pointers) {
+        if (wl_resource_get_client(pointer) != client) continue;
+        int version = wl_resource_get_version(pointer);
+        if (version >= WL_POINTER_AXIS_SOURCE_SINCE_VERSION &&
+            (source != WL_POINTER_AXIS_SOURCE_WHEEL_TILT || version >= WL_POINTER_AXIS_SOURCE_WHEEL_TILT_SINCE_VERSION)) {
+            wl_pointer_send_axis_source(pointer, source);
+        }
+        for (uint32_t axis = 0; axis < 2; axis++) {
+            if (!has_axis[axis]) continue;
+            // Fingers lifted, kinetic scrolling may start
+            if (value[axis] == 0.0 && source != WL_POINTER_AXIS_SOURCE_WHEEL) {
+                if (version >= WL_POINTER_AXIS_STOP_SINCE_VERSION) wl_pointer_send_axis_stop(pointer, time_ms, axis);
+                continue;
+            }
+            if (discrete[axis] != 0 && version >= WL_POINTER_AXIS_DISCRETE_SINCE_VERSION) {
+                wl_pointer_send_axis_discrete(pointer, axis, discrete[axis]);
+            }
+            wl_pointer_send_axis(pointer, time_ms, axis, wl_fixed_from_double(value[axis]));
+        }
+    }
+    send_frame(seat, client);
+}
+
+void seat_pointer_flush(struct pwc_seat *seat) {
+    if (seat->motion_pending) update_pointer(seat);
+    publish_cursor(seat);
+}
+
+void seat_set_input_map(struct pwc_seat *seat, InputMapT *map) {
+    free(seat->map);
+    seat->map = map;
+    // Surfaces may have moved under a still cursor
+    clamp_cursor(seat);
+    update_pointer(seat);
+    publish_cursor(seat);
+}
+
+void seat_surface_destroyed(struct pwc_seat *seat, struct pwc_surface *surface) {
+    // Nothing is sent to a destroyed surface, wl_pointer.leave isn't either
+    if (seat->focus == surface) {
+        seat->focus = NULL;
+        seat->buttons_down = 0;
+        reset_cursor(seat);
+        seat->motion_pending = true;
+    }
+    if (seat->cursor_surface == surface) {
+        seat->cursor_surface = NULL;
+        send_cursor(seat);
+    }
+}
+
+void seat_surface_freed(struct pwc_seat *seat, struct pwc_surface *surface) {
+    if (!seat->map) return;
+    for (uint32_t i = 0; i < seat->map->target_count; i++) {
+        if (seat->map->targets[i].surface == surface) seat->map->targets[i].surface = NULL;
+    }
+}
+
+static void resource_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void unlink_resource(struct wl_resource *resource) {
+    wl_list_remove(wl_resource_get_link(resource));
+}
+
+static void pointer_handle_set_cursor(struct wl_client *client, struct wl_resource *resource, uint32_t serial,
+                                      struct wl_resource *surface_resource, int32_t hotspot_x, int32_t hotspot_y) {
+    struct pwc_seat *seat = wl_resource_get_user_data(resource);
+    // Only the focused client, in answer to its latest enter
+    if (client != focus_client(seat) || serial != seat->enter_serial) return;
+    seat->cursor_set = true;
+    seat->cursor_surface = surface_resource ? surface_from_resource(surface_resource) : NULL;
+    seat->hotspot_x = hotspot_x;
+    seat->hotspot_y = hotspot_y;
+    send_cursor(seat);
+}
+
+static const struct wl_pointer_interface pointer_impl = {
+    .set_cursor = pointer_handle_set_cursor,
+    .release = resource_handle_destroy,
+};
+
+static const struct wl_keyboard_interface keyboard_impl = {
+    .release = resource_handle_destroy,
+};
+
+static const struct wl_touch_interface touch_impl = {
+    .release = resource_handle_destroy,
+};
+
+static void seat_handle_get_pointer(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    struct pwc_seat *seat = wl_resource_get_user_data(resource);
+    struct wl_resource *pointer = wl_resource_create(client, &wl_pointer_interface, wl_resource_get_version(resource), id);
+    if (!pointer) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(pointer, &pointer_impl, seat, unlink_resource);
+    wl_list_insert(&seat->pointers, wl_resource_get_link(pointer));
+    if (client == focus_client(seat)) {
+        send_enter(seat, pointer);
+        if (wl_resource_get_version(pointer) >= WL_POINTER_FRAME_SINCE_VERSION) wl_pointer_send_frame(pointer);
+    }
+}
+
+// Never advertised, the objects stay inert
+static void seat_handle_get_keyboard(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    struct wl_resource *keyboard = wl_resource_create(client, &wl_keyboard_interface, wl_resource_get_version(resource), id);
+    if (!keyboard) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(keyboard, &keyboard_impl, NULL, NULL);
+}
+
+static void seat_handle_get_touch(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    struct wl_resource *touch = wl_resource_create(client, &wl_touch_interface, wl_resource_get_version(resource), id);
+    if (!touch) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(touch, &touch_impl, NULL, NULL);
+}
+
+static const struct wl_seat_interface seat_impl = {
+    .get_pointer = seat_handle_get_pointer,
+    .get_keyboard = seat_handle_get_keyboard,
+    .get_touch = seat_handle_get_touch,
+    .release = resource_handle_destroy,
+};
+
+static void seat_bind(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client, &wl_seat_interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &seat_impl, data, NULL);
+    wl_seat_send_capabilities(resource, WL_SEAT_CAPABILITY_POINTER);
+    if (version >= WL_SEAT_NAME_SINCE_VERSION) wl_seat_send_name(resource, "seat0");
+}
+
+static const struct zwp_relative_pointer_v1_interface relative_pointer_impl = {
+    .destroy = resource_handle_destroy,
+};
+
+static void relative_pointer_manager_handle_get_relative_pointer(struct wl_client *client, struct wl_resource *resource,
+                                                                 uint32_t id, struct wl_resource *pointer) {
+    struct pwc_seat *seat = wl_resource_get_user_data(resource);
+    struct wl_resource *relative =
+        wl_resource_create(client, &zwp_relative_pointer_v1_interface, wl_resource_get_version(resource), id);
+    if (!relative) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(relative, &relative_pointer_impl, seat, unlink_resource);
+    wl_list_insert(&seat->relative_pointers, wl_resource_get_link(relative));
+}
+
+static const struct zwp_relative_pointer_manager_v1_interface relative_pointer_manager_impl = {
+    .destroy = resource_handle_destroy,
+    .get_relative_pointer = relative_pointer_manager_handle_get_relative_pointer,
+};
+
+static void relative_pointer_manager_bind(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client, &zwp_relative_pointer_manager_v1_interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &relative_pointer_manager_impl, data, NULL);
+}
+
+struct pwc_seat *create_seat(struct pwc_server *server) {
+    struct pwc_seat *seat = calloc(1, sizeof(struct pwc_seat));
+    if (!seat) {
+        fprintf(stderr, "Failed to allocate seat\n");
+        return NULL;
+    }
+    seat->server = server;
+    seat->focus_scale = 1.0f;
+    wl_list_init(&seat->pointers);
+    wl_list_init(&seat->relative_pointers);
+    atomic_init(&seat->cursor, 0);
+
+    seat->global = wl_global_create(server->display, &wl_seat_interface, SEAT_VERSION, seat, seat_bind);
+    seat->relative_pointer_manager = wl_global_create(server->display, &zwp_relative_pointer_manager_v1_interface,
+                                                      RELATIVE_POINTER_MANAGER_VERSION, seat, relative_pointer_manager_bind);
+    if (!seat->global || !seat->relative_pointer_manager) {
+        fprintf(stderr, "Failed to create wl_seat\n");
+        destroy_seat(seat);
+        return NULL;
+    }
+    return seat;
+}
+
+void destroy_seat(struct pwc_seat *seat) {
+    if (!seat) return;
+    if (seat->global) wl_global_destroy(seat->global);
+    if (seat->relative_pointer_manager) wl_global_destroy(seat->relative_pointer_manager);
+    free(seat->map);
+    free(seat);
+}
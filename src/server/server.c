@@ -0,0 +1,436 @@
+#include <poll.h>
+#include <pthread.h>
+#include <pwc/render/cursor.h>
+#include <pwc/render/render.h>
+#include <pwc/render/vulkan/vk-upload.h>
+#include <pwc/server/fractional-scale.h>
+#include <pwc/server/handoff.h>
+#include <pwc/server/input.h>
+#include <pwc/server/linux-dmabuf.h>
+#include <pwc/server/presentation.h>
+#include <pwc/server/seat.h>
+#include <pwc/server/server.h>
+#include <pwc/server/shm.h>
+#include <pwc/server/subcompositor.h>
+#include <pwc/server/surface.h>
+#include <pwc/server/viewporter.h>
+#include <pwc/server/xdg-shell.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+
+// Render thread: brings the render's cursor up to the seat's choice and the cursor surface's
+// contents. Nothing is replaced while they stay the same
+static void update_cursor(struct pwc_server *server) {
+    struct pwc_cursor *cursor = server->render->cursor;
+    if (!server->cursor_set) {
+        if (!server->cursor_default) cursor_set_default(cursor);
+        server->cursor_default = true;
+        return;
+    }
+
+    struct pwc_surface *surface = server->cursor_surface;
+    TextureT *texture = surface && surface->node ? surface->node->texture : NULL;
+    VkExtent2D size = texture ? surface->node->geometry.extent : (VkExtent2D){0, 0};
+    VkOffset2D hotspot = {server->cursor_hotspot_x, server->cursor_hotspot_y};
+    uint64_t commit = surface ? surface->shown_commit : 0;
+    if (!server->cursor_default && cursor->texture == texture && cursor->size.width == size.width &&
+        cursor->size.height == size.height && cursor->hotspot.x == hotspot.x && cursor->hotspot.y == hotspot.y &&
+        server->cursor_commit == commit) {
+        return;
+    }
+    server->cursor_default = false;
+    server->cursor_commit = commit;
+    cursor_set_image(cursor, texture, size, hotspot);
+}
+
+// Render thread
+static void apply_message(struct pwc_server *server, HandoffMessageT *message) {
+    switch (message->type) {
+        case HANDOFF_SURFACE_CREATE:
+            surface_render_create(message->surface);
+            break;
+        case HANDOFF_SURFACE_COMMIT: {
+            SurfaceCommitT *commit = message->commit.state;
+            while (commit) {
+                SurfaceCommitT *next = commit->next;
+                commit->next = NULL;
+                surface_render_commit(commit->surface, commit);
+                commit = next;
+            }
+            break;
+        }
+        case HANDOFF_SURFACE_DESTROY:
+            surface_render_destroy(message->surface);
+            break;
+        case HANDOFF_SURFACE_STACK:
+            surface_render_stack(message->stack.surface, message->stack.stack);
+            break;
+        case HANDOFF_SURFACE_UNMAP:
+            surface_render_unmap(message->surface);
+            break;
+        case HANDOFF_DMABUF_IMPORT:
+            dmabuf_buffer_import(message->dmabuf.buffer);
+            break;
+        case HANDOFF_DMABUF_DESTROY: {
+            struct pwc_surface *surface;
+            wl_list_for_each(surface, &server->surfaces, link) {
+                surface_dmabuf_destroyed(surface, message->dmabuf.buffer);
+            }
+            dmabuf_buffer_destroy(message->dmabuf.buffer);
+            break;
+        }
+        case HANDOFF_CURSOR:
+            server->cursor_set = message->cursor.set;
+            server->cursor_surface = message->cursor.surface;
+            server->cursor_hotspot_x = message->cursor.hotspot_x;
+            server->cursor_hotspot_y = message->cursor.hotspot_y;
+            break;
+        case HANDOFF_SWITCH_WORKSPACE:
+            render_switch_workspace(server->render, message->workspace.output_index, message->workspace.index);
+            break;
+        case HANDOFF_TOGGLE_OVERVIEW:
+            render_toggle_overview(server->render, message->workspace.output_index);
+            break;
+        default:
+            fprintf(stderr, "Unexpected handoff message %d on the render thread\n", message->type);
+            break;
+    }
+    // Every message may have changed what the cursor surface shows
+    update_cursor(server);
+}
+
+// Protocol thread
+static void handle_message(struct pwc_server *server, HandoffMessageT *message) {
+    switch (message->type) {
+        case HANDOFF_SURFACE_FRAME:
+            surface_frame(message->frame.surface, message->frame.commit, message->frame.output_index, message->frame.serial,
+                          message->frame.time_ns);
+            break;
+        case HANDOFF_SURFACE_FREED:
+            seat_surface_freed(server->seat, message->surface);
+            surface_free(message->surface);
+            break;
+        case HANDOFF_SURFACE_SCALE:
+            fractional_scale_preferred(message->scale.surface, message->scale.scale);
+            break;
+        case HANDOFF_SHM_RELEASE:
+            shm_buffer_release(message->shm);
+            break;
+        case HANDOFF_DMABUF_IMPORTED:
+            dmabuf_buffer_imported(message->dmabuf.buffer, message->dmabuf.imported);
+            break;
+        case HANDOFF_DMABUF_RELEASE:
+            dmabuf_buffer_release(message->dmabuf.buffer, message->dmabuf.commit_count);
+            break;
+        case HANDOFF_DMABUF_FREED:
+            dmabuf_buffer_free(message->dmabuf.buffer);
+            break;
+        case HANDOFF_FRAME_PRESENTED:
+            presentation_frame_presented(server->presentation, message->presented.output_index, &message->presented.frame);
+            break;
+        case HANDOFF_INPUT_MAP:
+            seat_set_input_map(server->seat, message->input_map);
+            break;
+        default:
+            fprintf(stderr, "Unexpected handoff message %d on the protocol thread\n", message->type);
+            break;
+    }
+}
+
+static int handle_wake(int fd, uint32_t mask, void *data) {
+    struct pwc_server *server = data;
+    handoff_clear_wake(server->to_protocol);
+    HandoffMessageT message;
+    while (handoff_receive(server->to_protocol, &message)) {
+        handle_message(server, &message);
+    }
+    return 0;
+}
+
+static void *protocol_thread_main(void *data) {
+    struct pwc_server *server = data;
+    bool flushed = true;
+    while (!atomic_load(&server->quit)) {
+        // A backlog is retried every millisecond until the render made room for it
+        wl_event_loop_dispatch(server->loop, flushed ? -1 : 1);
+        wl_display_flush_clients(server->display);
+        flushed = handoff_flush(server->to_render);
+    }
+    return NULL;
+}
+
+struct pwc_server *create_server(struct pwc_render *render) {
+    struct pwc_server *server = calloc(1, sizeof(struct pwc_server));
+    if (!server) {
+        fprintf(stderr, "Failed to allocate server\n");
+        return NULL;
+    }
+    server->render = render;
+    server->cursor_default = true;
+    wl_list_init(&server->surfaces);
+    atomic_init(&server->quit, false);
+
+    server->to_render = create_handoff_queue();
+    server->to_protocol = create_handoff_queue();
+    if (!server->to_render || !server->to_protocol) {
+        destroy_server(server);
+        return NULL;
+    }
+
+    server->display = wl_display_create();
+    if (!server->display) {
+        fprintf(stderr, "Failed to create wayland display\n");
+        destroy_server(server);
+        return NULL;
+    }
+    server->loop = wl_display_get_event_loop(server->display);
+    server->wake_source = wl_event_loop_add_fd(server->loop, server->to_protocol->wake_fd, WL_EVENT_READABLE, handle_wake, server);
+    if (!server->wake_source) {
+        fprintf(stderr, "Failed to watch the handoff eventfd\n");
+        destroy_server(server);
+        return NULL;
+    }
+
+    server->shm = create_shm_global(server);
+    if (!server->shm) {
+        fprintf(stderr, "Failed to create wl_shm\n");
+        destroy_server(server);
+        return NULL;
+    }
+
+    server->compositor = create_compositor_global(server);
+    if (!server->compositor) {
+        fprintf(stderr, "Failed to create wl_compositor\n");
+        destroy_server(server);
+        return NULL;
+    }
+
+    server->subcompositor = create_subcompositor_global(server);
+    if (!server->subcompositor) {
+        fprintf(stderr, "Failed to create wl_subcompositor\n");
+        destroy_server(server);
+        return NULL;
+    }
+
+    server->xdg_shell = create_xdg_shell_global(server);
+    if (!server->xdg_shell) {
+        fprintf(stderr, "Failed to create xdg_wm_base\n");
+        destroy_server(server);
+        return NULL;
+    }
+
+    server->viewporter = create_viewporter_global(server);
+    if (!server->viewporter) {
+        fprintf(stderr, "Failed to create wp_viewporter\n");
+        destroy_server(server);
+        return NULL;
+    }
+
+    server->fractional_scale = create_fractional_scale_global(server);
+    if (!server->fractional_scale) {
+        fprintf(stderr, "Failed to create wp_fractional_scale_manager_v1\n");
+        destroy_server(server);
+        return NULL;
+    }
+
+    server->presentation = create_presentation(server);
+    if (!server->presentation) {
+        destroy_server(server);
+        return NULL;
+    }
+
+    server->seat = create_seat(server);
+    if (!server->seat) {
+        destroy_server(server);
+        return NULL;
+    }
+    // Optional, without devices nothing moves the cursor
+    server->input = create_input(server, server->seat);
+
+    // Optional, clients fall back to wl_shm
+    server->linux_dmabuf = create_linux_dmabuf(server);
+
+    server->socket = wl_display_add_socket_auto(server->display);
+    if (!server->socket) {
+        fprintf(stderr, "Failed to add wayland socket\n");
+        destroy_server(server);
+        return NULL;
+    }
+    setenv("WAYLAND_DISPLAY", server->socket, true);
+
+    if (pthread_create(&server->thread, NULL, protocol_thread_main, server) != 0) {
+        fprintf(stderr, "Failed to create protocol thread\n");
+        destroy_server(server);
+        return NULL;
+    }
+    server->thread_started = true;
+    printf("Running on WAYLAND_DISPLAY=%s\n", server->socket);
+    return server;
+}
+
+// Both sides on this thread, until neither has anything left to say
+static void drain_handoff(struct pwc_server *server) {
+    bool busy = true;
+    while (busy) {
+        busy = !handoff_flush(server->to_render);
+        busy = !handoff_flush(server->to_protocol) || busy;
+        HandoffMessageT message;
+        while (handoff_receive(server->to_render, &message)) {
+            apply_message(server, &message);
+            busy = true;
+        }
+        while (handoff_receive(server->to_protocol, &message)) {
+            handle_message(server, &message);
+            busy = true;
+        }
+    }
+}
+
+void destroy_server(struct pwc_server *server) {
+    if (!server) return;
+    if (server->thread_started) {
+        atomic_store(&server->quit, true);
+        uint64_t one = 1;
+        write(server->to_protocol->wake_fd, &one, sizeof(one));
+        pthread_join(server->thread, NULL);
+    }
+
+    // The protocol side is this thread's now. Surfaces go with their clients, once the render
+    // side let go of them too
+    if (server->display) {
+        wl_display_destroy_clients(server->display);
+        drain_handoff(server);
+        destroy_input(server->input);
+        destroy_seat(server->seat);
+        destroy_linux_dmabuf(server->linux_dmabuf);
+        destroy_presentation(server->presentation);
+        if (server->wake_source) wl_event_source_remove(server->wake_source);
+        wl_display_destroy(server->display);
+    }
+    destroy_handoff_queue(server->to_render);
+    destroy_handoff_queue(server->to_protocol);
+    free(server->input_map);
+    free(server);
+}
+
+void server_dispatch(struct pwc_server *server, int timeout_ms) {
+    // Copies in flight are polled, their buffers go back without waiting for a frame
+    bool copying = uploader_release_completed(server->render->uploader);
+    if (copying && (timeout_ms < 0 || timeout_ms > UPLOAD_POLL_MS)) timeout_ms = UPLOAD_POLL_MS;
+
+    struct pollfd wake = {.fd = server->to_render->wake_fd, .events = POLLIN};
+    if (poll(&wake, 1, timeout_ms) > 0) {
+        handoff_clear_wake(server->to_render);
+        HandoffMessageT message;
+        while (handoff_receive(server->to_render, &message)) {
+            apply_message(server, &message);
+        }
+    }
+    if (copying) uploader_release_completed(server->render->uploader);
+    handoff_flush(server->to_protocol);
+}
+
+// Surface nodes of the subtree, top-most first: children are stacked above their parent
+static void add_input_targets(struct pwc_server *server, SceneNodeT *node, const VkOffset2D *output_origins, InputMapT *map,
+                              uint32_t capacity) {
+    for (SceneNodeT *child = node->last_child; child; child = child->prev) {
+        add_input_targets(server, child, output_origins, map, capacity);
+    }
+    if (node->type != SCENE_NODE_SURFACE || map->target_count == capacity) return;
+
+    struct pwc_surface *surface;
+    wl_list_for_each(surface, &server->surfaces, link) {
+        if (surface->node != node) continue;
+        uint32_t output_index;
+        if (!render_node_visible(server->render, node, &output_index)) return;
+        VkRect2D box = scene_node_transformed_geometry(node);
+        box.offset.x += output_origins[output_index].x;
+        box.offset.y += output_origins[output_index].y;
+        map->targets[map->target_count++] = (InputTargetT){surface, box, surface->output_scale};
+        return;
+    }
+}
+
+static size_t input_map_size(uint32_t target_count) {
+    return sizeof(InputMapT) + (size_t)target_count * sizeof(InputTargetT);
+}
+
+// Rebuilt every tick, but only handed over when it changed
+static void publish_input_map(struct pwc_server *server) {
+    struct pwc_render *render = server->render;
+    uint32_t capacity = 0;
+    struct pwc_surface *surface;
+    wl_list_for_each(surface, &server->surfaces, link) {
+        capacity++;
+    }
+    InputMapT *map = calloc(1, input_map_size(capacity));
+    if (!map) {
+        fprintf(stderr, "Failed to allocate input map\n");
+        return;
+    }
+
+    VkOffset2D origins[MAX_OUTPUTS];
+    for (uint32_t i = 0; i < render->output_count; i++) {
+        origins[i] = render_output_origin(render, i);
+        map->outputs[i] = (VkRect2D){origins[i], render->outputs[i].output->swapchain_extent};
+    }
+    map->output_count = render->output_count;
+    add_input_targets(server, render->scene->root, origins, map, capacity);
+
+    InputMapT *last = server->input_map;
+    if (last && last->target_count == map->target_count && memcmp(last, map, input_map_size(map->target_count)) == 0) {
+        free(map);
+        return;
+    }
+    InputMapT *copy = malloc(input_map_size(map->target_count));
+    if (!copy) {
+        fprintf(stderr, "Failed to allocate input map\n");
+        free(map);
+        return;
+    }
+    memcpy(copy, map, input_map_size(map->target_count));
+    free(server->input_map);
+    server->input_map = map;
+    handoff_send(server->to_protocol, &(HandoffMessageT){.type = HANDOFF_INPUT_MAP, .input_map = copy});
+}
+
+void server_frame_done(struct pwc_server *server, uint64_t now_ns) {
+    struct pwc_surface *surface;
+    wl_list_for_each(surface, &server->surfaces, link) {
+        surface_retry_upload(surface);
+        // Visible ones are done by their output, see server_output_frame()
+        if (!surface->frame_requested || now_ns - surface->frame_done_ns < HIDDEN_FRAME_INTERVAL_NS) continue;
+        if (surface->node && render_node_visible(server->render, surface->node, NULL)) continue;
+        // No frame shows it
+        surface_frame_due(surface, 0, 0, now_ns);
+    }
+    // A held cursor image may have been uploaded
+    update_cursor(server);
+    if (server->linux_dmabuf) linux_dmabuf_send_releases(server->linux_dmabuf);
+    publish_input_map(server);
+    uploader_release_completed(server->render->uploader);
+    handoff_flush(server->to_protocol);
+}
+
+void server_output_frame(struct pwc_server *server, uint32_t output_index, uint64_t serial, uint64_t now_ns) {
+    struct pwc_surface *surface;
+    wl_list_for_each(surface, &server->surfaces, link) {
+        if (!surface->frame_requested || !surface->node) continue;
+        uint32_t index;
+        if (!render_node_visible(server->render, surface->node, &index) || index != output_index) continue;
+        surface_frame_due(surface, output_index, serial, now_ns);
+    }
+}
+
+void server_frame_presented(struct pwc_server *server, uint32_t output_index, const PresentedFrameT *frame) {
+    handoff_send(server->to_protocol, &(HandoffMessageT){
+                                          .type = HANDOFF_FRAME_PRESENTED,
+                                          .presented = {output_index, *frame},
+                                      });
+}
@@ -0,0 +1,367 @@
+// F_GET_SEALS and MAP_ANONYMOUS
+#define _GNU_SOURCE
+
+#include <pwc/render/damage.h>
+#include <pwc/render/render.h>
+#include <pwc/render/vulkan/vk-texture.h>
+#include <pwc/render/vulkan/vk-upload.h>
+#include <pwc/render/vulkan/vulkan.h>
+#include <pwc/server/handoff.h>
+#include <pwc/server/server.h>
+#include <pwc/server/shm.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vulkan/vulkan_core.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+
+// A client's wl_shm_pool. Protocol thread
+typedef struct ShmPool {
+    struct pwc_server *server;
+    uint32_t refs;  // The wl_shm_pool resource and every wl_buffer created from it
+    int fd;         // Kept to map the pool again on resize
+    ShmMappingT *mapping;
+} ShmPoolT;
+
+// A wl_buffer created from a pool. Protocol thread
+typedef struct ShmPoolBuffer {
+    ShmPoolT *pool;
+    int32_t offset;
+    int32_t width, height;
+    int32_t stride;
+    uint32_t format;  // enum wl_shm_format
+} ShmPoolBufferT;
+
+static const struct wl_shm_pool_interface pool_impl;
+static const struct wl_buffer_interface buffer_impl;
+
+// Pages of the buffer being staged by this thread, see handle_sigbus()
+static _Thread_local ShmBufferT *guarded;
+static _Thread_local uintptr_t guarded_start, guarded_end;
+static struct sigaction previous_sigbus;
+static bool sigbus_installed;
+
+// Sealed against shrinking and at least size long: the client can't truncate it under a copy
+static bool pool_sealed(int fd, size_t size) {
+    int seals = fcntl(fd, F_GET_SEALS);
+    struct stat st;
+    return seals >= 0 && (seals & F_SEAL_SHRINK) && fstat(fd, &st) == 0 && (size_t)st.st_size >= size;
+}
+
+static ShmMappingT *map_pool(int fd, size_t size) {
+    ShmMappingT *mapping = calloc(1, sizeof(ShmMappingT));
+    if (!mapping) {
+        fprintf(stderr, "Failed to allocate shm mapping\n");
+        return NULL;
+    }
+    mapping->data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping->data == MAP_FAILED) {
+        free(mapping);
+        return NULL;
+    }
+    mapping->size = size;
+    mapping->refs = 1;
+    mapping->sealed = pool_sealed(fd, size);
+    return mapping;
+}
+
+static void mapping_unref(ShmMappingT *mapping) {
+    if (--mapping->refs > 0) return;
+    // The import has to go before the pages it wraps
+    if (mapping->import_buffer) vkDestroyBuffer(mapping->import_device, mapping->import_buffer, NULL);
+    if (mapping->import_mem) vkFreeMemory(mapping->import_device, mapping->import_mem, NULL);
+    munmap(mapping->data, mapping->size);
+    free(mapping);
+}
+
+static void pool_unref(ShmPoolT *pool) {
+    if (--pool->refs > 0) return;
+    mapping_unref(pool->mapping);
+    close(pool->fd);
+    free(pool);
+}
+
+static ShmPoolBufferT *pool_buffer_from_resource(struct wl_resource *resource) {
+    if (!wl_resource_instance_of(resource, &wl_buffer_interface, &buffer_impl)) return NULL;
+    return wl_resource_get_user_data(resource);
+}
+
+static void resource_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static const struct wl_buffer_interface buffer_impl = {
+    .destroy = resource_handle_destroy,
+};
+
+static void buffer_handle_resource_destroy(struct wl_resource *resource) {
+    ShmPoolBufferT *buffer = wl_resource_get_user_data(resource);
+    pool_unref(buffer->pool);
+    free(buffer);
+}
+
+static void pool_handle_create_buffer(struct wl_client *client, struct wl_resource *resource, uint32_t id, int32_t offset,
+                                      int32_t width, int32_t height, int32_t stride, uint32_t format) {
+    ShmPoolT *pool = wl_resource_get_user_data(resource);
+    if (format != WL_SHM_FORMAT_ARGB8888 && format != WL_SHM_FORMAT_XRGB8888) {
+        wl_resource_post_error(resource, WL_SHM_ERROR_INVALID_FORMAT, "Invalid format 0x%x", format);
+        return;
+    }
+    if (offset < 0 || width <= 0 || height <= 0 || stride / 4 < width ||
+        (uint64_t)offset + (uint64_t)stride * (uint64_t)height > pool->mapping->size) {
+        wl_resource_post_error(resource, WL_SHM_ERROR_INVALID_STRIDE, "Invalid buffer %dx%d, stride %d, offset %d", width,
+                               height, stride, offset);
+        return;
+    }
+
+    ShmPoolBufferT *buffer = calloc(1, sizeof(ShmPoolBufferT));
+    if (!buffer) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    struct wl_resource *buffer_resource = wl_resource_create(client, &wl_buffer_interface, 1, id);
+    if (!buffer_resource) {
+        free(buffer);
+        wl_client_post_no_memory(client);
+        return;
+    }
+    *buffer = (ShmPoolBufferT){pool, offset, width, height, stride, format};
+    pool->refs++;
+    wl_resource_set_implementation(buffer_resource, &buffer_impl, buffer, buffer_handle_resource_destroy);
+}
+
+// The pool is mapped again, buffers committed from the old mapping keep it until released.
+// A new mapping is imported again by its first upload
+static void pool_handle_resize(struct wl_client *client, struct wl_resource *resource, int32_t size) {
+    ShmPoolT *pool = wl_resource_get_user_data(resource);
+    if (size <= 0 || (size_t)size < pool->mapping->size) {
+        wl_resource_post_error(resource, WL_SHM_ERROR_INVALID_STRIDE, "Shrinking the pool to %d is invalid", size);
+        return;
+    }
+    if ((size_t)size == pool->mapping->size) return;
+
+    ShmMappingT *mapping = map_pool(pool->fd, (size_t)size);
+    if (!mapping) {
+        wl_resource_post_error(resource, WL_SHM_ERROR_INVALID_FD, "Failed to map the resized pool");
+        return;
+    }
+    mapping_unref(pool->mapping);
+    pool->mapping = mapping;
+}
+
+static const struct wl_shm_pool_interface pool_impl = {
+    .create_buffer = pool_handle_create_buffer,
+    .destroy = resource_handle_destroy,
+    .resize = pool_handle_resize,
+};
+
+static void pool_handle_resource_destroy(struct wl_resource *resource) {
+    pool_unref(wl_resource_get_user_data(resource));
+}
+
+static void shm_handle_create_pool(struct wl_client *client, struct wl_resource *resource, uint32_t id, int32_t fd,
+                                   int32_t size) {
+    if (size <= 0) {
+        wl_resource_post_error(resource, WL_SHM_ERROR_INVALID_STRIDE, "Invalid pool size %d", size);
+        close(fd);
+        return;
+    }
+    ShmPoolT *pool = calloc(1, sizeof(ShmPoolT));
+    if (!pool) {
+        wl_client_post_no_memory(client);
+        close(fd);
+        return;
+    }
+    pool->server = wl_resource_get_user_data(resource);
+    pool->fd = fd;
+    pool->mapping = map_pool(fd, (size_t)size);
+    if (!pool->mapping) {
+        wl_resource_post_error(resource, WL_SHM_ERROR_INVALID_FD, "Failed to map the pool");
+        close(fd);
+        free(pool);
+        return;
+    }
+    struct wl_resource *pool_resource = wl_resource_create(client, &wl_shm_pool_interface, 1, id);
+    if (!pool_resource) {
+        wl_client_post_no_memory(client);
+        mapping_unref(pool->mapping);
+        close(fd);
+        free(pool);
+        return;
+    }
+    pool->refs = 1;
+    wl_resource_set_implementation(pool_resource, &pool_impl, pool, pool_handle_resource_destroy);
+}
+
+static const struct wl_shm_interface shm_impl = {
+    .create_pool = shm_handle_create_pool,
+};
+
+static void shm_bind(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client, &wl_shm_interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &shm_impl, data, NULL);
+    wl_shm_send_format(resource, WL_SHM_FORMAT_ARGB8888);
+    wl_shm_send_format(resource, WL_SHM_FORMAT_XRGB8888);
+}
+
+struct wl_global *create_shm_global(struct pwc_server *server) {
+    return wl_global_create(server->display, &wl_shm_interface, SHM_VERSION, server, shm_bind);
+}
+
+static void handle_buffer_destroy(struct wl_listener *listener, void *data) {
+    ShmBufferT *buffer = wl_container_of(listener, buffer, destroy);
+    wl_list_remove(&buffer->destroy.link);
+    buffer->resource = NULL;
+}
+
+bool shm_buffer_extent(struct wl_resource *resource, VkExtent2D *extent) {
+    ShmPoolBufferT *pool_buffer = pool_buffer_from_resource(resource);
+    if (!pool_buffer) return false;
+    *extent = (VkExtent2D){(uint32_t)pool_buffer->width, (uint32_t)pool_buffer->height};
+    return true;
+}
+
+ShmBufferT *shm_buffer_take(struct wl_resource *resource) {
+    ShmPoolBufferT *pool_buffer = pool_buffer_from_resource(resource);
+    if (!pool_buffer) return NULL;
+
+    ShmBufferT *buffer = calloc(1, sizeof(ShmBufferT));
+    if (!buffer) {
+        fprintf(stderr, "Failed to allocate shm buffer\n");
+        return NULL;
+    }
+    ShmPoolT *pool = pool_buffer->pool;
+    buffer->server = pool->server;
+    buffer->resource = resource;
+    buffer->destroy.notify = handle_buffer_destroy;
+    wl_resource_add_destroy_listener(resource, &buffer->destroy);
+    buffer->mapping = pool->mapping;
+    buffer->mapping->refs++;
+    buffer->data = (uint8_t *)pool->mapping->data + pool_buffer->offset;
+    buffer->stride = (uint32_t)pool_buffer->stride;
+    buffer->extent = (VkExtent2D){(uint32_t)pool_buffer->width, (uint32_t)pool_buffer->height};
+    // Little endian ARGB8888 is B, G, R, A in memory. Premultiplied, like the blending
+    buffer->format = VK_FORMAT_B8G8R8A8_UNORM;
+    buffer->opaque = pool_buffer->format == WL_SHM_FORMAT_XRGB8888;
+    return buffer;
+}
+
+void shm_buffer_release(ShmBufferT *buffer) {
+    mapping_unref(buffer->mapping);
+    if (buffer->resource) {
+        wl_list_remove(&buffer->destroy.link);
+        if (buffer->faulted) {
+            wl_resource_post_error(buffer->resource, WL_SHM_ERROR_INVALID_FD, "Error accessing the shm buffer");
+        } else {
+            wl_buffer_send_release(buffer->resource);
+        }
+    }
+    free(buffer);
+}
+
+void shm_buffer_return(struct pwc_server *server, ShmBufferT *buffer) {
+    handoff_send(server->to_protocol, &(HandoffMessageT){.type = HANDOFF_SHM_RELEASE, .shm = buffer});
+}
+
+// Same as libwayland: zeroes are mapped over the truncated pages, the copy completes and the
+// client is disconnected when the buffer is released. Faults anywhere else aren't ours
+static void handle_sigbus(int signum, siginfo_t *info, void *context) {
+    uintptr_t address = (uintptr_t)info->si_addr;
+    if (guarded && address >= guarded_start && address < guarded_end &&
+        mmap((void *)guarded_start, guarded_end - guarded_start, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS,
+             -1, 0) != MAP_FAILED) {
+        guarded->faulted = true;
+        return;
+    }
+    sigaction(SIGBUS, &previous_sigbus, NULL);
+    raise(SIGBUS);
+}
+
+static void guard_begin(ShmBufferT *buffer) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (!sigbus_installed) {
+        struct sigaction action = {
+            .sa_sigaction = handle_sigbus,
+            .sa_flags = SA_SIGINFO | SA_NODEFER,
+        };
+        sigemptyset(&action.sa_mask);
+        sigbus_installed = sigaction(SIGBUS, &action, &previous_sigbus) == 0;
+    }
+    uintptr_t data = (uintptr_t)buffer->data;
+    uintptr_t end = data + (uintptr_t)buffer->stride * buffer->extent.height;
+    guarded_start = data & ~(uintptr_t)(page_size - 1);
+    guarded_end = (end + (uintptr_t)page_size - 1) & ~(uintptr_t)(page_size - 1);
+    guarded = buffer;
+}
+
+static void guard_end(void) {
+    guarded = NULL;
+}
+
+// Upload release: the copy completed
+static void import_release(void *data) {
+    ShmBufferT *buffer = data;
+    shm_buffer_return(buffer->server, buffer);
+}
+
+// Copies straight out of the client's pool, through the import of the whole mapping. The
+// mapping is page aligned and the import size is rounded up to the import alignment, which
+// stays inside the mapping's last page as long as the alignment isn't above the page size
+static bool upload_imported(struct pwc_server *server, TextureImageT *image, ShmBufferT *buffer, const DamageRegionT *region) {
+    struct pwc_render *render = server->render;
+    struct pwc_vulkan *vulkan = render->vulkan;
+    ShmMappingT *mapping = buffer->mapping;
+    VkDeviceSize alignment = vulkan->host_pointer_alignment;
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (!mapping->sealed || !vulkan->external_memory_host || alignment == 0 || page_size <= 0 ||
+        alignment > (VkDeviceSize)page_size) {
+        return false;
+    }
+
+    // Copy offsets have to be texel aligned
+    VkDeviceSize offset = (uintptr_t)buffer->data - (uintptr_t)mapping->data;
+    if (offset % 4 != 0 || buffer->stride % 4 != 0) return false;
+
+    // Once per mapping, a driver refusing it is not asked again
+    if (!mapping->import_buffer) {
+        if (mapping->import_tried) return false;
+        mapping->import_tried = true;
+        VkDeviceSize import_size = (mapping->size + alignment - 1) & ~(alignment - 1);
+        if (!upload_import_host(vulkan, mapping->data, import_size, &mapping->import_buffer, &mapping->import_mem)) {
+            return false;
+        }
+        mapping->import_device = vulkan->device;
+    }
+
+    return upload_image_region_from_buffer(render->uploader, image->image, image->initialized, mapping->import_buffer, offset,
+                                           buffer->stride, region, import_release, buffer);
+}
+
+bool shm_buffer_upload(struct pwc_server *server, TextureT *texture, ShmBufferT *buffer, const DamageRegionT *damage) {
+    struct pwc_render *render = server->render;
+    DamageRegionT region;
+    TextureImageT *image = texture_begin_update(render->textures, texture, damage, &region);
+    if (!image) return false;
+
+    if (!upload_imported(server, image, buffer, &region)) {
+        // Staged: the buffer is free again as soon as the rects are copied out
+        guard_begin(buffer);
+        bool uploaded = upload_image_region(render->uploader, image->image, image->initialized, buffer->data, buffer->stride, &region);
+        guard_end();
+        if (!uploaded) return false;
+        shm_buffer_return(server, buffer);
+    }
+
+    texture_end_update(render->textures, texture, damage);
+    return true;
+}
@@ -0,0 +1,230 @@
+#include <assert.h>
+#include <pwc/server/server.h>
+#include <pwc/server/subcompositor.h>
+#include <pwc/server/surface.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+
+static const struct wl_subsurface_interface subsurface_impl;
+
+static SubsurfaceT *subsurface_from_resource(struct wl_resource *resource) {
+    assert(wl_resource_instance_of(resource, &wl_subsurface_interface, &subsurface_impl));
+    return wl_resource_get_user_data(resource);
+}
+
+static SubsurfaceT *surface_subsurface(struct pwc_surface *surface) {
+    return surface->role == SURFACE_ROLE_SUBSURFACE ? surface->role_object : NULL;
+}
+
+bool surface_synchronized(struct pwc_surface *surface) {
+    SubsurfaceT *subsurface;
+    while ((subsurface = surface_subsurface(surface)) && subsurface->parent) {
+        if (subsurface->synchronized) return true;
+        surface = subsurface->parent;
+    }
+    return false;
+}
+
+void subsurface_parent_commit(struct pwc_surface *surface) {
+    if (!surface->pending_stack_changed) return;
+    surface->pending_stack_changed = false;
+    surface->stack_changed = true;
+
+    // Every applied entry is pending too, the stack is rebuilt in pending order
+    wl_list_init(&surface->stack);
+    for (struct wl_list *link = surface->pending_stack.next; link != &surface->pending_stack; link = link->next) {
+        if (link == &surface->pending_self) {
+            wl_list_insert(surface->stack.prev, &surface->self.link);
+            continue;
+        }
+        SubsurfaceT *subsurface = wl_container_of(link, subsurface, pending_link);
+        subsurface->child.x = subsurface->pending_x;
+        subsurface->child.y = subsurface->pending_y;
+        wl_list_insert(surface->stack.prev, &subsurface->child.link);
+    }
+}
+
+// Out of the parent's stacks, the render unparents its tree with the parent's new stack
+static void subsurface_unlink(SubsurfaceT *subsurface) {
+    struct pwc_surface *parent = subsurface->parent;
+    if (!parent) return;
+    subsurface->parent = NULL;
+
+    wl_list_remove(&subsurface->pending_link);
+    wl_list_init(&subsurface->pending_link);
+    if (wl_list_empty(&subsurface->child.link)) return;
+    wl_list_remove(&subsurface->child.link);
+    wl_list_init(&subsurface->child.link);
+    surface_send_stack(parent);
+}
+
+void subsurface_surface_destroyed(struct pwc_surface *surface) {
+    SubsurfaceT *subsurface = surface_subsurface(surface);
+    if (subsurface) {
+        subsurface_unlink(subsurface);
+        subsurface->surface = NULL;
+        surface->role_object = NULL;
+    }
+
+    // Its subsurfaces stay without a parent, unmapped. Nothing caches their commits any more
+    struct wl_list *link, *next;
+    for (link = surface->pending_stack.next; link != &surface->pending_stack; link = next) {
+        next = link->next;
+        if (link == &surface->pending_self) continue;
+        SubsurfaceT *child = wl_container_of(link, child, pending_link);
+        child->parent = NULL;
+        wl_list_remove(&child->pending_link);
+        wl_list_init(&child->pending_link);
+        wl_list_remove(&child->child.link);
+        wl_list_init(&child->child.link);
+        if (child->surface) surface_flush_cached(child->surface);
+    }
+}
+
+static void subsurface_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void subsurface_handle_set_position(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y) {
+    SubsurfaceT *subsurface = subsurface_from_resource(resource);
+    if (!subsurface->parent) return;
+    subsurface->pending_x = x;
+    subsurface->pending_y = y;
+    subsurface->parent->pending_stack_changed = true;
+}
+
+// Pending link of the parent's own entry or of a subsurface sharing the parent, NULL for
+// anything else
+static struct wl_list *sibling_pending_link(SubsurfaceT *subsurface, struct wl_resource *sibling_resource) {
+    struct pwc_surface *sibling = surface_from_resource(sibling_resource);
+    if (sibling == subsurface->parent) return &sibling->pending_self;
+
+    SubsurfaceT *other = surface_subsurface(sibling);
+    if (!other || other == subsurface || other->parent != subsurface->parent) return NULL;
+    return &other->pending_link;
+}
+
+static void subsurface_restack(struct wl_resource *resource, struct wl_resource *sibling_resource, bool above) {
+    SubsurfaceT *subsurface = subsurface_from_resource(resource);
+    if (!subsurface->parent) return;
+
+    struct wl_list *sibling = sibling_pending_link(subsurface, sibling_resource);
+    if (!sibling) {
+        wl_resource_post_error(resource, WL_SUBSURFACE_ERROR_BAD_SURFACE, "wl_surface@%u is neither a sibling nor the parent",
+                               wl_resource_get_id(sibling_resource));
+        return;
+    }
+    wl_list_remove(&subsurface->pending_link);
+    wl_list_insert(above ? sibling : sibling->prev, &subsurface->pending_link);
+    subsurface->parent->pending_stack_changed = true;
+}
+
+static void subsurface_handle_place_above(struct wl_client *client, struct wl_resource *resource, struct wl_resource *sibling) {
+    subsurface_restack(resource, sibling, true);
+}
+
+static void subsurface_handle_place_below(struct wl_client *client, struct wl_resource *resource, struct wl_resource *sibling) {
+    subsurface_restack(resource, sibling, false);
+}
+
+static void subsurface_handle_set_sync(struct wl_client *client, struct wl_resource *resource) {
+    subsurface_from_resource(resource)->synchronized = true;
+}
+
+// What it cached applies now, unless an ancestor keeps it synchronized
+static void subsurface_handle_set_desync(struct wl_client *client, struct wl_resource *resource) {
+    SubsurfaceT *subsurface = subsurface_from_resource(resource);
+    if (!subsurface->synchronized) return;
+    subsurface->synchronized = false;
+    if (subsurface->surface && !surface_synchronized(subsurface->surface)) surface_flush_cached(subsurface->surface);
+}
+
+static const struct wl_subsurface_interface subsurface_impl = {
+    .destroy = subsurface_handle_destroy,
+    .set_position = subsurface_handle_set_position,
+    .place_above = subsurface_handle_place_above,
+    .place_below = subsurface_handle_place_below,
+    .set_sync = subsurface_handle_set_sync,
+    .set_desync = subsurface_handle_set_desync,
+};
+
+// The surface is unmapped right away, it keeps the role
+static void subsurface_handle_resource_destroy(struct wl_resource *resource) {
+    SubsurfaceT *subsurface = subsurface_from_resource(resource);
+    subsurface_unlink(subsurface);
+    if (subsurface->surface) {
+        subsurface->surface->role_object = NULL;
+        surface_flush_cached(subsurface->surface);
+    }
+    free(subsurface);
+}
+
+static void subcompositor_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void subcompositor_handle_get_subsurface(struct wl_client *client, struct wl_resource *resource, uint32_t id,
+                                                struct wl_resource *surface_resource, struct wl_resource *parent_resource) {
+    struct pwc_surface *surface = surface_from_resource(surface_resource);
+    struct pwc_surface *parent = surface_from_resource(parent_resource);
+    if (surface->role_object || (surface->role != SURFACE_ROLE_NONE && surface->role != SURFACE_ROLE_SUBSURFACE)) {
+        wl_resource_post_error(resource, WL_SUBCOMPOSITOR_ERROR_BAD_SURFACE, "wl_surface@%u already has a role",
+                               wl_resource_get_id(surface_resource));
+        return;
+    }
+    // The parent must not be the surface or below it
+    for (struct pwc_surface *it = parent; it;) {
+        if (it == surface) {
+            wl_resource_post_error(resource, WL_SUBCOMPOSITOR_ERROR_BAD_PARENT, "wl_surface@%u is below wl_surface@%u",
+                                   wl_resource_get_id(parent_resource), wl_resource_get_id(surface_resource));
+            return;
+        }
+        SubsurfaceT *above = surface_subsurface(it);
+        it = above ? above->parent : NULL;
+    }
+
+    SubsurfaceT *subsurface = calloc(1, sizeof(SubsurfaceT));
+    if (!subsurface) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    subsurface->resource = wl_resource_create(client, &wl_subsurface_interface, wl_resource_get_version(resource), id);
+    if (!subsurface->resource) {
+        free(subsurface);
+        wl_client_post_no_memory(client);
+        return;
+    }
+    subsurface->surface = surface;
+    subsurface->parent = parent;
+    subsurface->synchronized = true;
+    subsurface->child.surface = surface;
+    wl_list_init(&subsurface->child.link);
+    // On top of its siblings, shown from the parent's next commit on
+    wl_list_insert(parent->pending_stack.prev, &subsurface->pending_link);
+    parent->pending_stack_changed = true;
+    surface->role = SURFACE_ROLE_SUBSURFACE;
+    surface->role_object = subsurface;
+    wl_resource_set_implementation(subsurface->resource, &subsurface_impl, subsurface, subsurface_handle_resource_destroy);
+}
+
+static const struct wl_subcompositor_interface subcompositor_impl = {
+    .destroy = subcompositor_handle_destroy,
+    .get_subsurface = subcompositor_handle_get_subsurface,
+};
+
+static void subcompositor_bind(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client, &wl_subcompositor_interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &subcompositor_impl, data, NULL);
+}
+
+struct wl_global *create_subcompositor_global(struct pwc_server *server) {
+    return wl_global_create(server->display, &wl_subcompositor_interface, SUBCOMPOSITOR_VERSION, server, subcompositor_bind);
+}
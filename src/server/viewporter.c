@@ -0,0 +1,154 @@
+#include <assert.h>
+#include <math.h>
+#include <pwc/server/server.h>
+#include <pwc/server/surface.h>
+#include <pwc/server/viewporter.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <viewporter-protocol.h>
+#include <wayland-server-core.h>
+
+static const struct wp_viewport_interface viewport_impl;
+
+// NULL once the surface was destroyed
+static struct pwc_surface *viewport_surface(struct wl_resource *resource) {
+    assert(wl_resource_instance_of(resource, &wp_viewport_interface, &viewport_impl));
+    return wl_resource_get_user_data(resource);
+}
+
+bool viewport_commit(struct pwc_surface *surface, VkExtent2D buffer_extent) {
+    const SurfaceViewportT *viewport = &surface->pending.viewport;
+    if (!surface->viewport_resource || !viewport->has_source) return true;
+
+    // Without a destination the surface takes the source's size, which must be whole
+    if (viewport->destination_width == 0 &&
+        (viewport->source_width != floorf(viewport->source_width) || viewport->source_height != floorf(viewport->source_height))) {
+        wl_resource_post_error(surface->viewport_resource, WP_VIEWPORT_ERROR_BAD_SIZE,
+                               "Source size %fx%f isn't an integer and no destination is set", viewport->source_width,
+                               viewport->source_height);
+        return false;
+    }
+    if (buffer_extent.width == 0 || buffer_extent.height == 0) return true;
+
+    // Surface coordinates: scaled, and rotated by the transform
+    bool swapped = surface->pending.transform & 1;
+    float width = (float)(swapped ? buffer_extent.height : buffer_extent.width) / surface->pending.scale;
+    float height = (float)(swapped ? buffer_extent.width : buffer_extent.height) / surface->pending.scale;
+    if (viewport->source_x + viewport->source_width > width || viewport->source_y + viewport->source_height > height) {
+        wl_resource_post_error(surface->viewport_resource, WP_VIEWPORT_ERROR_OUT_OF_BUFFER,
+                               "Source %f,%f %fx%f is outside the %fx%f buffer", viewport->source_x, viewport->source_y,
+                               viewport->source_width, viewport->source_height, width, height);
+        return false;
+    }
+    return true;
+}
+
+void viewport_surface_destroyed(struct pwc_surface *surface) {
+    if (!surface->viewport_resource) return;
+    wl_resource_set_user_data(surface->viewport_resource, NULL);
+    surface->viewport_resource = NULL;
+}
+
+static void viewport_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void viewport_handle_set_source(struct wl_client *client, struct wl_resource *resource, wl_fixed_t x, wl_fixed_t y,
+                                       wl_fixed_t width, wl_fixed_t height) {
+    struct pwc_surface *surface = viewport_surface(resource);
+    if (!surface) {
+        wl_resource_post_error(resource, WP_VIEWPORT_ERROR_NO_SURFACE, "The wl_surface was destroyed");
+        return;
+    }
+    SurfaceViewportT *viewport = &surface->pending.viewport;
+    wl_fixed_t unset = wl_fixed_from_int(-1);
+    if (x == unset && y == unset && width == unset && height == unset) {
+        viewport->has_source = false;
+        return;
+    }
+    if (x < 0 || y < 0 || width <= 0 || height <= 0) {
+        wl_resource_post_error(resource, WP_VIEWPORT_ERROR_BAD_VALUE, "Invalid source %f,%f %fx%f", wl_fixed_to_double(x),
+                               wl_fixed_to_double(y), wl_fixed_to_double(width), wl_fixed_to_double(height));
+        return;
+    }
+    viewport->has_source = true;
+    viewport->source_x = (float)wl_fixed_to_double(x);
+    viewport->source_y = (float)wl_fixed_to_double(y);
+    viewport->source_width = (float)wl_fixed_to_double(width);
+    viewport->source_height = (float)wl_fixed_to_double(height);
+}
+
+static void viewport_handle_set_destination(struct wl_client *client, struct wl_resource *resource, int32_t width,
+                                            int32_t height) {
+    struct pwc_surface *surface = viewport_surface(resource);
+    if (!surface) {
+        wl_resource_post_error(resource, WP_VIEWPORT_ERROR_NO_SURFACE, "The wl_surface was destroyed");
+        return;
+    }
+    SurfaceViewportT *viewport = &surface->pending.viewport;
+    if (width == -1 && height == -1) {
+        viewport->destination_width = 0;
+        viewport->destination_height = 0;
+        return;
+    }
+    if (width <= 0 || height <= 0) {
+        wl_resource_post_error(resource, WP_VIEWPORT_ERROR_BAD_VALUE, "Invalid destination %dx%d", width, height);
+        return;
+    }
+    viewport->destination_width = width;
+    viewport->destination_height = height;
+}
+
+static const struct wp_viewport_interface viewport_impl = {
+    .destroy = viewport_handle_destroy,
+    .set_source = viewport_handle_set_source,
+    .set_destination = viewport_handle_set_destination,
+};
+
+// The surface goes back to its buffer's size with its next commit
+static void viewport_handle_resource_destroy(struct wl_resource *resource) {
+    struct pwc_surface *surface = viewport_surface(resource);
+    if (!surface) return;
+    surface->pending.viewport = (SurfaceViewportT){0};
+    surface->viewport_resource = NULL;
+}
+
+static void viewporter_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void viewporter_handle_get_viewport(struct wl_client *client, struct wl_resource *resource, uint32_t id,
+                                           struct wl_resource *surface_resource) {
+    struct pwc_surface *surface = surface_from_resource(surface_resource);
+    if (surface->viewport_resource) {
+        wl_resource_post_error(resource, WP_VIEWPORTER_ERROR_VIEWPORT_EXISTS, "wl_surface@%u already has a viewport",
+                               wl_resource_get_id(surface_resource));
+        return;
+    }
+    struct wl_resource *viewport = wl_resource_create(client, &wp_viewport_interface, wl_resource_get_version(resource), id);
+    if (!viewport) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(viewport, &viewport_impl, surface, viewport_handle_resource_destroy);
+    surface->viewport_resource = viewport;
+}
+
+static const struct wp_viewporter_interface viewporter_impl = {
+    .destroy = viewporter_handle_destroy,
+    .get_viewport = viewporter_handle_get_viewport,
+};
+
+static void viewporter_bind(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client, &wp_viewporter_interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &viewporter_impl, data, NULL);
+}
+
+struct wl_global *create_viewporter_global(struct pwc_server *server) {
+    return wl_global_create(server->display, &wp_viewporter_interface, VIEWPORTER_VERSION, server, viewporter_bind);
+}
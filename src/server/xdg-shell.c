@@ -0,0 +1,474 @@
+#include <assert.h>
+#include <pwc/server/handoff.h>
+#include <pwc/server/linux-dmabuf.h>
+#include <pwc/server/server.h>
+#include <pwc/server/shm.h>
+#include <pwc/server/surface.h>
+#include <pwc/server/xdg-shell.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+#include <xdg-shell-protocol.h>
+
+static const struct xdg_positioner_interface positioner_impl;
+static const struct xdg_surface_interface xdg_surface_impl;
+static const struct xdg_toplevel_interface toplevel_impl;
+static const struct xdg_popup_interface popup_impl;
+
+static XdgPositionerT *positioner_from_resource(struct wl_resource *resource) {
+    assert(wl_resource_instance_of(resource, &xdg_positioner_interface, &positioner_impl));
+    return wl_resource_get_user_data(resource);
+}
+
+static XdgSurfaceT *xdg_surface_from_resource(struct wl_resource *resource) {
+    assert(wl_resource_instance_of(resource, &xdg_surface_interface, &xdg_surface_impl));
+    return wl_resource_get_user_data(resource);
+}
+
+// Anchor and gravity share their values: -1, 0 or 1 along each axis
+static void edge_direction(uint32_t edge, int32_t *dx, int32_t *dy) {
+    *dx = 0;
+    *dy = 0;
+    switch (edge) {
+        case XDG_POSITIONER_ANCHOR_TOP_LEFT:
+        case XDG_POSITIONER_ANCHOR_BOTTOM_LEFT:
+        case XDG_POSITIONER_ANCHOR_LEFT:
+            *dx = -1;
+            break;
+        case XDG_POSITIONER_ANCHOR_TOP_RIGHT:
+        case XDG_POSITIONER_ANCHOR_BOTTOM_RIGHT:
+        case XDG_POSITIONER_ANCHOR_RIGHT:
+            *dx = 1;
+            break;
+        default:
+            break;
+    }
+    switch (edge) {
+        case XDG_POSITIONER_ANCHOR_TOP_LEFT:
+        case XDG_POSITIONER_ANCHOR_TOP_RIGHT:
+        case XDG_POSITIONER_ANCHOR_TOP:
+            *dy = -1;
+            break;
+        case XDG_POSITIONER_ANCHOR_BOTTOM_LEFT:
+        case XDG_POSITIONER_ANCHOR_BOTTOM_RIGHT:
+        case XDG_POSITIONER_ANCHOR_BOTTOM:
+            *dy = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+// The popup's window geometry relative to the parent's, no constraint adjustment
+static VkRect2D positioner_place(const XdgPositionerT *positioner) {
+    int32_t anchor_dx, anchor_dy, gravity_dx, gravity_dy;
+    edge_direction(positioner->anchor, &anchor_dx, &anchor_dy);
+    edge_direction(positioner->gravity, &gravity_dx, &gravity_dy);
+
+    VkRect2D rect = positioner->anchor_rect;
+    int32_t x = rect.offset.x + (int32_t)rect.extent.width * (anchor_dx + 1) / 2;
+    int32_t y = rect.offset.y + (int32_t)rect.extent.height * (anchor_dy + 1) / 2;
+    x += positioner->width * (gravity_dx - 1) / 2 + positioner->offset_x;
+    y += positioner->height * (gravity_dy - 1) / 2 + positioner->offset_y;
+    return (VkRect2D){{x, y}, {(uint32_t)positioner->width, (uint32_t)positioner->height}};
+}
+
+static void send_configure(XdgSurfaceT *xdg) {
+    xdg->configure_serial = wl_display_next_serial(wl_client_get_display(wl_resource_get_client(xdg->resource)));
+    if (xdg->role == XDG_ROLE_TOPLEVEL) {
+        struct wl_array states;
+        wl_array_init(&states);
+        uint32_t *state = xdg->fullscreen ? wl_array_add(&states, sizeof(uint32_t)) : NULL;
+        if (state) *state = XDG_TOPLEVEL_STATE_FULLSCREEN;
+        xdg_toplevel_send_configure(xdg->role_resource, 0, 0, &states);
+        wl_array_release(&states);
+    } else {
+        VkRect2D box = positioner_place(&xdg->positioner);
+        xdg_popup_send_configure(xdg->role_resource, box.offset.x, box.offset.y, (int32_t)box.extent.width,
+                                 (int32_t)box.extent.height);
+    }
+    xdg_surface_send_configure(xdg->resource, xdg->configure_serial);
+}
+
+// Where the window is in the surface: its geometry, else the whole buffer
+static VkRect2D window_geometry(XdgSurfaceT *xdg, const SurfaceCommitT *commit) {
+    if (xdg->geometry.extent.width > 0 && xdg->geometry.extent.height > 0) return xdg->geometry;
+
+    VkExtent2D extent = {0, 0};
+    if (commit->shm) extent = commit->shm->extent;
+    if (commit->dmabuf) extent = (VkExtent2D){commit->dmabuf->attributes.width, commit->dmabuf->attributes.height};
+    return (VkRect2D){{0, 0}, {extent.width / commit->scale, extent.height / commit->scale}};
+}
+
+// Into the parent surface's popups, on top. Without a parent nothing shows it
+static void popup_map(XdgSurfaceT *xdg, const SurfaceCommitT *commit) {
+    XdgSurfaceT *parent = xdg->parent;
+    if (!parent || !parent->surface) return;
+
+    VkRect2D box = positioner_place(&xdg->positioner);
+    VkRect2D geometry = window_geometry(xdg, commit);
+    xdg->child.x = parent->geometry.offset.x + box.offset.x - geometry.offset.x;
+    xdg->child.y = parent->geometry.offset.y + box.offset.y - geometry.offset.y;
+    wl_list_insert(parent->surface->popups.prev, &xdg->child.link);
+    surface_send_stack(parent->surface);
+}
+
+// Toplevels outside a commit, popups by the parent's new stack
+static void xdg_surface_unmap(XdgSurfaceT *xdg) {
+    if (!xdg->mapped) return;
+    xdg->mapped = false;
+    if (xdg->role == XDG_ROLE_TOPLEVEL) {
+        if (xdg->surface) {
+            handoff_send(xdg->surface->server->to_render,
+                         &(HandoffMessageT){.type = HANDOFF_SURFACE_UNMAP, .surface = xdg->surface});
+        }
+        return;
+    }
+    if (wl_list_empty(&xdg->child.link)) return;
+    wl_list_remove(&xdg->child.link);
+    wl_list_init(&xdg->child.link);
+    if (xdg->parent && xdg->parent->surface) surface_send_stack(xdg->parent->surface);
+}
+
+void xdg_surface_commit(struct pwc_surface *surface, SurfaceCommitT *commit) {
+    XdgSurfaceT *xdg = surface->role_object;
+    if (!xdg) return;
+    if (xdg->role == XDG_ROLE_NONE) {
+        wl_resource_post_error(xdg->resource, XDG_SURFACE_ERROR_NOT_CONSTRUCTED, "xdg_surface has no role yet");
+        return;
+    }
+    xdg->geometry = xdg->pending_geometry;
+    if (commit->attached) xdg->buffered = commit->shm || commit->dmabuf;
+    // Its role object is gone, the surface stays unmapped
+    if (!xdg->role_resource) return;
+
+    if (xdg->buffered && !xdg->configured) {
+        wl_resource_post_error(xdg->resource, XDG_SURFACE_ERROR_UNCONFIGURED_BUFFER, "Buffer committed before the configure was acked");
+        return;
+    }
+    if (xdg->configure_serial == 0) {
+        // The initial commit, the client waits for its configure
+        send_configure(xdg);
+        return;
+    }
+    if (xdg->role == XDG_ROLE_TOPLEVEL) commit->plane_hint = xdg->fullscreen ? SCENE_PLANE_HINT_OVERLAY : SCENE_PLANE_HINT_NONE;
+    if (xdg->buffered && !xdg->mapped) {
+        xdg->mapped = true;
+        if (xdg->role == XDG_ROLE_TOPLEVEL) {
+            commit->map = SURFACE_MAP_TOPLEVEL;
+            commit->window_geometry = window_geometry(xdg, commit);
+        } else {
+            popup_map(xdg, commit);
+        }
+    } else if (!xdg->buffered && xdg->mapped) {
+        // Unmapped with a null buffer, it starts over from the initial commit
+        xdg->configure_serial = 0;
+        xdg->configured = false;
+        if (xdg->role == XDG_ROLE_TOPLEVEL) {
+            xdg->mapped = false;
+            commit->map = SURFACE_MAP_UNMAP;
+        } else {
+            xdg_surface_unmap(xdg);
+        }
+    }
+}
+
+void xdg_surface_surface_destroyed(struct pwc_surface *surface) {
+    SurfaceChildT *child, *tmp;
+    wl_list_for_each_safe(child, tmp, &surface->popups, link) {
+        wl_list_remove(&child->link);
+        wl_list_init(&child->link);
+    }
+    if (surface->role != SURFACE_ROLE_XDG || !surface->role_object) return;
+
+    XdgSurfaceT *xdg = surface->role_object;
+    xdg_surface_unmap(xdg);
+    xdg->surface = NULL;
+    surface->role_object = NULL;
+}
+
+static void resource_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void positioner_handle_set_size(struct wl_client *client, struct wl_resource *resource, int32_t width, int32_t height) {
+    if (width <= 0 || height <= 0) {
+        wl_resource_post_error(resource, XDG_POSITIONER_ERROR_INVALID_INPUT, "Invalid size %dx%d", width, height);
+        return;
+    }
+    XdgPositionerT *positioner = positioner_from_resource(resource);
+    positioner->width = width;
+    positioner->height = height;
+}
+
+static void positioner_handle_set_anchor_rect(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y,
+                                              int32_t width, int32_t height) {
+    if (width < 0 || height < 0) {
+        wl_resource_post_error(resource, XDG_POSITIONER_ERROR_INVALID_INPUT, "Invalid anchor rect size %dx%d", width, height);
+        return;
+    }
+    positioner_from_resource(resource)->anchor_rect = (VkRect2D){{x, y}, {(uint32_t)width, (uint32_t)height}};
+}
+
+static void positioner_handle_set_anchor(struct wl_client *client, struct wl_resource *resource, uint32_t anchor) {
+    if (anchor > XDG_POSITIONER_ANCHOR_BOTTOM_RIGHT) {
+        wl_resource_post_error(resource, XDG_POSITIONER_ERROR_INVALID_INPUT, "Invalid anchor %u", anchor);
+        return;
+    }
+    positioner_from_resource(resource)->anchor = anchor;
+}
+
+static void positioner_handle_set_gravity(struct wl_client *client, struct wl_resource *resource, uint32_t gravity) {
+    if (gravity > XDG_POSITIONER_GRAVITY_BOTTOM_RIGHT) {
+        wl_resource_post_error(resource, XDG_POSITIONER_ERROR_INVALID_INPUT, "Invalid gravity %u", gravity);
+        return;
+    }
+    positioner_from_resource(resource)->gravity = gravity;
+}
+
+static void positioner_handle_set_constraint_adjustment(struct wl_client *client, struct wl_resource *resource,
+                                                        uint32_t constraint_adjustment) {}
+
+static void positioner_handle_set_offset(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y) {
+    XdgPositionerT *positioner = positioner_from_resource(resource);
+    positioner->offset_x = x;
+    positioner->offset_y = y;
+}
+
+static const struct xdg_positioner_interface positioner_impl = {
+    .destroy = resource_handle_destroy,
+    .set_size = positioner_handle_set_size,
+    .set_anchor_rect = positioner_handle_set_anchor_rect,
+    .set_anchor = positioner_handle_set_anchor,
+    .set_gravity = positioner_handle_set_gravity,
+    .set_constraint_adjustment = positioner_handle_set_constraint_adjustment,
+    .set_offset = positioner_handle_set_offset,
+};
+
+static void positioner_handle_resource_destroy(struct wl_resource *resource) {
+    free(positioner_from_resource(resource));
+}
+
+// Window management isn't there yet, what a toplevel asks for is ignored
+static void toplevel_handle_set_parent(struct wl_client *client, struct wl_resource *resource, struct wl_resource *parent) {}
+static void toplevel_handle_set_title(struct wl_client *client, struct wl_resource *resource, const char *title) {}
+static void toplevel_handle_set_app_id(struct wl_client *client, struct wl_resource *resource, const char *app_id) {}
+static void toplevel_handle_show_window_menu(struct wl_client *client, struct wl_resource *resource, struct wl_resource *seat,
+                                             uint32_t serial, int32_t x, int32_t y) {}
+static void toplevel_handle_move(struct wl_client *client, struct wl_resource *resource, struct wl_resource *seat,
+                                 uint32_t serial) {}
+static void toplevel_handle_resize(struct wl_client *client, struct wl_resource *resource, struct wl_resource *seat,
+                                   uint32_t serial, uint32_t edges) {}
+static void toplevel_handle_set_max_size(struct wl_client *client, struct wl_resource *resource, int32_t width,
+                                         int32_t height) {}
+static void toplevel_handle_set_min_size(struct wl_client *client, struct wl_resource *resource, int32_t width,
+                                         int32_t height) {}
+static void toplevel_handle_set_maximized(struct wl_client *client, struct wl_resource *resource) {}
+static void toplevel_handle_unset_maximized(struct wl_client *client, struct wl_resource *resource) {}
+// Nothing resizes it, the client keeps its size and position. Its tree is hinted for a
+// display plane with its next commit, the output is ignored
+static void toplevel_set_fullscreen(struct wl_resource *resource, bool fullscreen) {
+    XdgSurfaceT *xdg = wl_resource_get_user_data(resource);
+    if (!xdg || xdg->fullscreen == fullscreen) return;
+    xdg->fullscreen = fullscreen;
+    // Before the initial commit the initial configure carries it
+    if (xdg->configure_serial != 0) send_configure(xdg);
+}
+
+static void toplevel_handle_set_fullscreen(struct wl_client *client, struct wl_resource *resource,
+                                           struct wl_resource *output) {
+    toplevel_set_fullscreen(resource, true);
+}
+static void toplevel_handle_unset_fullscreen(struct wl_client *client, struct wl_resource *resource) {
+    toplevel_set_fullscreen(resource, false);
+}
+static void toplevel_handle_set_minimized(struct wl_client *client, struct wl_resource *resource) {}
+
+static const struct xdg_toplevel_interface toplevel_impl = {
+    .destroy = resource_handle_destroy,
+    .set_parent = toplevel_handle_set_parent,
+    .set_title = toplevel_handle_set_title,
+    .set_app_id = toplevel_handle_set_app_id,
+    .show_window_menu = toplevel_handle_show_window_menu,
+    .move = toplevel_handle_move,
+    .resize = toplevel_handle_resize,
+    .set_max_size = toplevel_handle_set_max_size,
+    .set_min_size = toplevel_handle_set_min_size,
+    .set_maximized = toplevel_handle_set_maximized,
+    .unset_maximized = toplevel_handle_unset_maximized,
+    .set_fullscreen = toplevel_handle_set_fullscreen,
+    .unset_fullscreen = toplevel_handle_unset_fullscreen,
+    .set_minimized = toplevel_handle_set_minimized,
+};
+
+static void popup_handle_grab(struct wl_client *client, struct wl_resource *resource, struct wl_resource *seat,
+                              uint32_t serial) {}
+
+static const struct xdg_popup_interface popup_impl = {
+    .destroy = resource_handle_destroy,
+    .grab = popup_handle_grab,
+};
+
+// Unmaps the surface, the xdg_surface can't take another role. NULL user data: the
+// xdg_surface went first
+static void role_handle_resource_destroy(struct wl_resource *resource) {
+    XdgSurfaceT *xdg = wl_resource_get_user_data(resource);
+    if (!xdg) return;
+    xdg_surface_unmap(xdg);
+    xdg->role_resource = NULL;
+}
+
+static bool xdg_surface_construct(XdgSurfaceT *xdg, struct wl_client *client, uint32_t id,
+                                  const struct wl_interface *interface, const void *implementation) {
+    if (xdg->role != XDG_ROLE_NONE) {
+        wl_resource_post_error(xdg->resource, XDG_SURFACE_ERROR_ALREADY_CONSTRUCTED, "xdg_surface already has a role");
+        return false;
+    }
+    xdg->role_resource = wl_resource_create(client, interface, wl_resource_get_version(xdg->resource), id);
+    if (!xdg->role_resource) {
+        wl_client_post_no_memory(client);
+        return false;
+    }
+    wl_resource_set_implementation(xdg->role_resource, implementation, xdg, role_handle_resource_destroy);
+    return true;
+}
+
+static void xdg_surface_handle_get_toplevel(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    XdgSurfaceT *xdg = xdg_surface_from_resource(resource);
+    if (!xdg_surface_construct(xdg, client, id, &xdg_toplevel_interface, &toplevel_impl)) return;
+    xdg->role = XDG_ROLE_TOPLEVEL;
+}
+
+static void xdg_surface_handle_get_popup(struct wl_client *client, struct wl_resource *resource, uint32_t id,
+                                         struct wl_resource *parent_resource, struct wl_resource *positioner_resource) {
+    XdgSurfaceT *xdg = xdg_surface_from_resource(resource);
+    XdgPositionerT *positioner = positioner_from_resource(positioner_resource);
+    if (positioner->width <= 0 || positioner->height <= 0 || positioner->anchor_rect.extent.width == 0 ||
+        positioner->anchor_rect.extent.height == 0) {
+        wl_resource_post_error(positioner_resource, XDG_POSITIONER_ERROR_INVALID_INPUT, "Positioner lacks a size or anchor rect");
+        return;
+    }
+    if (!xdg_surface_construct(xdg, client, id, &xdg_popup_interface, &popup_impl)) return;
+    xdg->role = XDG_ROLE_POPUP;
+    xdg->positioner = *positioner;
+    if (parent_resource) {
+        xdg->parent = xdg_surface_from_resource(parent_resource);
+        wl_list_insert(&xdg->parent->popups, &xdg->popup_link);
+    }
+}
+
+static void xdg_surface_handle_set_window_geometry(struct wl_client *client, struct wl_resource *resource, int32_t x,
+                                                   int32_t y, int32_t width, int32_t height) {
+    if (width <= 0 || height <= 0) {
+        wl_resource_post_error(resource, XDG_SURFACE_ERROR_INVALID_SIZE, "Invalid window geometry size %dx%d", width, height);
+        return;
+    }
+    xdg_surface_from_resource(resource)->pending_geometry = (VkRect2D){{x, y}, {(uint32_t)width, (uint32_t)height}};
+}
+
+// Only the last configure matters, older acks are as good
+static void xdg_surface_handle_ack_configure(struct wl_client *client, struct wl_resource *resource, uint32_t serial) {
+    XdgSurfaceT *xdg = xdg_surface_from_resource(resource);
+    if (xdg->configure_serial == 0) {
+        wl_resource_post_error(resource, XDG_SURFACE_ERROR_INVALID_SERIAL, "No configure was sent");
+        return;
+    }
+    xdg->configured = true;
+}
+
+static const struct xdg_surface_interface xdg_surface_impl = {
+    .destroy = resource_handle_destroy,
+    .get_toplevel = xdg_surface_handle_get_toplevel,
+    .get_popup = xdg_surface_handle_get_popup,
+    .set_window_geometry = xdg_surface_handle_set_window_geometry,
+    .ack_configure = xdg_surface_handle_ack_configure,
+};
+
+// Popups on it are unmapped and stay without a parent
+static void xdg_surface_handle_resource_destroy(struct wl_resource *resource) {
+    XdgSurfaceT *xdg = xdg_surface_from_resource(resource);
+    xdg_surface_unmap(xdg);
+    if (xdg->role_resource) wl_resource_set_user_data(xdg->role_resource, NULL);
+
+    XdgSurfaceT *popup, *tmp;
+    wl_list_for_each_safe(popup, tmp, &xdg->popups, popup_link) {
+        xdg_surface_unmap(popup);
+        popup->parent = NULL;
+        wl_list_remove(&popup->popup_link);
+        wl_list_init(&popup->popup_link);
+    }
+    wl_list_remove(&xdg->popup_link);
+    if (xdg->surface) xdg->surface->role_object = NULL;
+    free(xdg);
+}
+
+static void wm_base_handle_create_positioner(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    XdgPositionerT *positioner = calloc(1, sizeof(XdgPositionerT));
+    if (!positioner) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    struct wl_resource *positioner_resource =
+        wl_resource_create(client, &xdg_positioner_interface, wl_resource_get_version(resource), id);
+    if (!positioner_resource) {
+        free(positioner);
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(positioner_resource, &positioner_impl, positioner, positioner_handle_resource_destroy);
+}
+
+static void wm_base_handle_get_xdg_surface(struct wl_client *client, struct wl_resource *resource, uint32_t id,
+                                           struct wl_resource *surface_resource) {
+    struct pwc_surface *surface = surface_from_resource(surface_resource);
+    if (surface->role_object || (surface->role != SURFACE_ROLE_NONE && surface->role != SURFACE_ROLE_XDG)) {
+        wl_resource_post_error(resource, XDG_WM_BASE_ERROR_ROLE, "wl_surface@%u already has a role",
+                               wl_resource_get_id(surface_resource));
+        return;
+    }
+
+    XdgSurfaceT *xdg = calloc(1, sizeof(XdgSurfaceT));
+    if (!xdg) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    xdg->resource = wl_resource_create(client, &xdg_surface_interface, wl_resource_get_version(resource), id);
+    if (!xdg->resource) {
+        free(xdg);
+        wl_client_post_no_memory(client);
+        return;
+    }
+    xdg->surface = surface;
+    xdg->child.surface = surface;
+    wl_list_init(&xdg->child.link);
+    wl_list_init(&xdg->popups);
+    wl_list_init(&xdg->popup_link);
+    surface->role = SURFACE_ROLE_XDG;
+    surface->role_object = xdg;
+    wl_resource_set_implementation(xdg->resource, &xdg_surface_impl, xdg, xdg_surface_handle_resource_destroy);
+}
+
+static void wm_base_handle_pong(struct wl_client *client, struct wl_resource *resource, uint32_t serial) {}
+
+static const struct xdg_wm_base_interface wm_base_impl = {
+    .destroy = resource_handle_destroy,
+    .create_positioner = wm_base_handle_create_positioner,
+    .get_xdg_surface = wm_base_handle_get_xdg_surface,
+    .pong = wm_base_handle_pong,
+};
+
+static void wm_base_bind(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client, &xdg_wm_base_interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+    wl_resource_set_implementation(resource, &wm_base_impl, data, NULL);
+}
+
+struct wl_global *create_xdg_shell_global(struct pwc_server *server) {
+    return wl_global_create(server->display, &xdg_wm_base_interface, XDG_WM_BASE_VERSION, server, wm_base_bind);
+}